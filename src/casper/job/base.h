@@ -24,6 +24,12 @@
 
 #include "casper/job/basic.h"
 
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm> // std::stable_sort
+#include <functional>
+
 namespace casper
 {
 
@@ -34,6 +40,30 @@ namespace casper
         class Base : public ::casper::job::Basic<S>
         {
 
+        public: // Data Type(s)
+
+            typedef struct {
+                uint64_t    id_;      //!< Job ID.
+                std::string rcid_;    //!< REDIS channel ID.
+                std::string rjid_;    //!< REDIS job key.
+                Json::Value payload_; //!< Job payload.
+                std::chrono::steady_clock::time_point reserved_; //!< When job was reserved ( or enqueued ), it's validity counts from there; epoch for now.
+            } Batched;
+
+            typedef struct {
+                uint64_t before_; //!< Batched jobs rejected, without being run, because their deadline passed while waiting.
+                uint64_t after_;  //!< Batched jobs that finished after their deadline.
+            } Misses;
+
+        private: // Data
+
+            size_t               batch_;    //!< Maximum number of jobs per \link RunBatch \link call, 0 when batch mode is disabled.
+            bool                 edf_;      //!< When set, batched jobs are run earliest deadline first.
+            size_t               linger_;   //!< In ms, how long the first gathered job waits for others to be reserved.
+            Misses               misses_;
+            std::vector<Batched> gathered_; //!< Jobs reserved by the looper, waiting for the next \link Flush \link.
+            bool                 flushing_; //!< True while a \link Flush \link is scheduled.
+
         public: // Constructor(s) / Destructor
             
             Base () = delete;
@@ -45,15 +75,46 @@ namespace casper
 
             virtual void Setup ();
             virtual void Run   (const uint64_t& a_id, const Json::Value& a_payload, cc::easy::job::Job::Response& o_response);
-            
+
+        public: // Method(s) / Function(s)
+
+            void RunBatch (const std::vector<Batched>& a_jobs);
+
+        public: // Inline Method(s) / Function(s)
+
+            /**
+             * @return Maximum number of ready jobs to reserve for a single \link RunBatch \link call, 0 if batch mode is disabled.
+             */
+            inline size_t batch () const
+            {
+                return batch_;
+            }
+
+            /**
+             * @return R/O access to batched jobs deadline \link Misses \link.
+             */
+            inline const Misses& misses () const
+            {
+                return misses_;
+            }
+
         protected: // Virtual Method(s) / Function(s)
             
-            virtual void InnerSetup () {}
-            virtual void InnerRun   (const uint64_t& a_id, const Json::Value& a_payload, cc::easy::job::Job::Response& o_response) = 0;
+            virtual void InnerSetup    () {}
+            virtual void InnerRun      (const uint64_t& a_id, const Json::Value& a_payload, cc::easy::job::Job::Response& o_response) = 0;
+            virtual void InnerRunBatch (const std::vector<const Batched*>& a_jobs, std::vector<cc::easy::job::Job::Response>& o_responses);
             
         protected: // Method(s) / Function(s)
             
-            void Log (const size_t a_level, const char* const a_step, const std::string& a_message);
+            void Log     (const size_t a_level, const char* const a_step, const std::string& a_message);
+            void Process (const std::vector<Batched>& a_jobs, std::vector<cc::easy::job::Job::Response>& o_responses);
+
+        private: // Method(s) / Function(s)
+
+            bool     Gather   (const uint64_t& a_id, const Json::Value& a_payload);
+            void     Flush    ();
+            void     Guard    (std::function<void()> a_function, cc::easy::job::Job::Response& o_response);
+            uint64_t Lifetime (const Json::Value& a_payload);
         
         }; // end of class 'Job'
             
@@ -67,7 +128,8 @@ namespace casper
         template <typename S, S doneValue>
         ::casper::job::Base<S, doneValue>::Base (const std::string& a_tube,
                                                  const ev::Loggable::Data& a_loggable_data, const cc::easy::job::Job::Config& a_config)
-            : ::casper::job::Basic<S>::Basic(a_tube, a_loggable_data, a_config)
+            : ::casper::job::Basic<S>::Basic(a_tube, a_loggable_data, a_config),
+            batch_(0), edf_(false), linger_(0), misses_({ 0, 0 }), flushing_(false)
         {
             /* empty */
         }
@@ -88,6 +150,19 @@ namespace casper
         void ::casper::job::Base<S, doneValue>::Setup ()
         {
             ::casper::job::Basic<S>::Setup();
+            // ... batch mode?
+            const ::cc::easy::JSON<::cc::Exception> json;
+            const Json::Value  c_max    = 0;
+            const Json::Value& batch    = json.Get(::casper::job::Basic<S>::config_.other(), "batch", Json::ValueType::objectValue, &Json::Value::null);
+            const Json::Value  c_edf    = false;
+            const Json::Value  c_linger = 0;
+            batch_  = static_cast<size_t>(json.Get(batch, "max", Json::ValueType::uintValue, &c_max).asUInt64());
+            edf_    = json.Get(batch, "edf", Json::ValueType::booleanValue, &c_edf).asBool();
+            linger_ = static_cast<size_t>(json.Get(batch, "linger", Json::ValueType::uintValue, &c_linger).asUInt64());
+            // ... results of gathered jobs are published later, job must be deferrable ...
+            if ( 0 != batch_ && false == ::casper::job::Basic<S>::Deferred() ) {
+                throw ::cc::Exception("%s", "Batch mode requires a tube whose results can be deferred!");
+            }
             InnerSetup();
         }
     
@@ -105,6 +180,12 @@ namespace casper
             // ... sanity check ...
             CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::Basic<S>::thread_id_);
 
+            // ... batch mode? job result is published when it's batch runs, batch is logged as a whole ...
+            if ( true == Gather(a_id, a_payload) ) {
+                o_response.code_ = CC_STATUS_CODE_OK;
+                return;
+            }
+
             Json::FastWriter jfw; jfw.omitEndingLineFeed();
 
             // ... log request ...
@@ -121,10 +202,300 @@ namespace casper
             // ... assuming BAD REQUEST ...
             o_response.code_ = CC_STATUS_CODE_BAD_REQUEST;
             
+            // ... run, expanding payload if it's compressed ...
+            ::casper::job::Basic<S>::Negotiate(a_id, a_payload);
+            Guard([this, &a_id, &a_payload, &o_response] () {
+                Json::Value inflated;
+                if ( true == ::casper::job::Basic<S>::Inflate(a_payload, inflated) ) {
+                    InnerRun(a_id, inflated, o_response);
+                } else {
+                    InnerRun(a_id, a_payload, o_response);
+                }
+            }, o_response);
+
+            // ... spill or compress result, unless it will be published later ...
+            if ( false == this->Pending(o_response) ) {
+                Guard([this, &a_id, &o_response] () {
+                    ::casper::job::Basic<S>::Conclude(a_id, o_response.code_, o_response.payload_);
+                }, o_response);
+            }
+        }
+
+        /**
+         * @brief Process a batch of jobs to this tube, each one is finished independently.
+         *
+         * @param a_jobs Jobs, at most \link batch \link.
+         *
+         * @note Job validity is counted from it's \link Batched::reserved_ \link time, jobs whose deadline passed while waiting
+         *       ( to be gathered or for their turn ) are rejected without being run.
+         */
+        template <typename S, S doneValue>
+        void ::casper::job::Base<S, doneValue>::RunBatch (const std::vector<Batched>& a_jobs)
+        {
+            // ... sanity check ...
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::Basic<S>::thread_id_);
+
+            if ( 0 == batch_ || a_jobs.size() > batch_ ) {
+                throw ::cc::Exception("Invalid batch of " SIZET_FMT " job(s), batch mode limit is " SIZET_FMT "!", a_jobs.size(), batch_);
+            }
+
+            // ... log request, once for the whole batch ...
+            CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_IN,
+                           "Batch: " SIZET_FMT " job(s)", a_jobs.size()
+            );
+
             // ... run ...
+            std::vector<cc::easy::job::Job::Response> responses;
+            Process(a_jobs, responses);
+
+            // ... publish results, back-to-back ...
+            size_t failed = 0;
+            for ( size_t idx = 0 ; idx < a_jobs.size() ; ++idx ) {
+                Guard([this, &a_jobs, &responses, idx] () {
+                    ::casper::job::Basic<S>::Conclude(a_jobs[idx].id_, responses[idx].code_, responses[idx].payload_);
+                }, responses[idx]);
+                Json::Value result = Json::Value::null;
+                if ( CC_STATUS_CODE_OK == responses[idx].code_ ) {
+                    (void)::casper::job::Basic<S>::SetCompletedResponse(responses[idx].payload_, result);
+                } else {
+                    (void)::casper::job::Basic<S>::SetFailedResponse(responses[idx].code_, responses[idx].payload_, result);
+                    failed++;
+                }
+                const uint64_t id = a_jobs[idx].id_;
+                ::casper::job::Basic<S>::Finished(/* a_id               */ id,
+                                                  /* a_channel          */ a_jobs[idx].rcid_,
+                                                  /* a_key              */ a_jobs[idx].rjid_,
+                                                  /* a_response         */ result,
+                                                  /* a_success_callback */ nullptr,
+                                                  /* a_failure_callback */
+                                                  [this, id](const ev::Exception& a_ev_exception) {
+                                                      // ... log error ...
+                                                      CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_ERR, CC_JOB_LOG_STEP_ERROR,
+                                                                     CC_JOB_LOG_COLOR(LIGHT_RED) "%s" CC_LOGS_LOGGER_RESET_ATTRS " - %s " UINT64_FMT ": %s",
+                                                                     "FAILED", "while publishing finished notification of batched job", id, a_ev_exception.what()
+                                                      );
+                                                  }
+                );
+            }
+
+            // ... status, once for the whole batch ...
+            CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATUS,
+                           "Batch: " SIZET_FMT " succeeded, " SIZET_FMT " failed; deadline misses " UINT64_FMT " before, " UINT64_FMT " after start",
+                           a_jobs.size() - failed, failed, misses_.before_, misses_.after_
+            );
+        }
+
+        /**
+         * @brief Run a batch of jobs, without publishing their results: jobs whose deadline passed are rejected, the others
+         *        run through \link InnerRunBatch \link and, if it throws, one by one so that a bad job fails alone.
+         *
+         * @param a_jobs      Jobs, at most \link batch \link.
+         * @param o_responses One response per job, in \link a_jobs \link order.
+         */
+        template <typename S, S doneValue>
+        void ::casper::job::Base<S, doneValue>::Process (const std::vector<Batched>& a_jobs, std::vector<cc::easy::job::Job::Response>& o_responses)
+        {
+            // ... sanity check ...
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::Basic<S>::thread_id_);
+
+            // ... deadlines, no deadline is represented by the epoch ...
+            const auto                                         now = std::chrono::steady_clock::now();
+            std::vector<std::chrono::steady_clock::time_point> deadlines;
+            std::vector<size_t>                                order;
+            for ( size_t idx = 0 ; idx < a_jobs.size() ; ++idx ) {
+                const uint64_t validity = Lifetime(a_jobs[idx].payload_);
+                const auto     from     = ( std::chrono::steady_clock::time_point() != a_jobs[idx].reserved_ ? a_jobs[idx].reserved_ : now );
+                deadlines.push_back(0 == validity ? std::chrono::steady_clock::time_point() : from + std::chrono::seconds(validity));
+                order.push_back(idx);
+            }
+            // ... earliest deadline first? ties, and jobs without a deadline, keep arrival order ...
+            if ( true == edf_ ) {
+                std::stable_sort(order.begin(), order.end(), [&deadlines] (const size_t& a_lhs, const size_t& a_rhs) {
+                    if ( std::chrono::steady_clock::time_point() == deadlines[a_lhs] ) {
+                        return false;
+                    }
+                    return ( std::chrono::steady_clock::time_point() == deadlines[a_rhs] || deadlines[a_lhs] < deadlines[a_rhs] );
+                });
+            }
+
+            // ... assuming BAD REQUEST ...
+            std::vector<cc::easy::job::Job::Response>& responses = o_responses;
+            responses.clear();
+            responses.resize(a_jobs.size());
+            for ( auto& response : responses ) {
+                response.code_ = CC_STATUS_CODE_BAD_REQUEST;
+            }
+
+            // ... a job whose deadline passed is rejected before it's payload is processed ...
+            std::vector<bool> rejected(a_jobs.size(), false);
+            const auto expired = [this, &deadlines, &responses, &rejected] (const size_t a_idx) -> bool {
+                if ( std::chrono::steady_clock::time_point() == deadlines[a_idx] || std::chrono::steady_clock::now() < deadlines[a_idx] ) {
+                    return false;
+                }
+                misses_.before_++;
+                rejected[a_idx] = true;
+                responses[a_idx].code_ = ::casper::job::Basic<S>::SetError(CC_STATUS_CODE_GATEWAY_TIMEOUT,
+                                                                          /* a_i18n */ &::casper::job::Base<S, doneValue>::I18NError(),
+                                                                          /* a_error */ {
+                                                                              /* code_ */ nullptr,
+                                                                              /* why_  */ "Deadline exceeded before job was started!"
+                                                                          },
+                                                                          responses[a_idx].payload_
+                );
+                return true;
+            };
+            std::vector<size_t>         live;
+            std::vector<const Batched*> jobs;
+            std::deque<Batched>         inflated; //!< Expanded copies of compressed payloads, stable addresses.
+            for ( const auto idx : order ) {
+                ::casper::job::Basic<S>::Negotiate(a_jobs[idx].id_, a_jobs[idx].payload_);
+                if ( true == expired(idx) ) {
+                    continue;
+                }
+                const Batched* job = &a_jobs[idx];
+                bool           ok  = false;
+                Guard([this, &a_jobs, &inflated, &job, &ok, idx] () {
+                    Json::Value payload;
+                    if ( true == ::casper::job::Basic<S>::Inflate(a_jobs[idx].payload_, payload) ) {
+                        inflated.push_back({ /* id_ */ a_jobs[idx].id_, /* rcid_ */ a_jobs[idx].rcid_, /* rjid_ */ a_jobs[idx].rjid_, /* payload_ */ Json::Value::null, /* reserved_ */ a_jobs[idx].reserved_ });
+                        inflated.back().payload_.swap(payload);
+                        job = &inflated.back();
+                    }
+                    ok = true;
+                }, responses[idx]);
+                if ( true == ok ) {
+                    live.push_back(idx);
+                    jobs.push_back(job);
+                }
+            }
+
+            // ... run ...
+            std::vector<cc::easy::job::Job::Response> results;
+            results.resize(jobs.size());
+            for ( auto& result : results ) {
+                result.code_ = CC_STATUS_CODE_BAD_REQUEST;
+            }
+            cc::easy::job::Job::Response batch;
+            batch.code_ = CC_STATUS_CODE_OK;
+            if ( 0 != jobs.size() ) {
+                Guard([this, &jobs, &results] () {
+                    InnerRunBatch(jobs, results);
+                }, batch);
+            }
+
+            // ... whole batch failed? isolate bad payload(s) by running each job on it's own ...
+            if ( CC_STATUS_CODE_OK != batch.code_ || results.size() != jobs.size() ) {
+                CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_WRN, CC_JOB_LOG_STEP_INFO,
+                               "Batch: failed with " UINT16_FMT ", running " SIZET_FMT " job(s) one by one", batch.code_, jobs.size()
+                );
+                for ( size_t pos = 0 ; pos < live.size() ; ++pos ) {
+                    const size_t idx = live[pos];
+                    if ( true == expired(idx) ) {
+                        continue;
+                    }
+                    Guard([this, &jobs, &responses, pos, idx] () {
+                        InnerRun(jobs[pos]->id_, jobs[pos]->payload_, responses[idx]);
+                    }, responses[idx]);
+                }
+            } else {
+                for ( size_t idx = 0 ; idx < live.size() ; ++idx ) {
+                    responses[live[idx]] = results[idx];
+                }
+            }
+
+            // ... late?
+            const auto finished = std::chrono::steady_clock::now();
+            for ( const auto idx : live ) {
+                if ( std::chrono::steady_clock::time_point() != deadlines[idx] && finished >= deadlines[idx] && false == rejected[idx] ) {
+                    misses_.after_++;
+                }
+            }
+        }
+
+        /**
+         * @brief Keep a job reserved by the looper for the next batch, the looper keeps reserving ready jobs until a
+         *        \link Flush \link runs them.
+         *
+         * @param a_id      Job ID.
+         * @param a_payload Job payload.
+         *
+         * @return True if job was gathered, false if batch mode is disabled or job was chained and must run now.
+         *
+         * @note Payload is moved out, not copied: the looper is done with the payload it parsed once \link Run \link returns.
+         */
+        template <typename S, S doneValue>
+        bool ::casper::job::Base<S, doneValue>::Gather (const uint64_t& a_id, const Json::Value& a_payload)
+        {
+            if ( 0 == batch_ || nullptr != ::casper::job::Basic<S>::Chained() ) {
+                return false;
+            }
+            gathered_.push_back({ /* id_ */ a_id, /* rcid_ */ ::casper::job::Basic<S>::RCID(), /* rjid_ */ ::casper::job::Basic<S>::RJID(), /* payload_ */ Json::Value::null,
+                                  /* reserved_ */ std::chrono::steady_clock::now() });
+            gathered_.back().payload_.swap(const_cast<Json::Value&>(a_payload));
+            if ( false == flushing_ ) {
+                // ... runs after looper is done with jobs already reserved ( or after linger time ) ...
+                flushing_ = true;
+                ::casper::job::Basic<S>::ScheduleCallbackOnLooperThread("batch-flush", [this] (const std::string&) {
+                    Flush();
+                }, linger_);
+            }
+            return true;
+        }
+
+        /**
+         * @brief Run gathered jobs, in batches of at most \link batch \link jobs.
+         */
+        template <typename S, S doneValue>
+        void ::casper::job::Base<S, doneValue>::Flush ()
+        {
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::Basic<S>::thread_id_);
+            flushing_ = false;
+            std::vector<Batched> gathered;
+            gathered.swap(gathered_);
+            for ( size_t first = 0 ; first < gathered.size() ; first += batch_ ) {
+                const size_t         last = std::min(first + batch_, gathered.size());
+                std::vector<Batched> jobs;
+                jobs.reserve(last - first);
+                for ( size_t idx = first ; idx < last ; ++idx ) {
+                    jobs.push_back(Batched({ gathered[idx].id_, gathered[idx].rcid_, gathered[idx].rjid_, Json::Value::null, gathered[idx].reserved_ }));
+                    jobs.back().payload_.swap(gathered[idx].payload_);
+                }
+                RunBatch(jobs);
+            }
+        }
+
+        /**
+         * @brief Process a batch of jobs, by default one by one.
+         *
+         * @param a_jobs      Jobs, in the order they should run.
+         * @param o_responses One response per job, in the same order, each one already set to BAD REQUEST.
+         *
+         * @note Per-job errors must be reported in it's own response; if this function throws, the whole batch is discarded
+         *       and each job is run again by \link InnerRun \link, so overrides should not have side effects until they succeed.
+         */
+        template <typename S, S doneValue>
+        void ::casper::job::Base<S, doneValue>::InnerRunBatch (const std::vector<const Batched*>& a_jobs, std::vector<cc::easy::job::Job::Response>& o_responses)
+        {
+            for ( size_t idx = 0 ; idx < a_jobs.size() ; ++idx ) {
+                Guard([this, &a_jobs, &o_responses, idx] () {
+                    InnerRun(a_jobs[idx]->id_, a_jobs[idx]->payload_, o_responses[idx]);
+                }, o_responses[idx]);
+            }
+        }
+
+        /**
+         * @brief Call a function, translating any exception it throws to an error response.
+         *
+         * @param a_function Function to call.
+         *
+         * @param o_response JSON object.
+         */
+        template <typename S, S doneValue>
+        void ::casper::job::Base<S, doneValue>::Guard (std::function<void()> a_function, cc::easy::job::Job::Response& o_response)
+        {
             try {
 
-                InnerRun(a_id, a_payload, o_response);
+                a_function();
 
             } catch (const ::cc::BadRequest& a_br_exception) {
                 // ... parsing error ...
@@ -187,7 +558,25 @@ namespace casper
                 }
             }
         }
-        
+
+        /**
+         * @return Job validity, in seconds, read without processing the rest of it's payload; 0 for no deadline.
+         *
+         * @param a_payload Job payload, as received from beanstalkd or from nginx-broker.
+         */
+        template <typename S, S doneValue>
+        uint64_t ::casper::job::Base<S, doneValue>::Lifetime (const Json::Value& a_payload)
+        {
+            const Json::Value& object = ( true == a_payload.isObject() && true == a_payload.isMember("body") && true == a_payload.isMember("headers") ? a_payload["body"] : a_payload );
+            if ( true == object.isObject() ) {
+                const Json::Value& validity = object["validity"];
+                if ( true == validity.isUInt64() ) {
+                    return validity.asUInt64();
+                }
+            }
+            return static_cast<uint64_t>(::casper::job::Basic<S>::Validity());
+        }
+
         /**
          * @brief Log a message.
          *
@@ -34,6 +34,14 @@
 #include "cc/easy/json.h"
 #include "cc/i18n/singleton.h"
 
+#include "casper/job/chain.h"
+#include "casper/job/envelope.h"
+#include "casper/job/codec.h"
+#include "casper/job/compressor.h"
+#include "casper/job/spill.h"
+
+#include <set>
+
 namespace casper
 {
 
@@ -62,11 +70,25 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
               "JOB", a_step, __VA_ARGS__ \
 );
 
+        private: // Data Type(s)
+
+            typedef struct {
+                std::mutex mutex_;
+                bool       alive_;
+            } Liveness;
+
         private: // Data
             
             ::cc::easy::job::I18N* i18n_in_progress_;
             ::cc::easy::job::I18N* i18n_completed_;
             ::cc::easy::job::I18N* i18n_error_;
+            const Chain::Origin*   origin_;    //!< Set while running a chained job.
+            Codec::Encoding        encoding_;  //!< How this tube encodes payloads and responses it produces.
+            Compressor*            compressor_;
+            std::set<uint64_t>     deflatable_; //!< IDs of running jobs whose producer accepts compressed results.
+            std::set<uint64_t>     encodable_;  //!< IDs of running jobs whose producer accepts results in this tube's binary encoding.
+            Spill*                 spill_;
+            std::shared_ptr<Liveness> chained_; //!< Shared with chained payloads in transit, so they can tell if this instance was disposed.
 
         public: // Constructor(s) / Destructor
             
@@ -93,6 +115,20 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
 
             const Json::Value& Payload        (const Json::Value& a_payload, bool* o_broker = nullptr, bool* o_with_job_role = nullptr);
             const bool         SourceIsBroker (const Json::Value& a_payload, bool* o_with_job_role);
+            const bool         Peek           (const std::string& a_raw, Envelope::Fields& o_fields, bool* o_broker = nullptr, bool* o_with_job_role = nullptr);
+            void               Decode         (const std::string& a_data, Json::Value& o_value) const;
+            void               Encode         (const Json::Value& a_value, std::string& o_data) const;
+            bool               Inflate        (const Json::Value& a_payload, Json::Value& o_payload);
+            void               Negotiate      (const uint64_t& a_id, const Json::Value& a_payload);
+            void               Deflate        (const uint64_t& a_id, const uint16_t a_code, Json::Value& io_payload);
+            void               Forget         (const uint64_t& a_id);
+            bool               Spool          (const uint64_t& a_id, const Spill::Producer& a_producer, const std::string& a_content_type, Json::Value& o_reference);
+            bool               Spool          (const uint64_t& a_id, const std::string& a_data, const std::string& a_content_type, Json::Value& o_reference);
+            void               Conclude       (const uint64_t& a_id, const uint16_t a_code, Json::Value& io_payload);
+
+        private: // Static Method(s) / Function(s)
+
+            static bool RoleMask (const std::string& a_header, bool& o_with_job_role);
                             
         protected: // Method(s) / Function(s)
             
@@ -104,6 +140,51 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
                           const char* const a_i18n_key,
                           const std::map<std::string, Json::Value>& a_arguments);
             
+        protected: // Method(s) / Function(s)
+
+            bool Handoff (const std::string& a_tube, const Chain::Origin& a_origin, Json::Value& io_payload);
+            bool Handoff (const std::string& a_tube, const Chain::Origin& a_origin, std::string& io_payload);
+            bool Touch   (const uint64_t& a_id);
+
+        protected: // Virtual Method(s) / Function(s)
+
+            virtual void Relay   (const Chain::Origin& a_origin, Chain::Payload& a_payload);
+            virtual bool Pending (const cc::easy::job::Job::Response& a_response) const;
+
+        protected: // Inline Method(s) / Function(s)
+
+            /**
+             * @return Chained job identifiers, nullptr if current job was reserved from beanstalkd.
+             */
+            inline const Chain::Origin* Chained () const
+            {
+                return origin_;
+            }
+
+            /**
+             * @return How this tube encodes payloads and responses it produces.
+             */
+            inline Codec::Encoding encoding () const
+            {
+                return encoding_;
+            }
+
+            /**
+             * @return This tube's compressor, nullptr until \link Setup \link.
+             */
+            inline const Compressor* compressor () const
+            {
+                return compressor_;
+            }
+
+            /**
+             * @return This tube's spill to file helper, nullptr until \link Setup \link.
+             */
+            inline const Spill* spill () const
+            {
+                return spill_;
+            }
+
         protected: // Method(s) / Function(s)
             
             void                         OverrideI18N   (const Json::Value& a_value);
@@ -131,9 +212,10 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
         casper::job::Basic<S>::Basic (const std::string& a_tube,
                                           const ev::Loggable::Data& a_loggable_data, const cc::easy::job::Job::Config& a_config)
             : cc::easy::job::Job(a_loggable_data, a_tube, a_config),
-             i18n_in_progress_(nullptr), i18n_completed_(nullptr), i18n_error_(nullptr)
+             i18n_in_progress_(nullptr), i18n_completed_(nullptr), i18n_error_(nullptr), origin_(nullptr), encoding_(Codec::Encoding::JSON), compressor_(nullptr), spill_(nullptr)
         {
-            /* empty */
+            chained_ = std::make_shared<Liveness>();
+            chained_->alive_ = true;
         }
 
         /**
@@ -142,6 +224,12 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
         template <typename S>
         casper::job::Basic<S>::~Basic ()
         {
+            // ... no more payloads for this instance, and those already posted must not reach it ...
+            ::casper::job::Chain::GetInstance().Unregister(tube_, this);
+            {
+                std::lock_guard<std::mutex> lock(chained_->mutex_);
+                chained_->alive_ = false;
+            }
             if ( nullptr != i18n_in_progress_ ) {
                 delete i18n_in_progress_;
             }
@@ -151,6 +239,12 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
             if ( nullptr != i18n_error_ ) {
                 delete i18n_error_;
             }
+            if ( nullptr != compressor_ ) {
+                delete compressor_;
+            }
+            if ( nullptr != spill_ ) {
+                delete spill_;
+            }
         }
 
         /**
@@ -160,13 +254,53 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
         void casper::job::Basic<S>::Setup ()
         {
             CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            std::string        output;
             const Json::Value& directories = GetJSONObject(config_.other(), "directories", Json::ValueType::objectValue, &Json::Value::null);
             if ( false == directories.isNull() ) {
                 const Json::Value& tmp = GetJSONObject(directories, "tmp", Json::ValueType::stringValue, &Json::Value::null);
                 if ( false == tmp.isNull() ) {
-                    SetOutputDirectoryPrefix(OSAL_NORMALIZE_PATH(tmp.asString()));
+                    output = OSAL_NORMALIZE_PATH(tmp.asString());
+                    SetOutputDirectoryPrefix(output);
                 }
             }
+            // ... encoding ...
+            encoding_ = Codec::Load(GetJSONObject(config_.other(), "encoding", Json::ValueType::stringValue, &Json::Value::null));
+            // ... compression ...
+            if ( nullptr != compressor_ ) {
+                delete compressor_;
+            }
+            compressor_ = new Compressor(Compressor::Load(GetJSONObject(config_.other(), "compression", Json::ValueType::objectValue, &Json::Value::null)));
+            // ... large results to file ...
+            if ( nullptr != spill_ ) {
+                delete spill_;
+            }
+            spill_ = new Spill(Spill::Load(GetJSONObject(config_.other(), "spill", Json::ValueType::objectValue, &Json::Value::null), output));
+            // ... accept jobs chained by other tubes of this process ...
+            const auto liveness = chained_;
+            ::casper::job::Chain::GetInstance().Register(tube_, this, [this, liveness] (const Chain::Origin& a_origin, std::shared_ptr<Chain::Payload> a_payload) -> bool {
+                // ... called on forwarder thread, this instance might be being disposed ...
+                std::lock_guard<std::mutex> lock(liveness->mutex_);
+                if ( false == liveness->alive_ ) {
+                    return false;
+                }
+                // ... from forwarder thread to 'main' thread, and then to this tube 'looper' thread ...
+                ExecuteOnMainThread([this, liveness, a_origin, a_payload] () {
+                    std::lock_guard<std::mutex> lock(liveness->mutex_);
+                    if ( false == liveness->alive_ ) {
+                        return;
+                    }
+                    ScheduleCallbackOnLooperThread("chain-" + a_origin.rcid_, [this, liveness, a_origin, a_payload] (const std::string&) {
+                        {
+                            std::lock_guard<std::mutex> lock(liveness->mutex_);
+                            if ( false == liveness->alive_ ) {
+                                return;
+                            }
+                        }
+                        Relay(a_origin, *a_payload);
+                    });
+                }, /* a_blocking */ false);
+                return true;
+            });
         }
     
         /**
@@ -243,20 +377,50 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
             }
             // ... test role mask ...
             const auto& headers = a_payload["headers"];
-            std::smatch match;
-            char* end_ptr = nullptr;
             for ( Json::ArrayIndex idx = 0 ; idx < headers.size(); ++idx ) {
-                const std::string value = headers[idx].asString();
-                const std::regex hex_expr("X-CASPER-ROLE-MASK:\\s+(0[xX][0-9a-fA-F]+)");
-                if ( true == std::regex_match(value, match, hex_expr) && 2 == match.size() ) {
-                    const std::string v = match[1].str();
-                    (*o_with_job_role) = ( 0 != ( std::strtoull(v.c_str(), &end_ptr, 16) & 0x40000000 ) );
+                if ( true == RoleMask(headers[idx].asString(), *o_with_job_role) ) {
                     break;
-                } else {
-                    const std::regex dec_expr("X-CASPER-ROLE-MASK:\\s+(\\d+)");
-                    if ( true == std::regex_match(value, match, dec_expr) && 2 == match.size() ) {
-                        const std::string v = match[1].str();
-                        (*o_with_job_role) = ( 0 != ( std::strtoull(v.c_str(), &end_ptr, 10) & 0x40000000 ) );
+                }
+            }
+            // ... done ...
+            return true;
+        }
+
+        /**
+         * @brief Read TTR, validity and source of a job straight from it's raw payload, without parsing it; the same
+         *        rules as \link Payload \link apply so a job can be screened before it's full parse.
+         *
+         * @param a_raw           Raw payload, as reserved from beanstalkd or handed as text by another tube, see \link Relay \link.
+         * @param o_fields        See \link Envelope::Fields \link, 'body' slice can be parsed alone once job is accepted.
+         * @param o_broker        If not null, check if 'source' was nginx-broker.
+         * @param o_with_job_role If not null, check if 'source' is nginx-broker and it has job as 'role'.
+         *
+         * @return False if raw payload is not a well formed JSON object, or it's binary encoded or compressed, nothing was read and job must be fully parsed.
+         */
+        template <typename S>
+        inline const bool casper::job::Basic<S>::Peek (const std::string& a_raw, Envelope::Fields& o_fields, bool* o_broker, bool* o_with_job_role)
+        {
+            // ... reset ...
+            if ( nullptr != o_broker ) {
+                (*o_broker) = false;
+            }
+            if ( nullptr != o_with_job_role ) {
+                (*o_with_job_role) = false;
+            }
+            if ( true == Codec::Binary(a_raw) || true == Compressor::Framed(a_raw) || false == Envelope::Peek(a_raw.c_str(), a_raw.length(), o_fields) ) {
+                return false;
+            }
+            // ... read TTR and validity ...
+            SetTTRAndValidity(( true == o_fields.has_ttr_      ? o_fields.ttr_      : static_cast<uint64_t>(TTR())      ),
+                              ( true == o_fields.has_validity_ ? o_fields.validity_ : static_cast<uint64_t>(Validity()) )
+            );
+            // ... from nginx-broker?
+            if ( nullptr != o_broker ) {
+                (*o_broker) = o_fields.broker_;
+            }
+            if ( true == o_fields.broker_ && nullptr != o_with_job_role ) {
+                for ( const auto& header : o_fields.headers_ ) {
+                    if ( true == RoleMask(header, *o_with_job_role) ) {
                         break;
                     }
                 }
@@ -265,6 +429,263 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
             return true;
         }
 
+        /**
+         * @brief Deserialize a payload or response, JSON text or binary encoded, compressed or not.
+         *
+         * @param a_data  Serialized value, as transported.
+         * @param o_value Deserialized value.
+         */
+        template <typename S>
+        inline void casper::job::Basic<S>::Decode (const std::string& a_data, Json::Value& o_value) const
+        {
+            if ( true == Compressor::Framed(a_data) ) {
+                if ( nullptr == compressor_ ) {
+                    throw ::cc::Exception("%s", "Unable to decode compressed data, compressor not set up!");
+                }
+                std::string data;
+                compressor_->Inflate(a_data, data);
+                Codec::Decode(data, o_value);
+            } else {
+                Codec::Decode(a_data, o_value);
+            }
+        }
+
+        /**
+         * @brief Serialize a payload or response with this tube's encoding, compressed if enabled and above threshold.
+         *
+         * @param a_value Value to serialize.
+         * @param o_data  Serialized value.
+         */
+        template <typename S>
+        inline void casper::job::Basic<S>::Encode (const Json::Value& a_value, std::string& o_data) const
+        {
+            Codec::Encode(a_value, encoding_, o_data);
+            if ( nullptr != compressor_ ) {
+                std::string frame;
+                if ( true == compressor_->Deflate(o_data, frame) ) {
+                    o_data.swap(frame);
+                }
+            }
+        }
+
+        /**
+         * @brief Expand a compressed, or binary encoded, payload envelope; top-level or, if from nginx-broker, it's 'body'.
+         *
+         * @param a_payload Payload, as received.
+         * @param o_payload Expanded payload, untouched if payload is not enveloped.
+         *
+         * @return True if payload was enveloped and \link o_payload \link should be used instead.
+         */
+        template <typename S>
+        inline bool casper::job::Basic<S>::Inflate (const Json::Value& a_payload, Json::Value& o_payload)
+        {
+            const bool wrapped = ( true == a_payload.isObject() && true == a_payload.isMember("body") && true == a_payload.isMember("headers") );
+            const Json::Value& object = ( true == wrapped ? a_payload["body"] : a_payload );
+            if ( false == Compressor::Enveloped(object) ) {
+                return false;
+            }
+            if ( nullptr == compressor_ ) {
+                throw ::cc::Exception("%s", "Unable to expand compressed payload, compressor not set up!");
+            }
+            std::string data;
+            compressor_->Unpack(object, data);
+            Json::Value value;
+            Codec::Decode(data, value);
+            if ( true == wrapped ) {
+                o_payload = a_payload;
+                o_payload["body"].swap(value);
+            } else {
+                o_payload.swap(value);
+            }
+            CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                           "Compression: payload expanded to " SIZET_FMT " byte(s), total " UINT64_FMT " us",
+                           data.length(), compressor_->stats().inflate_us_
+            );
+            return true;
+        }
+
+        /**
+         * @brief Remember if a job's producer accepts a compressed result, 'compression' set to "lz4", and / or a binary
+         *        encoded one, 'encoding' set to this tube's encoding; top-level or, if from nginx-broker, in it's 'body';
+         *        they must be in the clear, even when payload itself is compressed.
+         *
+         * @param a_id      Job ID.
+         * @param a_payload Payload, as received.
+         */
+        template <typename S>
+        inline void casper::job::Basic<S>::Negotiate (const uint64_t& a_id, const Json::Value& a_payload)
+        {
+            if ( false == a_payload.isObject() ) {
+                return;
+            }
+            const Json::Value& object = ( true == a_payload.isMember("body") && true == a_payload.isMember("headers") ? a_payload["body"] : a_payload );
+            if ( false == object.isObject() ) {
+                return;
+            }
+            if ( nullptr != compressor_ && true == compressor_->config().enabled_
+                    && true == object["compression"].isString() && 0 == object["compression"].asString().compare("lz4") ) {
+                deflatable_.insert(a_id);
+            }
+            if ( Codec::Encoding::JSON != encoding_ && true == object["encoding"].isString() ) {
+                try {
+                    if ( encoding_ == Codec::Load(object["encoding"]) ) {
+                        encodable_.insert(a_id);
+                    }
+                } catch (const ::cc::Exception& /* a_cc_exception */) {
+                    // ... unknown encoding, producer gets JSON ...
+                }
+            }
+        }
+
+        /**
+         * @brief Encode a successful job result with this tube's encoding, if it's producer accepts it, and compress it, if
+         *        it's producer accepts it and it's above threshold; a binary encoded result that was not compressed is wrapped,
+         *        see \link Compressor::Wrap \link. Producers that negotiated neither get the result as is.
+         *
+         * @param a_id       Job ID, forgotten after this call.
+         * @param a_code     Job status code.
+         * @param io_payload Result, replaced by an envelope if compressed or binary encoded.
+         */
+        template <typename S>
+        inline void casper::job::Basic<S>::Deflate (const uint64_t& a_id, const uint16_t a_code, Json::Value& io_payload)
+        {
+            const bool            deflatable = ( 1 == deflatable_.erase(a_id) );
+            const Codec::Encoding encoding   = ( 1 == encodable_.erase(a_id) ? encoding_ : Codec::Encoding::JSON );
+            if ( CC_STATUS_CODE_OK != a_code || ( false == deflatable && Codec::Encoding::JSON == encoding ) ) {
+                return;
+            }
+            std::string data;
+            Codec::Encode(io_payload, encoding, data);
+            Json::Value envelope;
+            if ( true == deflatable && true == compressor_->Pack(data, envelope) ) {
+                CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                               "Compression: result of " SIZET_FMT " byte(s) compressed, ratio %.2f, total " UINT64_FMT " us",
+                               data.length(), compressor_->ratio(), compressor_->stats().deflate_us_
+                );
+            } else if ( Codec::Encoding::JSON != encoding ) {
+                Compressor::Wrap(data, envelope);
+                CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                               "Encoding: result of " SIZET_FMT " byte(s) binary encoded",
+                               data.length()
+                );
+            } else {
+                return;
+            }
+            io_payload.swap(envelope);
+        }
+
+        /**
+         * @brief Forget what was negotiated for a job, for when it's finished without it's result being concluded.
+         *
+         * @param a_id Job ID.
+         */
+        template <typename S>
+        inline void casper::job::Basic<S>::Forget (const uint64_t& a_id)
+        {
+            deflatable_.erase(a_id);
+            encodable_.erase(a_id);
+        }
+
+        /**
+         * @brief Stream a large output to a file, in the output directory, instead of building it in memory.
+         *
+         * @param a_id           Job ID.
+         * @param a_producer     Function that writes output.
+         * @param a_content_type Output content type.
+         * @param o_reference    Spilled file reference, see \link Spill::Reference \link, untouched if false is returned.
+         *
+         * @return True if output was spilled, false if spilling is disabled or output is at or below threshold ( and was discarded ).
+         */
+        template <typename S>
+        inline bool casper::job::Basic<S>::Spool (const uint64_t& a_id, const Spill::Producer& a_producer, const std::string& a_content_type, Json::Value& o_reference)
+        {
+            Spill::File file;
+            if ( nullptr == spill_ || false == spill_->Write(tube_ + "-" + std::to_string(a_id), a_producer, a_content_type, file) ) {
+                return false;
+            }
+            Spill::Reference(file, o_reference);
+            return true;
+        }
+
+        /**
+         * @brief Move large data, e.g. a deferred request response body, to a file in the output directory.
+         *
+         * @param a_id           Job ID.
+         * @param a_data         Data to write.
+         * @param a_content_type Data content type.
+         * @param o_reference    Spilled file reference, see \link Spill::Reference \link, untouched if false is returned.
+         *
+         * @return True if data was spilled, false if spilling is disabled or data is at or below threshold.
+         */
+        template <typename S>
+        inline bool casper::job::Basic<S>::Spool (const uint64_t& a_id, const std::string& a_data, const std::string& a_content_type, Json::Value& o_reference)
+        {
+            Spill::File file;
+            if ( nullptr == spill_ || false == spill_->Write(tube_ + "-" + std::to_string(a_id), a_data, a_content_type, file) ) {
+                return false;
+            }
+            Spill::Reference(file, o_reference);
+            return true;
+        }
+
+        /**
+         * @brief Prepare a job result to be published: if it's larger than spill threshold it's written to a file and
+         *        replaced by it's reference; then it's encoded and compressed, see \link Deflate \link.
+         *
+         * @param a_id       Job ID.
+         * @param a_code     Job status code.
+         * @param io_payload Result.
+         */
+        template <typename S>
+        inline void casper::job::Basic<S>::Conclude (const uint64_t& a_id, const uint16_t a_code, Json::Value& io_payload)
+        {
+            if ( CC_STATUS_CODE_OK == a_code && nullptr != spill_ && true == spill_->config().enabled_ ) {
+                Spill::File file;
+                try {
+                    if ( true == spill_->Write(tube_ + "-" + std::to_string(a_id), io_payload, file) ) {
+                        Spill::Reference(file, io_payload);
+                        CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                                       "Spill: result of " SIZET_FMT " byte(s) written to %s",
+                                       file.size_, file.path_.c_str()
+                        );
+                    }
+                } catch (...) {
+                    // ... job is finished anyway ...
+                    Forget(a_id);
+                    throw;
+                }
+            }
+            Deflate(a_id, a_code, io_payload);
+        }
+
+        /**
+         * @brief Check if an header is the role mask header and, if so, if it has job as 'role'.
+         *
+         * @param a_header        Header line.
+         * @param o_with_job_role Set only if it's the role mask header.
+         *
+         * @return True if it's the role mask header.
+         */
+        template <typename S>
+        inline bool casper::job::Basic<S>::RoleMask (const std::string& a_header, bool& o_with_job_role)
+        {
+            std::smatch match;
+            char* end_ptr = nullptr;
+            const std::regex hex_expr("X-CASPER-ROLE-MASK:\\s+(0[xX][0-9a-fA-F]+)");
+            if ( true == std::regex_match(a_header, match, hex_expr) && 2 == match.size() ) {
+                const std::string v = match[1].str();
+                o_with_job_role = ( 0 != ( std::strtoull(v.c_str(), &end_ptr, 16) & 0x40000000 ) );
+                return true;
+            }
+            const std::regex dec_expr("X-CASPER-ROLE-MASK:\\s+(\\d+)");
+            if ( true == std::regex_match(a_header, match, dec_expr) && 2 == match.size() ) {
+                const std::string v = match[1].str();
+                o_with_job_role = ( 0 != ( std::strtoull(v.c_str(), &end_ptr, 10) & 0x40000000 ) );
+                return true;
+            }
+            return false;
+        }
+
         // MARK: - PROGRESS REPORT HELPER(S)
 
         /**
@@ -280,6 +701,19 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
                                              const char* const a_i18n_key, const std::map<std::string, Json::Value>& a_arguments)
         {
             CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            // ... chained job?
+            if ( nullptr != origin_ ) {
+                ev::loop::beanstalkd::Job::Publish(
+                origin_->id_, origin_->rcid_, origin_->rjid_,
+                {
+                    /* key_    */ a_i18n_key,
+                    /* args_   */ a_arguments,
+                    /* status_ */ a_status,
+                    /* value_  */ static_cast<double>(a_step),
+                    /* now_    */ true
+                });
+                return;
+            }
             ev::loop::beanstalkd::Job::Publish({
                 /* key_    */ a_i18n_key,
                 /* args_   */ a_arguments,
@@ -302,6 +736,19 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
                                              const char* const a_i18n_key, const std::map<std::string, Json::Value>& a_arguments)
         {
             CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            // ... chained job?
+            if ( nullptr != origin_ ) {
+                ev::loop::beanstalkd::Job::Publish(
+                origin_->id_, origin_->rcid_, origin_->rjid_,
+                {
+                    /* key_    */ a_i18n_key,
+                    /* args_   */ a_arguments,
+                    /* status_ */ a_status,
+                    /* value_  */ a_progress,
+                    /* now_    */ true
+                });
+                return;
+            }
             ev::loop::beanstalkd::Job::Publish({
                 /* key_    */ a_i18n_key,
                 /* args_   */ a_arguments,
@@ -311,6 +758,171 @@ __CASPER_JOB(a_level, casper::job::Basic<S>::ID(), \
             });
         }
     
+        /**
+         * @brief Touch a job reserved by this tube, so that it's TTR restarts.
+         *
+         * @param a_id Job ID.
+         *
+         * @return True if beanstalkd accepted the touch, false if job is no longer reserved by this worker.
+         */
+        template <typename S>
+        bool casper::job::Basic<S>::Touch (const uint64_t& a_id)
+        {
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            // ... a reservation belongs to the connection that reserved it, so the looper's one must be used ...
+            return ev::loop::beanstalkd::Job::Touch(static_cast<int64_t>(a_id));
+        }
+    
+        // MARK: - IN-PROCESS CHAINING
+
+        /**
+         * @brief Hand a payload to another tube of this process, instead of putting a new beanstalkd job.
+         *
+         * @param a_tube     Tube name.
+         * @param a_origin   Chained job identifiers, progress and result are published there.
+         * @param io_payload Chained job payload, moved out ( left null ) only if it was handed.
+         *
+         * @return True if payload was handed, false if tube is not registered in this process.
+         */
+        template <typename S>
+        bool casper::job::Basic<S>::Handoff (const std::string& a_tube, const Chain::Origin& a_origin, Json::Value& io_payload)
+        {
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            Chain::Origin origin = a_origin;
+            origin.handed_ = std::chrono::steady_clock::now();
+            const bool handed = ::casper::job::Chain::GetInstance().Forward(a_tube, origin, io_payload);
+            CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_INFO,
+                           "Chain  : %s, job " UINT64_FMT " %s",
+                           a_tube.c_str(), a_origin.id_, ( true == handed ? "handed" : "not registered in this process" )
+            );
+            return handed;
+        }
+
+        /**
+         * @brief Hand a serialized payload, e.g. as received from elsewhere, to another tube of this process; receiving
+         *        tube screens it before it's parsed.
+         *
+         * @param a_tube     Tube name.
+         * @param a_origin   Chained job identifiers, progress and result are published there.
+         * @param io_payload Chained job serialized payload, moved out ( left empty ) only if it was handed.
+         *
+         * @return True if payload was handed, false if tube is not registered in this process.
+         */
+        template <typename S>
+        bool casper::job::Basic<S>::Handoff (const std::string& a_tube, const Chain::Origin& a_origin, std::string& io_payload)
+        {
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            Chain::Origin origin = a_origin;
+            origin.handed_ = std::chrono::steady_clock::now();
+            const bool handed = ::casper::job::Chain::GetInstance().Forward(a_tube, origin, io_payload);
+            CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_INFO,
+                           "Chain  : %s, job " UINT64_FMT " %s",
+                           a_tube.c_str(), a_origin.id_, ( true == handed ? "handed" : "not registered in this process" )
+            );
+            return handed;
+        }
+
+        /**
+         * @brief Run a job chained by another tube of this process and publish it's result.
+         *
+         * @param a_origin  Chained job identifiers.
+         * @param a_payload Chained job payload, a serialized one has it's envelope peeked before it's parsed.
+         */
+        template <typename S>
+        void casper::job::Basic<S>::Relay (const Chain::Origin& a_origin, Chain::Payload& a_payload)
+        {
+            CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+            cc::easy::job::Job::Response response;
+            response.code_    = CC_STATUS_CODE_BAD_REQUEST;
+            response.payload_ = Json::Value::null;
+            // ... run, publishing progress on chained job channel ...
+            origin_ = &a_origin;
+            try {
+                // ... validity, read without parsing a serialized payload ...
+                uint64_t validity = 0;
+                if ( 0 != a_payload.raw_.length() ) {
+                    Envelope::Fields fields;
+                    if ( true == Peek(a_payload.raw_, fields) && true == fields.has_validity_ ) {
+                        validity = fields.validity_;
+                    }
+                } else {
+                    const Json::Value& object = ( true == a_payload.value_.isObject() && true == a_payload.value_.isMember("body") && true == a_payload.value_.isMember("headers")
+                                                  ? a_payload.value_["body"] : a_payload.value_
+                    );
+                    if ( true == object.isObject() && true == object.isMember("validity") && true == object["validity"].isUInt64() ) {
+                        validity = object["validity"].asUInt64();
+                    }
+                }
+                // ... validity elapsed while waiting to be run? reject it ...
+                if ( 0 != validity && std::chrono::steady_clock::now() >= a_origin.handed_ + std::chrono::seconds(validity) ) {
+                    response.code_ = SetError(CC_STATUS_CODE_GATEWAY_TIMEOUT,
+                                              /* a_i18n */ &I18NError(),
+                                              /* a_error */ {
+                                                  /* code_ */ nullptr,
+                                                  /* why_  */ "Deadline exceeded before job was started!"
+                                              },
+                                              response.payload_
+                    );
+                } else {
+                    if ( 0 != a_payload.raw_.length() ) {
+                        Decode(a_payload.raw_, a_payload.value_);
+                        a_payload.raw_.clear();
+                    }
+                    Run(a_origin.id_, a_payload.value_, response);
+                }
+            } catch (...) {
+                try {
+                    ::cc::Exception::Rethrow(/* a_unhandled */ true, __FILE__, __LINE__, __FUNCTION__);
+                } catch (::cc::Exception& a_cc_exception) {
+                    response.code_ = SetInternalServerError(/* a_i18n */ &I18NError(),
+                                                            /* a_error */ {
+                                                                /* code_ */ nullptr,
+                                                                /* why_  */ std::string(a_cc_exception.what())
+                                                            },
+                                                            response.payload_
+                    );
+                }
+            }
+            origin_ = nullptr;
+            // ... result will be published later?
+            if ( true == Pending(response) ) {
+                return;
+            }
+            // ... publish result ...
+            Json::Value result = Json::Value::null;
+            if ( CC_STATUS_CODE_OK == response.code_ ) {
+                (void)SetCompletedResponse(response.payload_, result);
+            } else {
+                (void)SetFailedResponse(response.code_, response.payload_, result);
+            }
+            LogResponse(response, response.payload_);
+            Finished(/* a_id               */ a_origin.id_,
+                     /* a_channel          */ a_origin.rcid_,
+                     /* a_key              */ a_origin.rjid_,
+                     /* a_response         */ result,
+                     /* a_success_callback */ nullptr,
+                     /* a_failure_callback */
+                     [this](const ev::Exception& a_ev_exception) {
+                         // ... log error ...
+                         CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_ERR, CC_JOB_LOG_STEP_ERROR,
+                                        CC_JOB_LOG_COLOR(LIGHT_RED) "%s" CC_LOGS_LOGGER_RESET_ATTRS " - %s: %s",
+                                        "FAILED", "while publishing chained job finished notification", a_ev_exception.what()
+                         );
+                     }
+            );
+        }
+
+        /**
+         * @return True if a chained job result is published later, by the job itself.
+         *
+         * @param a_response Response filled by \link Run \link.
+         */
+        template <typename S>
+        bool casper::job::Basic<S>::Pending (const cc::easy::job::Job::Response& /* a_response */) const
+        {
+            return false;
+        }
+
         /**
          * @brief Load this job message.
          *
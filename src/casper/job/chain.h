@@ -0,0 +1,292 @@
+/**
+ * @file chain.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_CHAIN_H_
+#define CASPER_JOB_CHAIN_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "json/json.h"
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <iterator>   // std::advance
+#include <mutex>
+#include <chrono>
+#include <memory>     // std::shared_ptr
+#include <functional>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        /**
+         * @brief In-process job chaining: tubes running in this process register themselves so that a job can hand it's
+         *        result directly to another tube, skipping the beanstalkd put / reserve round trip.
+         *
+         * Parsed payloads are moved, not copied, nor serialized; a payload the caller only has as raw text is handed as is,
+         * so the receiving tube can screen it before it's parsed.
+         *
+         * A tube can run several instances, each one registers itself and payloads are handed to them in turn.
+         *
+         * Thread safe, jobs of different tubes run on different threads.
+         */
+        class Chain final : public ::cc::NonCopyable, public ::cc::NonMovable
+        {
+
+        public: // Data Type(s)
+
+            typedef struct {
+                uint64_t                              id_;     //!< Job ID, as it would have been assigned to a beanstalkd job.
+                std::string                           rcid_;   //!< REDIS channel ID, where progress and result are published.
+                std::string                           rjid_;   //!< REDIS job key.
+                std::chrono::steady_clock::time_point handed_; //!< When payload was handed, job validity is counted from it.
+            } Origin;
+
+            typedef struct {
+                Json::Value value_; //!< Parsed payload, used when \link raw_ \link is empty.
+                std::string raw_;   //!< Serialized payload, as it would have been put.
+            } Payload;
+
+            typedef std::function<bool(const Origin&, std::shared_ptr<Payload>)> Link; //!< Called on forwarder thread, false if instance is gone and payload was not taken.
+
+            typedef struct {
+                uint64_t forwarded_; //!< Payloads handed to a tube.
+                uint64_t refused_;   //!< Payloads not handed, no such tube in this process.
+            } Stats;
+
+        private: // Data Type(s)
+
+            typedef struct {
+                std::map<const void*, Link> links_; //!< Instance -> Link
+                size_t                      next_;  //!< Index of instance to hand next payload to.
+            } Instances;
+
+        private: // Data
+
+            std::map<std::string, Instances> tubes_; //!< Tube -> Instances
+            std::mutex                       mutex_;
+            Stats                            stats_;
+
+        private: // Constructor(s) / Destructor
+
+            Chain ();
+
+        public: // Constructor(s) / Destructor
+
+            virtual ~Chain ();
+
+        public: // Method(s) / Function(s)
+
+            void  Register   (const std::string& a_tube, const void* a_instance, Link a_link);
+            void  Unregister (const std::string& a_tube, const void* a_instance);
+            bool  Linked     (const std::string& a_tube);
+            bool  Forward    (const std::string& a_tube, const Origin& a_origin, Json::Value& io_payload);
+            bool  Forward    (const std::string& a_tube, const Origin& a_origin, std::string& io_payload);
+            Stats Snapshot   ();
+
+        private: // Method(s) / Function(s)
+
+            bool Forward (const std::string& a_tube, const Origin& a_origin, std::shared_ptr<Payload> a_payload);
+
+        public: // Static Method(s) / Function(s)
+
+            static Chain& GetInstance ();
+
+        }; // end of class 'Chain'
+
+        /**
+         * @brief Default constructor.
+         */
+        inline Chain::Chain ()
+        {
+            stats_ = { 0, 0 };
+        }
+
+        /**
+         * @brief Destructor.
+         */
+        inline Chain::~Chain ()
+        {
+            /* empty */
+        }
+
+        /**
+         * @brief Register an instance of a tube, replacing any previous registration of that instance.
+         *
+         * @param a_tube     Tube name.
+         * @param a_instance Instance that runs the payloads, only used as a key.
+         * @param a_link     Function to call with forwarded payloads.
+         */
+        inline void Chain::Register (const std::string& a_tube, const void* a_instance, Link a_link)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = tubes_.find(a_tube);
+            if ( tubes_.end() == it ) {
+                it = tubes_.insert(std::make_pair(a_tube, Instances{ {}, 0 })).first;
+            }
+            it->second.links_[a_instance] = a_link;
+        }
+
+        /**
+         * @brief Unregister an instance of a tube, other instances of the same tube keep receiving payloads.
+         *
+         * @param a_tube     Tube name.
+         * @param a_instance Instance, as registered.
+         */
+        inline void Chain::Unregister (const std::string& a_tube, const void* a_instance)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto it = tubes_.find(a_tube);
+            if ( tubes_.end() == it ) {
+                return;
+            }
+            it->second.links_.erase(a_instance);
+            if ( 0 == it->second.links_.size() ) {
+                tubes_.erase(it);
+            }
+        }
+
+        /**
+         * @return True if at least one instance of a tube is registered in this process.
+         *
+         * @param a_tube Tube name.
+         */
+        inline bool Chain::Linked (const std::string& a_tube)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return ( tubes_.end() != tubes_.find(a_tube) );
+        }
+
+        /**
+         * @brief Hand a parsed payload to a tube registered in this process.
+         *
+         * @param a_tube     Tube name.
+         * @param a_origin   Identifiers of the chained job, see \link Origin \link.
+         * @param io_payload Job payload, moved out ( left null ) only if it was handed.
+         *
+         * @return True if payload was handed, false if tube is not registered and caller must fallback to beanstalkd.
+         */
+        inline bool Chain::Forward (const std::string& a_tube, const Origin& a_origin, Json::Value& io_payload)
+        {
+            // ... move, not copy ...
+            std::shared_ptr<Payload> payload = std::make_shared<Payload>();
+            payload->value_.swap(io_payload);
+            if ( false == Forward(a_tube, a_origin, payload) ) {
+                io_payload.swap(payload->value_);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Hand a serialized payload to a tube registered in this process, for when caller only has it's raw text.
+         *
+         * @param a_tube     Tube name.
+         * @param a_origin   Identifiers of the chained job, see \link Origin \link.
+         * @param io_payload Serialized job payload, moved out ( left empty ) only if it was handed.
+         *
+         * @return True if payload was handed, false if tube is not registered and caller must fallback to beanstalkd.
+         */
+        inline bool Chain::Forward (const std::string& a_tube, const Origin& a_origin, std::string& io_payload)
+        {
+            // ... move, not copy ...
+            std::shared_ptr<Payload> payload = std::make_shared<Payload>();
+            payload->raw_.swap(io_payload);
+            if ( false == Forward(a_tube, a_origin, payload) ) {
+                io_payload.swap(payload->raw_);
+                return false;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Hand a payload to the next instance of a tube, trying the others if an instance is gone meanwhile.
+         *
+         * @param a_tube    Tube name.
+         * @param a_origin  Identifiers of the chained job, see \link Origin \link.
+         * @param a_payload Job payload, owned by the link if it's taken.
+         *
+         * @return True if payload was taken.
+         */
+        inline bool Chain::Forward (const std::string& a_tube, const Origin& a_origin, std::shared_ptr<Payload> a_payload)
+        {
+            std::vector<Link> links;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto it = tubes_.find(a_tube);
+                if ( tubes_.end() == it ) {
+                    stats_.refused_++;
+                    return false;
+                }
+                // ... in turn, starting with next instance ...
+                const size_t count = it->second.links_.size();
+                const size_t first = ( it->second.next_++ % count );
+                auto         link  = it->second.links_.begin();
+                std::advance(link, first);
+                for ( size_t idx = 0 ; idx < count ; ++idx ) {
+                    links.push_back(link->second);
+                    if ( it->second.links_.end() == ++link ) {
+                        link = it->second.links_.begin();
+                    }
+                }
+            }
+            // ... called unlocked, an instance being disposed refuses it ...
+            for ( const auto& link : links ) {
+                if ( true == link(a_origin, a_payload) ) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stats_.forwarded_++;
+                    return true;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.refused_++;
+            return false;
+        }
+
+        /**
+         * @return Copy of current \link Stats \link.
+         */
+        inline Chain::Stats Chain::Snapshot ()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return stats_;
+        }
+
+        /**
+         * @return Process wide instance.
+         */
+        inline Chain& Chain::GetInstance ()
+        {
+            static Chain instance;
+            return instance;
+        }
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_CHAIN_H_
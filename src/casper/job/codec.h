@@ -0,0 +1,535 @@
+/**
+ * @file codec.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_CODEC_H_
+#define CASPER_JOB_CODEC_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <limits>   // std::numeric_limits
+#include <string.h> // memcpy
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        /**
+         * @brief Job payloads and responses codec: JSON text or MessagePack, binary payloads are recognized by a leading
+         *        marker byte ( 0xC1, never used by MessagePack and never valid in UTF-8 text ).
+         */
+        class Codec final
+        {
+
+        public: // Data Type(s)
+
+            enum class Encoding : uint8_t {
+                JSON = 0,
+                MessagePack
+            };
+
+        public: // Const Data
+
+            static constexpr uint8_t k_marker_    = 0xC1;
+            static constexpr size_t  k_max_depth_ = 512; //!< Deepest nesting accepted when decoding.
+
+        private: // Data Type(s)
+
+            /**
+             * @brief Walk handler that builds a Json::Value.
+             */
+            class Builder final
+            {
+
+            private: // Data
+
+                Json::Value&              root_;
+                std::vector<Json::Value*> stack_;
+                std::string               key_;
+
+            public: // Constructor(s) / Destructor
+
+                Builder (Json::Value& o_root) : root_(o_root) {}
+
+            public: // Method(s) / Function(s)
+
+                inline void Null   ()                                           { Slot() = Json::Value::null; }
+                inline void Bool   (const bool a_value)                         { Slot() = a_value; }
+                inline void Int    (const int64_t a_value)                      { Slot() = static_cast<Json::Int64>(a_value); }
+                inline void Real   (const double a_value)                       { Slot() = a_value; }
+                inline void String (const char* a_value, const size_t a_length) { Slot() = Json::Value(a_value, a_value + a_length); }
+                inline void Key    (const char* a_value, const size_t a_length) { key_.assign(a_value, a_length); }
+                inline void Array  (const size_t /* a_size */)                  { Open(Json::ValueType::arrayValue); }
+                inline void Map    (const size_t /* a_size */)                  { Open(Json::ValueType::objectValue); }
+                inline void Close  ()                                           { stack_.pop_back(); }
+
+                /**
+                 * @brief Unsigned values that fit a signed one are stored as such, as JSON text parser does.
+                 *
+                 * @param a_value Value.
+                 */
+                inline void UInt (const uint64_t a_value)
+                {
+                    if ( a_value <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) ) {
+                        Slot() = static_cast<Json::Int64>(a_value);
+                    } else {
+                        Slot() = static_cast<Json::UInt64>(a_value);
+                    }
+                }
+
+            private: // Method(s) / Function(s)
+
+                /**
+                 * @return Where next value goes: root, next array element or current key member.
+                 */
+                inline Json::Value& Slot ()
+                {
+                    if ( 0 == stack_.size() ) {
+                        return root_;
+                    }
+                    Json::Value& top = *stack_.back();
+                    if ( true == top.isArray() ) {
+                        return top.append(Json::Value::null);
+                    }
+                    return top[key_];
+                }
+
+                /**
+                 * @brief Start a container.
+                 *
+                 * @param a_type Container type.
+                 */
+                inline void Open (const Json::ValueType a_type)
+                {
+                    Json::Value& value = Slot();
+                    value = Json::Value(a_type);
+                    stack_.push_back(&value);
+                }
+
+            }; // end of class 'Builder'
+
+        public: // Constructor(s) / Destructor
+
+            Codec () = delete;
+
+        public: // Static Method(s) / Function(s)
+
+            static Encoding Load   (const Json::Value& a_config);
+            static bool     Binary (const std::string& a_data);
+            static void     Encode (const Json::Value& a_value, const Encoding a_encoding, std::string& o_data);
+            static void     Decode (const std::string& a_data, Json::Value& o_value);
+
+            template <class H>
+            static void     Walk   (const char* const a_data, const size_t a_length, H& a_handler);
+
+        private: // Static Method(s) / Function(s)
+
+            static void     Pack   (const Json::Value& a_value, std::string& o_data);
+            static void     Head   (const uint8_t a_fix, const uint8_t a_fix_max, const uint8_t a_16, const size_t a_size, std::string& o_data);
+            static void     Put    (const uint64_t a_value, const size_t a_bytes, std::string& o_data);
+            static uint64_t Get    (const char* const a_data, const size_t a_length, size_t& io_offset, const size_t a_bytes);
+
+            template <class H>
+            static void     Value  (const char* const a_data, const size_t a_length, size_t& io_offset, const size_t a_depth, H& a_handler);
+
+        }; // end of class 'Codec'
+
+        /**
+         * @brief Load a tube's encoding from it's JSON representation.
+         *
+         * @param a_config JSON string, "json" ( default ) or "msgpack".
+         *
+         * @return See \link Encoding \link.
+         */
+        inline Codec::Encoding Codec::Load (const Json::Value& a_config)
+        {
+            if ( true == a_config.isNull() ) {
+                return Encoding::JSON;
+            }
+            const std::string value = ( true == a_config.isString() ? a_config.asString() : "" );
+            if ( 0 == value.compare("json") ) {
+                return Encoding::JSON;
+            } else if ( 0 == value.compare("msgpack") ) {
+                return Encoding::MessagePack;
+            }
+            throw ::cc::Exception("%s", "Invalid encoding configuration, expecting 'json' or 'msgpack'!");
+        }
+
+        /**
+         * @return True if data is binary encoded.
+         *
+         * @param a_data Payload or response, as transported.
+         */
+        inline bool Codec::Binary (const std::string& a_data)
+        {
+            return ( a_data.length() > 0 && k_marker_ == static_cast<uint8_t>(a_data[0]) );
+        }
+
+        /**
+         * @brief Serialize a value.
+         *
+         * @param a_value    Value to serialize.
+         * @param a_encoding See \link Encoding \link.
+         * @param o_data     Serialized value.
+         */
+        inline void Codec::Encode (const Json::Value& a_value, const Encoding a_encoding, std::string& o_data)
+        {
+            if ( Encoding::JSON == a_encoding ) {
+                Json::FastWriter jfw; jfw.omitEndingLineFeed();
+                o_data = jfw.write(a_value);
+                return;
+            }
+            o_data.clear();
+            o_data.push_back(static_cast<char>(k_marker_));
+            Pack(a_value, o_data);
+        }
+
+        /**
+         * @brief Deserialize a value, encoding is auto-detected.
+         *
+         * @param a_data  Serialized value.
+         * @param o_value Deserialized value.
+         */
+        inline void Codec::Decode (const std::string& a_data, Json::Value& o_value)
+        {
+            if ( false == Binary(a_data) ) {
+                const ::cc::easy::JSON<::cc::Exception> json;
+                json.Parse(a_data, o_value);
+                return;
+            }
+            o_value = Json::Value::null;
+            Builder builder(o_value);
+            Walk(a_data.c_str() + 1, a_data.length() - 1, builder);
+        }
+
+        /**
+         * @brief Walk a MessagePack value, without building a Json::Value, reporting each element to an handler.
+         *
+         * @param a_data    MessagePack data, without marker.
+         * @param a_length  MessagePack data length.
+         * @param a_handler Handler, with Null, Bool, Int, UInt, Real, String, Key, Array, Map and Close methods;
+         *                  Array and Map receive the number of elements that follow, Close ends them.
+         */
+        template <class H>
+        inline void Codec::Walk (const char* const a_data, const size_t a_length, H& a_handler)
+        {
+            size_t offset = 0;
+            Value(a_data, a_length, offset, 0, a_handler);
+            if ( offset != a_length ) {
+                throw ::cc::Exception("Invalid MessagePack data, " SIZET_FMT " trailing byte(s)!", a_length - offset);
+            }
+        }
+
+        /**
+         * @brief Serialize a value to MessagePack.
+         *
+         * @param a_value Value to serialize.
+         * @param o_data  Where to append it.
+         */
+        inline void Codec::Pack (const Json::Value& a_value, std::string& o_data)
+        {
+            switch ( a_value.type() ) {
+                case Json::ValueType::nullValue:
+                    o_data.push_back(static_cast<char>(0xC0));
+                    break;
+                case Json::ValueType::booleanValue:
+                    o_data.push_back(static_cast<char>(true == a_value.asBool() ? 0xC3 : 0xC2));
+                    break;
+                case Json::ValueType::intValue:
+                {
+                    const int64_t value = static_cast<int64_t>(a_value.asInt64());
+                    if ( value >= 0 ) {
+                        Pack(Json::Value(static_cast<Json::UInt64>(value)), o_data);
+                    } else if ( value >= -32 ) {
+                        o_data.push_back(static_cast<char>(value));
+                    } else if ( value >= std::numeric_limits<int8_t>::min() ) {
+                        o_data.push_back(static_cast<char>(0xD0));
+                        Put(static_cast<uint64_t>(value), 1, o_data);
+                    } else if ( value >= std::numeric_limits<int16_t>::min() ) {
+                        o_data.push_back(static_cast<char>(0xD1));
+                        Put(static_cast<uint64_t>(value), 2, o_data);
+                    } else if ( value >= std::numeric_limits<int32_t>::min() ) {
+                        o_data.push_back(static_cast<char>(0xD2));
+                        Put(static_cast<uint64_t>(value), 4, o_data);
+                    } else {
+                        o_data.push_back(static_cast<char>(0xD3));
+                        Put(static_cast<uint64_t>(value), 8, o_data);
+                    }
+                    break;
+                }
+                case Json::ValueType::uintValue:
+                {
+                    const uint64_t value = static_cast<uint64_t>(a_value.asUInt64());
+                    if ( value < 0x80 ) {
+                        o_data.push_back(static_cast<char>(value));
+                    } else if ( value <= std::numeric_limits<uint8_t>::max() ) {
+                        o_data.push_back(static_cast<char>(0xCC));
+                        Put(value, 1, o_data);
+                    } else if ( value <= std::numeric_limits<uint16_t>::max() ) {
+                        o_data.push_back(static_cast<char>(0xCD));
+                        Put(value, 2, o_data);
+                    } else if ( value <= std::numeric_limits<uint32_t>::max() ) {
+                        o_data.push_back(static_cast<char>(0xCE));
+                        Put(value, 4, o_data);
+                    } else {
+                        o_data.push_back(static_cast<char>(0xCF));
+                        Put(value, 8, o_data);
+                    }
+                    break;
+                }
+                case Json::ValueType::realValue:
+                {
+                    // ... single precision when it's exact ...
+                    const double value = a_value.asDouble();
+                    const float  single = static_cast<float>(value);
+                    if ( static_cast<double>(single) == value ) {
+                        uint32_t bits; memcpy(&bits, &single, sizeof(bits));
+                        o_data.push_back(static_cast<char>(0xCA));
+                        Put(bits, 4, o_data);
+                    } else {
+                        uint64_t bits; memcpy(&bits, &value, sizeof(bits));
+                        o_data.push_back(static_cast<char>(0xCB));
+                        Put(bits, 8, o_data);
+                    }
+                    break;
+                }
+                case Json::ValueType::stringValue:
+                {
+                    const char* begin = nullptr;
+                    const char* end   = nullptr;
+                    a_value.getString(&begin, &end);
+                    const size_t length = static_cast<size_t>(end - begin);
+                    if ( length < 32 ) {
+                        o_data.push_back(static_cast<char>(0xA0 | length));
+                    } else if ( length <= std::numeric_limits<uint8_t>::max() ) {
+                        o_data.push_back(static_cast<char>(0xD9));
+                        Put(length, 1, o_data);
+                    } else {
+                        Head(0xA0, 0xA0, 0xDA, length, o_data);
+                    }
+                    o_data.append(begin, length);
+                    break;
+                }
+                case Json::ValueType::arrayValue:
+                    Head(0x90, 0x9F, 0xDC, a_value.size(), o_data);
+                    for ( Json::ArrayIndex idx = 0 ; idx < a_value.size() ; ++idx ) {
+                        Pack(a_value[idx], o_data);
+                    }
+                    break;
+                case Json::ValueType::objectValue:
+                    Head(0x80, 0x8F, 0xDE, a_value.size(), o_data);
+                    for ( auto it = a_value.begin() ; a_value.end() != it ; ++it ) {
+                        Pack(Json::Value(it.name()), o_data);
+                        Pack(*it, o_data);
+                    }
+                    break;
+                default:
+                    throw ::cc::Exception("Unable to encode JSON value type %d!", static_cast<int>(a_value.type()));
+            }
+        }
+
+        /**
+         * @brief Append a sized element header: fix, 16 or 32 bits form.
+         *
+         * @param a_fix     Fix form first byte, size is or'ed.
+         * @param a_fix_max Fix form largest first byte, a_fix if there's no fix form.
+         * @param a_16      16 bits form first byte, 32 bits form is the next one.
+         * @param a_size    Element size.
+         * @param o_data    Where to append it.
+         */
+        inline void Codec::Head (const uint8_t a_fix, const uint8_t a_fix_max, const uint8_t a_16, const size_t a_size, std::string& o_data)
+        {
+            if ( a_fix != a_fix_max && a_size <= static_cast<size_t>(a_fix_max - a_fix) ) {
+                o_data.push_back(static_cast<char>(a_fix | a_size));
+            } else if ( a_size <= std::numeric_limits<uint16_t>::max() ) {
+                o_data.push_back(static_cast<char>(a_16));
+                Put(a_size, 2, o_data);
+            } else if ( a_size <= std::numeric_limits<uint32_t>::max() ) {
+                o_data.push_back(static_cast<char>(a_16 + 1));
+                Put(a_size, 4, o_data);
+            } else {
+                throw ::cc::Exception("Unable to encode element with " SIZET_FMT " entries!", a_size);
+            }
+        }
+
+        /**
+         * @brief Append an unsigned value, big-endian.
+         *
+         * @param a_value Value.
+         * @param a_bytes Number of bytes to write.
+         * @param o_data  Where to append it.
+         */
+        inline void Codec::Put (const uint64_t a_value, const size_t a_bytes, std::string& o_data)
+        {
+            for ( size_t idx = a_bytes ; idx > 0 ; --idx ) {
+                o_data.push_back(static_cast<char>(( a_value >> ( 8 * ( idx - 1 ) ) ) & 0xFF));
+            }
+        }
+
+        /**
+         * @brief Read an unsigned value, big-endian.
+         *
+         * @param a_data    MessagePack data.
+         * @param a_length  MessagePack data length.
+         * @param io_offset Where value starts, moved past it.
+         * @param a_bytes   Number of bytes to read.
+         *
+         * @return Value read.
+         */
+        inline uint64_t Codec::Get (const char* const a_data, const size_t a_length, size_t& io_offset, const size_t a_bytes)
+        {
+            if ( a_bytes > a_length - io_offset ) {
+                throw ::cc::Exception("%s", "Invalid MessagePack data, truncated!");
+            }
+            uint64_t value = 0;
+            for ( size_t idx = 0 ; idx < a_bytes ; ++idx ) {
+                value = ( value << 8 ) | static_cast<uint8_t>(a_data[io_offset++]);
+            }
+            return value;
+        }
+
+        /**
+         * @brief Walk a MessagePack value.
+         *
+         * @param a_data    MessagePack data.
+         * @param a_length  MessagePack data length.
+         * @param io_offset Where value starts, moved past it.
+         * @param a_depth   Current nesting depth.
+         * @param a_handler See \link Walk \link.
+         */
+        template <class H>
+        inline void Codec::Value (const char* const a_data, const size_t a_length, size_t& io_offset, const size_t a_depth, H& a_handler)
+        {
+            if ( a_depth > k_max_depth_ ) {
+                throw ::cc::Exception("Invalid MessagePack data, nested deeper than " SIZET_FMT " level(s)!", k_max_depth_);
+            }
+            const uint8_t type = static_cast<uint8_t>(Get(a_data, a_length, io_offset, 1));
+            // ... strings and containers share their body handling ...
+            size_t length = 0;
+            enum { kString, kArray, kMap } kind;
+            if ( type < 0x80 ) {
+                a_handler.UInt(type);
+                return;
+            } else if ( type >= 0xE0 ) {
+                a_handler.Int(static_cast<int8_t>(type));
+                return;
+            } else if ( type <= 0x8F ) {
+                kind = kMap; length = type & 0x0F;
+            } else if ( type <= 0x9F ) {
+                kind = kArray; length = type & 0x0F;
+            } else if ( type <= 0xBF ) {
+                kind = kString; length = type & 0x1F;
+            } else {
+                switch ( type ) {
+                    case 0xC0: a_handler.Null();      return;
+                    case 0xC2: a_handler.Bool(false); return;
+                    case 0xC3: a_handler.Bool(true);  return;
+                    case 0xC4: case 0xD9: kind = kString; length = static_cast<size_t>(Get(a_data, a_length, io_offset, 1)); break;
+                    case 0xC5: case 0xDA: kind = kString; length = static_cast<size_t>(Get(a_data, a_length, io_offset, 2)); break;
+                    case 0xC6: case 0xDB: kind = kString; length = static_cast<size_t>(Get(a_data, a_length, io_offset, 4)); break;
+                    case 0xCA:
+                    {
+                        const uint32_t bits = static_cast<uint32_t>(Get(a_data, a_length, io_offset, 4));
+                        float value; memcpy(&value, &bits, sizeof(value));
+                        a_handler.Real(static_cast<double>(value));
+                        return;
+                    }
+                    case 0xCB:
+                    {
+                        const uint64_t bits = Get(a_data, a_length, io_offset, 8);
+                        double value; memcpy(&value, &bits, sizeof(value));
+                        a_handler.Real(value);
+                        return;
+                    }
+                    case 0xCC: a_handler.UInt(Get(a_data, a_length, io_offset, 1)); return;
+                    case 0xCD: a_handler.UInt(Get(a_data, a_length, io_offset, 2)); return;
+                    case 0xCE: a_handler.UInt(Get(a_data, a_length, io_offset, 4)); return;
+                    case 0xCF: a_handler.UInt(Get(a_data, a_length, io_offset, 8)); return;
+                    case 0xD0: a_handler.Int(static_cast<int8_t>(Get(a_data, a_length, io_offset, 1)));  return;
+                    case 0xD1: a_handler.Int(static_cast<int16_t>(Get(a_data, a_length, io_offset, 2))); return;
+                    case 0xD2: a_handler.Int(static_cast<int32_t>(Get(a_data, a_length, io_offset, 4))); return;
+                    case 0xD3: a_handler.Int(static_cast<int64_t>(Get(a_data, a_length, io_offset, 8))); return;
+                    case 0xDC: kind = kArray; length = static_cast<size_t>(Get(a_data, a_length, io_offset, 2)); break;
+                    case 0xDD: kind = kArray; length = static_cast<size_t>(Get(a_data, a_length, io_offset, 4)); break;
+                    case 0xDE: kind = kMap;   length = static_cast<size_t>(Get(a_data, a_length, io_offset, 2)); break;
+                    case 0xDF: kind = kMap;   length = static_cast<size_t>(Get(a_data, a_length, io_offset, 4)); break;
+                    default:
+                        throw ::cc::Exception("Invalid MessagePack data, unsupported type 0x%02X!", static_cast<unsigned>(type));
+                }
+            }
+            if ( kString == kind ) {
+                if ( length > a_length - io_offset ) {
+                    throw ::cc::Exception("%s", "Invalid MessagePack data, truncated!");
+                }
+                a_handler.String(a_data + io_offset, length);
+                io_offset += length;
+            } else if ( kArray == kind ) {
+                // ... each element takes at least one byte ...
+                if ( length > a_length - io_offset ) {
+                    throw ::cc::Exception("%s", "Invalid MessagePack data, truncated!");
+                }
+                a_handler.Array(length);
+                for ( size_t idx = 0 ; idx < length ; ++idx ) {
+                    Value(a_data, a_length, io_offset, a_depth + 1, a_handler);
+                }
+                a_handler.Close();
+            } else {
+                if ( length > ( a_length - io_offset ) / 2 ) {
+                    throw ::cc::Exception("%s", "Invalid MessagePack data, truncated!");
+                }
+                a_handler.Map(length);
+                for ( size_t idx = 0 ; idx < length ; ++idx ) {
+                    // ... keys must be strings ...
+                    const uint8_t key = static_cast<uint8_t>(Get(a_data, a_length, io_offset, 1));
+                    size_t        size;
+                    if ( key >= 0xA0 && key <= 0xBF ) {
+                        size = key & 0x1F;
+                    } else if ( 0xD9 == key ) {
+                        size = static_cast<size_t>(Get(a_data, a_length, io_offset, 1));
+                    } else if ( 0xDA == key ) {
+                        size = static_cast<size_t>(Get(a_data, a_length, io_offset, 2));
+                    } else if ( 0xDB == key ) {
+                        size = static_cast<size_t>(Get(a_data, a_length, io_offset, 4));
+                    } else {
+                        throw ::cc::Exception("Invalid MessagePack data, unsupported key type 0x%02X!", static_cast<unsigned>(key));
+                    }
+                    if ( size > a_length - io_offset ) {
+                        throw ::cc::Exception("%s", "Invalid MessagePack data, truncated!");
+                    }
+                    a_handler.Key(a_data + io_offset, size);
+                    io_offset += size;
+                    Value(a_data, a_length, io_offset, a_depth + 1, a_handler);
+                }
+                a_handler.Close();
+            }
+        }
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_CODEC_H_
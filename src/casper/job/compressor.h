@@ -0,0 +1,610 @@
+/**
+ * @file compressor.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_COMPRESSOR_H_
+#define CASPER_JOB_COMPRESSOR_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "cc/exception.h"
+
+#include "json/json.h"
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <string.h> // memcpy
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        /**
+         * @brief Transparent compression of large payloads and results, LZ4 block format.
+         *
+         * Raw data is framed by a leading marker byte ( 0xC0, never valid in UTF-8 text and distinct from \link Codec \link marker ),
+         * followed by the algorithm, the original size ( 4 bytes, big-endian ) and the compressed block.
+         *
+         * Where a JSON value is expected, a frame travels base64 encoded in an envelope: { "__compressed__": "lz4", "data": "..." }.
+         * Binary encoded data that was not compressed travels in the same envelope, as "none", see \link Wrap \link.
+         *
+         * Not thread safe, each tube owns one.
+         */
+        class Compressor final : public ::cc::NonCopyable, public ::cc::NonMovable
+        {
+
+        public: // Data Type(s)
+
+            typedef struct {
+                bool   enabled_;
+                size_t threshold_; //!< Data smaller than this, in bytes, is not compressed.
+                size_t limit_;     //!< Largest original size accepted when expanding, in bytes.
+            } Config;
+
+            typedef struct {
+                uint64_t compressed_; //!< Number of times data was compressed.
+                uint64_t skipped_;    //!< Number of times data was above threshold but did not shrink.
+                uint64_t expanded_;   //!< Number of frames expanded.
+                uint64_t in_;         //!< Bytes before compression.
+                uint64_t out_;        //!< Bytes after compression.
+                uint64_t deflate_us_; //!< CPU time spent compressing, in microseconds.
+                uint64_t inflate_us_; //!< CPU time spent expanding, in microseconds.
+            } Stats;
+
+        public: // Const Data
+
+            static constexpr uint8_t     k_marker_   = 0xC0;
+            static constexpr uint8_t     k_lz4_      = 0x01;
+            static constexpr size_t      k_head_     = 6; //!< Marker, algorithm and original size.
+            static constexpr const char* k_envelope_ = "__compressed__";
+
+        private: // Const Data
+
+            static constexpr size_t k_hash_log_      = 12;
+            static constexpr size_t k_min_match_     = 4;
+            static constexpr size_t k_last_literals_ = 5;  //!< LZ4 block rule: last 5 bytes are always literals.
+            static constexpr size_t k_match_limit_   = 12; //!< LZ4 block rule: last match starts at least 12 bytes before end.
+            static constexpr size_t k_max_offset_    = 65535;
+
+        private: // Data
+
+            const Config config_;
+            Stats        stats_;
+
+        public: // Constructor(s) / Destructor
+
+            Compressor () = delete;
+            Compressor (const Config& a_config);
+            virtual ~Compressor ();
+
+        public: // Method(s) / Function(s)
+
+            bool Deflate (const std::string& a_data, std::string& o_frame);
+            void Inflate (const std::string& a_frame, std::string& o_data);
+            bool Pack    (const std::string& a_data, Json::Value& o_envelope);
+            void Unpack  (const Json::Value& a_envelope, std::string& o_data);
+
+        public: // Inline Method(s) / Function(s)
+
+            /**
+             * @return R/O access to configuration.
+             */
+            inline const Config& config () const
+            {
+                return config_;
+            }
+
+            /**
+             * @return R/O access to statistics.
+             */
+            inline const Stats& stats () const
+            {
+                return stats_;
+            }
+
+            /**
+             * @return Compression ratio, original / compressed size, 0 if nothing was compressed yet.
+             */
+            inline double ratio () const
+            {
+                return ( 0 == stats_.out_ ? 0.0 : static_cast<double>(stats_.in_) / static_cast<double>(stats_.out_) );
+            }
+
+        public: // Static Method(s) / Function(s)
+
+            static Config Load      (const Json::Value& a_config);
+            static bool   Framed    (const std::string& a_data);
+            static bool   Enveloped (const Json::Value& a_value);
+            static void   Wrap      (const std::string& a_data, Json::Value& o_envelope);
+
+        private: // Static Method(s) / Function(s)
+
+            static void   Encode     (const uint8_t* const a_data, const size_t a_length, std::string& o_block);
+            static void   Decode     (const uint8_t* const a_block, const size_t a_length, const size_t a_size, std::string& o_data);
+            static void   Sequence   (const uint8_t* const a_literals, const size_t a_count, const size_t a_offset, const size_t a_match, std::string& o_block);
+            static void   Length     (size_t a_length, std::string& o_block);
+            static void   ToBase64   (const std::string& a_data, std::string& o_text);
+            static void   FromBase64 (const char* const a_text, const size_t a_length, std::string& o_data);
+
+        private: // Static Inline Method(s) / Function(s)
+
+            /**
+             * @return Microseconds elapsed since a time point.
+             *
+             * @param a_start Time point.
+             */
+            static inline uint64_t Elapsed (const std::chrono::steady_clock::time_point& a_start)
+            {
+                return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - a_start).count());
+            }
+
+            /**
+             * @return 4 bytes, as found in memory.
+             *
+             * @param a_data Where to read them.
+             */
+            static inline uint32_t Read32 (const uint8_t* const a_data)
+            {
+                uint32_t value; memcpy(&value, a_data, sizeof(value));
+                return value;
+            }
+
+        }; // end of class 'Compressor'
+
+        /**
+         * @brief Default constructor.
+         *
+         * @param a_config See \link Config \link.
+         */
+        inline Compressor::Compressor (const Config& a_config)
+            : config_(a_config)
+        {
+            stats_ = { 0, 0, 0, 0, 0, 0, 0 };
+        }
+
+        /**
+         * @brief Destructor.
+         */
+        inline Compressor::~Compressor ()
+        {
+            /* empty */
+        }
+
+        /**
+         * @brief Load a tube's compression configuration from it's JSON representation.
+         *
+         * @param a_config JSON object, { "threshold": <bytes>, "limit": <bytes> }, null to disable compression.
+         *
+         * @return See \link Config \link.
+         */
+        inline Compressor::Config Compressor::Load (const Json::Value& a_config)
+        {
+            Config config = { /* enabled_ */ false, /* threshold_ */ 4096, /* limit_ */ 64 * 1024 * 1024 };
+            if ( true == a_config.isNull() ) {
+                return config;
+            }
+            if ( false == a_config.isObject() ) {
+                throw ::cc::Exception("%s", "Invalid compression configuration, expecting an object!");
+            }
+            const Json::Value& threshold = a_config["threshold"];
+            const Json::Value& limit     = a_config["limit"];
+            if ( ( false == threshold.isNull() && false == threshold.isUInt64() ) || ( false == limit.isNull() && false == limit.isUInt64() ) ) {
+                throw ::cc::Exception("%s", "Invalid compression configuration, 'threshold' and 'limit' must be unsigned integers!");
+            }
+            config.enabled_ = true;
+            if ( false == threshold.isNull() ) {
+                config.threshold_ = static_cast<size_t>(threshold.asUInt64());
+            }
+            if ( false == limit.isNull() ) {
+                config.limit_ = static_cast<size_t>(limit.asUInt64());
+            }
+            if ( config.limit_ > 0xFFFFFFFF ) {
+                throw ::cc::Exception("%s", "Invalid compression configuration, 'limit' must fit 32 bits!");
+            }
+            return config;
+        }
+
+        /**
+         * @return True if data is a compressed frame.
+         *
+         * @param a_data Payload or response, as transported.
+         */
+        inline bool Compressor::Framed (const std::string& a_data)
+        {
+            return ( a_data.length() >= k_head_ && k_marker_ == static_cast<uint8_t>(a_data[0]) );
+        }
+
+        /**
+         * @return True if value is a compressed envelope.
+         *
+         * @param a_value Payload or response.
+         */
+        inline bool Compressor::Enveloped (const Json::Value& a_value)
+        {
+            return ( true == a_value.isObject() && true == a_value.isMember(k_envelope_) && true == a_value["data"].isString() );
+        }
+
+        /**
+         * @brief Wrap data, as is, in a JSON envelope; used for binary encoded data that was not compressed.
+         *
+         * @param a_data     Data to wrap.
+         * @param o_envelope JSON envelope, see \link Enveloped \link.
+         */
+        inline void Compressor::Wrap (const std::string& a_data, Json::Value& o_envelope)
+        {
+            std::string text;
+            ToBase64(a_data, text);
+            o_envelope = Json::Value(Json::ValueType::objectValue);
+            o_envelope[k_envelope_] = "none";
+            o_envelope["data"]      = text;
+        }
+
+        /**
+         * @brief Compress data, if enabled and it's worth it.
+         *
+         * @param a_data  Data to compress.
+         * @param o_frame Compressed frame, untouched if false is returned.
+         *
+         * @return True if data was compressed, false if disabled, below threshold or it did not shrink.
+         */
+        inline bool Compressor::Deflate (const std::string& a_data, std::string& o_frame)
+        {
+            if ( false == config_.enabled_ || a_data.length() < config_.threshold_ || a_data.length() > 0xFFFFFFFF ) {
+                return false;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            std::string frame;
+            frame.reserve(a_data.length() / 2 + k_head_);
+            frame.push_back(static_cast<char>(k_marker_));
+            frame.push_back(static_cast<char>(k_lz4_));
+            for ( size_t idx = 4 ; idx > 0 ; --idx ) {
+                frame.push_back(static_cast<char>(( a_data.length() >> ( 8 * ( idx - 1 ) ) ) & 0xFF));
+            }
+            Encode(reinterpret_cast<const uint8_t*>(a_data.c_str()), a_data.length(), frame);
+            stats_.deflate_us_ += Elapsed(start);
+            // ... worth it?
+            if ( frame.length() >= a_data.length() ) {
+                stats_.skipped_++;
+                return false;
+            }
+            stats_.compressed_++;
+            stats_.in_  += a_data.length();
+            stats_.out_ += frame.length();
+            o_frame.swap(frame);
+            return true;
+        }
+
+        /**
+         * @brief Expand a compressed frame.
+         *
+         * @param a_frame Compressed frame, see \link Framed \link.
+         * @param o_data  Original data.
+         */
+        inline void Compressor::Inflate (const std::string& a_frame, std::string& o_data)
+        {
+            if ( false == Framed(a_frame) ) {
+                throw ::cc::Exception("%s", "Invalid compressed frame, missing header!");
+            }
+            if ( k_lz4_ != static_cast<uint8_t>(a_frame[1]) ) {
+                throw ::cc::Exception("Invalid compressed frame, unsupported algorithm %u!", static_cast<unsigned>(static_cast<uint8_t>(a_frame[1])));
+            }
+            size_t size = 0;
+            for ( size_t idx = 2 ; idx < k_head_ ; ++idx ) {
+                size = ( size << 8 ) | static_cast<uint8_t>(a_frame[idx]);
+            }
+            if ( size > config_.limit_ ) {
+                throw ::cc::Exception("Invalid compressed frame, original size " SIZET_FMT " is above limit " SIZET_FMT "!", size, config_.limit_);
+            }
+            const auto start = std::chrono::steady_clock::now();
+            Decode(reinterpret_cast<const uint8_t*>(a_frame.c_str()) + k_head_, a_frame.length() - k_head_, size, o_data);
+            stats_.inflate_us_ += Elapsed(start);
+            stats_.expanded_++;
+        }
+
+        /**
+         * @brief Compress data into a JSON envelope, if enabled and it's worth it.
+         *
+         * @param a_data     Data to compress, usually an encoded JSON value.
+         * @param o_envelope Compressed envelope, untouched if false is returned.
+         *
+         * @return True if data was compressed.
+         */
+        inline bool Compressor::Pack (const std::string& a_data, Json::Value& o_envelope)
+        {
+            std::string frame;
+            if ( false == Deflate(a_data, frame) ) {
+                return false;
+            }
+            std::string text;
+            ToBase64(frame, text);
+            o_envelope = Json::Value(Json::ValueType::objectValue);
+            o_envelope[k_envelope_] = "lz4";
+            o_envelope["data"]      = text;
+            return true;
+        }
+
+        /**
+         * @brief Expand a JSON envelope.
+         *
+         * @param a_envelope Compressed, or wrapped, envelope, see \link Enveloped \link.
+         * @param o_data     Original data.
+         */
+        inline void Compressor::Unpack (const Json::Value& a_envelope, std::string& o_data)
+        {
+            if ( false == Enveloped(a_envelope) || false == a_envelope[k_envelope_].isString() ) {
+                throw ::cc::Exception("%s", "Invalid compressed envelope!");
+            }
+            const std::string algorithm = a_envelope[k_envelope_].asString();
+            if ( 0 != algorithm.compare("lz4") && 0 != algorithm.compare("none") ) {
+                throw ::cc::Exception("%s", "Invalid compressed envelope!");
+            }
+            const char* begin = nullptr;
+            const char* end   = nullptr;
+            a_envelope["data"].getString(&begin, &end);
+            if ( 0 == algorithm.compare("none") ) {
+                FromBase64(begin, static_cast<size_t>(end - begin), o_data);
+                return;
+            }
+            std::string frame;
+            FromBase64(begin, static_cast<size_t>(end - begin), frame);
+            Inflate(frame, o_data);
+        }
+
+        /**
+         * @brief Compress data to an LZ4 block: greedy, single hash table of 4 bytes sequences.
+         *
+         * @param a_data   Data to compress.
+         * @param a_length Data length.
+         * @param o_block  Where to append the block.
+         */
+        inline void Compressor::Encode (const uint8_t* const a_data, const size_t a_length, std::string& o_block)
+        {
+            size_t anchor = 0;
+            if ( a_length > k_match_limit_ ) {
+                std::vector<uint32_t> table(static_cast<size_t>(1) << k_hash_log_, 0);
+                const size_t limit = a_length - k_match_limit_;
+                size_t       pos   = 0;
+                while ( pos < limit ) {
+                    const uint32_t sequence = Read32(a_data + pos);
+                    const uint32_t hash     = ( sequence * 2654435761U ) >> ( 32 - k_hash_log_ );
+                    const size_t   ref      = table[hash];
+                    table[hash] = static_cast<uint32_t>(pos);
+                    if ( ref < pos && pos - ref <= k_max_offset_ && Read32(a_data + ref) == sequence ) {
+                        size_t match = k_min_match_;
+                        while ( pos + match < a_length - k_last_literals_ && a_data[ref + match] == a_data[pos + match] ) {
+                            ++match;
+                        }
+                        Sequence(a_data + anchor, pos - anchor, pos - ref, match, o_block);
+                        pos   += match;
+                        anchor = pos;
+                    } else {
+                        // ... skip faster over data that does not compress ...
+                        pos += 1 + ( ( pos - anchor ) >> 6 );
+                    }
+                }
+            }
+            // ... last literals ...
+            const size_t count = a_length - anchor;
+            o_block.push_back(static_cast<char>(( count < 15 ? count : 15 ) << 4));
+            if ( count >= 15 ) {
+                Length(count - 15, o_block);
+            }
+            o_block.append(reinterpret_cast<const char*>(a_data + anchor), count);
+        }
+
+        /**
+         * @brief Expand an LZ4 block, every length and offset is checked against input and output bounds.
+         *
+         * @param a_block  Block.
+         * @param a_length Block length.
+         * @param a_size   Original size.
+         * @param o_data   Original data.
+         */
+        inline void Compressor::Decode (const uint8_t* const a_block, const size_t a_length, const size_t a_size, std::string& o_data)
+        {
+            o_data.resize(a_size);
+            char*  out = ( a_size > 0 ? &o_data[0] : nullptr );
+            size_t ip  = 0;
+            size_t op  = 0;
+            const auto length = [a_block, a_length, a_size, &ip] (size_t a_value) -> size_t {
+                uint8_t byte;
+                do {
+                    if ( ip >= a_length ) {
+                        throw ::cc::Exception("%s", "Invalid compressed block, truncated length!");
+                    }
+                    byte     = a_block[ip++];
+                    a_value += byte;
+                    if ( a_value > a_size ) {
+                        throw ::cc::Exception("%s", "Invalid compressed block, length out of bounds!");
+                    }
+                } while ( 255 == byte );
+                return a_value;
+            };
+            while ( true ) {
+                if ( ip >= a_length ) {
+                    throw ::cc::Exception("%s", "Invalid compressed block, truncated!");
+                }
+                const uint8_t token = a_block[ip++];
+                // ... literals ...
+                size_t count = ( token >> 4 );
+                if ( 15 == count ) {
+                    count = length(count);
+                }
+                if ( count > a_length - ip || count > a_size - op ) {
+                    throw ::cc::Exception("%s", "Invalid compressed block, literals out of bounds!");
+                }
+                if ( count > 0 ) {
+                    memcpy(out + op, a_block + ip, count);
+                }
+                ip += count;
+                op += count;
+                // ... last sequence?
+                if ( ip == a_length ) {
+                    break;
+                }
+                // ... match ...
+                if ( a_length - ip < 2 ) {
+                    throw ::cc::Exception("%s", "Invalid compressed block, truncated offset!");
+                }
+                const size_t offset = static_cast<size_t>(a_block[ip]) | ( static_cast<size_t>(a_block[ip + 1]) << 8 );
+                ip += 2;
+                if ( 0 == offset || offset > op ) {
+                    throw ::cc::Exception("%s", "Invalid compressed block, offset out of bounds!");
+                }
+                size_t match = ( token & 0x0F );
+                if ( 15 == match ) {
+                    match = length(match);
+                }
+                match += k_min_match_;
+                if ( match > a_size - op ) {
+                    throw ::cc::Exception("%s", "Invalid compressed block, match out of bounds!");
+                }
+                // ... byte by byte, match may overlap it's own output ...
+                for ( size_t idx = 0 ; idx < match ; ++idx, ++op ) {
+                    out[op] = out[op - offset];
+                }
+            }
+            if ( op != a_size ) {
+                throw ::cc::Exception("Invalid compressed block, expanded to " SIZET_FMT " byte(s) instead of " SIZET_FMT "!", op, a_size);
+            }
+        }
+
+        /**
+         * @brief Append a sequence: literals followed by a match.
+         *
+         * @param a_literals Literals.
+         * @param a_count    Number of literals.
+         * @param a_offset   Match offset, back from current position.
+         * @param a_match    Match length, at least \link k_min_match_ \link.
+         * @param o_block    Where to append it.
+         */
+        inline void Compressor::Sequence (const uint8_t* const a_literals, const size_t a_count, const size_t a_offset, const size_t a_match, std::string& o_block)
+        {
+            const size_t match = a_match - k_min_match_;
+            o_block.push_back(static_cast<char>(( ( a_count < 15 ? a_count : 15 ) << 4 ) | ( match < 15 ? match : 15 )));
+            if ( a_count >= 15 ) {
+                Length(a_count - 15, o_block);
+            }
+            o_block.append(reinterpret_cast<const char*>(a_literals), a_count);
+            o_block.push_back(static_cast<char>(a_offset & 0xFF));
+            o_block.push_back(static_cast<char>(( a_offset >> 8 ) & 0xFF));
+            if ( match >= 15 ) {
+                Length(match - 15, o_block);
+            }
+        }
+
+        /**
+         * @brief Append the remainder of a length that did not fit it's token nibble.
+         *
+         * @param a_length Remainder.
+         * @param o_block  Where to append it.
+         */
+        inline void Compressor::Length (size_t a_length, std::string& o_block)
+        {
+            while ( a_length >= 255 ) {
+                o_block.push_back(static_cast<char>(255));
+                a_length -= 255;
+            }
+            o_block.push_back(static_cast<char>(a_length));
+        }
+
+        /**
+         * @brief Base64 encode binary data.
+         *
+         * @param a_data Data.
+         * @param o_text Base64 text, padded.
+         */
+        inline void Compressor::ToBase64 (const std::string& a_data, std::string& o_text)
+        {
+            static const char* const k_alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            const uint8_t* const data   = reinterpret_cast<const uint8_t*>(a_data.c_str());
+            const size_t         length = a_data.length();
+            o_text.clear();
+            o_text.reserve(( ( length + 2 ) / 3 ) * 4);
+            size_t idx = 0;
+            for ( ; idx + 3 <= length ; idx += 3 ) {
+                const uint32_t v = ( static_cast<uint32_t>(data[idx]) << 16 ) | ( static_cast<uint32_t>(data[idx + 1]) << 8 ) | data[idx + 2];
+                o_text.push_back(k_alphabet[( v >> 18 ) & 0x3F]);
+                o_text.push_back(k_alphabet[( v >> 12 ) & 0x3F]);
+                o_text.push_back(k_alphabet[( v >>  6 ) & 0x3F]);
+                o_text.push_back(k_alphabet[v & 0x3F]);
+            }
+            if ( idx < length ) {
+                const uint32_t v = ( static_cast<uint32_t>(data[idx]) << 16 ) | ( idx + 1 < length ? ( static_cast<uint32_t>(data[idx + 1]) << 8 ) : 0 );
+                o_text.push_back(k_alphabet[( v >> 18 ) & 0x3F]);
+                o_text.push_back(k_alphabet[( v >> 12 ) & 0x3F]);
+                o_text.push_back(idx + 1 < length ? k_alphabet[( v >> 6 ) & 0x3F] : '=');
+                o_text.push_back('=');
+            }
+        }
+
+        /**
+         * @brief Base64 decode text.
+         *
+         * @param a_text   Base64 text, padded.
+         * @param a_length Text length.
+         * @param o_data   Binary data.
+         */
+        inline void Compressor::FromBase64 (const char* const a_text, const size_t a_length, std::string& o_data)
+        {
+            if ( 0 != ( a_length % 4 ) ) {
+                throw ::cc::Exception("%s", "Invalid compressed envelope, bad base64 length!");
+            }
+            const auto value = [] (const char a_c) -> int {
+                if ( a_c >= 'A' && a_c <= 'Z' ) return a_c - 'A';
+                if ( a_c >= 'a' && a_c <= 'z' ) return a_c - 'a' + 26;
+                if ( a_c >= '0' && a_c <= '9' ) return a_c - '0' + 52;
+                if ( '+' == a_c ) return 62;
+                if ( '/' == a_c ) return 63;
+                return -1;
+            };
+            o_data.clear();
+            o_data.reserve(( a_length / 4 ) * 3);
+            for ( size_t idx = 0 ; idx < a_length ; idx += 4 ) {
+                const bool last = ( idx + 4 == a_length );
+                const int  pad  = ( true == last && '=' == a_text[idx + 3] ? ( '=' == a_text[idx + 2] ? 2 : 1 ) : 0 );
+                uint32_t   v    = 0;
+                for ( size_t n = 0 ; n < 4 ; ++n ) {
+                    const int d = ( n >= static_cast<size_t>(4 - pad) ? 0 : value(a_text[idx + n]) );
+                    if ( d < 0 ) {
+                        throw ::cc::Exception("%s", "Invalid compressed envelope, bad base64 character!");
+                    }
+                    v = ( v << 6 ) | static_cast<uint32_t>(d);
+                }
+                o_data.push_back(static_cast<char>(( v >> 16 ) & 0xFF));
+                if ( pad < 2 ) {
+                    o_data.push_back(static_cast<char>(( v >> 8 ) & 0xFF));
+                }
+                if ( pad < 1 ) {
+                    o_data.push_back(static_cast<char>(v & 0xFF));
+                }
+            }
+        }
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_COMPRESSOR_H_
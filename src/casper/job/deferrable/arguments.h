@@ -30,6 +30,8 @@
 
 #include "cc/macros.h"
 
+#include "json/json.h"
+
 namespace casper
 {
 
@@ -81,6 +83,17 @@ namespace casper
                 
                 virtual bool Primitive () const { return false; }
                 
+                /**
+                 * @return Canonical representation of these arguments, requests with equal keys are interchangeable;
+                 *         empty if they can't be compared.
+                 */
+                virtual std::string Key () const { return Canonical(parameters_); }
+                
+                /**
+                 * @return Tenant these arguments belong to, read from a parameters field; empty if unknown.
+                 */
+                virtual std::string Tenant (const std::string& a_field) const { return Member(parameters_, a_field); }
+                
             public: // Overloaded Operator(s)
                 
                 void operator = (Arguments const&)  = delete;  // assignment is not allowed
@@ -104,6 +117,41 @@ namespace casper
                     return parameters_;
                 }
                 
+            private: // Static Method(s) / Function(s)
+                
+                /**
+                 * @brief JSON objects members are written sorted by name, so equal values have equal representations.
+                 */
+                static std::string Canonical (const Json::Value& a_value)
+                {
+                    Json::FastWriter jfw; jfw.omitEndingLineFeed();
+                    return jfw.write(a_value);
+                }
+                
+                template <typename T>
+                static std::string Canonical (const T& /* a_value */)
+                {
+                    return "";
+                }
+                
+                /**
+                 * @brief Only scalar members of JSON objects are read.
+                 */
+                static std::string Member (const Json::Value& a_value, const std::string& a_field)
+                {
+                    if ( 0 == a_field.length() || false == a_value.isObject() || false == a_value.isMember(a_field) ) {
+                        return "";
+                    }
+                    const Json::Value& member = a_value[a_field];
+                    return ( true == member.isConvertibleTo(Json::ValueType::stringValue) ? member.asString() : "" );
+                }
+                
+                template <typename T>
+                static std::string Member (const T& /* a_value */, const std::string& /* a_field */)
+                {
+                    return "";
+                }
+                
             };
         
         } // end of namespace 'deferrable'
@@ -0,0 +1,378 @@
+/**
+ * @file balancer.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_BALANCER_H_
+#define CASPER_JOB_DEFERRABLE_BALANCER_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Spreads requests over a set of backend endpoints.
+             *
+             * Endpoints are picked by least outstanding requests or by power of two choices, both weighted by an RTT EWMA.
+             * An endpoint is ejected after a number of consecutive errors, once in a while one request is sent to it ( probe )
+             * and a successful response re-admits it. When all endpoints are ejected, all of them are eligible ( fail open ).
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Balancer final
+            {
+
+            public: // Data Type(s)
+
+                enum class Strategy : uint8_t {
+                    LeastOutstanding = 0,
+                    PowerOfTwoChoices
+                };
+
+                typedef struct {
+                    bool                     enabled_;
+                    Strategy                 strategy_;
+                    std::vector<std::string> endpoints_;
+                    double                   alpha_;          //!< 0..1, EWMA weight of a new RTT sample.
+                    size_t                   max_errors_;     //!< Consecutive errors that eject an endpoint.
+                    size_t                   probe_interval_; //!< In ms, how long an ejected endpoint waits for a probe.
+                } Config;
+
+                typedef struct {
+                    std::string                           url_;
+                    size_t                                outstanding_;
+                    double                                ewma_;     //!< RTT EWMA, in ms, 0 until first sample.
+                    size_t                                errors_;   //!< Consecutive errors.
+                    bool                                  ejected_;
+                    bool                                  probing_;
+                    std::chrono::steady_clock::time_point probe_at_;
+                    uint64_t                              requests_;
+                    uint64_t                              failures_;
+                } Endpoint;
+
+                typedef struct {
+                    uint64_t picks_;
+                    uint64_t probes_;
+                    uint64_t ejections_;
+                    uint64_t readmissions_;
+                } Stats;
+
+            private: // Data
+
+                Config                config_;
+                std::vector<Endpoint> endpoints_;
+                std::vector<size_t>   candidates_;
+                size_t                next_;   //!< Round-robin offset, spreads ties.
+                std::mt19937          random_;
+                Stats                 stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Balancer ();
+                virtual ~Balancer ();
+
+            public: // Method(s) / Function(s)
+
+                void   Setup   (const Config& a_config);
+                size_t Pick    ();
+                void   Release (const size_t a_index, const size_t a_rtt, const bool a_failed);
+                void   Abort   (const size_t a_index);
+                void   Reset   ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            private: // Method(s) / Function(s)
+
+                double Cost (const size_t a_index) const;
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if balancing is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Endpoint \link s.
+                 */
+                inline const std::vector<Endpoint>& endpoints () const
+                {
+                    return endpoints_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Balancer'
+
+            /**
+             * @brief Default constructor, balancing is disabled.
+             */
+            inline Balancer::Balancer ()
+                : random_(std::random_device()())
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Balancer::~Balancer ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, resets all state.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Balancer::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Pick an endpoint for a new request, it's accounted as outstanding until \link Release \link or \link Abort \link.
+             *
+             * @return Endpoint index.
+             */
+            inline size_t Balancer::Pick ()
+            {
+                const auto now = std::chrono::steady_clock::now();
+                stats_.picks_++;
+                // ... ejected endpoint waiting for a probe?
+                for ( size_t idx = 0 ; idx < endpoints_.size() ; ++idx ) {
+                    Endpoint& endpoint = endpoints_[idx];
+                    if ( true == endpoint.ejected_ && false == endpoint.probing_ && now >= endpoint.probe_at_ ) {
+                        endpoint.probing_ = true;
+                        endpoint.outstanding_++;
+                        endpoint.requests_++;
+                        stats_.probes_++;
+                        return idx;
+                    }
+                }
+                // ... healthy endpoints, or all of them if none is ...
+                candidates_.clear();
+                for ( size_t idx = 0 ; idx < endpoints_.size() ; ++idx ) {
+                    if ( false == endpoints_[idx].ejected_ ) {
+                        candidates_.push_back(idx);
+                    }
+                }
+                if ( 0 == candidates_.size() ) {
+                    for ( size_t idx = 0 ; idx < endpoints_.size() ; ++idx ) {
+                        candidates_.push_back(idx);
+                    }
+                }
+                size_t rv = candidates_[0];
+                if ( candidates_.size() > 1 ) {
+                    if ( Strategy::PowerOfTwoChoices == config_.strategy_ ) {
+                        const size_t first  = std::uniform_int_distribution<size_t>(0, candidates_.size() - 1)(random_);
+                        const size_t second = ( first + std::uniform_int_distribution<size_t>(1, candidates_.size() - 1)(random_) ) % candidates_.size();
+                        rv = ( Cost(candidates_[first]) <= Cost(candidates_[second]) ? candidates_[first] : candidates_[second] );
+                    } else {
+                        // ... fewest outstanding requests, faster one on ties, rotating start spreads exact ties ...
+                        const size_t start = next_++ % candidates_.size();
+                        rv = candidates_[start];
+                        for ( size_t offset = 1 ; offset < candidates_.size() ; ++offset ) {
+                            const Endpoint& best      = endpoints_[rv];
+                            const size_t    idx       = candidates_[( start + offset ) % candidates_.size()];
+                            const Endpoint& candidate = endpoints_[idx];
+                            if ( candidate.outstanding_ < best.outstanding_ || ( candidate.outstanding_ == best.outstanding_ && candidate.ewma_ < best.ewma_ ) ) {
+                                rv = idx;
+                            }
+                        }
+                    }
+                }
+                endpoints_[rv].outstanding_++;
+                endpoints_[rv].requests_++;
+                return rv;
+            }
+
+            /**
+             * @brief Account the outcome of a request.
+             *
+             * @param a_index  Endpoint index, as returned by \link Pick \link.
+             * @param a_rtt    Request RTT, in ms.
+             * @param a_failed True if endpoint failed to serve the request.
+             */
+            inline void Balancer::Release (const size_t a_index, const size_t a_rtt, const bool a_failed)
+            {
+                if ( a_index >= endpoints_.size() ) {
+                    return;
+                }
+                Endpoint& endpoint = endpoints_[a_index];
+                if ( endpoint.outstanding_ > 0 ) {
+                    endpoint.outstanding_--;
+                }
+                if ( true == a_failed ) {
+                    endpoint.errors_++;
+                    endpoint.failures_++;
+                    // ... failed probe or too many errors?
+                    if ( true == endpoint.probing_ || ( false == endpoint.ejected_ && endpoint.errors_ >= config_.max_errors_ ) ) {
+                        if ( false == endpoint.ejected_ ) {
+                            stats_.ejections_++;
+                        }
+                        endpoint.ejected_  = true;
+                        endpoint.probing_  = false;
+                        endpoint.probe_at_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.probe_interval_);
+                    }
+                    return;
+                }
+                endpoint.errors_ = 0;
+                endpoint.ewma_   = ( 0.0 == endpoint.ewma_ ? static_cast<double>(a_rtt) : config_.alpha_ * static_cast<double>(a_rtt) + ( 1.0 - config_.alpha_ ) * endpoint.ewma_ );
+                if ( true == endpoint.ejected_ ) {
+                    endpoint.ejected_ = false;
+                    endpoint.probing_ = false;
+                    stats_.readmissions_++;
+                }
+            }
+
+            /**
+             * @brief Account a request that ended without an outcome ( e.g. cancelled ).
+             *
+             * @param a_index Endpoint index, as returned by \link Pick \link.
+             */
+            inline void Balancer::Abort (const size_t a_index)
+            {
+                if ( a_index >= endpoints_.size() ) {
+                    return;
+                }
+                Endpoint& endpoint = endpoints_[a_index];
+                if ( endpoint.outstanding_ > 0 ) {
+                    endpoint.outstanding_--;
+                }
+                // ... probe must be retried ...
+                endpoint.probing_ = false;
+            }
+
+            /**
+             * @brief Forget all endpoints state and stats.
+             */
+            inline void Balancer::Reset ()
+            {
+                endpoints_.clear();
+                for ( const auto& url : config_.endpoints_ ) {
+                    endpoints_.push_back({
+                        /* url_         */ url,
+                        /* outstanding_ */ 0,
+                        /* ewma_        */ 0.0,
+                        /* errors_      */ 0,
+                        /* ejected_     */ false,
+                        /* probing_     */ false,
+                        /* probe_at_    */ std::chrono::steady_clock::time_point(),
+                        /* requests_    */ 0,
+                        /* failures_    */ 0
+                    });
+                }
+                candidates_.clear();
+                candidates_.reserve(endpoints_.size());
+                next_  = 0;
+                stats_ = { 0, 0, 0, 0 };
+            }
+
+            /**
+             * @brief Load a balancer configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for a disabled balancer.
+             *
+             * @return See \link Config \link.
+             */
+            inline Balancer::Config Balancer::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_strategy       = "p2c";
+                const Json::Value c_alpha          = 0.3;
+                const Json::Value c_max_errors     = 5;
+                const Json::Value c_probe_interval = 5000;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                Config rv = {
+                    /* enabled_        */ ( false == config.isNull() ),
+                    /* strategy_       */ Strategy::PowerOfTwoChoices,
+                    /* endpoints_      */ {},
+                    /* alpha_          */ json.Get(config, "alpha", Json::ValueType::realValue, &c_alpha).asDouble(),
+                    /* max_errors_     */ static_cast<size_t>(json.Get(config, "max-errors"    , Json::ValueType::uintValue, &c_max_errors).asUInt64()),
+                    /* probe_interval_ */ static_cast<size_t>(json.Get(config, "probe-interval", Json::ValueType::uintValue, &c_probe_interval).asUInt64())
+                };
+                if ( false == rv.enabled_ ) {
+                    return rv;
+                }
+                const std::string strategy = json.Get(config, "strategy", Json::ValueType::stringValue, &c_strategy).asString();
+                if ( "least-outstanding" == strategy ) {
+                    rv.strategy_ = Strategy::LeastOutstanding;
+                } else if ( "p2c" != strategy ) {
+                    throw ::cc::Exception("Unsupported balancing strategy '%s'!", strategy.c_str());
+                }
+                const Json::Value& endpoints = json.Get(config, "endpoints", Json::ValueType::arrayValue, nullptr);
+                for ( Json::ArrayIndex idx = 0 ; idx < endpoints.size() ; ++idx ) {
+                    rv.endpoints_.push_back(endpoints[idx].asString());
+                }
+                if ( 0 == rv.endpoints_.size() || rv.alpha_ <= 0.0 || rv.alpha_ > 1.0 || 0 == rv.max_errors_ || 0 == rv.probe_interval_ ) {
+                    throw ::cc::Exception("%s", "Invalid balancer configuration!");
+                }
+                return rv;
+            }
+
+            /**
+             * @return Expected cost of sending one more request to an endpoint: RTT EWMA weighted by it's load.
+             *
+             * @param a_index Endpoint index.
+             */
+            inline double Balancer::Cost (const size_t a_index) const
+            {
+                const Endpoint& endpoint = endpoints_[a_index];
+                return endpoint.ewma_ * static_cast<double>(endpoint.outstanding_ + 1);
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_BALANCER_H_
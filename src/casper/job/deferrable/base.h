@@ -26,6 +26,12 @@
 
 #include "casper/job/deferrable/deferred.h"
 #include "casper/job/deferrable/dispatcher.h"
+#include "casper/job/deferrable/recorder.h"
+#include "casper/job/deferrable/replay.h"
+#include "casper/job/deferrable/listener.h"
+#include "casper/job/deferrable/fan.h"
+#include "casper/job/deferrable/pipeline.h"
+#include "casper/job/deferrable/coroutine.h"
 
 #include "cc/exception.h"
 #include "cc/i18n/singleton.h"
@@ -65,6 +71,15 @@ namespace casper
                     std::function<uint16_t(const deferrable::Deferred<A>*, Json::Value&)> on_deferred_request_failed_;
                 } D;
                 
+                typedef deferrable::Fan::Merge Merge; //!< Sub-request responses, in fan-out order -> job response code.
+                
+            private: // Data Type(s)
+                
+                typedef struct {
+                    std::mutex mutex_;
+                    bool       alive_;
+                } Liveness;
+                
             protected: // Helper(s)
                 
                 D d_;
@@ -72,6 +87,17 @@ namespace casper
             private: // Data
                 
                 const bool sequentiable_;
+                Recorder*  recorder_; //!< When set, job traffic is recorded.
+                Script*    script_;   //!< When set, recorded responses are replayed.
+                Listener*  listener_; //!< When set, clients can cancel their jobs.
+                std::shared_ptr<Liveness> liveness_; //!< Shared with callbacks posted from other threads, so they can tell if this object was disposed.
+                std::map<uint64_t, deferrable::Fan*> fans_; //!< Jobs running concurrent sub-requests.
+                std::map<uint64_t, deferrable::Pipeline<S>*> pipelines_; //!< Jobs running a stages graph.
+                std::map<std::string, typename deferrable::Pipeline<S>::Timing> timings_; //!< Stage name -> Timing
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+                coroutine::Scheduler* scheduler_; //!< Resumes job coroutines.
+                std::map<uint64_t, bool> gateways_; //!< Job ID -> True if it's awaited requests have primitive arguments.
+#endif
 
             public: // Constructor(s) / Destructor
                 
@@ -81,16 +107,33 @@ namespace casper
                       const bool a_sequentiable = true);
                 virtual ~Base ();
                 
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+            public: // Inline Method(s) / Function(s) - Coroutines
+                
+                /**
+                 * @return R/W access to this tube coroutine scheduler, job coroutines allocate their frames from it.
+                 */
+                inline coroutine::Scheduler& scheduler ()
+                {
+                    return *scheduler_;
+                }
+                
+#endif
             public: // Inherited Virtual Method(s) / Function(s) - from cc::easy::job::Runnable
 
                 virtual void Setup ();
                 virtual void Run  (const uint64_t& a_id, const Json::Value& a_payload, cc::easy::job::Job::Response& o_response);
 
+            protected: // Inherited Virtual Method(s) / Function(s) - from casper::job::Basic
+
+                virtual bool Pending (const cc::easy::job::Job::Response& a_response) const;
+
             protected: // Virtual Method(s) / Function(s)
                 
                 virtual void InnerSetup   () = 0;
                 virtual void InnerRun     (const uint64_t& a_id, const Json::Value& a_payload, cc::easy::job::Job::Response& o_response) = 0;
                 virtual void InnerCleanUp () {}
+                virtual void Touch        (const std::vector<uint64_t>& a_ids, std::function<void(const uint64_t&, const bool)> a_callback);
 
             protected: // Method(s) / Function(s) - Callbacks
                 
@@ -121,12 +164,35 @@ namespace casper
                               const ::cc::easy::job::I18N a_i18n);
 
                 void HandleDeferredRequestCompletion (const deferrable::Deferred<A>* a_deferred, std::function<uint16_t(Json::Value&)> a_callback, const Tracking& a_tracking);
+                void Complete                        (const Tracking& a_tracking, const bool a_primitive, std::function<uint16_t(Json::Value&)> a_callback);
+                
+                std::vector<std::string> FanOut (const Tracking& a_tracking, const size_t a_count, const size_t a_quorum, Merge a_merge);
+                uint16_t                 FanIn  (const deferrable::Deferred<A>* a_deferred, Json::Value& o_payload);
+                
+                void                     Pipe    (const Tracking& a_tracking, const std::vector<typename deferrable::Pipeline<S>::Stage>& a_stages,
+                                                  typename deferrable::Pipeline<S>::Conclusion a_conclusion);
+                uint16_t                 Advance (const deferrable::Deferred<A>* a_deferred, Json::Value& o_payload);
+                void                     Launch  (deferrable::Pipeline<S>* a_pipeline, const Tracking& a_tracking);
+                void                     Dismiss (const uint64_t& a_id);
+                
+                bool                     Spool   (const Tracking& a_tracking, const deferrable::Response& a_response, Json::Value& o_reference);
+                using                    ::casper::job::Basic<S>::Spool;
+                
+            protected: // Inline Method(s) / Function(s)
+                
+                /**
+                 * @return R/O access to stage timings, by stage name, of all pipelines run so far.
+                 */
+                inline const std::map<std::string, typename deferrable::Pipeline<S>::Timing>& timings () const
+                {
+                    return timings_;
+                }
 
             protected: // Method(s) / Function(s) - Helpers
 
                 void SetDeferredRequestFailed   (const std::string& a_dpid, const deferrable::Response& a_response, const ::cc::Exception* a_exception, Json::Value& o_payload);
                 void LogDeferredRequestMessage  (const std::string& a_dpid, const size_t a_level, const deferrable::Tracking& a_tracking, const std::string& a_message);
-                void LogDeferredRequestResponse (const std::string& a_dpid, const deferrable::Tracking& a_tracking, const deferrable::Response& a_response);
+                void LogDeferredRequestResponse (const std::string& a_dpid, const deferrable::Tracking& a_tracking, const deferrable::Response& a_response, const size_t a_waited = 0);
                 
             }; // end of class 'Job'
 
@@ -153,6 +219,14 @@ namespace casper
                    sequentiable_(a_sequentiable)
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                recorder_ = nullptr;
+                script_   = nullptr;
+                listener_ = nullptr;
+                liveness_ = std::make_shared<Liveness>();
+                liveness_->alive_ = true;
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+                scheduler_ = nullptr;
+#endif
             }
 
             /**
@@ -162,9 +236,32 @@ namespace casper
             casper::job::deferrable::Base<A, S, doneValue>::Base::~Base ()
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                // ... stop listening first, no cancellation must reach a deleted dispatcher ...
+                if ( nullptr != listener_ ) {
+                    delete listener_;
+                }
+                // ... cancellations already posted to main thread must not reach this object ...
+                {
+                    std::lock_guard<std::mutex> lock(liveness_->mutex_);
+                    liveness_->alive_ = false;
+                }
                 if ( nullptr != d_.dispatcher_ ) {
                     delete d_.dispatcher_;
                 }
+                if ( nullptr != recorder_ ) {
+                    delete recorder_;
+                }
+                for ( auto& fan : fans_ ) {
+                    delete fan.second;
+                }
+                for ( auto& pipeline : pipelines_ ) {
+                    delete pipeline.second;
+                }
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+                if ( nullptr != scheduler_ ) {
+                    delete scheduler_;
+                }
+#endif
             }
 
             // MARK: -
@@ -201,6 +298,131 @@ namespace casper
                     /* on_log_deferred_             */ std::bind(&casper::job::deferrable::Base<A, S, doneValue>::OnDeferredRequestLog, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4),
                     /* on_log_tracking_             */ std::bind(&casper::job::deferrable::Base<A, S, doneValue>::OnDeferredRequestLogTracking, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4)
                 });
+
+                //
+                // RECORD / REPLAY setup
+                //
+                const ::cc::easy::JSON<::cc::Exception> json;
+                const Json::Value& recorder = json.Get(DeferrableBaseClassAlias::config_.other(), "recorder", Json::ValueType::objectValue, &Json::Value::null);
+                if ( false == recorder.isNull() ) {
+                    recorder_ = new Recorder(json.Get(recorder, "path", Json::ValueType::stringValue, nullptr).asString(), DeferrableBaseClassAlias::tube_);
+                }
+                const Json::Value& replay = json.Get(DeferrableBaseClassAlias::config_.other(), "replay", Json::ValueType::objectValue, &Json::Value::null);
+                if ( false == replay.isNull() ) {
+                    script_ = &Script::Load(json.Get(replay, "path", Json::ValueType::stringValue, nullptr).asString());
+                    d_.dispatcher_->Replay(script_);
+                }
+
+                //
+                // CONCURRENCY LIMIT setup
+                //
+                d_.dispatcher_->Limit(Limiter::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "limiter", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // EARLIEST DEADLINE FIRST setup
+                //
+                const Json::Value c_edf = false;
+                d_.dispatcher_->Prioritize(json.Get(DeferrableBaseClassAlias::config_.other(), "edf", Json::ValueType::booleanValue, &c_edf).asBool());
+
+                //
+                // HEDGING setup
+                //
+                d_.dispatcher_->Hedge(Hedger::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "hedging", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // COALESCING setup
+                //
+                const Json::Value c_coalescing = false;
+                d_.dispatcher_->Coalesce(json.Get(DeferrableBaseClassAlias::config_.other(), "coalescing", Json::ValueType::booleanValue, &c_coalescing).asBool());
+
+                //
+                // CACHE setup
+                //
+                d_.dispatcher_->Memoize(Cache::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "cache", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // BATCHING setup
+                //
+                d_.dispatcher_->Batch(Batcher::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "batching", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // BALANCING setup
+                //
+                d_.dispatcher_->Balance(Balancer::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "balancer", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // CIRCUIT BREAKER setup
+                //
+                d_.dispatcher_->Protect(Breaker::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "breaker", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // RATE LIMIT setup
+                //
+                d_.dispatcher_->Ration(Throttle::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "throttle", Json::ValueType::objectValue, &Json::Value::null)));
+
+                //
+                // TTR KEEP-ALIVE setup
+                //
+                d_.dispatcher_->Sustain(Keeper::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "keep-alive", Json::ValueType::objectValue, &Json::Value::null)),
+                                        std::bind(&casper::job::deferrable::Base<A, S, doneValue>::Touch, this, std::placeholders::_1, std::placeholders::_2)
+                );
+
+                //
+                // CANCELLATION setup
+                //
+                const Listener::Config cancellation = Listener::Load(json.Get(DeferrableBaseClassAlias::config_.other(), "cancellation", Json::ValueType::objectValue, &Json::Value::null));
+                if ( true == cancellation.enabled_ ) {
+                    listener_ = new Listener(cancellation, [this] (const std::string& a_rcid) {
+                        // ... called on listener thread, this object is alive until listener is stopped ...
+                        const auto liveness = liveness_;
+                        DeferrableBaseClassAlias::ExecuteOnMainThread([this, liveness, a_rcid] () {
+                            // ... but it might be gone when this callback runs ...
+                            std::lock_guard<std::mutex> lock(liveness->mutex_);
+                            if ( false == liveness->alive_ ) {
+                                return;
+                            }
+                            d_.dispatcher_->Revoke(a_rcid);
+                        }, /* a_blocking */ false);
+                    });
+                    listener_->Start();
+                }
+
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+                //
+                // COROUTINES setup
+                //
+                scheduler_ = new coroutine::Scheduler({
+                    /* on_main_thread_          */ [this] (std::function<void()> a_callback) {
+                        // ... any thread, coroutines might be resumed on looper thread ...
+                        DeferrableBaseClassAlias::ExecuteOnMainThread(a_callback, /* a_blocking */ false);
+                    },
+                    /* on_main_thread_deferred_ */ std::bind(&casper::job::deferrable::Base<A, S, doneValue>::OnMainThreadDelayed, this, std::placeholders::_1, std::placeholders::_2),
+                    /* on_looper_thread_        */ std::bind(&casper::job::deferrable::Base<A, S, doneValue>::OnLooperThread, this, std::placeholders::_1, std::placeholders::_2),
+                    /* on_exception_            */ [this] (std::exception_ptr a_exception) {
+                        try {
+                            std::rethrow_exception(a_exception);
+                        } catch (...) {
+                            try {
+                                ::cc::Exception::Rethrow(/* a_unhandled */ true, __FILE__, __LINE__, __FUNCTION__);
+                            } catch (const ::cc::Exception& a_cc_exception) {
+                                CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_ERR, CC_JOB_LOG_STEP_ERROR,
+                                               CC_JOB_LOG_COLOR(LIGHT_RED) "%s" CC_LOGS_LOGGER_RESET_ATTRS " - %s: %s",
+                                               "FAILED", "coroutine ended with an exception", a_cc_exception.what()
+                                );
+                            }
+                        }
+                    },
+                    /* on_concluded_            */ [this] (const Tracking& a_tracking) {
+                        // ... concluded while not resumed by a completion, finish it now ...
+                        const auto gateway = gateways_.find(a_tracking.bjid_);
+                        const bool primitive = ( gateways_.end() != gateway && true == gateway->second );
+                        gateways_.erase(a_tracking.bjid_);
+                        Complete(a_tracking, primitive, [this, a_tracking] (Json::Value& o_payload) -> uint16_t {
+                            return scheduler_->Outcome(a_tracking.bjid_, o_payload);
+                        });
+                    }
+                });
+#endif
             }
         
             /**
@@ -220,6 +442,9 @@ namespace casper
                 CC_DEBUG_ASSERT(nullptr != d_.dispatcher_);
                 CC_DEBUG_ASSERT(nullptr != d_.on_deferred_request_completed_);
 
+                // ... looper runs a job as soon as it's reserved, TTR countdown started about now ...
+                const auto reserved = std::chrono::steady_clock::now();
+
                 Json::FastWriter jfw; jfw.omitEndingLineFeed();
                 
                 // ... log request ...
@@ -232,16 +457,37 @@ namespace casper
                                    "Payload: %s", jfw.write(a_payload).c_str()
                     );
                 }
-                
+
+                // ... record / replay?
+                if ( nullptr != recorder_ || nullptr != script_ ) {
+                    const std::string payload = jfw.write(a_payload);
+                    if ( nullptr != recorder_ ) {
+                        recorder_->Payload(a_id, payload);
+                    }
+                    if ( nullptr != script_ && false == script_->Bind(a_id, payload) ) {
+                        CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_WRN, CC_JOB_LOG_STEP_IN, "%s", "Payload not found in recording");
+                    }
+                }
 
                 // ... one-shot call ensured by dispatcher: load additional configs from dispatcher ...
                 d_.dispatcher_->Load();
 
+                // ... producer accepts a compressed result?
+                DeferrableBaseClassAlias::Negotiate(a_id, a_payload);
+
                 try {
+                    // ... expand payload if it's compressed ...
+                    Json::Value        inflated;
+                    const Json::Value& payload = ( true == DeferrableBaseClassAlias::Inflate(a_payload, inflated) ? inflated : a_payload );
+                    // ... job validity bounds all of it's deferred requests ...
+                    (void)DeferrableBaseClassAlias::Payload(payload);
+                    d_.dispatcher_->Deadline(a_id, DeferrableBaseClassAlias::Validity(), reserved);
+                    // ... job can be cancelled from now on, even before it dispatches it's first request ...
+                    d_.dispatcher_->Enlist(a_id, ( nullptr != DeferrableBaseClassAlias::Chained() ? DeferrableBaseClassAlias::Chained()->rcid_ : DeferrableBaseClassAlias::RCID() ));
                     // ... pre-run clean up ..
                     InnerCleanUp();
                     // ... run ...
-                    InnerRun(a_id, a_payload, o_response);
+                    InnerRun(a_id, payload, o_response);
                     // ... post-run clean up ..
                     InnerCleanUp();
                 } catch (const ::cc::CodedException& a_coded_exception) {
@@ -302,6 +548,10 @@ namespace casper
                 if ( CC_STATUS_CODE_OK == o_response.code_ ) {
                     // ... insanity checkpoint ...
                     CC_ASSERT(true == DeferrableBaseClassAlias::Deferred());
+                    // ... keep job reserved until it's finished, chained jobs were not reserved ...
+                    if ( nullptr == DeferrableBaseClassAlias::Chained() ) {
+                        d_.dispatcher_->Keep(a_id, DeferrableBaseClassAlias::TTR(), reserved);
+                    }
                     // ... status ...
                     CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATUS,
                                    "%s",
@@ -309,6 +559,29 @@ namespace casper
                     );
                 } else {
                     
+                    // ... not deferred, nothing to track ...
+                    d_.dispatcher_->Drop(a_id);
+                    const auto fan = fans_.find(a_id);
+                    if ( fans_.end() != fan ) {
+                        delete fan->second;
+                        fans_.erase(fan);
+                    }
+                    Dismiss(a_id);
+                    DeferrableBaseClassAlias::Conclude(a_id, o_response.code_, o_response.payload_);
+
+                    // ... record / verify final response, a synchronous failure is also a terminal one ...
+                    if ( nullptr != recorder_ || nullptr != script_ ) {
+                        Json::Value payload  = o_response.payload_;
+                        Json::Value response = Json::Value::null;
+                        (void)DeferrableBaseClassAlias::SetFailedResponse(o_response.code_, payload, response);
+                        if ( nullptr != recorder_ ) {
+                            recorder_->Finished(a_id, response);
+                        }
+                        if ( nullptr != script_ ) {
+                            script_->Check(a_id, response);
+                        }
+                    }
+
                     // ... response ...
                     if ( true == DeferrableBaseClassAlias::config_.log_redact() ) {
                         CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_OUT,
@@ -329,6 +602,47 @@ namespace casper
                 }
             }
 
+            /**
+             * @return True if a chained job was deferred, it's result is published when it's deferred requests complete.
+             *
+             * @param a_response Response filled by \link Run \link.
+             *
+             * @note InnerRun must build it's \link Tracking \link from \link Chained \link identifiers, when set.
+             */
+            template <class A, typename S, S doneValue>
+            bool casper::job::deferrable::Base<A, S, doneValue>::Pending (const cc::easy::job::Job::Response& a_response) const
+            {
+                return ( CC_STATUS_CODE_OK == a_response.code_ );
+            }
+
+            /**
+             * @brief Touch a batch of reserved jobs, so that their TTR restarts.
+             *
+             * @param a_ids      Job IDs.
+             * @param a_callback Function to call for each job, with true if it was touched.
+             */
+            template <class A, typename S, S doneValue>
+            void casper::job::deferrable::Base<A, S, doneValue>::Touch (const std::vector<uint64_t>& a_ids, std::function<void(const uint64_t&, const bool)> a_callback)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                size_t failed = 0;
+                for ( const auto& id : a_ids ) {
+                    bool touched = false;
+                    try {
+                        touched = ::casper::job::Basic<S>::Touch(id);
+                    } catch (const ::cc::Exception& a_cc_exception) {
+                        CASPER_JOB_LOG(CC_JOB_LOG_LEVEL_ERR, CC_JOB_LOG_STEP_ERROR, "Unable to touch job " UINT64_FMT ": %s", id, a_cc_exception.what());
+                    }
+                    if ( false == touched ) {
+                        failed++;
+                    }
+                    a_callback(id, touched);
+                }
+                CASPER_JOB_LOG(( 0 == failed ? CC_JOB_LOG_LEVEL_DBG : CC_JOB_LOG_LEVEL_WRN ), CC_JOB_LOG_STEP_INFO,
+                               "Touched " SIZET_FMT " of " SIZET_FMT " job(s)", a_ids.size() - failed, a_ids.size()
+                );
+            }
+
             // MARK: -  Deferred::Callbacks.
 
             /**
@@ -413,12 +727,52 @@ namespace casper
                 // TODO: review the need for this ( @ log )
                 // ... only if it's not sequentiable ...
                 if ( true == sequentiable_ ) {
-                    LogDeferredRequestResponse(abbr_.c_str(), a_deferred->tracking_, a_deferred->response());
+                    LogDeferredRequestResponse(abbr_.c_str(), a_deferred->tracking_, a_deferred->response(), a_deferred->waited());
+                }
+
+                // ... record response?
+                if ( nullptr != recorder_ ) {
+                    recorder_->Response(a_deferred->tracking_.bjid_, a_deferred->response());
                 }
                 
                 //
                 // ... process response ...
                 //
+                if ( fans_.end() != fans_.find(a_deferred->tracking_.bjid_) ) {
+                    // ... one of many concurrent sub-requests ...
+                    HandleDeferredRequestCompletion(a_deferred,
+                                                    [this, a_deferred](Json::Value& o_payload) -> uint16_t {
+                                                        return FanIn(a_deferred, o_payload);
+                                                    }, a_deferred->tracking_
+                    );
+                    return;
+                }
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+                if ( true == scheduler_->Waiting(a_deferred->id_) ) {
+                    // ... awaited by a job coroutine, it runs until it's next suspension point and might conclude job ...
+                    gateways_[a_deferred->tracking_.bjid_] = a_deferred->arguments().Primitive();
+                    HandleDeferredRequestCompletion(a_deferred,
+                                                    [this, a_deferred](Json::Value& o_payload) -> uint16_t {
+                                                        scheduler_->Resume(a_deferred->id_, a_deferred->response());
+                                                        const uint16_t code = scheduler_->Outcome(a_deferred->tracking_.bjid_, o_payload);
+                                                        if ( 0 != code ) {
+                                                            gateways_.erase(a_deferred->tracking_.bjid_);
+                                                        }
+                                                        return code;
+                                                    }, a_deferred->tracking_
+                    );
+                    return;
+                }
+#endif
+                if ( pipelines_.end() != pipelines_.find(a_deferred->tracking_.bjid_) ) {
+                    // ... one of many stages ...
+                    HandleDeferredRequestCompletion(a_deferred,
+                                                    [this, a_deferred](Json::Value& o_payload) -> uint16_t {
+                                                        return Advance(a_deferred, o_payload);
+                                                    }, a_deferred->tracking_
+                    );
+                    return;
+                }
                 HandleDeferredRequestCompletion(a_deferred,
                                                 [this, a_deferred](Json::Value& o_payload) -> uint16_t {
                                                     // ... success?
@@ -633,9 +987,36 @@ namespace casper
              *                  - if returns 0 don't finalize job now ( still work to do );
              *                  - if 0, or if an exception is catched finalize job immediatley.
              * @param o_payload JSON response to fill.
+             *
+             * @note In gateway mode job result is the deferred request response, if it's body is above spill threshold
+             *       it's moved to a file and job result is it's reference, see \link Spool \link.
              */
             template <class A, typename S, S doneValue>
             void casper::job::deferrable::Base<A, S, doneValue>::HandleDeferredRequestCompletion (const deferrable::Deferred<A>* a_deferred, std::function<uint16_t(Json::Value& o_payload)> a_callback, const Tracking& a_tracking)
+            {
+                const bool primitive = a_deferred->arguments().Primitive();
+                Complete(a_tracking, primitive, [this, a_deferred, a_callback, &a_tracking, primitive] (Json::Value& o_payload) -> uint16_t {
+                    const uint16_t code = a_callback(o_payload);
+                    // ... finished with a large body that client still wants? it travels by reference ...
+                    if ( CC_STATUS_CODE_OK == code && true == primitive && false == d_.dispatcher_->Revoked(a_tracking.bjid_) ) {
+                        Json::Value reference;
+                        if ( true == Spool(a_tracking, a_deferred->response(), reference) ) {
+                            o_payload.swap(reference);
+                        }
+                    }
+                    return code;
+                });
+            }
+
+            /**
+             * @brief Finish a job, if it's done, and publish it's result.
+             *
+             * @param a_tracking  Job tracking info.
+             * @param a_primitive True if job result must be published in gateway mode.
+             * @param a_callback  See \link HandleDeferredRequestCompletion \link.
+             */
+            template <class A, typename S, S doneValue>
+            void casper::job::deferrable::Base<A, S, doneValue>::Complete (const Tracking& a_tracking, const bool a_primitive, std::function<uint16_t(Json::Value& o_payload)> a_callback)
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
                 
@@ -644,9 +1025,16 @@ namespace casper
                 
                 uint16_t code = CC_STATUS_CODE_INTERNAL_SERVER_ERROR;
                 
+                // ... client gave up on this job?
+                const bool cancelled = d_.dispatcher_->Revoked(a_tracking.bjid_);
+                
                 try {
                     // ... perform callback ...
                     code = a_callback(payload);
+                    // ... done? spill or compress result, unless client gave up on it ...
+                    if ( 0 != code && false == cancelled ) {
+                        DeferrableBaseClassAlias::Conclude(a_tracking.bjid_, code, payload);
+                    }
                     // ... success?
                     if ( CC_STATUS_CODE_OK == code ) {
                         // ... set 'completed' response ...
@@ -678,20 +1066,51 @@ namespace casper
                     // ... yes, we're done here ...
                     return;
                 }
+
+                // ... finished, result may not have been concluded ( cancelled or failed ) ...
+                DeferrableBaseClassAlias::Forget(a_tracking.bjid_);
+                
+                // ... cancelled? whatever the outcome, client is no longer interested in it ...
+                if ( true == cancelled ) {
+                    payload  = Json::Value(Json::ValueType::objectValue);
+                    response = Json::Value::null;
+                    code     = DeferrableBaseClassAlias::SetFailedResponse(
+                        DeferrableBaseClassAlias::SetError(CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED, /* a_i18n */ nullptr,
+                                                           /* a_error */ ::cc::easy::job::InternalError{
+                                                               /* code_ */ nullptr,
+                                                               /* why_  */ "Job cancelled by client"
+                                                           }, payload
+                        ),
+                        payload, response
+                    );
+                }
                         
                 // ... insanity checkpoint ...
                 CC_ASSERT(false == response.isNull());
 
                 // ... publish progress ( 100% ) ...
-                Publish(a_tracking.bjid_, a_tracking.rcid_, a_tracking.rjid_, doneValue, DeferrableBaseClassAlias::Status::InProgress,
-                        DeferrableBaseClassAlias::I18NCompleted()
-                );
+                if ( false == cancelled ) {
+                    Publish(a_tracking.bjid_, a_tracking.rcid_, a_tracking.rjid_, doneValue, DeferrableBaseClassAlias::Status::InProgress,
+                            DeferrableBaseClassAlias::I18NCompleted()
+                    );
+                }
 
                 //
                 // ... log final response ...
                 //
                 DeferrableBaseClassAlias::LogResponse({ code, Json::Value::null }, response);
 
+                // ... record / verify final response?
+                if ( nullptr != recorder_ ) {
+                    recorder_->Finished(a_tracking.bjid_, response);
+                }
+                if ( nullptr != script_ ) {
+                    script_->Check(a_tracking.bjid_, response);
+                }
+
+                // ... no longer needs to be kept alive ...
+                d_.dispatcher_->Drop(a_tracking.bjid_);
+
                 // ... publish result ...
                 DeferrableBaseClassAlias::Finished(/* a_id               */ a_tracking.bjid_,
                                                    /* a_channel          */ a_tracking.rcid_,
@@ -706,19 +1125,262 @@ namespace casper
                                                                       "FAILED", "while publishing finished notification", a_ev_exception.what()
                                                         );
                                                    },
-                                                   /* a_mode */ ( true == a_deferred->arguments().Primitive() ? DeferrableBaseClassAlias::Mode::Gateway : DeferrableBaseClassAlias::Mode::Default )
+                                                   /* a_mode */ ( true == a_primitive ? DeferrableBaseClassAlias::Mode::Gateway : DeferrableBaseClassAlias::Mode::Default )
                 );
             }
 
+            /**
+             * @brief Prepare a job to run concurrent sub-requests, each one must be dispatched with one of the returned IDs.
+             *
+             * @param a_tracking Job tracking info.
+             * @param a_count    Number of sub-requests.
+             * @param a_quorum   Number of sub-requests that must succeed to complete job, 1..a_count.
+             * @param a_merge    Function to call once quorum is reached, or can no longer be reached, to build job response.
+             *
+             * @return Sub-request IDs, in fan-out order.
+             */
+            template <class A, typename S, S doneValue>
+            std::vector<std::string> casper::job::deferrable::Base<A, S, doneValue>::FanOut (const Tracking& a_tracking, const size_t a_count, const size_t a_quorum, Merge a_merge)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                if ( fans_.end() != fans_.find(a_tracking.bjid_) ) {
+                    throw ::cc::Exception("Job " UINT64_FMT " already fanned out!", a_tracking.bjid_);
+                }
+                deferrable::Fan* fan = new deferrable::Fan(a_tracking.rcid_, a_count, a_quorum, a_merge);
+                fans_[a_tracking.bjid_] = fan;
+                return fan->ids();
+            }
+            
+            /**
+             * @brief Account a completed sub-request and, once quorum is reached ( or can no longer be reached ), merge responses.
+             *
+             * @param a_deferred Completed sub-request.
+             * @param o_payload  Job response payload to fill.
+             *
+             * @return 0 while job has work to do, otherwise job response code.
+             */
+            template <class A, typename S, S doneValue>
+            uint16_t casper::job::deferrable::Base<A, S, doneValue>::FanIn (const deferrable::Deferred<A>* a_deferred, Json::Value& o_payload)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                const uint64_t   id  = a_deferred->tracking_.bjid_;
+                const auto       it  = fans_.find(id);
+                deferrable::Fan* fan = it->second;
+                const size_t     idx = fan->Find(a_deferred->id_);
+                if ( idx == fan->size() ) {
+                    throw ::cc::Exception("Request '%s' is not one of job " UINT64_FMT " sub-requests!", a_deferred->id_.c_str(), id);
+                }
+                switch ( fan->Complete(idx, a_deferred->response()) ) {
+                    case deferrable::Fan::Outcome::Pending:
+                        // ... quorum not reached yet, publish progress ...
+                        Publish(id, a_deferred->tracking_.rcid_, a_deferred->tracking_.rjid_,
+                                static_cast<float>(fan->completed() * 100) / static_cast<float>(fan->size()), DeferrableBaseClassAlias::Status::InProgress,
+                                DeferrableBaseClassAlias::I18NInProgress()
+                        );
+                        return 0;
+                    case deferrable::Fan::Outcome::Ignored:
+                        // ... job already finished, forget it once all sub-requests are accounted ...
+                        if ( true == fan->settled() && true == fan->finished() ) {
+                            delete fan;
+                            fans_.erase(it);
+                        }
+                        return 0;
+                    default:
+                        break;
+                }
+                const Merge                             merge     = fan->merge();
+                const std::vector<deferrable::Response> responses = fan->responses();
+                if ( true == fan->finished() ) {
+                    delete fan;
+                    fans_.erase(it);
+                } else {
+                    // ... outstanding sub-requests are wasted work, fail them once this completion unwinds ...
+                    const auto liveness = liveness_;
+                    DeferrableBaseClassAlias::ExecuteOnMainThread([this, liveness, id] () {
+                        // ... this object might be gone when this callback runs ...
+                        std::lock_guard<std::mutex> lock(liveness->mutex_);
+                        if ( false == liveness->alive_ ) {
+                            return;
+                        }
+                        d_.dispatcher_->Prune(id);
+                    }, /* a_blocking */ false);
+                }
+                return merge(responses, o_payload);
+            }
+
+            /**
+             * @brief Run a job as a graph of stages, stages with no dependencies are launched now.
+             *
+             * @param a_tracking   Job tracking info.
+             * @param a_stages     Stages, see \link deferrable::Pipeline \link.
+             * @param a_conclusion Function to call, with all stage outputs, when all stages succeeded.
+             */
+            template <class A, typename S, S doneValue>
+            void casper::job::deferrable::Base<A, S, doneValue>::Pipe (const Tracking& a_tracking, const std::vector<typename deferrable::Pipeline<S>::Stage>& a_stages,
+                                                                       typename deferrable::Pipeline<S>::Conclusion a_conclusion)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                if ( pipelines_.end() != pipelines_.find(a_tracking.bjid_) ) {
+                    throw ::cc::Exception("Job " UINT64_FMT " already has a pipeline!", a_tracking.bjid_);
+                }
+                deferrable::Pipeline<S>* pipeline = new deferrable::Pipeline<S>(a_tracking.rcid_, a_stages, a_conclusion);
+                pipelines_[a_tracking.bjid_] = pipeline;
+                Launch(pipeline, a_tracking);
+            }
+            
+            /**
+             * @brief Account a completed stage and launch the stages it unblocked; conclude job when all stages succeeded or
+             *        fail it as soon as one stage fails.
+             *
+             * @param a_deferred Completed stage request.
+             * @param o_payload  Job response payload to fill.
+             *
+             * @return 0 while job has work to do, otherwise job response code.
+             */
+            template <class A, typename S, S doneValue>
+            uint16_t casper::job::deferrable::Base<A, S, doneValue>::Advance (const deferrable::Deferred<A>* a_deferred, Json::Value& o_payload)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                const uint64_t           id       = a_deferred->tracking_.bjid_;
+                deferrable::Pipeline<S>* pipeline = pipelines_.find(id)->second;
+                const size_t             stage    = pipeline->Find(a_deferred->id_);
+                if ( stage == pipeline->size() ) {
+                    throw ::cc::Exception("Request '%s' is not one of job " UINT64_FMT " stages!", a_deferred->id_.c_str(), id);
+                }
+                const bool   succeeded = ( CC_STATUS_CODE_OK == a_deferred->response().code() && nullptr == a_deferred->response().exception() );
+                const size_t elapsed   = pipeline->Complete(stage, a_deferred->response(), succeeded);
+                // ... export stage timing ...
+                const std::string& name = pipeline->stage(stage).name_;
+                auto timing = timings_.find(name);
+                if ( timings_.end() == timing ) {
+                    timing = timings_.insert(std::make_pair(name, typename deferrable::Pipeline<S>::Timing({ 0, 0, 0, 0 }))).first;
+                }
+                timing->second.runs_++;
+                timing->second.failures_ += ( true == succeeded ? 0 : 1 );
+                timing->second.total_    += elapsed;
+                timing->second.max_       = std::max(timing->second.max_, static_cast<uint64_t>(elapsed));
+                OnDeferredRequestLogTracking(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                             "Stage  : " + name + ( true == succeeded ? " succeeded" : " failed" ) + " in " + std::to_string(elapsed) + "ms, "
+                                             + std::to_string(timing->second.total_ / timing->second.runs_) + "ms average"
+                );
+                // ... job already settled?
+                if ( true == pipeline->settled() ) {
+                    // ... yes, forget it once all launched stages are accounted ...
+                    Dismiss(id);
+                    return 0;
+                }
+                if ( false == succeeded ) {
+                    // ... stop here, outstanding stages are wasted work ...
+                    Dismiss(id);
+                    if ( nullptr != d_.on_deferred_request_failed_ ) {
+                        d_.on_deferred_request_failed_(a_deferred, o_payload);
+                    } else {
+                        OnDeferredRequestFailed(a_deferred, o_payload);
+                    }
+                    return a_deferred->response().code();
+                }
+                if ( true == pipeline->finished() ) {
+                    const auto conclusion = pipeline->conclusion();
+                    const auto outputs    = pipeline->outputs();
+                    Dismiss(id);
+                    return conclusion(outputs, o_payload);
+                }
+                try {
+                    Launch(pipeline, a_deferred->tracking_);
+                } catch (...) {
+                    Dismiss(id);
+                    throw;
+                }
+                return 0;
+            }
+            
+            /**
+             * @brief Launch all stages whose dependencies succeeded, publishing their steps.
+             *
+             * @param a_pipeline Job pipeline.
+             * @param a_tracking Job tracking info.
+             */
+            template <class A, typename S, S doneValue>
+            void casper::job::deferrable::Base<A, S, doneValue>::Launch (deferrable::Pipeline<S>* a_pipeline, const Tracking& a_tracking)
+            {
+                std::vector<size_t> ready;
+                a_pipeline->Ready(ready);
+                for ( size_t idx = 0 ; idx < ready.size() ; ++idx ) {
+                    const auto& stage = a_pipeline->stage(ready[idx]);
+                    Publish(a_tracking.bjid_, a_tracking.rcid_, a_tracking.rjid_, stage.step_, DeferrableBaseClassAlias::Status::InProgress,
+                            DeferrableBaseClassAlias::I18NInProgress()
+                    );
+                    try {
+                        stage.launch_(a_pipeline->id(ready[idx]), a_pipeline->outputs());
+                    } catch (...) {
+                        // ... this and the following stages were never launched ...
+                        for ( size_t other = idx ; other < ready.size() ; ++other ) {
+                            a_pipeline->Complete(ready[other], deferrable::Response(), /* a_succeeded */ false);
+                        }
+                        throw;
+                    }
+                }
+            }
+            
+            /**
+             * @brief Move a large deferred request response body to a file, so job result carries only it's reference.
+             *
+             * @param a_tracking  Job tracking info.
+             * @param a_response  Deferred request response.
+             * @param o_reference Spilled file reference, untouched if false is returned.
+             *
+             * @return True if body was spilled, false if spilling is disabled or body is at or below threshold.
+             */
+            template <class A, typename S, S doneValue>
+            bool casper::job::deferrable::Base<A, S, doneValue>::Spool (const Tracking& a_tracking, const deferrable::Response& a_response, Json::Value& o_reference)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
+                return DeferrableBaseClassAlias::Spool(a_tracking.bjid_, a_response.body(), a_response.content_type(), o_reference);
+            }
+
+            /**
+             * @brief Job outcome is known: no more stages are launched, outstanding ones are failed and pipeline is forgotten
+             *        once they are all accounted.
+             *
+             * @param a_id Job ID.
+             */
+            template <class A, typename S, S doneValue>
+            void casper::job::deferrable::Base<A, S, doneValue>::Dismiss (const uint64_t& a_id)
+            {
+                const auto it = pipelines_.find(a_id);
+                if ( pipelines_.end() == it ) {
+                    return;
+                }
+                if ( 0 == it->second->running() ) {
+                    delete it->second;
+                    pipelines_.erase(it);
+                    return;
+                }
+                if ( false == it->second->settled() ) {
+                    it->second->Settle();
+                    // ... fail them once this completion unwinds ...
+                    const auto liveness = liveness_;
+                    DeferrableBaseClassAlias::ExecuteOnMainThread([this, liveness, a_id] () {
+                        // ... this object might be gone when this callback runs ...
+                        std::lock_guard<std::mutex> lock(liveness->mutex_);
+                        if ( false == liveness->alive_ ) {
+                            return;
+                        }
+                        d_.dispatcher_->Prune(a_id);
+                    }, /* a_blocking */ false);
+                }
+            }
+
             /**
              * @brief Helper function to be called when a deferred request returned and response must be logged.
              *
              * @param a_dpid     Dispatcher ID.
              * @param a_tracking Request tracking info.
              * @param a_response Deferred request response data.
+             * @param a_waited   Time, in ms, spent waiting for a rate limit token.
              */
             template <class A, typename S, S doneValue>
-            void casper::job::deferrable::Base<A, S, doneValue>::LogDeferredRequestResponse (const std::string& a_dpid, const deferrable::Tracking& a_tracking, const deferrable::Response& a_response)
+            void casper::job::deferrable::Base<A, S, doneValue>::LogDeferredRequestResponse (const std::string& a_dpid, const deferrable::Tracking& a_tracking, const deferrable::Response& a_response, const size_t a_waited)
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(DeferrableBaseClassAlias::thread_id_);
                 //
@@ -749,10 +1411,18 @@ namespace casper
                     );
                 }
                 // ... log response RTT ...
-                CASPER_JOB_LOG_DEFERRED(CC_JOB_LOG_LEVEL_INF, a_tracking, CC_JOB_LOG_STEP_RTT,
-                                        "{%s} - took " SIZET_FMT "ms",
-                                        a_dpid.c_str(), a_response.rtt()
-                );
+                if ( 0 == a_waited ) {
+                    CASPER_JOB_LOG_DEFERRED(CC_JOB_LOG_LEVEL_INF, a_tracking, CC_JOB_LOG_STEP_RTT,
+                                            "{%s} - took " SIZET_FMT "ms",
+                                            a_dpid.c_str(), a_response.rtt()
+                    );
+                } else {
+                    // ... plus time spent waiting for a rate limit token ...
+                    CASPER_JOB_LOG_DEFERRED(CC_JOB_LOG_LEVEL_INF, a_tracking, CC_JOB_LOG_STEP_RTT,
+                                            "{%s} - took " SIZET_FMT "ms, waited " SIZET_FMT "ms for rate limit",
+                                            a_dpid.c_str(), a_response.rtt(), a_waited
+                    );
+                }
             }
         
         
@@ -0,0 +1,194 @@
+/**
+ * @file batcher.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_BATCHER_H_
+#define CASPER_JOB_DEFERRABLE_BATCHER_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Micro-batching policy: requests of the same group are held for a short window ( or until enough of them arrive )
+             *        and then merged into a single backend call.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Batcher final
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool   enabled_;
+                    size_t window_;    //!< In ms, how long the first request of a batch waits for others.
+                    size_t max_items_; //!< Batch is flushed as soon as it reaches this size.
+                } Config;
+
+                typedef struct {
+                    uint64_t batches_; //!< Backend calls issued for merged requests.
+                    uint64_t items_;   //!< Requests served by those calls.
+                    uint64_t full_;    //!< Batches flushed by size, before window elapsed.
+                } Stats;
+
+            private: // Data
+
+                Config config_;
+                Stats  stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Batcher ();
+                virtual ~Batcher ();
+
+            public: // Method(s) / Function(s)
+
+                void Setup   (const Config& a_config);
+                void Account (const size_t a_items, const bool a_full);
+                void Reset   ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if batching is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Config \link.
+                 */
+                inline const Config& config () const
+                {
+                    return config_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Batcher'
+
+            /**
+             * @brief Default constructor, batching is disabled.
+             */
+            inline Batcher::Batcher ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Batcher::~Batcher ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, resets stats.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Batcher::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Account a merged backend call.
+             *
+             * @param a_items Number of requests merged.
+             * @param a_full  True if batch was flushed by size.
+             */
+            inline void Batcher::Account (const size_t a_items, const bool a_full)
+            {
+                stats_.batches_++;
+                stats_.items_ += a_items;
+                if ( true == a_full ) {
+                    stats_.full_++;
+                }
+            }
+
+            /**
+             * @brief Forget all stats.
+             */
+            inline void Batcher::Reset ()
+            {
+                stats_ = { 0, 0, 0 };
+            }
+
+            /**
+             * @brief Load a batching configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for disabled batching.
+             *
+             * @return See \link Config \link.
+             */
+            inline Batcher::Config Batcher::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_window    = 10;
+                const Json::Value c_max_items = 100;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                const Config rv = {
+                    /* enabled_   */ ( false == config.isNull() ),
+                    /* window_    */ static_cast<size_t>(json.Get(config, "window"   , Json::ValueType::uintValue, &c_window).asUInt64()),
+                    /* max_items_ */ static_cast<size_t>(json.Get(config, "max-items", Json::ValueType::uintValue, &c_max_items).asUInt64())
+                };
+                if ( true == rv.enabled_ && ( 0 == rv.window_ || rv.max_items_ < 2 ) ) {
+                    throw ::cc::Exception("%s", "Invalid batching configuration!");
+                }
+                return rv;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_BATCHER_H_
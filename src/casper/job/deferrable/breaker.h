@@ -0,0 +1,356 @@
+/**
+ * @file breaker.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_BREAKER_H_
+#define CASPER_JOB_DEFERRABLE_BREAKER_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <vector>
+#include <chrono>
+#include <algorithm> // std::min, std::max
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Circuit breaker, stops sending requests to a failing backend.
+             *
+             * Closed: requests flow, outcomes of the last \link Config::window_ \link requests are kept and the breaker opens
+             *         when too many of them failed or were too slow.
+             * Open: requests are refused, after \link Config::open_time_ \link the breaker becomes half-open.
+             * Half-open: a few trial requests are allowed, if all succeed the breaker closes, any failure opens it again.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Breaker final
+            {
+
+            public: // Data Type(s)
+
+                enum class State : uint8_t {
+                    Closed = 0,
+                    Open,
+                    HalfOpen
+                };
+
+                typedef struct {
+                    bool   enabled_;
+                    size_t window_;       //!< Number of recent outcomes to compute rates from.
+                    size_t min_requests_; //!< Minimum number of outcomes before the breaker can open.
+                    double error_rate_;   //!< 0..1, failed outcomes rate that opens the breaker.
+                    size_t slow_rtt_;     //!< In ms, RTT above which a request is slow, 0 to ignore latency.
+                    double slow_rate_;    //!< 0..1, slow outcomes rate that opens the breaker.
+                    size_t open_time_;    //!< In ms, how long the breaker stays open.
+                    size_t trials_;       //!< Number of requests allowed, and required to succeed, while half-open.
+                } Config;
+
+                typedef struct {
+                    State    state_;
+                    uint64_t trips_;      //!< Number of times breaker opened.
+                    uint64_t rejected_;   //!< Requests refused while open.
+                    double   error_rate_; //!< Current failed outcomes rate.
+                    double   slow_rate_;  //!< Current slow outcomes rate.
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+            private: // Data
+
+                Config               config_;
+                std::vector<uint8_t> outcomes_;  //!< Ring of outcomes, bit 0 failed, bit 1 slow.
+                size_t               next_;
+                size_t               failed_;    //!< Failed outcomes in ring.
+                size_t               slow_;      //!< Slow outcomes in ring.
+                size_t               allowed_;   //!< Trials allowed while half-open.
+                size_t               succeeded_; //!< Trials succeeded while half-open.
+                TimePoint            until_;     //!< End of open state or, while half-open, of current trials.
+                Stats                stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Breaker ();
+                virtual ~Breaker ();
+
+            public: // Method(s) / Function(s)
+
+                void Setup  (const Config& a_config);
+                bool Permit ();
+                bool Allow  ();
+                void Record (const size_t a_rtt, const bool a_failed);
+                void Reset  ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config      Load (const Json::Value& a_config);
+                static const char* Name (const State a_state);
+
+            private: // Method(s) / Function(s)
+
+                void Trip  ();
+                void Close ();
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if breaker is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Breaker'
+
+            /**
+             * @brief Default constructor, breaker is disabled.
+             */
+            inline Breaker::Breaker ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Breaker::~Breaker ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, breaker is closed.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Breaker::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Check, without taking a half-open trial, if a new request could be sent to the backend.
+             *
+             * @return True if request may proceed, false if it must fail immediately.
+             */
+            inline bool Breaker::Permit ()
+            {
+                if ( false == config_.enabled_ || State::Closed == stats_.state_ ) {
+                    return true;
+                }
+                // ... open time elapsed, or trials still available ...
+                if ( std::chrono::steady_clock::now() >= until_ || ( State::HalfOpen == stats_.state_ && allowed_ < config_.trials_ ) ) {
+                    return true;
+                }
+                stats_.rejected_++;
+                return false;
+            }
+
+            /**
+             * @brief Check if a new request can be sent to the backend, while half-open it takes a trial.
+             *
+             * @return True if request can be sent, false if it must fail immediately.
+             */
+            inline bool Breaker::Allow ()
+            {
+                if ( false == config_.enabled_ || State::Closed == stats_.state_ ) {
+                    return true;
+                }
+                const TimePoint now = std::chrono::steady_clock::now();
+                if ( now >= until_ ) {
+                    // ... open time elapsed, or trials never reported back, start ( new ) trials ...
+                    stats_.state_ = State::HalfOpen;
+                    allowed_      = 0;
+                    succeeded_    = 0;
+                    until_        = now + std::chrono::milliseconds(config_.open_time_);
+                }
+                if ( State::HalfOpen == stats_.state_ && allowed_ < config_.trials_ ) {
+                    allowed_++;
+                    return true;
+                }
+                stats_.rejected_++;
+                return false;
+            }
+
+            /**
+             * @brief Account the outcome of a request that was sent to the backend.
+             *
+             * @param a_rtt    Request RTT, in ms.
+             * @param a_failed True if request failed.
+             */
+            inline void Breaker::Record (const size_t a_rtt, const bool a_failed)
+            {
+                if ( false == config_.enabled_ ) {
+                    return;
+                }
+                const bool slow = ( 0 != config_.slow_rtt_ && a_rtt >= config_.slow_rtt_ );
+                switch ( stats_.state_ ) {
+                    case State::HalfOpen:
+                        if ( true == a_failed || true == slow ) {
+                            Trip();
+                        } else if ( ++succeeded_ >= config_.trials_ ) {
+                            Close();
+                        }
+                        return;
+                    case State::Open:
+                        // ... late outcome of a request sent before opening ...
+                        return;
+                    default:
+                        break;
+                }
+                const uint8_t outcome = static_cast<uint8_t>(( true == a_failed ? 0x1 : 0x0 ) | ( true == slow ? 0x2 : 0x0 ));
+                if ( outcomes_.size() < config_.window_ ) {
+                    outcomes_.push_back(outcome);
+                } else {
+                    const uint8_t previous = outcomes_[next_];
+                    failed_ -= ( previous & 0x1 );
+                    slow_   -= ( ( previous & 0x2 ) >> 1 );
+                    outcomes_[next_] = outcome;
+                    next_ = ( next_ + 1 ) % config_.window_;
+                }
+                failed_ += ( outcome & 0x1 );
+                slow_   += ( ( outcome & 0x2 ) >> 1 );
+                stats_.error_rate_ = static_cast<double>(failed_) / static_cast<double>(outcomes_.size());
+                stats_.slow_rate_  = static_cast<double>(slow_)   / static_cast<double>(outcomes_.size());
+                if ( outcomes_.size() >= config_.min_requests_ && ( stats_.error_rate_ >= config_.error_rate_ || ( 0 != config_.slow_rtt_ && stats_.slow_rate_ >= config_.slow_rate_ ) ) ) {
+                    Trip();
+                }
+            }
+
+            /**
+             * @brief Close breaker and forget all outcomes and stats.
+             */
+            inline void Breaker::Reset ()
+            {
+                stats_ = { State::Closed, 0, 0, 0.0, 0.0 };
+                Close();
+            }
+
+            /**
+             * @brief Load a breaker configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for a disabled breaker.
+             *
+             * @return See \link Config \link.
+             */
+            inline Breaker::Config Breaker::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_window       = 100;
+                const Json::Value c_min_requests = 20;
+                const Json::Value c_error_rate   = 0.5;
+                const Json::Value c_slow_rtt     = 0;
+                const Json::Value c_slow_rate    = 0.8;
+                const Json::Value c_open_time    = 5000;
+                const Json::Value c_trials       = 5;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                Config rv = {
+                    /* enabled_      */ ( false == config.isNull() ),
+                    /* window_       */ static_cast<size_t>(json.Get(config, "window"      , Json::ValueType::uintValue, &c_window).asUInt64()),
+                    /* min_requests_ */ static_cast<size_t>(json.Get(config, "min-requests", Json::ValueType::uintValue, &c_min_requests).asUInt64()),
+                    /* error_rate_   */ json.Get(config, "error-rate", Json::ValueType::realValue, &c_error_rate).asDouble(),
+                    /* slow_rtt_     */ static_cast<size_t>(json.Get(config, "slow-rtt"    , Json::ValueType::uintValue, &c_slow_rtt).asUInt64()),
+                    /* slow_rate_    */ json.Get(config, "slow-rate" , Json::ValueType::realValue, &c_slow_rate).asDouble(),
+                    /* open_time_    */ static_cast<size_t>(json.Get(config, "open-time"   , Json::ValueType::uintValue, &c_open_time).asUInt64()),
+                    /* trials_       */ static_cast<size_t>(json.Get(config, "trials"      , Json::ValueType::uintValue, &c_trials).asUInt64())
+                };
+                if ( 0 == rv.window_ || rv.error_rate_ <= 0.0 || rv.error_rate_ > 1.0 || rv.slow_rate_ <= 0.0 || rv.slow_rate_ > 1.0 || 0 == rv.open_time_ || 0 == rv.trials_ ) {
+                    throw ::cc::Exception("%s", "Invalid circuit breaker configuration!");
+                }
+                rv.min_requests_ = std::max(std::min(rv.min_requests_, rv.window_), static_cast<size_t>(1));
+                return rv;
+            }
+
+            /**
+             * @return Human readable \link State \link.
+             *
+             * @param a_state State.
+             */
+            inline const char* Breaker::Name (const State a_state)
+            {
+                switch ( a_state ) {
+                    case State::Open:
+                        return "open";
+                    case State::HalfOpen:
+                        return "half-open";
+                    default:
+                        return "closed";
+                }
+            }
+
+            /**
+             * @brief Open breaker, requests are refused for \link Config::open_time_ \link.
+             */
+            inline void Breaker::Trip ()
+            {
+                stats_.state_ = State::Open;
+                stats_.trips_++;
+                until_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.open_time_);
+            }
+
+            /**
+             * @brief Close breaker, outcomes collected so far are forgotten.
+             */
+            inline void Breaker::Close ()
+            {
+                stats_.state_      = State::Closed;
+                stats_.error_rate_ = 0.0;
+                stats_.slow_rate_  = 0.0;
+                outcomes_.clear();
+                outcomes_.reserve(config_.window_);
+                next_      = 0;
+                failed_    = 0;
+                slow_      = 0;
+                allowed_   = 0;
+                succeeded_ = 0;
+                until_     = TimePoint();
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_BREAKER_H_
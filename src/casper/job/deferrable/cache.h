@@ -0,0 +1,502 @@
+/**
+ * @file cache.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_CACHE_H_
+#define CASPER_JOB_DEFERRABLE_CACHE_H_
+
+#include "casper/job/deferrable/types.h"
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>   // std::min
+#include <strings.h>   // strcasecmp, strncasecmp
+#include <stdlib.h>    // strtoull
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Bounded, memory accounted, response cache.
+             *
+             * Entries are evicted in LRU order; when full, a new entry is only admitted if it's been requested more often
+             * than the entry it would evict ( TinyLFU, frequencies are estimated by a count-min sketch ).
+             *
+             * Freshness comes from response 'Cache-Control' ( 'max-age', 's-maxage', 'no-cache', 'no-store' ) capped by \link Config::ttl_ \link.
+             * Stale entries with an 'ETag' are kept so that they can be revalidated.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Cache final
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool   enabled_;
+                    size_t ttl_;       //!< In seconds, freshness when response has no 'Cache-Control' and freshness upper bound.
+                    size_t max_bytes_; //!< Memory budget.
+                    bool   tiny_lfu_;  //!< When false, plain LRU admission.
+                    size_t sketch_;    //!< Count-min sketch width, rounded up to a power of 2.
+                } Config;
+
+                typedef struct {
+                    uint64_t hits_;
+                    uint64_t misses_;
+                    uint64_t stale_;       //!< Lookups that required revalidation.
+                    uint64_t revalidated_; //!< Revalidations answered with '304 Not Modified'.
+                    uint64_t stores_;
+                    uint64_t rejected_;    //!< Entries not admitted.
+                    uint64_t evictions_;
+                    size_t   entries_;
+                    size_t   bytes_;
+                } Stats;
+
+                enum class Result : uint8_t {
+                    Miss = 0,
+                    Hit,
+                    Stale //!< Must be revalidated, 'ETag' provided.
+                };
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+                typedef struct {
+                    std::string key_;
+                    Response    response_; //!< Body is shared with responses delivered from this entry.
+                    std::string etag_;
+                    TimePoint   expires_;
+                    size_t      bytes_;
+                } Entry;
+
+                typedef std::list<Entry>                                            LRU;   //!< Most recently used first.
+                typedef std::unordered_map<std::string, typename LRU::iterator>     Index;
+
+            private: // Data
+
+                Config               config_;
+                LRU                  lru_;
+                Index                index_;
+                std::vector<uint8_t> sketch_;
+                size_t               increments_;
+                Stats                stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Cache ();
+                virtual ~Cache ();
+
+            public: // Method(s) / Function(s)
+
+                void   Setup   (const Config& a_config);
+                Result Lookup  (const std::string& a_key, Response& o_response, std::string& o_etag);
+                void   Store   (const std::string& a_key, const Response& a_response);
+                bool   Refresh (const std::string& a_key, const Response& a_response);
+                void   Reset   ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            private: // Method(s) / Function(s)
+
+                void     Erase     (const typename Index::iterator& a_it);
+                bool     Freshness (const Response& a_response, size_t& o_ttl, std::string& o_etag) const;
+                void     Increment (const std::string& a_key);
+                uint8_t  Frequency (const std::string& a_key) const;
+
+            private: // Static Method(s) / Function(s)
+
+                static const std::string* Header (const Response& a_response, const char* const a_name);
+                static size_t             Size   (const std::string& a_key, const Response& a_response);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if cache is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Cache'
+
+            /**
+             * @brief Default constructor, cache is disabled.
+             */
+            inline Cache::Cache ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Cache::~Cache ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, all entries are dropped.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Cache::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Search for a response.
+             *
+             * @param a_key      Canonical request key.
+             * @param o_response Cached response, set on \link Result::Hit \link and \link Result::Stale \link.
+             * @param o_etag     Entity tag to revalidate with, set on \link Result::Stale \link.
+             *
+             * @return See \link Result \link.
+             */
+            inline Cache::Result Cache::Lookup (const std::string& a_key, Response& o_response, std::string& o_etag)
+            {
+                if ( false == config_.enabled_ ) {
+                    return Result::Miss;
+                }
+                Increment(a_key);
+                const auto it = index_.find(a_key);
+                if ( index_.end() == it ) {
+                    stats_.misses_++;
+                    return Result::Miss;
+                }
+                // ... fresh?
+                if ( std::chrono::steady_clock::now() < it->second->expires_ ) {
+                    lru_.splice(lru_.begin(), lru_, it->second);
+                    o_response = it->second->response_;
+                    stats_.hits_++;
+                    return Result::Hit;
+                }
+                // ... stale, can it be revalidated?
+                if ( 0 != it->second->etag_.length() ) {
+                    o_response = it->second->response_;
+                    o_etag     = it->second->etag_;
+                    stats_.stale_++;
+                    return Result::Stale;
+                }
+                Erase(it);
+                stats_.misses_++;
+                return Result::Miss;
+            }
+
+            /**
+             * @brief Keep track of a successful response, if it's cacheable and admitted.
+             *
+             * @param a_key      Canonical request key.
+             * @param a_response Response to cache.
+             */
+            inline void Cache::Store (const std::string& a_key, const Response& a_response)
+            {
+                if ( false == config_.enabled_ ) {
+                    return;
+                }
+                size_t      ttl;
+                std::string etag;
+                if ( false == Freshness(a_response, ttl, etag) || ( 0 == ttl && 0 == etag.length() ) ) {
+                    // ... can't be kept or can't be served without a revalidation that is not possible ...
+                    return;
+                }
+                const size_t bytes = Size(a_key, a_response);
+                if ( bytes > config_.max_bytes_ ) {
+                    stats_.rejected_++;
+                    return;
+                }
+                // ... replace previous entry ...
+                const auto it = index_.find(a_key);
+                if ( index_.end() != it ) {
+                    Erase(it);
+                }
+                // ... make room, if candidate is worth it ...
+                if ( stats_.bytes_ + bytes > config_.max_bytes_ ) {
+                    if ( true == config_.tiny_lfu_ && Frequency(a_key) <= Frequency(lru_.back().key_) ) {
+                        stats_.rejected_++;
+                        return;
+                    }
+                    while ( stats_.bytes_ + bytes > config_.max_bytes_ ) {
+                        Erase(index_.find(lru_.back().key_));
+                        stats_.evictions_++;
+                    }
+                }
+                lru_.push_front({ a_key, a_response, etag, std::chrono::steady_clock::now() + std::chrono::seconds(ttl), bytes });
+                index_[a_key] = lru_.begin();
+                stats_.entries_ = lru_.size();
+                stats_.bytes_  += bytes;
+                stats_.stores_++;
+            }
+
+            /**
+             * @brief Renew a stale entry after a '304 Not Modified' response.
+             *
+             * @param a_key      Canonical request key.
+             * @param a_response '304 Not Modified' response, it's 'Cache-Control' sets new freshness.
+             *
+             * @return True if entry was found and renewed.
+             */
+            inline bool Cache::Refresh (const std::string& a_key, const Response& a_response)
+            {
+                const auto it = index_.find(a_key);
+                if ( index_.end() == it ) {
+                    return false;
+                }
+                size_t      ttl;
+                std::string etag;
+                stats_.revalidated_++;
+                if ( false == Freshness(a_response, ttl, etag) ) {
+                    // ... 'no-store', stop keeping it ...
+                    Erase(it);
+                    return false;
+                }
+                if ( 0 != etag.length() ) {
+                    it->second->etag_ = etag;
+                }
+                it->second->expires_ = std::chrono::steady_clock::now() + std::chrono::seconds(ttl);
+                lru_.splice(lru_.begin(), lru_, it->second);
+                return true;
+            }
+
+            /**
+             * @brief Drop all entries and stats.
+             */
+            inline void Cache::Reset ()
+            {
+                lru_.clear();
+                index_.clear();
+                size_t width = 16;
+                while ( width < config_.sketch_ ) {
+                    width <<= 1;
+                }
+                sketch_.assign(4 * width, 0);
+                increments_ = 0;
+                stats_      = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+            }
+
+            /**
+             * @brief Load a cache configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for a disabled cache.
+             *
+             * @return See \link Config \link.
+             */
+            inline Cache::Config Cache::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_ttl       = 300;
+                const Json::Value c_max_bytes = 64 * 1024 * 1024;
+                const Json::Value c_admission = "tinylfu";
+                const Json::Value c_sketch    = 4096;
+
+                const Json::Value& config    = ( true == a_config.isObject() ? a_config : Json::Value::null );
+                const std::string  admission = json.Get(config, "admission", Json::ValueType::stringValue, &c_admission).asString();
+                if ( "tinylfu" != admission && "lru" != admission ) {
+                    throw ::cc::Exception("Unsupported cache admission policy '%s'!", admission.c_str());
+                }
+
+                const Config rv = {
+                    /* enabled_   */ ( false == config.isNull() ),
+                    /* ttl_       */ static_cast<size_t>(json.Get(config, "ttl"      , Json::ValueType::uintValue, &c_ttl).asUInt64()),
+                    /* max_bytes_ */ static_cast<size_t>(json.Get(config, "max-bytes", Json::ValueType::uintValue, &c_max_bytes).asUInt64()),
+                    /* tiny_lfu_  */ ( "tinylfu" == admission ),
+                    /* sketch_    */ static_cast<size_t>(json.Get(config, "sketch"   , Json::ValueType::uintValue, &c_sketch).asUInt64())
+                };
+                if ( true == rv.enabled_ && ( 0 == rv.ttl_ || 0 == rv.max_bytes_ ) ) {
+                    throw ::cc::Exception("%s", "Invalid cache configuration!");
+                }
+                return rv;
+            }
+
+            /**
+             * @brief Remove an entry.
+             *
+             * @param a_it Index entry.
+             */
+            inline void Cache::Erase (const typename Index::iterator& a_it)
+            {
+                stats_.bytes_ -= a_it->second->bytes_;
+                lru_.erase(a_it->second);
+                index_.erase(a_it);
+                stats_.entries_ = lru_.size();
+            }
+
+            /**
+             * @brief Compute how long a response can be served from cache.
+             *
+             * @param a_response Response to check.
+             * @param o_ttl      Freshness, in seconds, 0 if it must always be revalidated.
+             * @param o_etag     Entity tag, empty if none.
+             *
+             * @return False if response must not be stored.
+             */
+            inline bool Cache::Freshness (const Response& a_response, size_t& o_ttl, std::string& o_etag) const
+            {
+                const std::string* etag = Header(a_response, "ETag");
+                o_etag = ( nullptr != etag ? *etag : "" );
+                o_ttl  = config_.ttl_;
+                const std::string* cache_control = Header(a_response, "Cache-Control");
+                if ( nullptr == cache_control ) {
+                    return true;
+                }
+                bool   shared  = false;
+                size_t offset  = 0;
+                while ( offset < cache_control->length() ) {
+                    size_t end = cache_control->find(',', offset);
+                    if ( std::string::npos == end ) {
+                        end = cache_control->length();
+                    }
+                    while ( offset < end && ' ' == (*cache_control)[offset] ) {
+                        offset++;
+                    }
+                    const char* const directive = cache_control->c_str() + offset;
+                    const size_t      length    = end - offset;
+                    if ( 8 <= length && 0 == strncasecmp(directive, "no-store", 8) ) {
+                        return false;
+                    } else if ( 8 <= length && 0 == strncasecmp(directive, "no-cache", 8) ) {
+                        o_ttl = 0;
+                    } else if ( 8 < length && 0 == strncasecmp(directive, "max-age=", 8) && false == shared ) {
+                        o_ttl = std::min(o_ttl, static_cast<size_t>(strtoull(directive + 8, nullptr, 10)));
+                    } else if ( 9 < length && 0 == strncasecmp(directive, "s-maxage=", 9) ) {
+                        // ... takes precedence over 'max-age' ...
+                        o_ttl  = std::min(config_.ttl_, static_cast<size_t>(strtoull(directive + 9, nullptr, 10)));
+                        shared = true;
+                    }
+                    offset = end + 1;
+                }
+                return true;
+            }
+
+            /**
+             * @brief Count a request in the frequency sketch, counters are halved periodically so that old popularity fades.
+             *
+             * @param a_key Canonical request key.
+             */
+            inline void Cache::Increment (const std::string& a_key)
+            {
+                if ( false == config_.tiny_lfu_ ) {
+                    return;
+                }
+                const size_t width = sketch_.size() / 4;
+                const size_t hash  = std::hash<std::string>()(a_key);
+                const size_t step  = ( hash >> 32 ) | 1;
+                for ( size_t row = 0 ; row < 4 ; ++row ) {
+                    uint8_t& counter = sketch_[row * width + ( ( hash + row * step ) & ( width - 1 ) )];
+                    if ( counter < 15 ) {
+                        counter++;
+                    }
+                }
+                if ( ++increments_ >= 10 * width ) {
+                    for ( auto& counter : sketch_ ) {
+                        counter >>= 1;
+                    }
+                    increments_ /= 2;
+                }
+            }
+
+            /**
+             * @return Estimated request frequency of a key.
+             *
+             * @param a_key Canonical request key.
+             */
+            inline uint8_t Cache::Frequency (const std::string& a_key) const
+            {
+                const size_t width = sketch_.size() / 4;
+                const size_t hash  = std::hash<std::string>()(a_key);
+                const size_t step  = ( hash >> 32 ) | 1;
+                uint8_t      rv    = 15;
+                for ( size_t row = 0 ; row < 4 ; ++row ) {
+                    rv = std::min(rv, sketch_[row * width + ( ( hash + row * step ) & ( width - 1 ) )]);
+                }
+                return rv;
+            }
+
+            /**
+             * @brief Case insensitive header lookup.
+             *
+             * @param a_response Response to search.
+             * @param a_name     Header name.
+             *
+             * @return Header value, nullptr if not present.
+             */
+            inline const std::string* Cache::Header (const Response& a_response, const char* const a_name)
+            {
+                for ( const auto& header : a_response.headers() ) {
+                    if ( 0 == strcasecmp(header.first.c_str(), a_name) ) {
+                        return &header.second;
+                    }
+                }
+                return nullptr;
+            }
+
+            /**
+             * @return Estimated memory used by an entry, parsed JSON is estimated as twice the body size.
+             *
+             * @param a_key      Canonical request key.
+             * @param a_response Response to account.
+             */
+            inline size_t Cache::Size (const std::string& a_key, const Response& a_response)
+            {
+                size_t rv = sizeof(Entry) + a_key.length() + a_response.body().length() + a_response.content_type().length();
+                for ( const auto& header : a_response.headers() ) {
+                    rv += header.first.length() + header.second.length() + 64;
+                }
+                if ( false == a_response.json().isNull() ) {
+                    rv += 2 * a_response.body().length();
+                }
+                return rv;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_CACHE_H_
@@ -0,0 +1,620 @@
+/**
+ * @file coroutine.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_COROUTINE_H_
+#define CASPER_JOB_DEFERRABLE_COROUTINE_H_
+
+// ... only available when building as C++20 ( or later ) with coroutines support ...
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L
+    #define CASPER_JOB_DEFERRABLE_COROUTINES 1
+#endif
+
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "casper/job/deferrable/types.h"
+#include "casper/job/deferrable/hedger.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <memory>    // std::shared_ptr
+#include <new>       // ::operator new
+#include <cstddef>   // std::max_align_t
+#include <exception> // std::exception_ptr
+#include <functional>
+#include <coroutine>
+#include <concepts>  // std::convertible_to
+#include <type_traits>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            namespace coroutine
+            {
+
+                /**
+                 * @brief Coroutine frames pool, freed frames are kept by size class and reused.
+                 *
+                 * Frames might be released on a thread other than the one they were allocated on, access is serialized.
+                 */
+                class Frames final : public ::cc::NonCopyable, public ::cc::NonMovable
+                {
+
+                public: // Data Type(s)
+
+                    typedef struct {
+                        uint64_t allocated_; //!< Frames allocated from heap.
+                        uint64_t reused_;    //!< Frames served from pool.
+                        size_t   live_;      //!< Frames in use.
+                        size_t   pooled_;    //!< Frames kept for reuse.
+                    } Stats;
+
+                private: // Data Type(s)
+
+                    typedef struct {
+                        Frames* owner_; //!< nullptr when frame is too big to be pooled.
+                        size_t  class_;
+                    } Header;
+
+                private: // Const Data
+
+                    static constexpr size_t k_granularity_ = 64;
+                    static constexpr size_t k_classes_     = 32;   //!< Up to 2KB frames are pooled.
+                    static constexpr size_t k_keep_        = 256;  //!< Maximum number of frames kept per size class.
+                    static constexpr size_t k_header_      = ( ( sizeof(Header) + alignof(std::max_align_t) - 1 ) / alignof(std::max_align_t) ) * alignof(std::max_align_t);
+
+                private: // Data
+
+                    std::mutex         mutex_;
+                    std::vector<void*> free_[k_classes_];
+                    Stats              stats_;
+
+                public: // Constructor(s) / Destructor
+
+                    /**
+                     * @brief Default constructor.
+                     */
+                    Frames ()
+                    {
+                        stats_ = { 0, 0, 0, 0 };
+                    }
+
+                    /**
+                     * @brief Destructor, all frames must have been released.
+                     */
+                    virtual ~Frames ()
+                    {
+                        for ( auto& free : free_ ) {
+                            for ( auto block : free ) {
+                                ::operator delete(block);
+                            }
+                        }
+                    }
+
+                public: // Method(s) / Function(s)
+
+                    /**
+                     * @brief Allocate a frame.
+                     *
+                     * @param a_size Frame size.
+                     *
+                     * @return Frame memory.
+                     */
+                    inline void* Allocate (const size_t a_size)
+                    {
+                        const size_t klass = ( a_size + k_granularity_ - 1 ) / k_granularity_;
+                        void*        block = nullptr;
+                        if ( klass < k_classes_ ) {
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            stats_.live_++;
+                            if ( 0 != free_[klass].size() ) {
+                                block = free_[klass].back();
+                                free_[klass].pop_back();
+                                stats_.reused_++;
+                                stats_.pooled_--;
+                            } else {
+                                stats_.allocated_++;
+                            }
+                        }
+                        if ( nullptr == block ) {
+                            block = ::operator new(k_header_ + ( klass < k_classes_ ? klass * k_granularity_ : a_size ));
+                        }
+                        Header* header = static_cast<Header*>(block);
+                        header->owner_ = ( klass < k_classes_ ? this : nullptr );
+                        header->class_ = klass;
+                        return static_cast<char*>(block) + k_header_;
+                    }
+
+                    /**
+                     * @brief Release a frame allocated by \link Allocate \link, of any pool.
+                     *
+                     * @param a_frame Frame memory.
+                     */
+                    static inline void Release (void* a_frame)
+                    {
+                        void*   block  = static_cast<char*>(a_frame) - k_header_;
+                        Header* header = static_cast<Header*>(block);
+                        if ( nullptr == header->owner_ ) {
+                            ::operator delete(block);
+                            return;
+                        }
+                        Frames* owner = header->owner_;
+                        {
+                            std::lock_guard<std::mutex> lock(owner->mutex_);
+                            owner->stats_.live_--;
+                            if ( owner->free_[header->class_].size() < k_keep_ ) {
+                                owner->free_[header->class_].push_back(block);
+                                owner->stats_.pooled_++;
+                                return;
+                            }
+                        }
+                        ::operator delete(block);
+                    }
+
+                    /**
+                     * @return A copy of current stats.
+                     */
+                    inline Stats Snapshot ()
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        return stats_;
+                    }
+
+                }; // end of class 'Frames'
+
+                /**
+                 * @brief Turns awaited steps into the existing scheduling primitives, one per tube.
+                 *
+                 * Main thread only, unless stated otherwise.
+                 */
+                class Scheduler final : public ::cc::NonCopyable, public ::cc::NonMovable
+                {
+
+                public: // Data Type(s)
+
+                    typedef struct {
+                        std::function<void(std::function<void()>)>                                             on_main_thread_;
+                        std::function<void(std::function<void()>, const size_t)>                               on_main_thread_deferred_;
+                        std::function<void(const std::string&, std::function<void(const std::string&)>)>      on_looper_thread_;
+                        std::function<void(std::exception_ptr)>                                                on_exception_; //!< A coroutine ended with an exception.
+                        std::function<void(const Tracking&)>                                                   on_concluded_; //!< A job was concluded, main thread; it's \link Outcome \link must be collected.
+                    } Callbacks;
+
+                private: // Data Type(s)
+
+                    typedef struct {
+                        std::coroutine_handle<> handle_;
+                        Response*               response_;
+                    } Waiter;
+
+                    typedef struct {
+                        uint16_t    code_;
+                        Json::Value payload_;
+                    } Result;
+
+                    typedef struct {
+                        std::mutex                        mutex_;
+                        bool                              alive_;
+                        std::set<std::coroutine_handle<>> suspended_; //!< Coroutines waiting to be resumed by a posted callback.
+                    } Liveness;
+
+                private: // Const Data
+
+                    const Callbacks callbacks_;
+
+                private: // Data
+
+                    Frames                            frames_;
+                    std::map<std::string, Waiter>     waiters_;  //!< Request ID -> Coroutine waiting for it's response
+                    std::map<uint64_t, Result>        outcomes_; //!< Job ID -> Result, set by a coroutine
+                    std::shared_ptr<Liveness>         liveness_; //!< Shared with posted callbacks, so they can tell if this object was disposed.
+
+                public: // Constructor(s) / Destructor
+
+                    Scheduler () = delete;
+
+                    /**
+                     * @brief Default constructor.
+                     *
+                     * @param a_callbacks See \link Callbacks \link.
+                     */
+                    Scheduler (const Callbacks& a_callbacks)
+                        : callbacks_(a_callbacks), liveness_(std::make_shared<Liveness>())
+                    {
+                        liveness_->alive_ = true;
+                    }
+
+                    /**
+                     * @brief Destructor, suspended coroutines are destroyed and won't be resumed.
+                     */
+                    virtual ~Scheduler ()
+                    {
+                        std::set<std::coroutine_handle<>> suspended;
+                        {
+                            std::lock_guard<std::mutex> lock(liveness_->mutex_);
+                            liveness_->alive_ = false;
+                            suspended.swap(liveness_->suspended_);
+                        }
+                        for ( const auto& waiter : waiters_ ) {
+                            suspended.insert(waiter.second.handle_);
+                        }
+                        waiters_.clear();
+                        // ... frames return to pool, it must outlive them ...
+                        for ( auto handle : suspended ) {
+                            handle.destroy();
+                        }
+                    }
+
+                public: // Awaitable(s)
+
+                    /**
+                     * @brief Awaitable: resume on main thread.
+                     */
+                    class Main {
+                    private:
+                        Scheduler& scheduler_;
+                    public:
+                        Main (Scheduler& a_scheduler)
+                            : scheduler_(a_scheduler)
+                        {
+                            /* empty */
+                        }
+                        inline bool await_ready   () const noexcept { return false; }
+                        inline void await_suspend (std::coroutine_handle<> a_handle) { scheduler_.callbacks_.on_main_thread_(scheduler_.Resumer(a_handle)); }
+                        inline void await_resume  () const noexcept {}
+                    };
+
+                    /**
+                     * @brief Awaitable: resume on looper thread.
+                     */
+                    class Looper {
+                    private:
+                        Scheduler&        scheduler_;
+                        const std::string id_;
+                    public:
+                        Looper (Scheduler& a_scheduler, const std::string& a_id)
+                            : scheduler_(a_scheduler), id_(a_id)
+                        {
+                            /* empty */
+                        }
+                        inline bool await_ready   () const noexcept { return false; }
+                        inline void await_suspend (std::coroutine_handle<> a_handle)
+                        {
+                            const std::function<void()> resume = scheduler_.Resumer(a_handle);
+                            scheduler_.callbacks_.on_looper_thread_(id_, [resume] (const std::string&) { resume(); });
+                        }
+                        inline void await_resume  () const noexcept {}
+                    };
+
+                    /**
+                     * @brief Awaitable: resume on main thread after a delay.
+                     */
+                    class Delay {
+                    private:
+                        Scheduler&   scheduler_;
+                        const size_t delay_; //!< In ms.
+                    public:
+                        Delay (Scheduler& a_scheduler, const size_t a_delay)
+                            : scheduler_(a_scheduler), delay_(a_delay)
+                        {
+                            /* empty */
+                        }
+                        inline bool await_ready   () const noexcept { return 0 == delay_; }
+                        inline void await_suspend (std::coroutine_handle<> a_handle) { scheduler_.callbacks_.on_main_thread_deferred_(scheduler_.Resumer(a_handle), delay_); }
+                        inline void await_resume  () const noexcept {}
+                    };
+
+                    /**
+                     * @brief Awaitable: dispatch a deferred request and resume, on main thread, with it's response.
+                     */
+                    class Perform {
+                    private:
+                        Scheduler&                              scheduler_;
+                        const std::string                       id_;     //!< Request ID, must be unique while in-flight.
+                        std::function<void(const std::string&)> launch_; //!< Dispatch request with the provided ID.
+                        Response                                response_;
+                        std::exception_ptr                      exception_;
+                    public:
+                        Perform (Scheduler& a_scheduler, const std::string& a_id, std::function<void(const std::string&)> a_launch)
+                            : scheduler_(a_scheduler), id_(a_id), launch_(a_launch)
+                        {
+                            /* empty */
+                        }
+                        inline bool await_ready () const noexcept { return false; }
+                        inline bool await_suspend (std::coroutine_handle<> a_handle)
+                        {
+                            if ( scheduler_.waiters_.end() != scheduler_.waiters_.find(id_) ) {
+                                exception_ = std::make_exception_ptr(::cc::Exception("Request '%s' is already being awaited!", id_.c_str()));
+                                return false;
+                            }
+                            scheduler_.waiters_[id_] = { a_handle, &response_ };
+                            try {
+                                launch_(id_);
+                            } catch (...) {
+                                scheduler_.waiters_.erase(id_);
+                                exception_ = std::current_exception();
+                                return false;
+                            }
+                            return true;
+                        }
+                        inline Response await_resume ()
+                        {
+                            if ( nullptr != exception_ ) {
+                                std::rethrow_exception(exception_);
+                            }
+                            return response_;
+                        }
+                    };
+
+                public: // Method(s) / Function(s)
+
+                    /**
+                     * @return True if a coroutine is waiting for a request's response.
+                     *
+                     * @param a_id Request ID, an hedge that won it's race answers for it's primary.
+                     */
+                    inline bool Waiting (const std::string& a_id) const
+                    {
+                        return waiters_.end() != Find(a_id);
+                    }
+
+                    /**
+                     * @brief Resume the coroutine waiting for a request, it runs until it's next suspension point.
+                     *
+                     * @param a_id       Request ID.
+                     * @param a_response Request response.
+                     *
+                     * @return True if a coroutine was resumed.
+                     */
+                    inline bool Resume (const std::string& a_id, const Response& a_response)
+                    {
+                        const auto it = Find(a_id);
+                        if ( waiters_.end() == it ) {
+                            return false;
+                        }
+                        const Waiter waiter = it->second;
+                        waiters_.erase(it);
+                        (*waiter.response_) = a_response;
+                        waiter.handle_.resume();
+                        return true;
+                    }
+
+                    /**
+                     * @brief Set a job outcome and finish it: if called while resumed by the completion of an awaited request the
+                     *        job finishes when that completion unwinds, otherwise \link Callbacks::on_concluded_ \link is posted.
+                     *
+                     * @param a_tracking Job tracking info.
+                     * @param a_code     Job response code.
+                     * @param a_payload  Job response payload.
+                     */
+                    inline void Conclude (const Tracking& a_tracking, const uint16_t a_code, const Json::Value& a_payload)
+                    {
+                        outcomes_[a_tracking.bjid_] = { a_code, a_payload };
+                        const std::shared_ptr<Liveness> liveness = liveness_;
+                        callbacks_.on_main_thread_([this, liveness, a_tracking] () {
+                            {
+                                std::lock_guard<std::mutex> lock(liveness->mutex_);
+                                if ( false == liveness->alive_ ) {
+                                    return;
+                                }
+                            }
+                            // ... already collected by a completion?
+                            if ( outcomes_.end() != outcomes_.find(a_tracking.bjid_) ) {
+                                callbacks_.on_concluded_(a_tracking);
+                            }
+                        });
+                    }
+
+                    /**
+                     * @brief Collect a job outcome, if it was set.
+                     *
+                     * @param a_id      Job ID.
+                     * @param o_payload Job response payload.
+                     *
+                     * @return 0 if job has no outcome yet, otherwise job response code.
+                     */
+                    inline uint16_t Outcome (const uint64_t& a_id, Json::Value& o_payload)
+                    {
+                        const auto it = outcomes_.find(a_id);
+                        if ( outcomes_.end() == it ) {
+                            return 0;
+                        }
+                        const uint16_t code = it->second.code_;
+                        o_payload.swap(it->second.payload_);
+                        outcomes_.erase(it);
+                        return code;
+                    }
+
+                    /**
+                     * @brief Forward an exception that escaped a coroutine, any thread.
+                     *
+                     * @param a_exception Exception.
+                     */
+                    inline void Unhandled (std::exception_ptr a_exception)
+                    {
+                        if ( nullptr != callbacks_.on_exception_ ) {
+                            callbacks_.on_exception_(a_exception);
+                        }
+                    }
+
+                    /**
+                     * @return R/W access to this scheduler frames pool, any thread.
+                     */
+                    inline Frames& frames ()
+                    {
+                        return frames_;
+                    }
+
+                private: // Method(s) / Function(s)
+
+                    /**
+                     * @return Function that resumes a suspended coroutine, unless this scheduler was disposed meanwhile.
+                     *
+                     * @param a_handle Coroutine about to be suspended.
+                     */
+                    inline std::function<void()> Resumer (std::coroutine_handle<> a_handle)
+                    {
+                        const std::shared_ptr<Liveness> liveness = liveness_;
+                        {
+                            std::lock_guard<std::mutex> lock(liveness->mutex_);
+                            liveness->suspended_.insert(a_handle);
+                        }
+                        return [liveness, a_handle] () {
+                            {
+                                std::lock_guard<std::mutex> lock(liveness->mutex_);
+                                if ( false == liveness->alive_ || 0 == liveness->suspended_.erase(a_handle) ) {
+                                    return;
+                                }
+                            }
+                            a_handle.resume();
+                        };
+                    }
+
+                    /**
+                     * @return Waiter of a request.
+                     *
+                     * @param a_id Request ID.
+                     */
+                    inline std::map<std::string, Waiter>::const_iterator Find (const std::string& a_id) const
+                    {
+                        auto it = waiters_.find(a_id);
+                        if ( waiters_.end() == it ) {
+                            it = waiters_.find(Hedger::Primary(a_id));
+                        }
+                        return it;
+                    }
+
+                }; // end of class 'Scheduler'
+
+                /**
+                 * @brief Fire-and-forget job coroutine, runs eagerly until it's first suspension point.
+                 *
+                 * It's frame comes from the pool of the \link Scheduler \link passed as it's first argument, or returned by
+                 * it's object's scheduler() for member coroutines.
+                 */
+                class Task final
+                {
+
+                public: // Data Type(s)
+
+                    /**
+                     * @brief Promise of a coroutine with parameters \link Args \link, see std::coroutine_traits below.
+                     *
+                     * A class template rather than a template operator new, so that the compiler pairs frame allocation
+                     * with it's deallocation function.
+                     */
+                    template <typename... Args>
+                    struct Promise {
+
+                        Scheduler* scheduler_;
+
+                        Promise (const Args&... a_args)
+                        {
+                            scheduler_ = Lookup(a_args...);
+                        }
+
+                        static void* operator new (size_t a_size, const Args&... a_args)
+                        {
+                            Scheduler* scheduler = Lookup(a_args...);
+                            return ( nullptr != scheduler ? scheduler->frames().Allocate(a_size) : Allocate(a_size) );
+                        }
+
+                        static void operator delete (void* a_frame, size_t /* a_size */)
+                        {
+                            Frames::Release(a_frame);
+                        }
+
+                        inline Task                get_return_object   () noexcept { return Task(); }
+                        inline std::suspend_never  initial_suspend     () const noexcept { return {}; }
+                        inline std::suspend_never  final_suspend       () const noexcept { return {}; }
+                        inline void                return_void         () const noexcept {}
+                        inline void                unhandled_exception ()
+                        {
+                            if ( nullptr != scheduler_ ) {
+                                scheduler_->Unhandled(std::current_exception());
+                            }
+                        }
+
+                    };
+
+                private: // Static Method(s) / Function(s)
+
+                    /**
+                     * @return Frame memory, for coroutines with no scheduler; released by \link Frames::Release \link.
+                     */
+                    static inline void* Allocate (const size_t a_size)
+                    {
+                        static Frames s_frames;
+                        return s_frames.Allocate(a_size);
+                    }
+
+                    static inline Scheduler* Lookup ()
+                    {
+                        return nullptr;
+                    }
+
+                    template <typename T, typename... Others>
+                    static inline Scheduler* Lookup (T& a_first, Others&... /* a_others */)
+                    {
+                        if constexpr ( std::is_same<typename std::decay<T>::type, Scheduler>::value ) {
+                            return &a_first;
+                        } else if constexpr ( requires { { a_first.scheduler() } -> std::convertible_to<Scheduler&>; } ) {
+                            return &a_first.scheduler();
+                        } else {
+                            return nullptr;
+                        }
+                    }
+
+                }; // end of class 'Task'
+
+            } // end of namespace 'coroutine'
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+/**
+ * @brief Coroutines returning \link casper::job::deferrable::coroutine::Task \link are promised by \link Task::Promise \link.
+ */
+template <typename... Args>
+struct std::coroutine_traits<casper::job::deferrable::coroutine::Task, Args...> {
+    using promise_type = casper::job::deferrable::coroutine::Task::Promise<Args...>;
+};
+
+#endif // CASPER_JOB_DEFERRABLE_COROUTINES
+
+#endif // CASPER_JOB_DEFERRABLE_COROUTINE_H_
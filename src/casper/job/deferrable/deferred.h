@@ -35,6 +35,9 @@
 #include "json/json.h"
 
 #include <functional> // std::function
+#include <memory>     // std::shared_ptr
+#include <chrono>
+#include <vector>
 
 namespace casper
 {
@@ -44,11 +47,15 @@ namespace casper
     
         namespace deferrable
         {
+
+            template <class A> class Dispatcher;
                 
             template <class A> //, class = std::enable_if<std::is_base_of<A, Arguments<A>>::value>>
             class Deferred : public ::cc::NonCopyable, public ::cc::NonMovable
             {
 
+                friend class Dispatcher<A>;
+
             public: // Data Type(s)
                 
                 typedef struct
@@ -84,10 +91,20 @@ namespace casper
                 
                 CC_IF_DEBUG_DECLARE_VAR(const cc::debug::Threading::ThreadID, thread_id_;)
 
+            protected: // Data Type(s)
+
+                typedef struct {
+                    std::mutex mutex_;
+                    bool       cancelled_;
+                } Guard;
+
             protected: // Data
 
-                A*             arguments_;
-                Response       response_;
+                A*                     arguments_;
+                Response               response_;
+                std::shared_ptr<Guard> guard_; //!< Shared with scheduled callbacks, so they can tell if this object was cancelled ( and disposed ).
+                size_t                 waited_; //!< In ms, time spent waiting for a rate limit token before being launched.
+                std::chrono::steady_clock::time_point deadline_; //!< When job's client gives up on it, epoch if never.
                 
             private: // TODO:
                 
@@ -127,6 +144,17 @@ namespace casper
                 
                 inline void Bind (Callbacks a_callbacks);
 
+            private: // Method(s) / Function(s)
+
+                void Reject   (const A& a_args, Callbacks a_callbacks, const uint16_t a_code, const std::string& a_reason);
+                void Shortcut (const A& a_args, Callbacks a_callbacks);
+                void Attach   (const A& a_args, Callbacks a_callbacks);
+                void Deliver  (const Response& a_response);
+
+            protected: // Virtual Method(s) / Function(s)
+
+                virtual void Cancel ();
+
             public: // Inline Method(s) / Function(s)
 
                 /**
@@ -153,6 +181,22 @@ namespace casper
                     return response_;
                 }
                 
+                /**
+                 * @return Time, in ms, spent waiting for a rate limit token before being launched.
+                 */
+                inline size_t waited () const
+                {
+                    return waited_;
+                }
+                
+                /**
+                 * @return When job's client gives up on this request, epoch if never.
+                 */
+                inline const std::chrono::steady_clock::time_point& deadline () const
+                {
+                    return deadline_;
+                }
+                
                 /**
                  * @brief Override some \link Response \link values.
                  *
@@ -230,6 +274,10 @@ namespace casper
                 arguments_                   = nullptr;
                 handler_.on_track_           = nullptr;
                 handler_.on_untrack_         = nullptr;
+                guard_                       = std::make_shared<Guard>();
+                guard_->cancelled_           = false;
+                waited_                      = 0;
+                deadline_                    = std::chrono::steady_clock::time_point();
             }
 
             /**
@@ -273,6 +321,105 @@ namespace casper
                 callbacks_ = a_callbacks;
             }
 
+            /**
+             * @brief Complete with an error response instead of running the request.
+             *
+             * @param a_args      Request specific arguments.
+             * @param a_callbacks See \link Callbacks \link.
+             * @param a_code      HTTP status code.
+             * @param a_reason    Error message.
+             */
+            template <class A>
+            inline void Deferred<A>::Reject (const A& a_args, Deferred<A>::Callbacks a_callbacks, const uint16_t a_code, const std::string& a_reason)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                response_.Set(a_code, ::cc::Exception("%s", a_reason.c_str()));
+                Shortcut(a_args, a_callbacks);
+            }
+
+            /**
+             * @brief Complete with the current response, asynchronously, as a real request would.
+             *
+             * @param a_args      Request specific arguments.
+             * @param a_callbacks See \link Callbacks \link.
+             *
+             * @note Safe to call after a failed \link Run \link, callbacks and arguments might already be set.
+             */
+            template <class A>
+            inline void Deferred<A>::Shortcut (const A& a_args, Deferred<A>::Callbacks a_callbacks)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                Attach(a_args, a_callbacks);
+                Deliver(response_);
+            }
+
+            /**
+             * @brief Bind and track, as \link Run \link would, but without performing the request.
+             *
+             * @param a_args      Request specific arguments.
+             * @param a_callbacks See \link Callbacks \link.
+             *
+             * @note Safe to call after a failed \link Run \link, callbacks and arguments might already be set.
+             */
+            template <class A>
+            inline void Deferred<A>::Attach (const A& a_args, Deferred<A>::Callbacks a_callbacks)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                callbacks_ = a_callbacks;
+                if ( nullptr == arguments_ ) {
+                    arguments_ = new A(a_args);
+                }
+                if ( false == Tracked() ) {
+                    Track();
+                }
+            }
+
+            /**
+             * @brief Complete with a response obtained elsewhere, asynchronously, as a real request would.
+             *
+             * @param a_response Response to deliver, body is shared not copied.
+             */
+            template <class A>
+            inline void Deferred<A>::Deliver (const Response& a_response)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                if ( &a_response != &response_ ) {
+                    response_ = a_response;
+                }
+                const auto guard = guard_;
+                CallOnMainThread([this, guard] () {
+                    if ( true == guard->cancelled_ ) {
+                        return;
+                    }
+                    OnCompleted(this);
+                    Untrack();
+                });
+            }
+
+            /**
+             * @brief Give up on this request, called on 'main' thread by the owner before disposing it.
+             *
+             * @note Subclasses must check \link guard_ \link on every callback that they schedule,
+             *       after this call no callback may touch this object.
+             */
+            template <class A>
+            inline void Deferred<A>::Cancel ()
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                {
+                    std::lock_guard<std::mutex> lock(guard_->mutex_);
+                    guard_->cancelled_ = true;
+                }
+                // ... work not yet started on 'looper' thread won't reach the backend ...
+                std::vector<std::string> ids;
+                pending_.mutex_.lock();
+                ids.assign(pending_.callbacks_.begin(), pending_.callbacks_.end());
+                pending_.mutex_.unlock();
+                for ( const auto& id : ids ) {
+                    TryCancelOnLooperThread(id);
+                }
+            }
+
             /**
              * @brief Request to be tracked;
              */
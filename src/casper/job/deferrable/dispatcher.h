@@ -32,9 +32,25 @@
 #include "json/json.h"
 
 #include "casper/job/deferrable/deferred.h"
+#include "casper/job/deferrable/replay.h"
+#include "casper/job/deferrable/limiter.h"
+#include "casper/job/deferrable/hedger.h"
+#include "casper/job/deferrable/cache.h"
+#include "casper/job/deferrable/batcher.h"
+#include "casper/job/deferrable/balancer.h"
+#include "casper/job/deferrable/breaker.h"
+#include "casper/job/deferrable/throttle.h"
+#include "casper/job/deferrable/keeper.h"
 
 #include <string>
 #include <map>
+#include <vector>
+#include <set>
+#include <deque>
+#include <chrono>
+#include <limits> // std::numeric_limits
+#include <memory> // std::shared_ptr
+#include <mutex>  // std::mutex
 
 #include "cc/easy/job/types.h"
 
@@ -53,10 +69,90 @@ namespace casper
             public: // Data Type(s)
                 
                 typedef typename Deferred<A>::Callbacks Callbacks;
+
+                typedef struct {
+                    Limiter::Metrics limiter_;
+                    size_t           queued_;
+                    Hedger::Stats    hedger_;
+                    uint64_t         coalesced_; //!< Requests served by an identical in-flight request.
+                    Cache::Stats     cache_;
+                    Batcher::Stats   batcher_;
+                    Balancer::Stats  balancer_;
+                    Breaker::Stats   breaker_;
+                    Throttle::Stats  throttle_;
+                    size_t           paced_;     //!< Requests waiting for a \link Throttle \link token.
+                    Keeper::Stats    keeper_;
+                    uint64_t         expired_;   //!< Requests failed because their job deadline passed.
+                    uint64_t         cancelled_; //!< Requests failed because their job was cancelled by it's client.
+                    uint64_t         overdue_;   //!< Of \link expired_ \link, requests whose deadline passed before they were launched.
+                } Metrics;
+
+                typedef std::function<void(const std::vector<uint64_t>&, std::function<void(const uint64_t&, const bool)>)> Touch; //!< Touch jobs, report each outcome.
+
+                typedef std::vector<std::pair<A, Deferred<A>*>> BatchMembers; //!< Requests merged into a single backend call.
                 
             protected: // Data Type(s)
                 
                 typedef std::map<std::string, Deferred<A>*> RunningMap; //!< RCID ( REDIS Channel ID ) -> Deferred<A>
+                typedef std::pair<std::chrono::steady_clock::time_point, uint64_t> WaitingKey;   //!< Deadline ( when EDF, otherwise max ) and arrival order.
+                typedef std::map<WaitingKey, std::pair<A, Deferred<A>*>>          WaitingQueue; //!< Requests waiting for a \link Limiter \link slot, next to launch first.
+                typedef std::map<const Deferred<A>*, WaitingKey>                   WaitingIndex; //!< Waiting request -> It's \link WaitingQueue \link key
+
+                typedef struct {
+                    A            args_;
+                    Deferred<A>* primary_;
+                    Deferred<A>* secondary_; //!< Hedge, nullptr until issued.
+                    size_t       delay_;     //!< In ms.
+                } Race;
+
+                typedef std::map<uint64_t, Race>                RaceMap;    //!< Race ID -> Race
+                typedef std::map<const Deferred<A>*, uint64_t> RacersMap;  //!< Racer -> Race ID
+
+                typedef struct {
+                    Deferred<A>*              leader_;    //!< Request actually performed.
+                    std::vector<Deferred<A>*> followers_; //!< Identical requests waiting for leader's response.
+                } Flight;
+
+                typedef std::map<std::string, Flight>              FlightMap;  //!< Key -> Flight
+                typedef std::map<const Deferred<A>*, std::string> LeadersMap; //!< Leader -> Key
+
+                typedef struct {
+                    std::string  key_;
+                    Deferred<A>* deferred_; //!< Request that will deliver the response.
+                    bool         stale_;    //!< True when revalidating \link response_ \link.
+                    Response     response_; //!< Stale response, served if backend replies '304 Not Modified'.
+                } Fill;
+
+                typedef std::map<const Deferred<A>*, Fill> FillsMap; //!< Request -> Cache entry it will fill
+
+                typedef struct {
+                    uint64_t     id_;
+                    BatchMembers members_;
+                } Bucket;
+
+                typedef struct {
+                    std::string  group_;
+                    BatchMembers members_;
+                } Bulk;
+
+                typedef std::map<std::string, Bucket>       BucketsMap; //!< Group -> Requests waiting to be merged
+                typedef std::map<const Deferred<A>*, Bulk> BulksMap;   //!< Merged request -> Requests it serves
+
+                typedef std::map<const Deferred<A>*, size_t> RoutesMap; //!< Request -> \link Balancer \link endpoint index
+
+                typedef struct {
+                    A                                     args_;
+                    Deferred<A>*                          deferred_;
+                    std::chrono::steady_clock::time_point queued_at_;
+                } Paced;
+
+                typedef std::map<std::string, std::deque<Paced>> PacedMap; //!< Tenant -> Requests waiting for a \link Throttle \link token
+
+                typedef std::map<uint64_t, std::chrono::steady_clock::time_point>                   DeadlinesMap; //!< BEANSTALKD job ID -> Deadline
+                typedef std::set<std::pair<std::chrono::steady_clock::time_point, Deferred<A>*>> ExpiringSet;  //!< Launched requests, by deadline
+
+                typedef std::map<std::string, uint64_t> ChannelsMap; //!< REDIS channel ID -> BEANSTALKD job ID
+                typedef std::map<uint64_t, std::string> JobsMap;     //!< BEANSTALKD job ID -> REDIS channel ID
 
         protected: // Const Data - DEBUG
                 
@@ -66,9 +162,66 @@ namespace casper
                 
                 Callbacks callbacks_;
                 
+            private: // Data Type(s)
+                
+                typedef struct {
+                    std::mutex mutex_;
+                    bool       alive_;
+                } Liveness;
+                
             private: // Data
                 
-                RunningMap running_; //!< Deferred running requests.
+                RunningMap                running_;  //!< Deferred running requests.
+                Script*                   script_;   //!< When set, requests are not performed, recorded responses are served instead.
+                Limiter                   limiter_;
+                WaitingQueue              waiting_;
+                WaitingIndex              positions_;
+                uint64_t                  arrival_;  //!< Last waiting request arrival order.
+                std::set<Deferred<A>*>    admitted_; //!< Requests holding a \link Limiter \link slot.
+                Hedger                    hedger_;
+                RaceMap                   races_;
+                RacersMap                 racers_;
+                uint64_t                  race_;     //!< Last race ID.
+                std::set<const Deferred<A>*> launched_; //!< Requests performed by the backend, only their RTT feeds the \link Hedger \link.
+                std::function<void(const Deferred<A>*)> on_completed_; //!< Bound \link Callbacks::on_completed_ \link, only race winners reach it.
+                bool                      coalesce_;
+                FlightMap                 flights_;
+                LeadersMap                leaders_;
+                uint64_t                  coalesced_;
+                Cache                     cache_;
+                FillsMap                  fills_;
+                Batcher                   batcher_;
+                BucketsMap                buckets_;
+                BulksMap                  bulks_;
+                uint64_t                  bucket_;   //!< Last bucket ID.
+                Balancer                  balancer_;
+                RoutesMap                 routes_;
+                Breaker                   breaker_;
+                std::set<const Deferred<A>*> sent_;  //!< Requests sent to backend, their outcome feeds the \link Breaker \link.
+                Throttle                  throttle_;
+                PacedMap                  paced_;
+                size_t                    pacing_;   //!< Requests in \link paced_ \link.
+                uint64_t                  pacer_;    //!< ID of the pending \link Pace \link timer, 0 if none.
+                uint64_t                  pace_;     //!< Last \link Pace \link timer ID.
+                std::chrono::steady_clock::time_point pace_at_; //!< When pending \link Pace \link timer fires.
+                Keeper                    keeper_;
+                Touch                     touch_;
+                uint64_t                  tender_;   //!< ID of the pending \link Tend \link timer, 0 if none.
+                uint64_t                  tend_;     //!< Last \link Tend \link timer ID.
+                std::chrono::steady_clock::time_point tend_at_; //!< When pending \link Tend \link timer fires.
+                DeadlinesMap              deadlines_;
+                ExpiringSet               expiring_;
+                uint64_t                  expired_;
+                uint64_t                  overdue_;
+                bool                      edf_;      //!< When set, waiting requests are launched earliest deadline first.
+                uint64_t                  reaper_;   //!< ID of the pending \link Reap \link timer, 0 if none.
+                uint64_t                  reap_;     //!< Last \link Reap \link timer ID.
+                std::chrono::steady_clock::time_point reap_at_; //!< When pending \link Reap \link timer fires.
+                ChannelsMap               channels_; //!< Jobs with dispatched requests, by REDIS channel ID.
+                JobsMap                   jobs_;
+                std::set<uint64_t>        revoked_;  //!< Jobs cancelled by their clients.
+                uint64_t                  cancelled_;
+                std::shared_ptr<Liveness> liveness_; //!< Shared with timer and touch callbacks, so they can tell if this object was disposed.
 
             public: // Constructor(s) / Destructor
                 
@@ -81,9 +234,98 @@ namespace casper
                 virtual void Setup (const Json::Value& a_config) = 0;
                 virtual void Load  (const bool a_reload = false) { (void)a_reload;}
                 
+            protected: // Virtual Method(s) / Function(s)
+                
+                /**
+                 * @return True if request can be safely performed more than once, only those are hedged.
+                 */
+                virtual bool         Idempotent (const Deferred<A>* /* a_deferred */) const { return false; }
+                
+                /**
+                 * @return A new, not launched, copy of a request with the provided ID; nullptr if not supported.
+                 */
+                virtual Deferred<A>* Duplicate  (const Deferred<A>* /* a_deferred */, const std::string& /* a_id */) { return nullptr; }
+                
+                /**
+                 * @return Canonical key of a request, identical in-flight requests share a key; empty if it can't be coalesced.
+                 */
+                virtual std::string  Key        (const A& a_args, const Deferred<A>* a_deferred) const { return ( true == Idempotent(a_deferred) ? a_args.Key() : "" ); }
+                
+                /**
+                 * @return True if request response can be kept and served to later identical requests.
+                 */
+                virtual bool         Cacheable  (const Deferred<A>* a_deferred) const { return Idempotent(a_deferred); }
+                
+                /**
+                 * @brief Make a not launched request conditional, so that backend can reply '304 Not Modified'.
+                 *
+                 * @return True if supported.
+                 */
+                virtual bool         Revalidate (Deferred<A>* /* a_deferred */, const std::string& /* a_etag */) { return false; }
+                
+                /**
+                 * @return Tenant a request belongs to, each one has it's own \link Throttle \link bucket; empty if unknown.
+                 */
+                virtual std::string  Tenant     (const A& a_args, const Deferred<A>* /* a_deferred */) const { return a_args.Tenant(throttle_.config().tenant_); }
+                
+                /**
+                 * @brief Point a not launched request to a backend endpoint.
+                 *
+                 * @return True if supported.
+                 */
+                virtual bool         Route      (Deferred<A>* /* a_deferred */, const std::string& /* a_endpoint */) { return false; }
+                
+                /**
+                 * @brief Let a not launched request know how much time ( in ms ) it has left, e.g. to limit it's timeout.
+                 *
+                 * @return True if supported.
+                 */
+                virtual bool         Budget     (Deferred<A>* /* a_deferred */, const size_t /* a_remaining */) { return false; }
+                
+                /**
+                 * @return Batch group of a request, requests of the same group can be merged into one backend call; empty if it can't be batched.
+                 */
+                virtual std::string  Group      (const A& /* a_args */, const Deferred<A>* /* a_deferred */) const { return ""; }
+                
+                /**
+                 * @return A new, not launched, request performing all members in a single backend call; nullptr if not supported.
+                 */
+                virtual Deferred<A>* Merge      (const std::string& /* a_group */, const BatchMembers& /* a_members */, const std::string& /* a_id */) { return nullptr; }
+                
+                /**
+                 * @brief Split a merged request response into one response per member, in members order.
+                 *        Only called for successful ( < 400 ) responses, failures are delivered to all members as is.
+                 */
+                virtual void         Split      (const std::string& /* a_group */, const BatchMembers& /* a_members */, const Response& /* a_response */, std::vector<Response>& /* o_responses */)
+                {
+                    throw ::cc::Exception("%s", "Batch split not implemented!");
+                }
+                
             public: // API - One-shot Call Method(s) / Function(s)
                 
                 void         Bind    (Callbacks a_callbacks);
+                void         Replay  (Script* a_script);
+                void         Limit   (const Limiter::Config& a_config);
+                void         Hedge   (const Hedger::Config& a_config);
+                void         Coalesce (const bool a_enabled);
+                void         Prioritize (const bool a_enabled);
+                void         Memoize  (const Cache::Config& a_config);
+                void         Batch    (const Batcher::Config& a_config);
+                void         Balance  (const Balancer::Config& a_config);
+                void         Protect  (const Breaker::Config& a_config);
+                void         Ration   (const Throttle::Config& a_config);
+                void         Sustain  (const Keeper::Config& a_config, Touch a_touch);
+                
+            public: // API - Method(s) / Function(s)
+                
+                void         Deadline (const uint64_t& a_id, const uint64_t a_validity, const std::chrono::steady_clock::time_point& a_reserved);
+                void         Enlist   (const uint64_t& a_id, const std::string& a_rcid);
+                void         Keep    (const uint64_t& a_id, const uint64_t a_ttr, const std::chrono::steady_clock::time_point& a_reserved);
+                void         Drop    (const uint64_t& a_id);
+                size_t       Revoke  (const std::string& a_rcid);
+                size_t       Prune   (const uint64_t& a_id);
+                bool         Revoked (const uint64_t& a_id) const;
+                Metrics      metrics () const;
                 
             protected: // API - One-shot Call Method(s) / Function(s)
                 
@@ -93,6 +335,60 @@ namespace casper
                 
                 void Dispatch (const A& a_args, Deferred<A>* a_deferred);
                 
+            private: // Method(s) / Function(s)
+                
+                void Admit   (const A& a_args, Deferred<A>* a_deferred);
+                void Acquire (const A& a_args, Deferred<A>* a_deferred);
+                void Submit  (const A& a_args, Deferred<A>* a_deferred);
+                void Launch  (const A& a_args, Deferred<A>* a_deferred);
+                void Replay  (const A& a_args, Deferred<A>* a_deferred);
+                void Settle  (Deferred<A>* a_deferred);
+                void Drain   ();
+                void                       Queue   (const A& a_args, Deferred<A>* a_deferred);
+                std::pair<A, Deferred<A>*> Pop     ();
+                void Forget  ();
+                void Forget  (Deferred<A>* a_deferred, const bool a_launched);
+                
+                void Enter   (const A& a_args, Deferred<A>* a_deferred);
+                void Fire    (const uint64_t a_race);
+                void Finish  (const Deferred<A>* a_deferred);
+                void Leave   (const Deferred<A>* a_deferred);
+                
+                bool Join    (const A& a_args, Deferred<A>* a_deferred);
+                void Land    (const Deferred<A>* a_deferred);
+                void Abandon (const Deferred<A>* a_deferred);
+                
+                bool Recall  (const A& a_args, Deferred<A>* a_deferred);
+                void Remember (const Deferred<A>* a_deferred);
+                
+                bool Collect (const A& a_args, Deferred<A>* a_deferred);
+                void Flush   (const std::string& a_group, const uint64_t a_id);
+                bool Scatter (const Deferred<A>* a_deferred);
+                void Disband (const Deferred<A>* a_deferred);
+                
+                void Assign  (Deferred<A>* a_deferred);
+                void Resolve (const Deferred<A>* a_deferred);
+                
+                bool Allow   (const A& a_args, Deferred<A>* a_deferred, const bool a_trial);
+                void Judge   (const Deferred<A>* a_deferred);
+                
+                bool Hold    (const A& a_args, Deferred<A>* a_deferred);
+                void Pace    ();
+                void Wake    (const size_t a_delay);
+                
+                void Tend    ();
+                void Watch   ();
+                
+                void Stamp   (Deferred<A>* a_deferred);
+                void Mind    (Deferred<A>* a_deferred);
+                bool Bound   (Deferred<A>* a_deferred);
+                void Expire  (Deferred<A>* a_deferred);
+                void Terminate (Deferred<A>* a_deferred, const uint16_t a_code, const std::string& a_reason);
+                bool Shared  (const Deferred<A>* a_deferred) const;
+                size_t Cull  (const uint64_t& a_id, const std::string& a_reason);
+                void Reap    ();
+                void Rearm   ();
+                
             }; // end of class 'Dispatcher'
         
             /**
@@ -105,6 +401,25 @@ namespace casper
                 CC_IF_DEBUG(: CC_IF_DEBUG_CONSTRUCT_SET_VAR(thread_id_, a_thread_id))
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                script_    = nullptr;
+                race_      = 0;
+                coalesce_  = false;
+                coalesced_ = 0;
+                bucket_    = 0;
+                pacing_    = 0;
+                pacer_     = 0;
+                pace_      = 0;
+                tender_    = 0;
+                tend_      = 0;
+                expired_   = 0;
+                overdue_   = 0;
+                edf_       = false;
+                arrival_   = 0;
+                reaper_    = 0;
+                reap_      = 0;
+                cancelled_ = 0;
+                liveness_  = std::make_shared<Liveness>();
+                liveness_->alive_ = true;
             }
 
             /**
@@ -114,6 +429,31 @@ namespace casper
             Dispatcher<A>::~Dispatcher ()
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                // ... pending timers must not call us back ...
+                {
+                    std::lock_guard<std::mutex> lock(liveness_->mutex_);
+                    liveness_->alive_ = false;
+                }
+                // ... waiting requests were never launched ...
+                for ( auto& entry : waiting_ ) {
+                    delete entry.second.second;
+                }
+                waiting_.clear();
+                positions_.clear();
+                // ... neither were requests waiting to be merged ...
+                for ( auto& bucket : buckets_ ) {
+                    for ( auto& member : bucket.second.members_ ) {
+                        delete member.second;
+                    }
+                }
+                buckets_.clear();
+                // ... nor were requests waiting for a token ...
+                for ( auto& tenant : paced_ ) {
+                    for ( auto& paced : tenant.second ) {
+                        delete paced.deferred_;
+                    }
+                }
+                paced_.clear();
                 callbacks_.on_completed_          = nullptr;
                 callbacks_.on_main_thread_        = nullptr;
                 callbacks_.on_looper_thread_      = nullptr;
@@ -130,12 +470,305 @@ namespace casper
             inline void Dispatcher<A>::Bind (Callbacks a_callbacks)
             {
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
-                callbacks_ = a_callbacks;
-                // ... forget running activities ...
-                for ( auto it : running_ ) {
-                    delete it.second;
+                callbacks_    = a_callbacks;
+                on_completed_ = a_callbacks.on_completed_;
+                // ... completion is intercepted so that only the first response of a race is delivered ...
+                if ( nullptr != on_completed_ ) {
+                    callbacks_.on_completed_ = std::bind(&Dispatcher<A>::Finish, this, std::placeholders::_1);
                 }
-                running_.clear();
+                // ... forget running and waiting activities ...
+                Forget();
+            }
+            
+            /**
+             * @brief Enable ( or disable ) replay mode.
+             *
+             * @param a_script Recording to serve responses from, nullptr to perform requests.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Replay (Script* a_script)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                script_ = a_script;
+            }
+            
+            /**
+             * @brief Enable ( or disable ) adaptive concurrency limiting.
+             *
+             * @param a_config See \link Limiter::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Limit (const Limiter::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                limiter_.Setup(a_config);
+                // ... slots held by running requests are no longer accounted ...
+                admitted_.clear();
+            }
+            
+            /**
+             * @brief Enable ( or disable ) hedging of slow idempotent requests.
+             *
+             * @param a_config See \link Hedger::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Hedge (const Hedger::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                hedger_.Setup(a_config);
+            }
+            
+            /**
+             * @brief Enable ( or disable ) coalescing of identical in-flight requests.
+             *
+             * @param a_enabled True to perform only one of a set of identical requests and share it's response.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Coalesce (const bool a_enabled)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                coalesce_ = a_enabled;
+            }
+            
+            /**
+             * @brief Enable ( or disable ) earliest deadline first launch of requests waiting for a \link Limiter \link slot.
+             *
+             * @param a_enabled True to launch the waiting request with the nearest job deadline first, instead of the oldest;
+             *                  applies to requests queued from now on.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Prioritize (const bool a_enabled)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                edf_ = a_enabled;
+            }
+            
+            /**
+             * @brief Enable ( or disable ) caching of idempotent requests responses.
+             *
+             * @param a_config See \link Cache::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Memoize (const Cache::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                cache_.Setup(a_config);
+                fills_.clear();
+            }
+            
+            /**
+             * @brief Enable ( or disable ) micro-batching of requests into single backend calls.
+             *
+             * @param a_config See \link Batcher::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Batch (const Batcher::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                batcher_.Setup(a_config);
+            }
+            
+            /**
+             * @brief Enable ( or disable ) balancing of requests over a set of backend endpoints.
+             *
+             * @param a_config See \link Balancer::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Balance (const Balancer::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                balancer_.Setup(a_config);
+                // ... running requests are no longer accounted ...
+                routes_.clear();
+            }
+            
+            /**
+             * @brief Enable ( or disable ) the circuit breaker.
+             *
+             * @param a_config See \link Breaker::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Protect (const Breaker::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                breaker_.Setup(a_config);
+                sent_.clear();
+            }
+            
+            /**
+             * @brief Enable ( or disable ) token bucket rate limiting.
+             *
+             * @param a_config See \link Throttle::Config \link.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Ration (const Throttle::Config& a_config)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                throttle_.Setup(a_config);
+            }
+            
+            /**
+             * @brief Enable ( or disable ) TTR keep-alive of jobs waiting for deferred requests.
+             *
+             * @param a_config See \link Keeper::Config \link.
+             * @param a_touch  Function that touches a batch of jobs, required when enabled.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Sustain (const Keeper::Config& a_config, Touch a_touch)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                if ( true == a_config.enabled_ && nullptr == a_touch ) {
+                    throw ::cc::Exception("%s", "Keep-alive requires a touch function!");
+                }
+                keeper_.Setup(a_config);
+                touch_  = a_touch;
+                tender_ = 0;
+            }
+            
+            /**
+             * @brief Set the deadline of a job's deferred requests, they fail once it's passed.
+             *
+             * @param a_id       Job ID.
+             * @param a_validity Job validity, in seconds; 0 for no deadline.
+             * @param a_reserved When job was reserved, validity counts from there.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Deadline (const uint64_t& a_id, const uint64_t a_validity, const std::chrono::steady_clock::time_point& a_reserved)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                if ( 0 == a_validity ) {
+                    deadlines_.erase(a_id);
+                } else {
+                    deadlines_[a_id] = a_reserved + std::chrono::seconds(a_validity);
+                }
+            }
+            
+            /**
+             * @brief Remember a job's REDIS channel, so it can be cancelled by it's client until \link Drop \link is called.
+             *
+             * @param a_id   Job ID.
+             * @param a_rcid REDIS channel ID of the job, empty if none.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Enlist (const uint64_t& a_id, const std::string& a_rcid)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                if ( 0 == a_rcid.length() || jobs_.end() != jobs_.find(a_id) ) {
+                    return;
+                }
+                jobs_[a_id]       = a_rcid;
+                channels_[a_rcid] = a_id;
+            }
+            
+            /**
+             * @brief Keep a job alive until \link Drop \link is called, it's touched ahead of TTR expiry.
+             *
+             * @param a_id       Job ID.
+             * @param a_ttr      Job TTR, in seconds.
+             * @param a_reserved When job was reserved, it's TTR counts from there.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Keep (const uint64_t& a_id, const uint64_t a_ttr, const std::chrono::steady_clock::time_point& a_reserved)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                if ( false == keeper_.enabled() ) {
+                    return;
+                }
+                keeper_.Track(a_id, a_ttr, a_reserved);
+                Watch();
+            }
+            
+            /**
+             * @brief Forget a job's deadline and cancellation state and stop keeping it alive, it's finished.
+             *
+             * @param a_id Job ID.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Drop (const uint64_t& a_id)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                deadlines_.erase(a_id);
+                revoked_.erase(a_id);
+                const auto job = jobs_.find(a_id);
+                if ( jobs_.end() != job ) {
+                    channels_.erase(job->second);
+                    jobs_.erase(job);
+                }
+                if ( true == keeper_.Untrack(a_id) && nullptr != callbacks_.on_log_tracking_ ) {
+                    callbacks_.on_log_tracking_({ a_id, "", "", "", "", "" }, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                "Finished after it's original TTR, kept alive"
+                    );
+                }
+            }
+            
+            /**
+             * @brief Cancel a job on behalf of it's client: it's queued and launched requests fail immediately and it's later
+             *        requests are refused.
+             *
+             * @param a_rcid REDIS channel ID of the job.
+             *
+             * @return Number of requests failed, 0 if job is unknown or already finished.
+             */
+            template <class A>
+            inline size_t Dispatcher<A>::Revoke (const std::string& a_rcid)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                const auto channel = channels_.find(a_rcid);
+                if ( channels_.end() == channel ) {
+                    return 0;
+                }
+                const uint64_t job = channel->second;
+                revoked_.insert(job);
+                const size_t count = Cull(job, "Cancelled by client");
+                cancelled_ += count;
+                if ( nullptr != callbacks_.on_log_tracking_ ) {
+                    callbacks_.on_log_tracking_({ job, "", "", a_rcid, "", "" }, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                "Cancel : " + std::to_string(count) + " request(s) failed, " + std::to_string(cancelled_) + " cancelled"
+                    );
+                }
+                return count;
+            }
+            
+            /**
+             * @brief Fail a job's outstanding requests, their responses are no longer needed ( e.g. job already finished ).
+             *
+             * @param a_id Job ID.
+             *
+             * @return Number of requests failed.
+             */
+            template <class A>
+            inline size_t Dispatcher<A>::Prune (const uint64_t& a_id)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                const size_t count = Cull(a_id, "No longer needed");
+                if ( 0 != count ) {
+                    callbacks_.on_log_tracking_({ a_id, "", "", "", "", "" }, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                "Prune  : " + std::to_string(count) + " request(s) failed"
+                    );
+                }
+                return count;
+            }
+            
+            /**
+             * @return True if a job was cancelled by it's client and is not finished yet.
+             *
+             * @param a_id Job ID.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Revoked (const uint64_t& a_id) const
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                return ( revoked_.end() != revoked_.find(a_id) );
+            }
+            
+            /**
+             * @return Current \link Metrics \link.
+             */
+            template <class A>
+            inline typename Dispatcher<A>::Metrics Dispatcher<A>::metrics () const
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                return { limiter_.metrics(), waiting_.size(), hedger_.stats(), coalesced_, cache_.stats(), batcher_.stats(), balancer_.stats(), breaker_.stats(), throttle_.stats(), pacing_, keeper_.stats(), expired_, cancelled_, overdue_ };
             }
             
             /**
@@ -165,14 +798,20 @@ namespace casper
                         // ... log ...
                         callbacks_.on_log_tracking_(a_deferred_u->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS, "Untrack: " + a_deferred_u->id_);
                         // ... untrack ...
+                        Forget(a_deferred_u, /* a_launched */ ( launched_.end() != launched_.find(a_deferred_u) ));
+                        // ... this lambda is owned by the object about to be deleted ...
+                        Dispatcher<A>* self = this;
                         const auto it = running_.find(a_deferred_u->id_);
                         if ( running_.end() == it ) {
                             // TODO: review old behaviour was:  throw cc::Exception("Logic error, '%s' not found!", a_deferred->id_.c_str());
                             delete a_deferred_u;
                         } else {
-                            delete it->second;
+                            Deferred<A>* deferred = it->second;
                             running_.erase(it);
+                            delete deferred;
                         }
+                        // ... a slot might have been released ...
+                        self->Drain();
                     }
                 });
             }
@@ -189,16 +828,1417 @@ namespace casper
                 CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
                 try {
                     Bind(a_deferred);
-                    a_deferred->Run(a_args, callbacks_);
+                    Stamp(a_deferred);
+                    // ... job cancelled by it's client?
+                    if ( revoked_.end() != revoked_.find(a_deferred->tracking_.bjid_) ) {
+                        a_deferred->Reject(a_args, callbacks_, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED, "Job cancelled by client!");
+                        return;
+                    }
+                    // ... fresh response cached?
+                    if ( true == Recall(a_args, a_deferred) ) {
+                        return;
+                    }
+                    // ... backend failing?
+                    if ( false == Allow(a_args, a_deferred, /* a_trial */ false) ) {
+                        return;
+                    }
+                    // ... identical request in-flight?
+                    if ( true == Join(a_args, a_deferred) ) {
+                        return;
+                    }
+                    // ... to be merged with others?
+                    if ( true == Collect(a_args, a_deferred) ) {
+                        return;
+                    }
+                    Admit(a_args, a_deferred);
                 } catch (...) {
                     if ( true == a_deferred->Tracked() ) {
                         a_deferred->Untrack();
                     } else {
+                        Forget(a_deferred, /* a_launched */ false);
                         delete a_deferred;
                     }
                     cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
                 }
             }
+            
+            /**
+             * @brief Launch a request once it gets a \link Throttle \link token and a \link Limiter \link slot.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request to launch.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Admit (const A& a_args, Deferred<A>* a_deferred)
+            {
+                // ... over rate budget?
+                if ( true == Hold(a_args, a_deferred) ) {
+                    return;
+                }
+                Acquire(a_args, a_deferred);
+            }
+            
+            /**
+             * @brief Launch a request if the \link Limiter \link allows it, otherwise it waits for a slot or it's rejected.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request to launch.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Acquire (const A& a_args, Deferred<A>* a_deferred)
+            {
+                // ... backend saturated?
+                if ( true == limiter_.enabled() ) {
+                    if ( false == limiter_.Acquire() ) {
+                        if ( waiting_.size() < limiter_.config().queue_ ) {
+                            // ... wait for a slot ...
+                            Queue(a_args, a_deferred);
+                            Mind(a_deferred);
+                        } else {
+                            // ... shed load ...
+                            limiter_.Reject();
+                            a_deferred->Reject(a_args, callbacks_, CC_STATUS_CODE_SERVICE_UNAVAILABLE, "Too many pending requests, try again later!");
+                        }
+                        return;
+                    }
+                    admitted_.insert(a_deferred);
+                }
+                Launch(a_args, a_deferred);
+            }
+            
+            /**
+             * @brief \link Admit \link a request whose job was already deferred, failures are delivered as a response.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request to launch.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Submit (const A& a_args, Deferred<A>* a_deferred)
+            {
+                try {
+                    Admit(a_args, a_deferred);
+                } catch (...) {
+                    try {
+                        ::cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
+                    } catch (const ::cc::Exception& a_cc_exception) {
+                        a_deferred->Reject(a_args, callbacks_, CC_STATUS_CODE_INTERNAL_SERVER_ERROR, a_cc_exception.what());
+                    }
+                }
+            }
+            
+            /**
+             * @brief Launch a deferred request.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request to run.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Launch (const A& a_args, Deferred<A>* a_deferred)
+            {
+                if ( nullptr != script_ ) {
+                    Replay(a_args, a_deferred);
+                } else {
+                    // ... job's client already gave up?
+                    if ( false == Bound(a_deferred) ) {
+                        expired_++;
+                        overdue_++;
+                        a_deferred->Reject(a_args, callbacks_, CC_STATUS_CODE_GATEWAY_TIMEOUT, "Deadline exceeded before request was launched!");
+                        return;
+                    }
+                    // ... half-open trials are only taken by requests really about to be sent ...
+                    if ( false == Allow(a_args, a_deferred, /* a_trial */ true) ) {
+                        return;
+                    }
+                    Assign(a_deferred);
+                    a_deferred->Run(a_args, callbacks_);
+                    launched_.insert(a_deferred);
+                    if ( true == breaker_.enabled() ) {
+                        sent_.insert(a_deferred);
+                    }
+                    Enter(a_args, a_deferred);
+                }
+            }
+            
+            /**
+             * @brief Complete a request with the next recorded response instead of performing it.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request to complete.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Replay (const A& a_args, Deferred<A>* a_deferred)
+            {
+                Response response;
+                if ( false == script_->Next(a_deferred->tracking_.bjid_, response) ) {
+                    response.Set(CC_STATUS_CODE_INTERNAL_SERVER_ERROR, ::cc::Exception("No recorded response for job #" UINT64_FMT "!", a_deferred->tracking_.bjid_));
+                }
+                a_deferred->Attach(a_args, callbacks_);
+                a_deferred->Deliver(response);
+            }
+            
+            /**
+             * @brief Release the \link Limiter \link slot held by a request ( if any ) and feed it's outcome to the limiter.
+             *
+             * @param a_deferred Finished request.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Settle (Deferred<A>* a_deferred)
+            {
+                if ( 0 == admitted_.erase(a_deferred) ) {
+                    return;
+                }
+                const Response& response = a_deferred->response();
+                limiter_.Release(response.rtt(),
+                                 /* a_failed */ ( nullptr != response.exception() || CC_STATUS_CODE_TOO_MANY_REQUESTS == response.code() || response.code() >= 500 )
+                );
+                const auto metrics = limiter_.metrics();
+                callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                                            "Limit  : " + std::to_string(metrics.limit_) + ", in-flight " + std::to_string(metrics.in_flight_)
+                                            + ", waiting " + std::to_string(waiting_.size()) + ", rejected " + std::to_string(metrics.rejected_)
+                );
+            }
+            
+            /**
+             * @brief Launch waiting requests while there are free slots.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Drain ()
+            {
+                while ( waiting_.size() > 0 && true == limiter_.Acquire() ) {
+                    const auto entry = Pop();
+                    admitted_.insert(entry.second);
+                    try {
+                        Launch(entry.first, entry.second);
+                    } catch (...) {
+                        // ... job was already deferred, failure must be delivered as a response ...
+                        try {
+                            ::cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
+                        } catch (const ::cc::Exception& a_cc_exception) {
+                            entry.second->Reject(entry.first, callbacks_, CC_STATUS_CODE_INTERNAL_SERVER_ERROR, a_cc_exception.what());
+                        }
+                    }
+                }
+            }
+            
+            /**
+             * @brief Add a request to the waiting queue.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request waiting for a slot.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Queue (const A& a_args, Deferred<A>* a_deferred)
+            {
+                // ... earliest deadline first? ties, and requests without a deadline, keep arrival order ...
+                const WaitingKey key = std::make_pair(( true == edf_ && std::chrono::steady_clock::time_point() != a_deferred->deadline_ ? a_deferred->deadline_ : std::chrono::steady_clock::time_point::max() ),
+                                                      ++arrival_);
+                waiting_.insert(std::make_pair(key, std::make_pair(a_args, a_deferred)));
+                positions_[a_deferred] = key;
+            }
+            
+            /**
+             * @brief Remove the next request to launch from the waiting queue.
+             *
+             * @return Request specific arguments and request.
+             */
+            template <class A>
+            inline std::pair<A, Deferred<A>*> Dispatcher<A>::Pop ()
+            {
+                const auto it    = waiting_.begin();
+                const auto entry = it->second;
+                positions_.erase(entry.second);
+                waiting_.erase(it);
+                return entry;
+            }
+            
+            /**
+             * @brief Forget running and waiting requests.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Forget ()
+            {
+                for ( auto it : running_ ) {
+                    delete it.second;
+                }
+                running_.clear();
+                for ( auto& entry : waiting_ ) {
+                    delete entry.second.second;
+                }
+                waiting_.clear();
+                positions_.clear();
+                admitted_.clear();
+                limiter_.Reset();
+                races_.clear();
+                racers_.clear();
+                launched_.clear();
+                hedger_.Reset();
+                flights_.clear();
+                leaders_.clear();
+                coalesced_ = 0;
+                // ... cached responses are still valid ...
+                fills_.clear();
+                for ( auto& bucket : buckets_ ) {
+                    for ( auto& member : bucket.second.members_ ) {
+                        delete member.second;
+                    }
+                }
+                buckets_.clear();
+                bulks_.clear();
+                batcher_.Reset();
+                routes_.clear();
+                balancer_.Reset();
+                sent_.clear();
+                for ( auto& tenant : paced_ ) {
+                    for ( auto& paced : tenant.second ) {
+                        delete paced.deferred_;
+                    }
+                }
+                paced_.clear();
+                pacing_ = 0;
+                pacer_  = 0;
+                throttle_.Reset();
+                keeper_.Reset();
+                tender_ = 0;
+                deadlines_.clear();
+                expiring_.clear();
+                expired_ = 0;
+                overdue_ = 0;
+                reaper_  = 0;
+                channels_.clear();
+                jobs_.clear();
+                revoked_.clear();
+                cancelled_ = 0;
+            }
+            
+            // MARK: - Hedging
+            
+            /**
+             * @brief Forget a request being disposed: it leaves it's race, flight, cache fill and merged request ( if any ),
+             *        it's limiter slot, endpoint and breaker outcome are accounted only if it was sent to the backend.
+             *
+             * @param a_deferred Request being disposed.
+             * @param a_launched True if request was launched, false if it never was, e.g. it failed while being dispatched.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Forget (Deferred<A>* a_deferred, const bool a_launched)
+            {
+                Leave(a_deferred);
+                Abandon(a_deferred);
+                fills_.erase(a_deferred);
+                Disband(a_deferred);
+                if ( true == a_launched ) {
+                    Settle(a_deferred);
+                    Resolve(a_deferred);
+                    Judge(a_deferred);
+                } else {
+                    // ... never performed, it's slot and endpoint have no outcome ...
+                    if ( 1 == admitted_.erase(a_deferred) ) {
+                        limiter_.Abort();
+                    }
+                    const auto route = routes_.find(a_deferred);
+                    if ( routes_.end() != route ) {
+                        balancer_.Abort(route->second);
+                        routes_.erase(route);
+                    }
+                    sent_.erase(a_deferred);
+                }
+                launched_.erase(a_deferred);
+                expiring_.erase(std::make_pair(a_deferred->deadline_, a_deferred));
+            }
+            
+            /**
+             * @brief Schedule an hedge for a just launched request, if it's eligible.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Launched request.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Enter (const A& a_args, Deferred<A>* a_deferred)
+            {
+                if ( false == hedger_.enabled() || false == Idempotent(a_deferred) ) {
+                    return;
+                }
+                const size_t delay = hedger_.Track();
+                if ( 0 == delay ) {
+                    return;
+                }
+                const uint64_t id = ++race_;
+                races_.insert(std::make_pair(id, Race({ a_args, a_deferred, nullptr, delay })));
+                racers_[a_deferred] = id;
+                const auto liveness = liveness_;
+                callbacks_.on_main_thread_deferred_([this, liveness, id] () {
+                    // ... dispatcher might be gone when this callback runs ...
+                    std::lock_guard<std::mutex> lock(liveness->mutex_);
+                    if ( false == liveness->alive_ ) {
+                        return;
+                    }
+                    Fire(id);
+                }, delay);
+            }
+            
+            /**
+             * @brief Issue an hedge for a request that did not complete in time.
+             *
+             * @param a_race Race ID.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Fire (const uint64_t a_race)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                const auto it = races_.find(a_race);
+                if ( races_.end() == it ) {
+                    // ... already completed ...
+                    return;
+                }
+                Race& race = it->second;
+                // ... an hedge is an extra backend request, it must fit within concurrency limit ...
+                bool slot = false;
+                if ( true == limiter_.enabled() ) {
+                    if ( false == limiter_.Acquire() ) {
+                        // ... no free slot, let primary run alone ...
+                        racers_.erase(race.primary_);
+                        races_.erase(it);
+                        return;
+                    }
+                    slot = true;
+                }
+                Deferred<A>* secondary = nullptr;
+                if ( true == hedger_.Fire() ) {
+                    secondary = Duplicate(race.primary_, Hedger::Hedge(race.primary_->id_));
+                }
+                if ( nullptr == secondary ) {
+                    // ... over budget or not supported, let primary run alone ...
+                    if ( true == slot ) {
+                        limiter_.Abort();
+                    }
+                    racers_.erase(race.primary_);
+                    races_.erase(it);
+                    return;
+                }
+                callbacks_.on_log_tracking_(race.primary_->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                            "Hedge  : " + race.primary_->id_ + " pending after " + std::to_string(race.delay_) + "ms"
+                );
+                race.secondary_    = secondary;
+                racers_[secondary] = a_race;
+                if ( true == slot ) {
+                    admitted_.insert(secondary);
+                }
+                try {
+                    Bind(secondary);
+                    secondary->deadline_ = race.primary_->deadline_;
+                    if ( false == Bound(secondary) ) {
+                        throw ::cc::Exception("%s", "deadline exceeded");
+                    }
+                    Assign(secondary);
+                    secondary->Run(race.args_, callbacks_);
+                    launched_.insert(secondary);
+                    if ( true == breaker_.enabled() ) {
+                        sent_.insert(secondary);
+                    }
+                } catch (...) {
+                    try {
+                        ::cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
+                    } catch (const ::cc::Exception& a_cc_exception) {
+                        callbacks_.on_log_tracking_(secondary->tracking_, CC_JOB_LOG_LEVEL_ERR, CC_JOB_LOG_STEP_ERROR,
+                                                    "Hedge  : " + std::string(a_cc_exception.what())
+                        );
+                    }
+                    // ... never performed, primary keeps running ...
+                    if ( true == secondary->Tracked() ) {
+                        secondary->Untrack();
+                    } else {
+                        Forget(secondary, /* a_launched */ false);
+                        delete secondary;
+                    }
+                }
+            }
+            
+            /**
+             * @brief Deliver a completed request, if it's the first of it's race the other one is cancelled.
+             *
+             * @param a_deferred Completed request.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Finish (const Deferred<A>* a_deferred)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                // ... only responses that went over the network are RTT samples, rejected or served ones are not ...
+                if ( launched_.end() != launched_.find(a_deferred) && false == a_deferred->guard_->cancelled_ && nullptr == a_deferred->response().exception() ) {
+                    hedger_.Sample(a_deferred->response().rtt());
+                }
+                const auto racer = racers_.find(a_deferred);
+                if ( racers_.end() != racer ) {
+                    const auto   it     = races_.find(racer->second);
+                    const Race   race   = it->second;
+                    Deferred<A>* winner = ( a_deferred == race.primary_ ? race.primary_ : race.secondary_ );
+                    Deferred<A>* loser  = ( a_deferred == race.primary_ ? race.secondary_ : race.primary_ );
+                    racers_.erase(race.primary_);
+                    if ( nullptr != race.secondary_ ) {
+                        racers_.erase(race.secondary_);
+                    }
+                    races_.erase(it);
+                    if ( nullptr != loser ) {
+                        if ( winner == race.secondary_ ) {
+                            hedger_.Won();
+                        }
+                        // ... winner takes over loser's limiter slot, unless it holds one, and flight ( if any ) ...
+                        if ( 1 == admitted_.erase(loser) ) {
+                            if ( false == admitted_.insert(winner).second ) {
+                                limiter_.Abort();
+                            }
+                        }
+                        const auto leader = leaders_.find(loser);
+                        if ( leaders_.end() != leader ) {
+                            flights_[leader->second].leader_ = winner;
+                            leaders_[winner] = leader->second;
+                            leaders_.erase(leader);
+                        }
+                        const auto fill = fills_.find(loser);
+                        if ( fills_.end() != fill ) {
+                            fills_[winner]           = fill->second;
+                            fills_[winner].deferred_ = winner;
+                            fills_.erase(fill);
+                        }
+                        const auto bulk = bulks_.find(loser);
+                        if ( bulks_.end() != bulk ) {
+                            bulks_.insert(std::make_pair(winner, bulk->second));
+                            bulks_.erase(bulk);
+                        }
+                        const auto& stats = hedger_.stats();
+                        callbacks_.on_log_tracking_(winner->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                    "Hedge  : won by " + winner->id_ + ", hedged " + std::to_string(stats.hedged_)
+                                                    + " of " + std::to_string(stats.requests_) + ", " + std::to_string(stats.won_) + " won"
+                        );
+                        // ... loser's response, if any, must not be delivered ...
+                        loser->Cancel();
+                        loser->Untrack();
+                    }
+                }
+                // ... merged request? it's members are the ones to be delivered ...
+                if ( true == Scatter(a_deferred) ) {
+                    return;
+                }
+                // ... keep response or, if revalidated, replace it by the cached one ...
+                Remember(a_deferred);
+                on_completed_(a_deferred);
+                // ... identical requests waiting for this response?
+                Land(a_deferred);
+            }
+            
+            /**
+             * @brief Remove a disposed request from it's race ( if any ).
+             *
+             * @param a_deferred Request being disposed.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Leave (const Deferred<A>* a_deferred)
+            {
+                const auto racer = racers_.find(a_deferred);
+                if ( racers_.end() == racer ) {
+                    return;
+                }
+                const auto it = races_.find(racer->second);
+                racers_.erase(racer);
+                if ( a_deferred == it->second.primary_ ) {
+                    // ... primary gone without completing, hedge ( if any ) runs alone ...
+                    if ( nullptr != it->second.secondary_ ) {
+                        it->second.primary_   = it->second.secondary_;
+                        it->second.secondary_ = nullptr;
+                    } else {
+                        races_.erase(it);
+                    }
+                } else {
+                    it->second.secondary_ = nullptr;
+                }
+            }
+        
+            // MARK: - Coalescing
+            
+            /**
+             * @brief Attach a request to an identical in-flight one ( if any ), otherwise it leads a new flight.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request about to be launched.
+             *
+             * @return True if request was attached and must not be launched.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Join (const A& a_args, Deferred<A>* a_deferred)
+            {
+                if ( false == coalesce_ || nullptr != script_ ) {
+                    return false;
+                }
+                const std::string key = Key(a_args, a_deferred);
+                if ( 0 == key.length() ) {
+                    return false;
+                }
+                const auto it = flights_.find(key);
+                if ( flights_.end() == it ) {
+                    flights_[key]        = { a_deferred, {} };
+                    leaders_[a_deferred] = key;
+                    return false;
+                }
+                a_deferred->Attach(a_args, callbacks_);
+                it->second.followers_.push_back(a_deferred);
+                coalesced_++;
+                callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                            "Join   : " + a_deferred->id_ + " -> " + it->second.leader_->id_ + ", " + std::to_string(coalesced_) + " coalesced"
+                );
+                return true;
+            }
+            
+            /**
+             * @brief Fan out a leader's response to it's followers.
+             *
+             * @param a_deferred Completed request.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Land (const Deferred<A>* a_deferred)
+            {
+                const auto leader = leaders_.find(a_deferred);
+                if ( leaders_.end() == leader ) {
+                    return;
+                }
+                const auto it = flights_.find(leader->second);
+                const std::vector<Deferred<A>*> followers = it->second.followers_;
+                flights_.erase(it);
+                leaders_.erase(leader);
+                for ( auto follower : followers ) {
+                    follower->Deliver(a_deferred->response());
+                }
+            }
+            
+            /**
+             * @brief A leader is being disposed without completing, it's followers fail.
+             *
+             * @param a_deferred Request being disposed.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Abandon (const Deferred<A>* a_deferred)
+            {
+                if ( leaders_.end() == leaders_.find(a_deferred) ) {
+                    return;
+                }
+                Response response;
+                response.Set(CC_STATUS_CODE_INTERNAL_SERVER_ERROR, ::cc::Exception("Coalesced request '%s' was abandoned!", a_deferred->id_.c_str()));
+                const auto it = flights_.find(leaders_[a_deferred]);
+                const std::vector<Deferred<A>*> followers = it->second.followers_;
+                flights_.erase(it);
+                leaders_.erase(a_deferred);
+                for ( auto follower : followers ) {
+                    follower->Deliver(response);
+                }
+            }
+        
+            // MARK: - Caching
+            
+            /**
+             * @brief Serve a request from cache, if a fresh response is available.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request about to be launched.
+             *
+             * @return True if request was served and must not be launched.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Recall (const A& a_args, Deferred<A>* a_deferred)
+            {
+                if ( false == cache_.enabled() || nullptr != script_ || false == Cacheable(a_deferred) ) {
+                    return false;
+                }
+                const std::string key = Key(a_args, a_deferred);
+                if ( 0 == key.length() ) {
+                    return false;
+                }
+                Response    response;
+                std::string etag;
+                switch ( cache_.Lookup(key, response, etag) ) {
+                    case Cache::Result::Hit:
+                    {
+                        const auto& stats = cache_.stats();
+                        callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                    "Cache  : hit " + a_deferred->id_ + ", " + std::to_string(stats.hits_) + " hits, " + std::to_string(stats.misses_)
+                                                    + " misses, " + std::to_string(stats.entries_) + " entries, " + std::to_string(stats.bytes_) + " bytes"
+                        );
+                        // ... backend is skipped, response is delivered through the usual completion path ...
+                        a_deferred->Attach(a_args, callbacks_);
+                        a_deferred->Deliver(response);
+                        return true;
+                    }
+                    case Cache::Result::Stale:
+                        if ( true == Revalidate(a_deferred, etag) ) {
+                            fills_.insert(std::make_pair(a_deferred, Fill({ key, a_deferred, true, response })));
+                            break;
+                        }
+                        fills_.insert(std::make_pair(a_deferred, Fill({ key, a_deferred, false, Response() })));
+                        break;
+                    default:
+                        fills_.insert(std::make_pair(a_deferred, Fill({ key, a_deferred, false, Response() })));
+                        break;
+                }
+                return false;
+            }
+            
+            /**
+             * @brief Keep a completed request response in cache or, when revalidating, replace a '304 Not Modified' by the cached one.
+             *
+             * @param a_deferred Completed request.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Remember (const Deferred<A>* a_deferred)
+            {
+                const auto it = fills_.find(a_deferred);
+                if ( fills_.end() == it ) {
+                    return;
+                }
+                const Response& response = a_deferred->response();
+                if ( nullptr == response.exception() ) {
+                    if ( true == it->second.stale_ && 304 /* Not Modified */ == response.code() ) {
+                        cache_.Refresh(it->second.key_, response);
+                        it->second.deferred_->response_ = it->second.response_;
+                        callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                                                    "Cache  : revalidated " + a_deferred->id_ + ", " + std::to_string(cache_.stats().revalidated_) + " revalidated"
+                        );
+                    } else if ( CC_STATUS_CODE_OK == response.code() ) {
+                        cache_.Store(it->second.key_, response);
+                    }
+                }
+                fills_.erase(it);
+            }
+        
+            // MARK: - Batching
+            
+            /**
+             * @brief Hold a request so that it can be merged with others of the same group.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request about to be launched.
+             *
+             * @return True if request is held and must not be launched.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Collect (const A& a_args, Deferred<A>* a_deferred)
+            {
+                if ( false == batcher_.enabled() || nullptr != script_ ) {
+                    return false;
+                }
+                const std::string group = Group(a_args, a_deferred);
+                if ( 0 == group.length() ) {
+                    return false;
+                }
+                auto it = buckets_.find(group);
+                if ( buckets_.end() == it ) {
+                    const uint64_t id = ++bucket_;
+                    it = buckets_.insert(std::make_pair(group, Bucket({ id, {} }))).first;
+                    const auto liveness = liveness_;
+                    callbacks_.on_main_thread_deferred_([this, liveness, group, id] () {
+                        // ... dispatcher might be gone when this callback runs ...
+                        std::lock_guard<std::mutex> lock(liveness->mutex_);
+                        if ( false == liveness->alive_ ) {
+                            return;
+                        }
+                        Flush(group, id);
+                    }, batcher_.config().window_);
+                }
+                it->second.members_.push_back(std::make_pair(a_args, a_deferred));
+                if ( it->second.members_.size() >= batcher_.config().max_items_ ) {
+                    Flush(group, it->second.id_);
+                }
+                return true;
+            }
+            
+            /**
+             * @brief Merge and launch the requests held by a bucket.
+             *
+             * @param a_group Batch group.
+             * @param a_id    Bucket ID.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Flush (const std::string& a_group, const uint64_t a_id)
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                const auto it = buckets_.find(a_group);
+                if ( buckets_.end() == it || a_id != it->second.id_ ) {
+                    // ... already flushed ...
+                    return;
+                }
+                const BatchMembers members = it->second.members_;
+                buckets_.erase(it);
+                Deferred<A>* bulk = nullptr;
+                if ( members.size() > 1 ) {
+                    try {
+                        bulk = Merge(a_group, members, "batch-" + std::to_string(a_id));
+                    } catch (...) {
+                        try {
+                            ::cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
+                        } catch (const ::cc::Exception& a_cc_exception) {
+                            callbacks_.on_log_tracking_(members[0].second->tracking_, CC_JOB_LOG_LEVEL_ERR, CC_JOB_LOG_STEP_ERROR,
+                                                        "Batch  : " + std::string(a_cc_exception.what())
+                            );
+                        }
+                        bulk = nullptr;
+                    }
+                }
+                if ( nullptr == bulk ) {
+                    // ... not merged, performed one by one ...
+                    for ( auto& member : members ) {
+                        Submit(member.first, member.second);
+                    }
+                    return;
+                }
+                batcher_.Account(members.size(), /* a_full */ members.size() >= batcher_.config().max_items_);
+                const auto& stats = batcher_.stats();
+                callbacks_.on_log_tracking_(bulk->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                            "Batch  : " + bulk->id_ + " merged " + std::to_string(members.size()) + " requests, "
+                                            + std::to_string(stats.items_) + " requests in " + std::to_string(stats.batches_) + " calls"
+                );
+                // ... members wait for merged request response ...
+                bulks_.insert(std::make_pair(bulk, Bulk({ a_group, members })));
+                for ( auto& member : members ) {
+                    member.second->Attach(member.first, callbacks_);
+                    // ... merged request is bound by the earliest deadline ...
+                    const auto& deadline = member.second->deadline_;
+                    if ( std::chrono::steady_clock::time_point() != deadline && ( std::chrono::steady_clock::time_point() == bulk->deadline_ || deadline < bulk->deadline_ ) ) {
+                        bulk->deadline_ = deadline;
+                    }
+                }
+                Bind(bulk);
+                Submit(members[0].first, bulk);
+            }
+            
+            /**
+             * @brief Split a merged request response and deliver it to it's members.
+             *
+             * @param a_deferred Completed request.
+             *
+             * @return True if request was a merged one.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Scatter (const Deferred<A>* a_deferred)
+            {
+                const auto it = bulks_.find(a_deferred);
+                if ( bulks_.end() == it ) {
+                    return false;
+                }
+                const Bulk      bulk     = it->second;
+                const Response& response = a_deferred->response();
+                bulks_.erase(it);
+                std::vector<Response> responses(bulk.members_.size());
+                Response              failure;
+                bool                  failed = false;
+                try {
+                    if ( nullptr != response.exception() || response.code() >= 400 ) {
+                        // ... merged request failed as a whole, so did all of it's members ...
+                        for ( auto& member_response : responses ) {
+                            member_response = response;
+                        }
+                    } else {
+                        Split(bulk.group_, bulk.members_, response, responses);
+                        if ( responses.size() != bulk.members_.size() ) {
+                            throw ::cc::Exception("Batch split produced " SIZET_FMT " responses for " SIZET_FMT " requests!", responses.size(), bulk.members_.size());
+                        }
+                    }
+                } catch (...) {
+                    try {
+                        ::cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
+                    } catch (const ::cc::Exception& a_cc_exception) {
+                        failure.Set(CC_STATUS_CODE_INTERNAL_SERVER_ERROR, a_cc_exception);
+                        failed = true;
+                    }
+                }
+                for ( size_t idx = 0 ; idx < bulk.members_.size() ; ++idx ) {
+                    bulk.members_[idx].second->Deliver(( true == failed ? failure : responses[idx] ));
+                }
+                return true;
+            }
+            
+            /**
+             * @brief A merged request is being disposed without completing, it's members fail.
+             *
+             * @param a_deferred Request being disposed.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Disband (const Deferred<A>* a_deferred)
+            {
+                const auto it = bulks_.find(a_deferred);
+                if ( bulks_.end() == it ) {
+                    return;
+                }
+                Response response;
+                response.Set(CC_STATUS_CODE_INTERNAL_SERVER_ERROR, ::cc::Exception("Batched request '%s' was abandoned!", a_deferred->id_.c_str()));
+                const BatchMembers members = it->second.members_;
+                bulks_.erase(it);
+                for ( auto& member : members ) {
+                    member.second->Deliver(response);
+                }
+            }
+        
+            // MARK: - Balancing
+            
+            /**
+             * @brief Point a request, about to be launched, to the endpoint picked by the \link Balancer \link.
+             *
+             * @param a_deferred Request to route.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Assign (Deferred<A>* a_deferred)
+            {
+                if ( false == balancer_.enabled() ) {
+                    return;
+                }
+                const size_t index = balancer_.Pick();
+                if ( false == Route(a_deferred, balancer_.endpoints()[index].url_) ) {
+                    balancer_.Abort(index);
+                    return;
+                }
+                routes_[a_deferred] = index;
+                callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_DBG, CC_JOB_LOG_STEP_STATS,
+                                            "Route  : " + a_deferred->id_ + " -> " + balancer_.endpoints()[index].url_
+                                            + ", outstanding " + std::to_string(balancer_.endpoints()[index].outstanding_)
+                );
+            }
+            
+            /**
+             * @brief Feed a disposed request outcome to the \link Balancer \link, unhealthy endpoints are ejected.
+             *
+             * @param a_deferred Request being disposed.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Resolve (const Deferred<A>* a_deferred)
+            {
+                const auto it = routes_.find(a_deferred);
+                if ( routes_.end() == it ) {
+                    return;
+                }
+                const size_t index = it->second;
+                routes_.erase(it);
+                // ... cancelled requests have no outcome ...
+                if ( true == a_deferred->guard_->cancelled_ ) {
+                    balancer_.Abort(index);
+                    return;
+                }
+                const Response& response = a_deferred->response();
+                const Balancer::Endpoint& endpoint = balancer_.endpoints()[index];
+                const bool ejected = endpoint.ejected_;
+                balancer_.Release(index, response.rtt(),
+                                  /* a_failed */ ( nullptr != response.exception() || CC_STATUS_CODE_TOO_MANY_REQUESTS == response.code() || response.code() >= 500 )
+                );
+                if ( ejected != endpoint.ejected_ ) {
+                    callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                "Balance: " + endpoint.url_ + ( true == endpoint.ejected_ ? " ejected after " + std::to_string(endpoint.errors_) + " consecutive errors" : " re-admitted" )
+                    );
+                }
+            }
+        
+            // MARK: - Circuit Breaker
+            
+            /**
+             * @brief Check if a request can be sent to the backend, if not it fails immediately.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request about to be dispatched or launched.
+             * @param a_trial    True when request is about to be sent, only then it takes an half-open trial.
+             *
+             * @return True if request can proceed, false if it was rejected.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Allow (const A& a_args, Deferred<A>* a_deferred, const bool a_trial)
+            {
+                if ( false == breaker_.enabled() ) {
+                    return true;
+                }
+                const Breaker::State state   = breaker_.stats().state_;
+                const bool           allowed = ( true == a_trial ? breaker_.Allow() : breaker_.Permit() );
+                if ( state != breaker_.stats().state_ ) {
+                    callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                "Breaker: " + std::string(Breaker::Name(state)) + " -> " + Breaker::Name(breaker_.stats().state_)
+                    );
+                }
+                if ( false == allowed ) {
+                    // ... never sent, it's limiter slot ( if any ) has no outcome ...
+                    if ( 1 == admitted_.erase(a_deferred) ) {
+                        limiter_.Abort();
+                    }
+                    // ... fail fast, don't wait for a timeout ...
+                    a_deferred->Reject(a_args, callbacks_, CC_STATUS_CODE_SERVICE_UNAVAILABLE, "Circuit breaker is open, backend unavailable!");
+                }
+                return allowed;
+            }
+            
+            /**
+             * @brief Feed a disposed request outcome to the \link Breaker \link.
+             *
+             * @param a_deferred Request being disposed.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Judge (const Deferred<A>* a_deferred)
+            {
+                // ... not sent or cancelled requests have no outcome ...
+                if ( 0 == sent_.erase(a_deferred) || true == a_deferred->guard_->cancelled_ ) {
+                    return;
+                }
+                const Response&      response = a_deferred->response();
+                const Breaker::State state    = breaker_.stats().state_;
+                breaker_.Record(response.rtt(), /* a_failed */ ( nullptr != response.exception() || response.code() >= 500 ));
+                if ( state != breaker_.stats().state_ ) {
+                    const auto& stats = breaker_.stats();
+                    callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                                "Breaker: " + std::string(Breaker::Name(state)) + " -> " + Breaker::Name(stats.state_)
+                                                + ", error rate " + std::to_string(static_cast<int>(stats.error_rate_ * 100.0)) + "%, slow rate "
+                                                + std::to_string(static_cast<int>(stats.slow_rate_ * 100.0)) + "%, " + std::to_string(stats.trips_) + " trips"
+                    );
+                }
+            }
+        
+            // MARK: - Throttling
+            
+            /**
+             * @brief Hold a request until it gets a \link Throttle \link token, requests of the same tenant are served in order.
+             *
+             * @param a_args     Request specific arguments.
+             * @param a_deferred Request about to be launched.
+             *
+             * @return True if request is held ( or rejected ) and must not be launched now.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Hold (const A& a_args, Deferred<A>* a_deferred)
+            {
+                if ( false == throttle_.enabled() ) {
+                    return false;
+                }
+                const std::string tenant = Tenant(a_args, a_deferred);
+                // ... don't overtake requests already waiting, a timer is already pending for them ...
+                if ( paced_.end() == paced_.find(tenant) ) {
+                    const size_t delay = throttle_.Take(tenant);
+                    if ( 0 == delay ) {
+                        return false;
+                    }
+                    if ( delay > throttle_.config().max_wait_ ) {
+                        throttle_.Expire();
+                        a_deferred->Reject(a_args, callbacks_, CC_STATUS_CODE_TOO_MANY_REQUESTS, "Rate limit exceeded, try again later!");
+                        return true;
+                    }
+                    Wake(delay);
+                }
+                paced_[tenant].push_back(Paced({ a_args, a_deferred, std::chrono::steady_clock::now() }));
+                pacing_++;
+                Mind(a_deferred);
+                throttle_.Delay();
+                return true;
+            }
+            
+            /**
+             * @brief Launch waiting requests that got a token, one per tenant per round so that no tenant starves others,
+             *        and reject the ones that waited too long.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Pace ()
+            {
+                CC_DEBUG_FAIL_IF_NOT_AT_THREAD(thread_id_);
+                pacer_ = 0;
+                const auto max_wait = std::chrono::milliseconds(throttle_.config().max_wait_);
+                size_t     next     = 0;
+                bool       progress = true;
+                while ( true == progress ) {
+                    progress = false;
+                    for ( auto it = paced_.begin() ; paced_.end() != it ; ) {
+                        const Paced& head   = it->second.front();
+                        const auto   waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - head.queued_at_);
+                        size_t       delay  = 0;
+                        if ( waited < max_wait ) {
+                            delay = throttle_.Take(it->first);
+                            if ( 0 != delay ) {
+                                // ... wait for a token, but not beyond deadline ...
+                                delay = std::min(delay, static_cast<size_t>(( max_wait - waited ).count()) + 1);
+                                next  = ( 0 == next ? delay : std::min(next, delay) );
+                                ++it;
+                                continue;
+                            }
+                        }
+                        const Paced paced = head;
+                        it->second.pop_front();
+                        pacing_--;
+                        if ( 0 == it->second.size() ) {
+                            it = paced_.erase(it);
+                        } else {
+                            ++it;
+                        }
+                        progress = true;
+                        if ( waited >= max_wait ) {
+                            throttle_.Expire();
+                            paced.deferred_->Reject(paced.args_, callbacks_, CC_STATUS_CODE_TOO_MANY_REQUESTS, "Rate limit exceeded, request waited too long!");
+                            continue;
+                        }
+                        paced.deferred_->waited_ = static_cast<size_t>(waited.count());
+                        try {
+                            Acquire(paced.args_, paced.deferred_);
+                        } catch (...) {
+                            // ... job was already deferred, failure must be delivered as a response ...
+                            try {
+                                ::cc::Exception::Rethrow(/* a_unhandled */ false, __FILE__, __LINE__, __FUNCTION__);
+                            } catch (const ::cc::Exception& a_cc_exception) {
+                                paced.deferred_->Reject(paced.args_, callbacks_, CC_STATUS_CODE_INTERNAL_SERVER_ERROR, a_cc_exception.what());
+                            }
+                        }
+                    }
+                }
+                if ( 0 != next ) {
+                    Wake(next);
+                }
+            }
+            
+            /**
+             * @brief Make sure \link Pace \link runs within a given delay, a single timer is kept.
+             *
+             * @param a_delay In ms.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Wake (const size_t a_delay)
+            {
+                const auto at = std::chrono::steady_clock::now() + std::chrono::milliseconds(a_delay);
+                if ( 0 != pacer_ && pace_at_ <= at ) {
+                    // ... pending timer fires soon enough ...
+                    return;
+                }
+                const uint64_t id = ++pace_;
+                pacer_   = id;
+                pace_at_ = at;
+                const auto liveness = liveness_;
+                callbacks_.on_main_thread_deferred_([this, liveness, id] () {
+                    // ... dispatcher might be gone when this callback runs ...
+                    std::lock_guard<std::mutex> lock(liveness->mutex_);
+                    if ( false == liveness->alive_ ) {
+                        return;
+                    }
+                    // ... superseded?
+                    if ( id == pacer_ ) {
+                        Pace();
+                    }
+                }, a_delay);
+            }
+            
+            // MARK: - Keep-alive
+            
+            /**
+             * @brief Touch, in a single batch, all jobs that are ( or soon will be ) close to TTR expiry.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Tend ()
+            {
+                tender_ = 0;
+                std::vector<uint64_t> ids;
+                keeper_.Due(ids);
+                if ( 0 != ids.size() ) {
+                    const auto liveness = liveness_;
+                    touch_(ids, [this, liveness] (const uint64_t& a_id, const bool a_ok) {
+                        // ... dispatcher might be gone when touch completes ...
+                        std::lock_guard<std::mutex> lock(liveness->mutex_);
+                        if ( false == liveness->alive_ ) {
+                            return;
+                        }
+                        keeper_.Touched(a_id, a_ok);
+                        if ( false == a_ok && nullptr != callbacks_.on_log_tracking_ ) {
+                            callbacks_.on_log_tracking_({ a_id, "", "", "", "", "" }, CC_JOB_LOG_LEVEL_WRN, CC_JOB_LOG_STEP_STATS,
+                                                        "Touch failed, job is no longer kept alive"
+                            );
+                        }
+                        Watch();
+                    });
+                }
+                Watch();
+            }
+            
+            /**
+             * @brief Make sure \link Tend \link runs when next job is due, a single timer is kept.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Watch ()
+            {
+                const size_t delay = keeper_.Next();
+                if ( std::numeric_limits<size_t>::max() == delay ) {
+                    return;
+                }
+                const auto at = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+                if ( 0 != tender_ && tend_at_ <= at ) {
+                    // ... pending timer fires soon enough ...
+                    return;
+                }
+                const uint64_t id = ++tend_;
+                tender_  = id;
+                tend_at_ = at;
+                const auto liveness = liveness_;
+                callbacks_.on_main_thread_deferred_([this, liveness, id] () {
+                    // ... dispatcher might be gone when this callback runs ...
+                    std::lock_guard<std::mutex> lock(liveness->mutex_);
+                    if ( false == liveness->alive_ ) {
+                        return;
+                    }
+                    // ... superseded?
+                    if ( id == tender_ ) {
+                        Tend();
+                    }
+                }, delay);
+            }
+            
+            // MARK: - Deadlines
+            
+            /**
+             * @brief Bind a request to it's job deadline ( if any ) and remember job's channel, if it was not \link Enlist \link -ed.
+             *
+             * @param a_deferred Request being dispatched.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Stamp (Deferred<A>* a_deferred)
+            {
+                const auto it = deadlines_.find(a_deferred->tracking_.bjid_);
+                if ( deadlines_.end() != it ) {
+                    a_deferred->deadline_ = it->second;
+                }
+                if ( 0 != a_deferred->tracking_.rcid_.length() && jobs_.end() == jobs_.find(a_deferred->tracking_.bjid_) ) {
+                    jobs_[a_deferred->tracking_.bjid_]     = a_deferred->tracking_.rcid_;
+                    channels_[a_deferred->tracking_.rcid_] = a_deferred->tracking_.bjid_;
+                }
+            }
+            
+            /**
+             * @brief Make sure a queued or launched request is reaped once it's deadline ( if any ) passes.
+             *
+             * @param a_deferred Request to watch.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Mind (Deferred<A>* a_deferred)
+            {
+                if ( std::chrono::steady_clock::time_point() == a_deferred->deadline_ ) {
+                    return;
+                }
+                expiring_.insert(std::make_pair(a_deferred->deadline_, a_deferred));
+                Rearm();
+            }
+            
+            /**
+             * @brief Pass remaining time to a request about to be launched and make sure it's reaped once it's deadline passes.
+             *
+             * @param a_deferred Request about to be launched.
+             *
+             * @return False if deadline already passed, request must not be launched.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Bound (Deferred<A>* a_deferred)
+            {
+                if ( std::chrono::steady_clock::time_point() == a_deferred->deadline_ ) {
+                    return true;
+                }
+                const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(a_deferred->deadline_ - std::chrono::steady_clock::now()).count();
+                if ( remaining <= 0 ) {
+                    return false;
+                }
+                Budget(a_deferred, static_cast<size_t>(remaining));
+                Mind(a_deferred);
+                return true;
+            }
+            
+            /**
+             * @brief Fail a request whose deadline passed.
+             *
+             * @param a_deferred Expired request.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Expire (Deferred<A>* a_deferred)
+            {
+                expired_++;
+                if ( false == a_deferred->Tracked() ) {
+                    overdue_++;
+                }
+                callbacks_.on_log_tracking_(a_deferred->tracking_, CC_JOB_LOG_LEVEL_INF, CC_JOB_LOG_STEP_STATS,
+                                            "Expire : " + a_deferred->id_ + " deadline exceeded, " + std::to_string(expired_) + " expired, "
+                                            + std::to_string(overdue_) + " before launch"
+                );
+                Terminate(a_deferred, CC_STATUS_CODE_GATEWAY_TIMEOUT, "Deadline exceeded");
+            }
+            
+            /**
+             * @brief Fail a request before it completes: a queued one leaves it's queue, a launched one has it's backend work
+             *        cancelled and it's slot released.
+             *
+             * @param a_deferred Request to fail.
+             * @param a_code     Status code to fail with.
+             * @param a_reason   Why it's failing.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Terminate (Deferred<A>* a_deferred, const uint16_t a_code, const std::string& a_reason)
+            {
+                if ( false == a_deferred->Tracked() ) {
+                    // ... still queued, never reached the backend; elements are not assignable so pacing queues are rebuilt ...
+                    const auto position = positions_.find(a_deferred);
+                    if ( positions_.end() != position ) {
+                        const auto it   = waiting_.find(position->second);
+                        const A    args = it->second.first;
+                        positions_.erase(position);
+                        waiting_.erase(it);
+                        a_deferred->Reject(args, callbacks_, a_code, a_reason + " while waiting for a slot!");
+                        return;
+                    }
+                    for ( auto tenant = paced_.begin() ; paced_.end() != tenant ; ++tenant ) {
+                        for ( const auto& paced : tenant->second ) {
+                            if ( a_deferred == paced.deferred_ ) {
+                                const A args = paced.args_;
+                                std::deque<Paced> kept;
+                                for ( const auto& other : tenant->second ) {
+                                    if ( a_deferred != other.deferred_ ) {
+                                        kept.push_back(other);
+                                    }
+                                }
+                                if ( 0 == kept.size() ) {
+                                    paced_.erase(tenant);
+                                } else {
+                                    tenant->second.swap(kept);
+                                }
+                                pacing_--;
+                                a_deferred->Reject(args, callbacks_, a_code, a_reason + " while waiting for a token!");
+                                return;
+                            }
+                        }
+                    }
+                    return;
+                }
+                // ... pending callbacks won't run and a late response won't be delivered ...
+                a_deferred->Cancel();
+                a_deferred->response_.Set(a_code, ::cc::Exception("%s, request '%s' terminated!", a_reason.c_str(), a_deferred->id_.c_str()));
+                if ( nullptr != callbacks_.on_completed_ ) {
+                    callbacks_.on_completed_(a_deferred);
+                }
+                a_deferred->Untrack();
+            }
+            
+            /**
+             * @brief Fail all queued and launched requests of a job with '499', requests shared with others are spared.
+             *
+             * @param a_id     Job ID.
+             * @param a_reason Why they are failing.
+             *
+             * @return Number of requests failed.
+             */
+            template <class A>
+            inline size_t Dispatcher<A>::Cull (const uint64_t& a_id, const std::string& a_reason)
+            {
+                // ... pick requests first, failing one might dispose others ...
+                std::vector<Deferred<A>*> queued;
+                for ( const auto& entry : waiting_ ) {
+                    if ( a_id == entry.second.second->tracking_.bjid_ ) {
+                        queued.push_back(entry.second.second);
+                    }
+                }
+                for ( const auto& tenant : paced_ ) {
+                    for ( const auto& paced : tenant.second ) {
+                        if ( a_id == paced.deferred_->tracking_.bjid_ ) {
+                            queued.push_back(paced.deferred_);
+                        }
+                    }
+                }
+                std::vector<std::string> launched;
+                for ( const auto& entry : running_ ) {
+                    // ... requests serving, or served by, others complete as usual ...
+                    if ( a_id == entry.second->tracking_.bjid_ && false == Shared(entry.second) ) {
+                        launched.push_back(entry.first);
+                    }
+                }
+                size_t count = 0;
+                for ( auto deferred : queued ) {
+                    Terminate(deferred, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED, a_reason);
+                    count++;
+                }
+                for ( const auto& id : launched ) {
+                    const auto it = running_.find(id);
+                    if ( running_.end() == it ) {
+                        // ... e.g. hedge loser disposed along with it's race winner ...
+                        continue;
+                    }
+                    Terminate(it->second, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED, a_reason);
+                    count++;
+                }
+                return count;
+            }
+            
+            /**
+             * @return True if a request is a merged request ( or one of it's members ), a coalesced follower or a leader with followers.
+             *
+             * @param a_deferred Request to check.
+             */
+            template <class A>
+            inline bool Dispatcher<A>::Shared (const Deferred<A>* a_deferred) const
+            {
+                if ( bulks_.end() != bulks_.find(a_deferred) ) {
+                    return true;
+                }
+                for ( const auto& bulk : bulks_ ) {
+                    for ( const auto& member : bulk.second.members_ ) {
+                        if ( a_deferred == member.second ) {
+                            return true;
+                        }
+                    }
+                }
+                for ( const auto& flight : flights_ ) {
+                    if ( a_deferred == flight.second.leader_ && 0 != flight.second.followers_.size() ) {
+                        return true;
+                    }
+                    for ( const auto follower : flight.second.followers_ ) {
+                        if ( a_deferred == follower ) {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+            
+            /**
+             * @brief Fail all launched requests whose deadline passed.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Reap ()
+            {
+                reaper_ = 0;
+                const auto now = std::chrono::steady_clock::now();
+                while ( 0 != expiring_.size() && expiring_.begin()->first <= now ) {
+                    Deferred<A>* deferred = expiring_.begin()->second;
+                    expiring_.erase(expiring_.begin());
+                    // ... completing it might dispose others, they leave expiring set when untracked ...
+                    Expire(deferred);
+                }
+                Rearm();
+            }
+            
+            /**
+             * @brief Make sure \link Reap \link runs when next deadline passes, a single timer is kept.
+             */
+            template <class A>
+            inline void Dispatcher<A>::Rearm ()
+            {
+                if ( 0 == expiring_.size() ) {
+                    return;
+                }
+                const auto at = expiring_.begin()->first;
+                if ( 0 != reaper_ && reap_at_ <= at ) {
+                    // ... pending timer fires soon enough ...
+                    return;
+                }
+                const auto     remaining = std::chrono::duration_cast<std::chrono::milliseconds>(at - std::chrono::steady_clock::now()).count() + 1;
+                const size_t   delay     = ( remaining > 0 ? static_cast<size_t>(remaining) : 0 );
+                const uint64_t id        = ++reap_;
+                reaper_  = id;
+                reap_at_ = at;
+                const auto liveness = liveness_;
+                callbacks_.on_main_thread_deferred_([this, liveness, id] () {
+                    // ... dispatcher might be gone when this callback runs ...
+                    std::lock_guard<std::mutex> lock(liveness->mutex_);
+                    if ( false == liveness->alive_ ) {
+                        return;
+                    }
+                    // ... superseded?
+                    if ( id == reaper_ ) {
+                        Reap();
+                    }
+                }, delay);
+            }
         
         } // end of namespace 'deferrable'
     
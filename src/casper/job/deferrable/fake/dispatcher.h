@@ -0,0 +1,407 @@
+/**
+ * @file dispatcher.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_FAKE_DISPATCHER_H_
+#define CASPER_JOB_DEFERRABLE_FAKE_DISPATCHER_H_
+
+#include "casper/job/deferrable/dispatcher.h"
+
+#include "cc/easy/json.h"
+
+#include <random>
+#include <memory>    // std::shared_ptr
+#include <cmath>     // std::log
+#include <strings.h> // strncasecmp
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            namespace fake
+            {
+
+                /**
+                 * @brief Backend behaviour to simulate.
+                 */
+                typedef struct {
+                    enum class Distribution : uint8_t {
+                        Fixed = 0, //!< Always \link latency_ \link.
+                        LogNormal, //!< Median \link latency_ \link, shape \link sigma_ \link.
+                        Bimodal    //!< \link latency_ \link or, with \link slow_ratio_ \link probability, \link slow_latency_ \link.
+                    };
+                    Distribution distribution_;
+                    double       latency_;      //!< In ms.
+                    double       sigma_;
+                    double       slow_latency_; //!< In ms.
+                    double       slow_ratio_;   //!< 0..1
+                    double       error_rate_;   //!< 0..1
+                    uint16_t     error_code_;
+                    size_t       body_size_;    //!< In bytes.
+                    std::string  content_type_;
+                    uint64_t     seed_;
+                } Profile;
+
+                /**
+                 * @brief Outcome of a simulated request, drawn at dispatch time so that a run is reproducible for a given seed.
+                 */
+                typedef struct {
+                    size_t   delay_; //!< In ms.
+                    uint16_t code_;
+                } Outcome;
+
+                template <class A>
+                class Deferred final : public ::casper::job::deferrable::Deferred<A>
+                {
+
+                private: // Data
+
+                    const Outcome                            outcome_;
+                    const std::string                        content_type_;
+                    const std::shared_ptr<const std::string> body_; //!< Shared with dispatcher, outlives a later \link Dispatcher::Setup \link.
+
+                public: // Constructor(s) / Destructor
+
+                    Deferred () = delete;
+
+                    /**
+                     * @brief Default constructor.
+                     *
+                     * @param a_id           Request ID, if empty tracking RCID will be used.
+                     * @param a_tracking     Request tracking info.
+                     * @param a_outcome      Simulated outcome.
+                     * @param a_content_type Simulated response Content-Type.
+                     * @param a_body         Simulated response body.
+                     */
+                    Deferred (const std::string& a_id, const Tracking& a_tracking,
+                              const Outcome& a_outcome, const std::string& a_content_type, const std::shared_ptr<const std::string>& a_body
+                              CC_IF_DEBUG_CONSTRUCT_APPEND_VAR(const cc::debug::Threading::ThreadID, a_thread_id))
+                        : ::casper::job::deferrable::Deferred<A>(a_id, a_tracking CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(a_thread_id)),
+                          outcome_(a_outcome), content_type_(a_content_type), body_(a_body)
+                    {
+                        /* empty */
+                    }
+
+                    /**
+                     * @brief Destructor.
+                     */
+                    virtual ~Deferred ()
+                    {
+                        /* empty */
+                    }
+
+                public: // Inherited Virtual Method(s) / Function(s) - from deferrable::Deferred<A>
+
+                    virtual void Run (const A& a_args, typename ::casper::job::deferrable::Deferred<A>::Callbacks a_callbacks);
+
+                }; // end of class 'Deferred'
+
+                /**
+                 * @brief Simulate a backend request.
+                 *
+                 * @param a_args      Request arguments.
+                 * @param a_callbacks See \link Deferred<A>::Callbacks \link.
+                 */
+                template <class A>
+                void Deferred<A>::Run (const A& a_args, typename ::casper::job::deferrable::Deferred<A>::Callbacks a_callbacks)
+                {
+                    using DeferredBaseClass = ::casper::job::deferrable::Deferred<A>;
+
+                    DeferredBaseClass::Bind(a_callbacks);
+                    DeferredBaseClass::arguments_ = new A(a_args);
+                    DeferredBaseClass::Track();
+                    // ... 'perform' request on looper thread, complete on main thread ...
+                    const auto guard = DeferredBaseClass::guard_;
+                    DeferredBaseClass::CallOnLooperThreadDeferred(DeferredBaseClass::id_, [this, guard] (const std::string& /* a_id */) {
+                        std::lock_guard<std::mutex> lock(guard->mutex_);
+                        if ( true == guard->cancelled_ ) {
+                            return;
+                        }
+                        if ( CC_STATUS_CODE_OK == outcome_.code_ ) {
+                            DeferredBaseClass::response_.Set(outcome_.code_, content_type_, *body_, outcome_.delay_,
+                                                             /* a_parse */ 0 == strncasecmp(content_type_.c_str(), "application/json", sizeof(char) * 16));
+                        } else {
+                            DeferredBaseClass::response_.Set(outcome_.code_, "application/json", "fake_error", "simulated backend error", outcome_.delay_);
+                        }
+                        DeferredBaseClass::CallOnMainThread([this, guard] () {
+                            if ( true == guard->cancelled_ ) {
+                                return;
+                            }
+                            DeferredBaseClass::OnCompleted(this);
+                            DeferredBaseClass::Untrack();
+                        });
+                    }, std::max(outcome_.delay_, static_cast<size_t>(1)));
+                }
+
+                template <class A>
+                class Dispatcher final : public ::casper::job::deferrable::Dispatcher<A>
+                {
+
+                public: // Data Type(s)
+
+                    typedef struct {
+                        uint64_t dispatched_;
+                        uint64_t failed_;
+                    } Stats;
+
+                private: // Data
+
+                    Profile                            profile_;
+                    std::mt19937_64                    engine_;
+                    std::shared_ptr<const std::string> body_;
+                    Stats                              stats_;
+
+                public: // Constructor(s) / Destructor
+
+                    Dispatcher (CC_IF_DEBUG_CONSTRUCT_DECLARE_VAR(const cc::debug::Threading::ThreadID, a_thread_id));
+                    virtual ~Dispatcher ();
+
+                public: // Inherited Virtual Method(s) / Function(s) - from deferrable::Dispatcher<A>
+
+                    virtual void Setup (const Json::Value& a_config);
+
+                protected: // Inherited Virtual Method(s) / Function(s) - from deferrable::Dispatcher<A>
+
+                    virtual bool                                    Idempotent (const ::casper::job::deferrable::Deferred<A>* a_deferred) const;
+                    virtual ::casper::job::deferrable::Deferred<A>* Duplicate  (const ::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_id);
+
+                public: // Method(s) / Function(s)
+
+                    void Setup   (const Profile& a_profile);
+                    void Perform (const Tracking& a_tracking, const A& a_args, const std::string& a_id = "");
+
+                public: // Static Method(s) / Function(s)
+
+                    static Profile Load (const Json::Value& a_config);
+
+                private: // Method(s) / Function(s)
+
+                    Outcome Draw ();
+
+                public: // Inline Method(s) / Function(s)
+
+                    /**
+                     * @return R/O access to \link Stats \link.
+                     */
+                    inline const Stats& stats () const
+                    {
+                        return stats_;
+                    }
+
+                }; // end of class 'Dispatcher'
+
+                /**
+                 * @brief Default constructor.
+                 *
+                 * param a_thread_id For debug purposes only
+                 */
+                template <class A>
+                Dispatcher<A>::Dispatcher (CC_IF_DEBUG_CONSTRUCT_DECLARE_VAR(const cc::debug::Threading::ThreadID, a_thread_id))
+                    : ::casper::job::deferrable::Dispatcher<A>(CC_IF_DEBUG(a_thread_id))
+                {
+                    stats_ = { 0, 0 };
+                    Setup(Load(Json::Value::null));
+                }
+
+                /**
+                 * @brief Destructor.
+                 */
+                template <class A>
+                Dispatcher<A>::~Dispatcher ()
+                {
+                    /* empty */
+                }
+
+                /**
+                 * @brief One-shot setup.
+                 *
+                 * @param a_config JSON object, simulation is configured by it's 'fake-dispatcher' object ( if any ).
+                 */
+                template <class A>
+                void Dispatcher<A>::Setup (const Json::Value& a_config)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    const ::cc::easy::JSON<::cc::Exception> json;
+                    Setup(Load(json.Get(a_config, "fake-dispatcher", Json::ValueType::objectValue, &Json::Value::null)));
+                }
+
+                /**
+                 * @brief Setup from a profile.
+                 *
+                 * @param a_profile See \link Profile \link.
+                 */
+                template <class A>
+                void Dispatcher<A>::Setup (const Profile& a_profile)
+                {
+                    profile_ = a_profile;
+                    engine_.seed(profile_.seed_);
+                    // ... pre-build body, shared by all requests ...
+                    if ( 0 == strncasecmp(profile_.content_type_.c_str(), "application/json", sizeof(char) * 16) ) {
+                        const size_t overhead = sizeof("{\"data\":\"\"}") - 1;
+                        body_ = std::make_shared<const std::string>("{\"data\":\"" + std::string(profile_.body_size_ > overhead ? profile_.body_size_ - overhead : 0, 'x') + "\"}");
+                    } else {
+                        body_ = std::make_shared<const std::string>(profile_.body_size_, 'x');
+                    }
+                }
+
+                /**
+                 * @brief Create, track and launch a simulated request.
+                 *
+                 * @param a_tracking Request tracking info.
+                 * @param a_args     Request arguments.
+                 * @param a_id       Request ID, if empty tracking RCID will be used.
+                 */
+                template <class A>
+                void Dispatcher<A>::Perform (const Tracking& a_tracking, const A& a_args, const std::string& a_id)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    const Outcome outcome = Draw();
+                    stats_.dispatched_++;
+                    if ( CC_STATUS_CODE_OK != outcome.code_ ) {
+                        stats_.failed_++;
+                    }
+                    ::casper::job::deferrable::Dispatcher<A>::Dispatch(a_args,
+                        new Deferred<A>(a_id, a_tracking, outcome, profile_.content_type_, body_
+                                        CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(::casper::job::deferrable::Dispatcher<A>::thread_id_))
+                    );
+                }
+
+                /**
+                 * @brief Simulated requests have no side effects, all of them can be hedged.
+                 *
+                 * @param a_deferred Request to check.
+                 */
+                template <class A>
+                bool Dispatcher<A>::Idempotent (const ::casper::job::deferrable::Deferred<A>* /* a_deferred */) const
+                {
+                    return true;
+                }
+
+                /**
+                 * @brief Create a duplicate of a simulated request, it's outcome is drawn independently.
+                 *
+                 * @param a_deferred Request to duplicate.
+                 * @param a_id       Duplicate request ID.
+                 *
+                 * @return New request, not launched yet.
+                 */
+                template <class A>
+                ::casper::job::deferrable::Deferred<A>* Dispatcher<A>::Duplicate (const ::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_id)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    const Outcome outcome = Draw();
+                    stats_.dispatched_++;
+                    if ( CC_STATUS_CODE_OK != outcome.code_ ) {
+                        stats_.failed_++;
+                    }
+                    return new Deferred<A>(a_id, a_deferred->tracking_, outcome, profile_.content_type_, body_
+                                           CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(::casper::job::deferrable::Dispatcher<A>::thread_id_));
+                }
+
+                /**
+                 * @brief Load a simulation profile from it's JSON representation.
+                 *
+                 * @param a_config JSON object, null for defaults.
+                 *
+                 * @return See \link Profile \link.
+                 */
+                template <class A>
+                Profile Dispatcher<A>::Load (const Json::Value& a_config)
+                {
+                    const ::cc::easy::JSON<::cc::Exception> json;
+
+                    const Json::Value c_distribution = "fixed";
+                    const Json::Value c_latency      = 10.0;
+                    const Json::Value c_sigma        = 0.5;
+                    const Json::Value c_slow_latency = 1000.0;
+                    const Json::Value c_slow_ratio   = 0.0;
+                    const Json::Value c_error_rate   = 0.0;
+                    const Json::Value c_error_code   = CC_STATUS_CODE_SERVICE_UNAVAILABLE;
+                    const Json::Value c_body_size    = 256;
+                    const Json::Value c_content_type = "application/json";
+                    const Json::Value c_seed         = 1;
+
+                    const Json::Value& config       = ( true == a_config.isObject() ? a_config : Json::Value::null );
+                    const std::string  distribution = json.Get(config, "distribution", Json::ValueType::stringValue, &c_distribution).asString();
+
+                    Profile profile;
+                    if ( "lognormal" == distribution ) {
+                        profile.distribution_ = Profile::Distribution::LogNormal;
+                    } else if ( "bimodal" == distribution ) {
+                        profile.distribution_ = Profile::Distribution::Bimodal;
+                    } else if ( "fixed" == distribution ) {
+                        profile.distribution_ = Profile::Distribution::Fixed;
+                    } else {
+                        throw ::cc::Exception("Unsupported fake dispatcher distribution '%s'!", distribution.c_str());
+                    }
+                    profile.latency_      = json.Get(config, "latency"     , Json::ValueType::realValue  , &c_latency).asDouble();
+                    profile.sigma_        = json.Get(config, "sigma"       , Json::ValueType::realValue  , &c_sigma).asDouble();
+                    profile.slow_latency_ = json.Get(config, "slow-latency", Json::ValueType::realValue  , &c_slow_latency).asDouble();
+                    profile.slow_ratio_   = json.Get(config, "slow-ratio"  , Json::ValueType::realValue  , &c_slow_ratio).asDouble();
+                    profile.error_rate_   = json.Get(config, "error-rate"  , Json::ValueType::realValue  , &c_error_rate).asDouble();
+                    profile.error_code_   = static_cast<uint16_t>(json.Get(config, "error-code", Json::ValueType::uintValue, &c_error_code).asUInt());
+                    profile.body_size_    = static_cast<size_t>(json.Get(config, "body-size", Json::ValueType::uintValue, &c_body_size).asUInt64());
+                    profile.content_type_ = json.Get(config, "content-type", Json::ValueType::stringValue, &c_content_type).asString();
+                    profile.seed_         = json.Get(config, "seed"        , Json::ValueType::uintValue  , &c_seed).asUInt64();
+                    return profile;
+                }
+
+                /**
+                 * @brief Draw the outcome of the next request.
+                 */
+                template <class A>
+                Outcome Dispatcher<A>::Draw ()
+                {
+                    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+                    double latency = profile_.latency_;
+                    switch (profile_.distribution_) {
+                        case Profile::Distribution::LogNormal:
+                        {
+                            std::lognormal_distribution<double> lognormal(std::log(std::max(profile_.latency_, 0.001)), profile_.sigma_);
+                            latency = lognormal(engine_);
+                        }
+                            break;
+                        case Profile::Distribution::Bimodal:
+                            latency = ( uniform(engine_) < profile_.slow_ratio_ ? profile_.slow_latency_ : profile_.latency_ );
+                            break;
+                        default:
+                            break;
+                    }
+                    const bool failed = ( profile_.error_rate_ > 0.0 && uniform(engine_) < profile_.error_rate_ );
+                    return {
+                        /* delay_ */ static_cast<size_t>(std::max(latency, 0.0) + 0.5),
+                        /* code_  */ ( true == failed ? profile_.error_code_ : static_cast<uint16_t>(CC_STATUS_CODE_OK) )
+                    };
+                }
+
+            } // end of namespace 'fake'
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_FAKE_DISPATCHER_H_
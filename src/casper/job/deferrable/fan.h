@@ -0,0 +1,254 @@
+/**
+ * @file fan.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_FAN_H_
+#define CASPER_JOB_DEFERRABLE_FAN_H_
+
+#include "casper/job/deferrable/types.h"
+#include "casper/job/deferrable/hedger.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Concurrent sub-requests of a single job, the job completes once a quorum of them succeeded or once that
+             *        quorum can no longer be reached.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Fan final
+            {
+
+            public: // Data Type(s)
+
+                typedef std::function<uint16_t(const std::vector<Response>&, Json::Value&)> Merge; //!< Sub-request responses, in fan-out order -> job response code.
+
+                enum class Outcome : uint8_t {
+                    Pending = 0, //!< Quorum still reachable, job has work to do.
+                    Settled,     //!< Quorum reached or unreachable, responses must be merged now.
+                    Ignored      //!< Duplicate, or late, completion.
+                };
+
+            private: // Const Data
+
+                const std::vector<std::string> ids_;
+                const size_t                   quorum_;
+                const Merge                    merge_;
+
+            private: // Data
+
+                std::vector<Response> responses_; //!< By \link ids_ \link index.
+                std::vector<bool>     done_;
+                size_t                completed_;
+                size_t                succeeded_;
+                bool                  settled_;   //!< True once job outcome is known, late sub-requests are just accounted.
+
+            public: // Constructor(s) / Destructor
+
+                Fan () = delete;
+                Fan (const std::string& a_prefix, const size_t a_count, const size_t a_quorum, Merge a_merge);
+                virtual ~Fan ();
+
+            public: // Method(s) / Function(s)
+
+                size_t  Find     (const std::string& a_id) const;
+                Outcome Complete (const size_t a_idx, const Response& a_response);
+
+            public: // Static Method(s) / Function(s)
+
+                static std::vector<std::string> IDs (const std::string& a_prefix, const size_t a_count);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return R/O access to sub-request IDs, in fan-out order.
+                 */
+                inline const std::vector<std::string>& ids () const
+                {
+                    return ids_;
+                }
+
+                /**
+                 * @return R/O access to sub-request responses, in fan-out order; once settled, the ones that did not complete
+                 *         are set as cancelled.
+                 */
+                inline const std::vector<Response>& responses () const
+                {
+                    return responses_;
+                }
+
+                /**
+                 * @return Function to call, once settled, with all responses.
+                 */
+                inline const Merge& merge () const
+                {
+                    return merge_;
+                }
+
+                /**
+                 * @return Number of sub-requests.
+                 */
+                inline size_t size () const
+                {
+                    return ids_.size();
+                }
+
+                /**
+                 * @return Number of completed sub-requests.
+                 */
+                inline size_t completed () const
+                {
+                    return completed_;
+                }
+
+                /**
+                 * @return True if job outcome is known.
+                 */
+                inline bool settled () const
+                {
+                    return settled_;
+                }
+
+                /**
+                 * @return True when all sub-requests completed, nothing left to account.
+                 */
+                inline bool finished () const
+                {
+                    return completed_ == ids_.size();
+                }
+
+            }; // end of class 'Fan'
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_prefix Sub-request IDs prefix, usually job's REDIS channel ID.
+             * @param a_count  Number of sub-requests.
+             * @param a_quorum Successful sub-requests required to complete job, within 1 and a_count.
+             * @param a_merge  Function to call once settled.
+             */
+            inline Fan::Fan (const std::string& a_prefix, const size_t a_count, const size_t a_quorum, Merge a_merge)
+                : ids_(IDs(a_prefix, a_count)), quorum_(a_quorum), merge_(a_merge)
+            {
+                if ( 0 == a_count || 0 == a_quorum || a_quorum > a_count || nullptr == a_merge ) {
+                    throw ::cc::Exception("%s", "Invalid fan-out, quorum must be within 1 and the number of sub-requests!");
+                }
+                responses_.resize(a_count);
+                done_.resize(a_count, false);
+                completed_ = 0;
+                succeeded_ = 0;
+                settled_   = false;
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Fan::~Fan ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @return Index of the sub-request a request is, \link size \link if none.
+             *
+             * @param a_id Request ID, an hedge that won it's race answers for it's primary.
+             */
+            inline size_t Fan::Find (const std::string& a_id) const
+            {
+                const std::string primary = Hedger::Primary(a_id);
+                size_t idx = 0;
+                while ( idx < ids_.size() && primary != ids_[idx] ) {
+                    idx++;
+                }
+                return idx;
+            }
+
+            /**
+             * @brief Account a completed sub-request.
+             *
+             * @param a_idx      Sub-request index.
+             * @param a_response Sub-request response.
+             *
+             * @return See \link Outcome \link.
+             */
+            inline Fan::Outcome Fan::Complete (const size_t a_idx, const Response& a_response)
+            {
+                if ( true == done_[a_idx] ) {
+                    return Outcome::Ignored;
+                }
+                done_[a_idx]      = true;
+                responses_[a_idx] = a_response;
+                completed_++;
+                if ( CC_STATUS_CODE_OK == a_response.code() && nullptr == a_response.exception() ) {
+                    succeeded_++;
+                }
+                if ( true == settled_ ) {
+                    return Outcome::Ignored;
+                }
+                // ... quorum reached or unreachable?
+                const size_t total = ids_.size();
+                if ( succeeded_ < quorum_ && succeeded_ + ( total - completed_ ) >= quorum_ ) {
+                    return Outcome::Pending;
+                }
+                settled_ = true;
+                for ( size_t other = 0 ; other < total ; ++other ) {
+                    if ( false == done_[other] ) {
+                        responses_[other].Set(CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED, ::cc::Exception("Sub-request '%s' no longer needed!", ids_[other].c_str()));
+                    }
+                }
+                return Outcome::Settled;
+            }
+
+            /**
+             * @return Sub-request IDs, "<prefix>#<index>".
+             *
+             * @param a_prefix Sub-request IDs prefix.
+             * @param a_count  Number of sub-requests.
+             */
+            inline std::vector<std::string> Fan::IDs (const std::string& a_prefix, const size_t a_count)
+            {
+                std::vector<std::string> rv;
+                for ( size_t idx = 0 ; idx < a_count ; ++idx ) {
+                    rv.push_back(a_prefix + "#" + std::to_string(idx));
+                }
+                return rv;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_FAN_H_
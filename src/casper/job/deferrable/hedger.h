@@ -0,0 +1,286 @@
+/**
+ * @file hedger.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_HEDGER_H_
+#define CASPER_JOB_DEFERRABLE_HEDGER_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <algorithm> // std::nth_element, std::max
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Decides when a slow request should be duplicated ( hedged ).
+             *
+             * Hedge delay is a percentile of recent RTT samples, hedges are capped to a fraction of all requests
+             * so that a backend wide slowdown does not double it's load.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Hedger final
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool   enabled_;
+                    double percentile_; //!< 0..100, RTT percentile after which a request is hedged.
+                    size_t min_delay_;  //!< In ms, hedge delay floor.
+                    double max_rate_;   //!< 0..1, maximum fraction of requests that can be hedged.
+                    size_t window_;     //!< Number of recent RTT samples to compute percentile from.
+                    size_t warm_up_;    //!< Number of samples required before hedging.
+                } Config;
+
+                typedef struct {
+                    uint64_t requests_;  //!< Requests eligible for hedging.
+                    uint64_t hedged_;    //!< Duplicates issued, each one is an extra backend request.
+                    uint64_t won_;       //!< Duplicates that completed first.
+                    size_t   delay_;     //!< Current hedge delay, in ms, 0 while warming up.
+                } Stats;
+
+            private: // Data
+
+                Config              config_;
+                std::vector<size_t> samples_;
+                size_t              next_;
+                size_t              pending_; //!< Samples since last delay computation.
+                Stats               stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Hedger ();
+                virtual ~Hedger ();
+
+            public: // Method(s) / Function(s)
+
+                void   Setup  (const Config& a_config);
+                size_t Track  ();
+                bool   Fire   ();
+                void   Won    ();
+                void   Sample (const size_t a_rtt);
+                void   Reset  ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config      Load    (const Json::Value& a_config);
+                static std::string Hedge   (const std::string& a_id);
+                static std::string Primary (const std::string& a_id);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if hedging is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Hedger'
+
+            /**
+             * @brief Default constructor, hedging is disabled.
+             */
+            inline Hedger::Hedger ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Hedger::~Hedger ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, resets all state.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Hedger::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Account a new request.
+             *
+             * @return Amount of time ( in ms ) to wait before hedging it, 0 if it should not be hedged.
+             */
+            inline size_t Hedger::Track ()
+            {
+                if ( false == config_.enabled_ ) {
+                    return 0;
+                }
+                stats_.requests_++;
+                return stats_.delay_;
+            }
+
+            /**
+             * @brief Check hedging budget before issuing a duplicate.
+             *
+             * @return True if a duplicate can be issued.
+             */
+            inline bool Hedger::Fire ()
+            {
+                if ( static_cast<double>(stats_.hedged_ + 1) > config_.max_rate_ * static_cast<double>(stats_.requests_) ) {
+                    return false;
+                }
+                stats_.hedged_++;
+                return true;
+            }
+
+            /**
+             * @brief Account a duplicate that completed before the original request.
+             */
+            inline void Hedger::Won ()
+            {
+                stats_.won_++;
+            }
+
+            /**
+             * @brief Add an RTT sample.
+             *
+             * @param a_rtt Request RTT, in ms.
+             */
+            inline void Hedger::Sample (const size_t a_rtt)
+            {
+                if ( false == config_.enabled_ ) {
+                    return;
+                }
+                if ( samples_.size() < config_.window_ ) {
+                    samples_.push_back(a_rtt);
+                } else {
+                    samples_[next_] = a_rtt;
+                    next_ = ( next_ + 1 ) % config_.window_;
+                }
+                // ... percentile is recomputed every 1/10 window, not on every sample ...
+                if ( samples_.size() < config_.warm_up_ || ++pending_ < std::max(config_.window_ / 10, static_cast<size_t>(1)) ) {
+                    return;
+                }
+                pending_ = 0;
+                std::vector<size_t> sorted = samples_;
+                const size_t        nth    = std::min(sorted.size() - 1, static_cast<size_t>(config_.percentile_ / 100.0 * static_cast<double>(sorted.size())));
+                std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(nth), sorted.end());
+                stats_.delay_ = std::max(sorted[nth], config_.min_delay_);
+            }
+
+            /**
+             * @brief Forget all samples and stats.
+             */
+            inline void Hedger::Reset ()
+            {
+                samples_.clear();
+                samples_.reserve(config_.window_);
+                next_    = 0;
+                pending_ = 0;
+                stats_   = { 0, 0, 0, 0 };
+            }
+
+            /**
+             * @brief Load an hedger configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for a disabled hedger.
+             *
+             * @return See \link Config \link.
+             */
+            inline Hedger::Config Hedger::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_percentile = 95.0;
+                const Json::Value c_min_delay  = 5;
+                const Json::Value c_max_rate   = 0.1;
+                const Json::Value c_window     = 1000;
+                const Json::Value c_warm_up    = 100;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                Config rv = {
+                    /* enabled_    */ ( false == config.isNull() ),
+                    /* percentile_ */ json.Get(config, "percentile", Json::ValueType::realValue, &c_percentile).asDouble(),
+                    /* min_delay_  */ static_cast<size_t>(json.Get(config, "min-delay", Json::ValueType::uintValue, &c_min_delay).asUInt64()),
+                    /* max_rate_   */ json.Get(config, "max-rate"  , Json::ValueType::realValue, &c_max_rate).asDouble(),
+                    /* window_     */ static_cast<size_t>(json.Get(config, "window"   , Json::ValueType::uintValue, &c_window).asUInt64()),
+                    /* warm_up_    */ static_cast<size_t>(json.Get(config, "warm-up"  , Json::ValueType::uintValue, &c_warm_up).asUInt64())
+                };
+                if ( rv.percentile_ <= 0.0 || rv.percentile_ >= 100.0 || rv.max_rate_ <= 0.0 || rv.max_rate_ > 1.0 || 0 == rv.window_ || 0 == rv.min_delay_ ) {
+                    throw ::cc::Exception("%s", "Invalid hedging configuration!");
+                }
+                rv.warm_up_ = std::max(std::min(rv.warm_up_, rv.window_), static_cast<size_t>(1));
+                return rv;
+            }
+
+            /**
+             * @return ID of an hedge issued for a request.
+             *
+             * @param a_id Primary request ID.
+             */
+            inline std::string Hedger::Hedge (const std::string& a_id)
+            {
+                return a_id + "-hedge";
+            }
+
+            /**
+             * @return ID of the request an hedge was issued for, \link a_id \link if it's not an hedge.
+             *
+             * @param a_id Request ID.
+             */
+            inline std::string Hedger::Primary (const std::string& a_id)
+            {
+                static const std::string s_suffix = "-hedge";
+                if ( a_id.length() > s_suffix.length() && 0 == a_id.compare(a_id.length() - s_suffix.length(), s_suffix.length(), s_suffix) ) {
+                    return a_id.substr(0, a_id.length() - s_suffix.length());
+                }
+                return a_id;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_HEDGER_H_
@@ -0,0 +1,579 @@
+/**
+ * @file dispatcher.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_HTTP_DISPATCHER_H_
+#define CASPER_JOB_DEFERRABLE_HTTP_DISPATCHER_H_
+
+#include "casper/job/deferrable/dispatcher.h"
+#include "casper/job/deferrable/http/pool.h"
+
+#include "cc/easy/json.h"
+
+#include <strings.h> // strcasecmp, strncasecmp
+#include <functional>
+#include <algorithm> // std::min, std::max
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            namespace http
+            {
+
+                typedef Pool::Request Request;
+
+                template <class A>
+                class Deferred final : public ::casper::job::deferrable::Deferred<A>
+                {
+
+                private: // Data
+
+                    Pool&         pool_;
+                    Request       request_;
+                    uint64_t      ticket_;
+
+                public: // Constructor(s) / Destructor
+
+                    Deferred () = delete;
+
+                    /**
+                     * @brief Default constructor.
+                     *
+                     * @param a_id       Request ID, if empty tracking RCID will be used.
+                     * @param a_tracking Request tracking info.
+                     * @param a_pool     Connection pool to perform request with, must outlive this object.
+                     * @param a_request  Request to perform.
+                     */
+                    Deferred (const std::string& a_id, const Tracking& a_tracking, Pool& a_pool, const Request& a_request
+                              CC_IF_DEBUG_CONSTRUCT_APPEND_VAR(const cc::debug::Threading::ThreadID, a_thread_id))
+                        : ::casper::job::deferrable::Deferred<A>(a_id, a_tracking CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(a_thread_id)),
+                          pool_(a_pool), request_(a_request), ticket_(0)
+                    {
+                        /* empty */
+                    }
+
+                    /**
+                     * @brief Destructor.
+                     */
+                    virtual ~Deferred ()
+                    {
+                        // ... a response might still be on it's way ...
+                        if ( 0 != ticket_ ) {
+                            pool_.Cancel(ticket_);
+                        }
+                    }
+
+                public: // Inherited Virtual Method(s) / Function(s) - from deferrable::Deferred<A>
+
+                    virtual void Run (const A& a_args, typename ::casper::job::deferrable::Deferred<A>::Callbacks a_callbacks);
+
+                protected: // Inherited Virtual Method(s) / Function(s) - from deferrable::Deferred<A>
+
+                    virtual void Cancel ();
+
+                public: // Inline Method(s) / Function(s)
+
+                    /**
+                     * @return R/O access to \link Request \link.
+                     */
+                    inline const Request& request () const
+                    {
+                        return request_;
+                    }
+
+                    /**
+                     * @brief Send request to another server, must be called before \link Run \link.
+                     *
+                     * @param a_origin Server origin, 'scheme://host[:port]', request path and query are kept.
+                     */
+                    inline void Retarget (const std::string& a_origin)
+                    {
+                        const size_t scheme = request_.url_.find("://");
+                        const size_t path   = ( std::string::npos != scheme ? request_.url_.find('/', scheme + 3) : request_.url_.find('/') );
+                        request_.url_ = a_origin + ( std::string::npos != path ? request_.url_.substr(path) : "" );
+                    }
+
+                    /**
+                     * @brief Make request conditional, must be called before \link Run \link.
+                     *
+                     * @param a_etag Entity tag of the cached response.
+                     */
+                    inline void Condition (const std::string& a_etag)
+                    {
+                        request_.headers_["If-None-Match"] = a_etag;
+                    }
+
+                    /**
+                     * @brief Limit request to the time left until it's deadline, must be called before \link Run \link.
+                     *
+                     * @param a_remaining Time left, in ms.
+                     * @param a_header    When not empty, name of the header that tells backend how much time ( in ms ) it has.
+                     */
+                    inline void Budget (const size_t a_remaining, const std::string& a_header)
+                    {
+                        const size_t timeout = ( request_.timeout_ > 0 ? request_.timeout_ : pool_.config().timeout_ );
+                        request_.timeout_ = std::max(std::min(timeout, a_remaining), static_cast<size_t>(1));
+                        if ( 0 != a_header.length() ) {
+                            request_.headers_[a_header] = std::to_string(request_.timeout_);
+                        }
+                    }
+
+                }; // end of class 'Deferred'
+
+                /**
+                 * @brief Perform HTTP request.
+                 *
+                 * @param a_args      Request arguments.
+                 * @param a_callbacks See \link Deferred<A>::Callbacks \link.
+                 */
+                template <class A>
+                void Deferred<A>::Run (const A& a_args, typename ::casper::job::deferrable::Deferred<A>::Callbacks a_callbacks)
+                {
+                    using DeferredBaseClass = ::casper::job::deferrable::Deferred<A>;
+
+                    DeferredBaseClass::Bind(a_callbacks);
+                    DeferredBaseClass::arguments_ = new A(a_args);
+                    DeferredBaseClass::Track();
+                    // ... perform request on pool thread, complete on main thread ...
+                    ticket_ = pool_.Submit(request_, [this] (const Pool::Result& a_result) {
+                        if ( 0 == a_result.error_.length() ) {
+                            DeferredBaseClass::response_.Set(a_result.code_, a_result.content_type_, a_result.headers_, a_result.body_, a_result.rtt_,
+                                                             /* a_parse */ 0 == strncasecmp(a_result.content_type_.c_str(), "application/json", sizeof(char) * 16));
+                        } else {
+                            // ... transport error, unless pool itself failed the request ...
+                            DeferredBaseClass::response_.Set(( true == a_result.timeout_ ? CC_STATUS_CODE_GATEWAY_TIMEOUT : ( a_result.code_ >= 500 ? a_result.code_ : CC_STATUS_CODE_BAD_GATEWAY ) ),
+                                                             ::cc::Exception("%s %s: %s", request_.method_.c_str(), request_.url_.c_str(), a_result.error_.c_str()));
+                        }
+                        const auto guard = DeferredBaseClass::guard_;
+                        DeferredBaseClass::CallOnMainThread([this, guard] () {
+                            if ( true == guard->cancelled_ ) {
+                                return;
+                            }
+                            ticket_ = 0;
+                            DeferredBaseClass::OnCompleted(this);
+                            DeferredBaseClass::Untrack();
+                        });
+                    });
+                }
+
+                /**
+                 * @brief Give up on this request, it's response ( if any ) won't be delivered.
+                 */
+                template <class A>
+                void Deferred<A>::Cancel ()
+                {
+                    ::casper::job::deferrable::Deferred<A>::Cancel();
+                    if ( 0 != ticket_ ) {
+                        pool_.Cancel(ticket_);
+                        ticket_ = 0;
+                    }
+                }
+
+                /**
+                 * @brief A stock HTTP dispatcher, requests are performed through a keep-alive connection pool.
+                 */
+                template <class A>
+                class Dispatcher : public ::casper::job::deferrable::Dispatcher<A>
+                {
+
+                public: // Data Type(s)
+
+                    typedef std::vector<const Request*> Requests;
+
+                    /**
+                     * @brief User supplied functions to merge requests into a single bulk request and to split it's response.
+                     */
+                    typedef struct {
+                        std::function<std::string(const Request&)>                                      group_; //!< Batch group, empty if request can't be merged.
+                        std::function<Request(const Requests&)>                                         merge_; //!< Bulk request performing all requests.
+                        std::function<void(const Requests&, const Response&, std::vector<Response>&)>   split_; //!< One response per request, in requests order.
+                    } Combiner;
+
+                private: // Data
+
+                    Pool*                    pool_;
+                    std::vector<std::string> warm_up_;
+                    size_t                   warm_up_connections_;
+                    Combiner                 combiner_;
+                    std::string              deadline_header_; //!< Header that propagates remaining time to backends, empty if none.
+
+                public: // Constructor(s) / Destructor
+
+                    Dispatcher (CC_IF_DEBUG_CONSTRUCT_DECLARE_VAR(const cc::debug::Threading::ThreadID, a_thread_id));
+                    virtual ~Dispatcher ();
+
+                public: // Inherited Virtual Method(s) / Function(s) - from deferrable::Dispatcher<A>
+
+                    virtual void Setup (const Json::Value& a_config);
+
+                protected: // Inherited Virtual Method(s) / Function(s) - from deferrable::Dispatcher<A>
+
+                    virtual bool                                    Idempotent (const ::casper::job::deferrable::Deferred<A>* a_deferred) const;
+                    virtual ::casper::job::deferrable::Deferred<A>* Duplicate  (const ::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_id);
+                    virtual std::string                             Key        (const A& a_args, const ::casper::job::deferrable::Deferred<A>* a_deferred) const;
+                    virtual bool                                    Cacheable  (const ::casper::job::deferrable::Deferred<A>* a_deferred) const;
+                    virtual bool                                    Revalidate (::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_etag);
+                    virtual bool                                    Route      (::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_endpoint);
+                    virtual bool                                    Budget     (::casper::job::deferrable::Deferred<A>* a_deferred, const size_t a_remaining);
+                    virtual std::string                             Group      (const A& a_args, const ::casper::job::deferrable::Deferred<A>* a_deferred) const;
+                    virtual ::casper::job::deferrable::Deferred<A>* Merge      (const std::string& a_group, const typename ::casper::job::deferrable::Dispatcher<A>::BatchMembers& a_members, const std::string& a_id);
+                    virtual void                                    Split      (const std::string& a_group, const typename ::casper::job::deferrable::Dispatcher<A>::BatchMembers& a_members,
+                                                                                const Response& a_response, std::vector<Response>& o_responses);
+
+                public: // Method(s) / Function(s)
+
+                    void Perform (const Tracking& a_tracking, const A& a_args, const Request& a_request, const std::string& a_id = "");
+                    void Combine (const Combiner& a_combiner);
+
+                public: // Static Method(s) / Function(s)
+
+                    static Pool::Config Load (const Json::Value& a_config);
+
+                public: // Inline Method(s) / Function(s)
+
+                    /**
+                     * @return Connection pool \link Pool::Stats \link, can be called from any thread.
+                     */
+                    inline Pool::Stats stats () const
+                    {
+                        return ( nullptr != pool_ ? pool_->Snapshot() : Pool::Stats({ 0, 0, 0 }) );
+                    }
+
+                }; // end of class 'Dispatcher'
+
+                /**
+                 * @brief Default constructor.
+                 *
+                 * param a_thread_id For debug purposes only
+                 */
+                template <class A>
+                Dispatcher<A>::Dispatcher (CC_IF_DEBUG_CONSTRUCT_DECLARE_VAR(const cc::debug::Threading::ThreadID, a_thread_id))
+                    : ::casper::job::deferrable::Dispatcher<A>(CC_IF_DEBUG(a_thread_id))
+                {
+                    pool_                = nullptr;
+                    warm_up_connections_ = 0;
+                }
+
+                /**
+                 * @brief Destructor.
+                 */
+                template <class A>
+                Dispatcher<A>::~Dispatcher ()
+                {
+                    if ( nullptr != pool_ ) {
+                        delete pool_;
+                    }
+                }
+
+                /**
+                 * @brief One-shot setup, connection pool is created and warmed up.
+                 *
+                 * @param a_config JSON object, pool is configured by it's 'http-dispatcher' object ( if any ):
+                 *
+                 * {
+                 *    "max-connections": 64, "max-host-connections": 8, "multiplex": true, "prior-knowledge": false,
+                 *    "connect-timeout": 5000, "timeout": 30000, "max-idle": 118,
+                 *    "warm-up": { "urls": [ "https://..." ], "connections": 2 },
+                 *    "deadline-header": "X-Request-Timeout"
+                 * }
+                 */
+                template <class A>
+                void Dispatcher<A>::Setup (const Json::Value& a_config)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+
+                    const ::cc::easy::JSON<::cc::Exception> json;
+
+                    const Json::Value  c_connections = 1;
+                    const Json::Value  c_header      = "";
+                    const Json::Value& config        = json.Get(a_config, "http-dispatcher", Json::ValueType::objectValue, &Json::Value::null);
+                    const Json::Value& warm_up       = json.Get(config  , "warm-up"        , Json::ValueType::objectValue, &Json::Value::null);
+
+                    deadline_header_ = json.Get(config, "deadline-header", Json::ValueType::stringValue, &c_header).asString();
+
+                    warm_up_.clear();
+                    if ( false == warm_up.isNull() ) {
+                        const Json::Value& urls = json.Get(warm_up, "urls", Json::ValueType::arrayValue, nullptr);
+                        for ( Json::ArrayIndex idx = 0 ; idx < urls.size() ; ++idx ) {
+                            warm_up_.push_back(urls[idx].asString());
+                        }
+                        warm_up_connections_ = static_cast<size_t>(json.Get(warm_up, "connections", Json::ValueType::uintValue, &c_connections).asUInt64());
+                    }
+
+                    // ... (re)create pool ...
+                    if ( nullptr != pool_ ) {
+                        delete pool_;
+                    }
+                    pool_ = new Pool(Load(config));
+                    pool_->Start();
+                    // ... start handshakes now, in background, ahead of first requests ...
+                    if ( warm_up_.size() > 0 && warm_up_connections_ > 0 ) {
+                        pool_->WarmUp(warm_up_, warm_up_connections_);
+                    }
+                }
+
+                /**
+                 * @brief Create, track and launch an HTTP request.
+                 *
+                 * @param a_tracking Request tracking info.
+                 * @param a_args     Request arguments.
+                 * @param a_request  Request to perform.
+                 * @param a_id       Request ID, if empty tracking RCID will be used.
+                 */
+                template <class A>
+                void Dispatcher<A>::Perform (const Tracking& a_tracking, const A& a_args, const Request& a_request, const std::string& a_id)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    if ( nullptr == pool_ ) {
+                        throw ::cc::Exception("%s", "HTTP dispatcher not set up!");
+                    }
+                    ::casper::job::deferrable::Dispatcher<A>::Dispatch(a_args,
+                        new Deferred<A>(a_id, a_tracking, *pool_, a_request
+                                        CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(::casper::job::deferrable::Dispatcher<A>::thread_id_))
+                    );
+                }
+
+                /**
+                 * @brief Only requests with idempotent methods ( RFC 7231 4.2.2 ) can be hedged.
+                 *
+                 * @param a_deferred Request to check, must have been created by this dispatcher.
+                 */
+                template <class A>
+                bool Dispatcher<A>::Idempotent (const ::casper::job::deferrable::Deferred<A>* a_deferred) const
+                {
+                    const std::string& method = static_cast<const Deferred<A>*>(a_deferred)->request().method_;
+                    return ( 0 == strcasecmp(method.c_str(), "GET") || 0 == strcasecmp(method.c_str(), "HEAD") || 0 == strcasecmp(method.c_str(), "OPTIONS")
+                             || 0 == strcasecmp(method.c_str(), "PUT") || 0 == strcasecmp(method.c_str(), "DELETE") );
+                }
+
+                /**
+                 * @brief Create a duplicate of an HTTP request.
+                 *
+                 * @param a_deferred Request to duplicate, must have been created by this dispatcher.
+                 * @param a_id       Duplicate request ID.
+                 *
+                 * @return New request, not launched yet.
+                 */
+                template <class A>
+                ::casper::job::deferrable::Deferred<A>* Dispatcher<A>::Duplicate (const ::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_id)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    return new Deferred<A>(a_id, a_deferred->tracking_, *pool_, static_cast<const Deferred<A>*>(a_deferred)->request()
+                                           CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(::casper::job::deferrable::Dispatcher<A>::thread_id_));
+                }
+
+                /**
+                 * @brief Identical HTTP requests are interchangeable, regardless of job arguments.
+                 *
+                 * @param a_args     Unused.
+                 * @param a_deferred Request to compute key for, must have been created by this dispatcher.
+                 *
+                 * @return Canonical request representation, empty if it's not idempotent.
+                 */
+                template <class A>
+                std::string Dispatcher<A>::Key (const A& /* a_args */, const ::casper::job::deferrable::Deferred<A>* a_deferred) const
+                {
+                    if ( false == Idempotent(a_deferred) ) {
+                        return "";
+                    }
+                    const Request& request = static_cast<const Deferred<A>*>(a_deferred)->request();
+                    std::string key = request.method_ + ' ' + request.url_ + '\n';
+                    for ( const auto& header : request.headers_ ) {
+                        key += header.first + ':' + header.second + '\n';
+                    }
+                    return key + '\n' + request.body_;
+                }
+
+                /**
+                 * @brief Only responses to safe requests that don't change server state ( GET and HEAD ) are cached.
+                 *
+                 * @param a_deferred Request to check, must have been created by this dispatcher.
+                 */
+                template <class A>
+                bool Dispatcher<A>::Cacheable (const ::casper::job::deferrable::Deferred<A>* a_deferred) const
+                {
+                    const std::string& method = static_cast<const Deferred<A>*>(a_deferred)->request().method_;
+                    return ( 0 == strcasecmp(method.c_str(), "GET") || 0 == strcasecmp(method.c_str(), "HEAD") );
+                }
+
+                /**
+                 * @brief Revalidate a stale cached response with 'If-None-Match'.
+                 *
+                 * @param a_deferred Request to make conditional, must have been created by this dispatcher.
+                 * @param a_etag     Entity tag of the cached response.
+                 *
+                 * @return True.
+                 */
+                template <class A>
+                bool Dispatcher<A>::Revalidate (::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_etag)
+                {
+                    static_cast<Deferred<A>*>(a_deferred)->Condition(a_etag);
+                    return true;
+                }
+
+                /**
+                 * @brief Send a request to a balanced endpoint.
+                 *
+                 * @param a_deferred Request to route, must have been created by this dispatcher.
+                 * @param a_endpoint Server origin, 'scheme://host[:port]'.
+                 *
+                 * @return True.
+                 */
+                template <class A>
+                bool Dispatcher<A>::Route (::casper::job::deferrable::Deferred<A>* a_deferred, const std::string& a_endpoint)
+                {
+                    static_cast<Deferred<A>*>(a_deferred)->Retarget(a_endpoint);
+                    return true;
+                }
+
+                /**
+                 * @brief Cap request timeout to it's job deadline and, if configured, tell backend about it.
+                 *
+                 * @param a_deferred  Request about to be launched, must have been created by this dispatcher.
+                 * @param a_remaining Time left, in ms.
+                 *
+                 * @return True.
+                 */
+                template <class A>
+                bool Dispatcher<A>::Budget (::casper::job::deferrable::Deferred<A>* a_deferred, const size_t a_remaining)
+                {
+                    static_cast<Deferred<A>*>(a_deferred)->Budget(a_remaining, deadline_header_);
+                    return true;
+                }
+
+                /**
+                 * @brief Set functions used to merge batched requests, see \link Batcher \link.
+                 *
+                 * @param a_combiner See \link Combiner \link, all functions must be set.
+                 */
+                template <class A>
+                void Dispatcher<A>::Combine (const Combiner& a_combiner)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    if ( nullptr == a_combiner.group_ || nullptr == a_combiner.merge_ || nullptr == a_combiner.split_ ) {
+                        throw ::cc::Exception("%s", "Invalid HTTP request combiner!");
+                    }
+                    combiner_ = a_combiner;
+                }
+
+                /**
+                 * @param a_args     Unused.
+                 * @param a_deferred Request to check, must have been created by this dispatcher.
+                 *
+                 * @return Batch group, as provided by \link Combiner \link; empty if none was set.
+                 */
+                template <class A>
+                std::string Dispatcher<A>::Group (const A& /* a_args */, const ::casper::job::deferrable::Deferred<A>* a_deferred) const
+                {
+                    if ( nullptr == combiner_.group_ ) {
+                        return "";
+                    }
+                    return combiner_.group_(static_cast<const Deferred<A>*>(a_deferred)->request());
+                }
+
+                /**
+                 * @brief Merge HTTP requests into a single bulk request.
+                 *
+                 * @param a_group   Batch group.
+                 * @param a_members Requests to merge, must have been created by this dispatcher.
+                 * @param a_id      Bulk request ID.
+                 *
+                 * @return New request, not launched yet.
+                 */
+                template <class A>
+                ::casper::job::deferrable::Deferred<A>* Dispatcher<A>::Merge (const std::string& /* a_group */, const typename ::casper::job::deferrable::Dispatcher<A>::BatchMembers& a_members,
+                                                                             const std::string& a_id)
+                {
+                    CC_DEBUG_FAIL_IF_NOT_AT_THREAD(::casper::job::deferrable::Dispatcher<A>::thread_id_);
+                    Requests requests;
+                    for ( const auto& member : a_members ) {
+                        requests.push_back(&static_cast<const Deferred<A>*>(member.second)->request());
+                    }
+                    return new Deferred<A>(a_id, a_members[0].second->tracking_, *pool_, combiner_.merge_(requests)
+                                           CC_IF_DEBUG_CONSTRUCT_APPEND_PARAM_VALUE(::casper::job::deferrable::Dispatcher<A>::thread_id_));
+                }
+
+                /**
+                 * @brief Split a bulk response into one response per merged request.
+                 *
+                 * @param a_group     Batch group.
+                 * @param a_members   Merged requests.
+                 * @param a_response  Bulk response.
+                 * @param o_responses One response per merged request, in members order.
+                 */
+                template <class A>
+                void Dispatcher<A>::Split (const std::string& /* a_group */, const typename ::casper::job::deferrable::Dispatcher<A>::BatchMembers& a_members,
+                                           const Response& a_response, std::vector<Response>& o_responses)
+                {
+                    Requests requests;
+                    for ( const auto& member : a_members ) {
+                        requests.push_back(&static_cast<const Deferred<A>*>(member.second)->request());
+                    }
+                    combiner_.split_(requests, a_response, o_responses);
+                }
+
+                /**
+                 * @brief Load a connection pool configuration from it's JSON representation.
+                 *
+                 * @param a_config JSON object, null for defaults.
+                 *
+                 * @return See \link Pool::Config \link.
+                 */
+                template <class A>
+                Pool::Config Dispatcher<A>::Load (const Json::Value& a_config)
+                {
+                    const ::cc::easy::JSON<::cc::Exception> json;
+
+                    const Json::Value c_max_connections      = 64;
+                    const Json::Value c_max_host_connections = 8;
+                    const Json::Value c_multiplex            = true;
+                    const Json::Value c_prior_knowledge      = false;
+                    const Json::Value c_connect_timeout      = 5000;
+                    const Json::Value c_timeout              = 30000;
+                    const Json::Value c_max_idle             = 118;
+
+                    const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                    return {
+                        /* max_connections_      */ static_cast<size_t>(json.Get(config, "max-connections"     , Json::ValueType::uintValue   , &c_max_connections).asUInt64()),
+                        /* max_host_connections_ */ static_cast<size_t>(json.Get(config, "max-host-connections", Json::ValueType::uintValue   , &c_max_host_connections).asUInt64()),
+                        /* multiplex_            */ json.Get(config, "multiplex"      , Json::ValueType::booleanValue, &c_multiplex).asBool(),
+                        /* prior_knowledge_      */ json.Get(config, "prior-knowledge", Json::ValueType::booleanValue, &c_prior_knowledge).asBool(),
+                        /* connect_timeout_      */ static_cast<size_t>(json.Get(config, "connect-timeout"     , Json::ValueType::uintValue   , &c_connect_timeout).asUInt64()),
+                        /* timeout_              */ static_cast<size_t>(json.Get(config, "timeout"             , Json::ValueType::uintValue   , &c_timeout).asUInt64()),
+                        /* max_idle_             */ static_cast<size_t>(json.Get(config, "max-idle"            , Json::ValueType::uintValue   , &c_max_idle).asUInt64())
+                    };
+                }
+
+            } // end of namespace 'http'
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_HTTP_DISPATCHER_H_
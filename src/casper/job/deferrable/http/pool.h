@@ -0,0 +1,569 @@
+/**
+ * @file pool.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_HTTP_POOL_H_
+#define CASPER_JOB_DEFERRABLE_HTTP_POOL_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "cc/exception.h"
+
+#include <curl/curl.h>
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include <string.h>  // memchr
+#include <strings.h> // strcasecmp, strncasecmp
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            namespace http
+            {
+
+                /**
+                 * @brief HTTP client connection pool, backed by a single libcurl multi handle driven by it's own thread.
+                 *
+                 * Connections are kept alive and reused per host, HTTP/2 streams are multiplexed over a single
+                 * connection when the server negotiates it.
+                 */
+                class Pool final : public ::cc::NonCopyable, public ::cc::NonMovable
+                {
+
+                public: // Data Type(s)
+
+                    typedef struct {
+                        std::string                        method_;
+                        std::string                        url_;
+                        std::map<std::string, std::string> headers_;
+                        std::string                        body_;
+                        size_t                             timeout_; //!< In ms, 0 for pool default.
+                    } Request;
+
+                    typedef struct {
+                        uint16_t                           code_;
+                        std::string                        content_type_;
+                        std::map<std::string, std::string> headers_;
+                        std::string                        body_;
+                        size_t                             rtt_;      //!< In ms.
+                        std::string                        error_;    //!< Transport error, empty on success.
+                        bool                               timeout_;  //!< True when transport error is a timeout.
+                    } Result;
+
+                    typedef std::function<void(const Result&)> Callback;
+
+                    typedef struct {
+                        size_t max_connections_;      //!< Total, 0 for unlimited.
+                        size_t max_host_connections_; //!< Per host, 0 for unlimited.
+                        bool   multiplex_;            //!< Use HTTP/2 multiplexing where available.
+                        bool   prior_knowledge_;      //!< Speak HTTP/2 to plain text servers without upgrade.
+                        size_t connect_timeout_;      //!< In ms.
+                        size_t timeout_;              //!< In ms.
+                        size_t max_idle_;             //!< In seconds, maximum idle time of a cached connection.
+                    } Config;
+
+                    typedef struct {
+                        uint64_t requests_;
+                        uint64_t failed_;
+                        uint64_t connects_;  //!< New connections opened ( each one a TCP, and maybe TLS, handshake ).
+                    } Stats;
+
+                private: // Data Type(s)
+
+                    typedef struct {
+                        uint64_t    ticket_;
+                        CURL*       easy_;
+                        curl_slist* headers_;
+                        Request     request_;
+                        Callback    callback_;
+                        Result      result_;
+                        bool        warm_up_;
+                        char        error_[CURL_ERROR_SIZE];
+                    } Transfer;
+
+                private: // Const Data
+
+                    const Config                  config_;
+
+                private: // Data
+
+                    CURLM*                        multi_;
+                    std::thread*                  thread_;
+                    std::atomic<bool>             running_;
+                    std::mutex                    mutex_;
+                    uint64_t                      ticket_;
+                    std::deque<Transfer*>         queue_;     //!< Submitted, not launched yet.
+                    std::map<uint64_t, Transfer*> tickets_;   //!< Submitted or launched, by ticket.
+                    std::set<Transfer*>           active_;    //!< Launched, pool thread only.
+                    std::vector<CURL*>            idle_;      //!< Reusable easy handles, pool thread only.
+                    Stats                         stats_;
+                    size_t                        warming_;   //!< Number of pending warm-up requests.
+
+                public: // Constructor(s) / Destructor
+
+                    Pool () = delete;
+                    Pool (const Config& a_config);
+                    virtual ~Pool ();
+
+                public: // Method(s) / Function(s)
+
+                    void     Start  ();
+                    void     Stop   ();
+                    uint64_t Submit (const Request& a_request, Callback a_callback);
+                    void     Cancel (const uint64_t& a_ticket);
+                    void     WarmUp (const std::vector<std::string>& a_urls, const size_t a_connections);
+                    Stats    Snapshot ();
+
+                public: // Inline Method(s) / Function(s)
+
+                    /**
+                     * @return R/O access to \link Config \link.
+                     */
+                    inline const Config& config () const
+                    {
+                        return config_;
+                    }
+
+                private: // Method(s) / Function(s)
+
+                    uint64_t Enqueue (Transfer* a_transfer);
+                    void     Loop    ();
+                    void     Launch  (Transfer* a_transfer);
+                    void     Finish  (Transfer* a_transfer, const CURLcode a_code);
+                    void     Abort   (Transfer* a_transfer);
+                    void     Release (Transfer* a_transfer);
+
+                private: // Static Method(s) / Function(s)
+
+                    static size_t OnBody   (char* a_data, size_t a_size, size_t a_count, void* a_transfer);
+                    static size_t OnHeader (char* a_data, size_t a_size, size_t a_count, void* a_transfer);
+
+                }; // end of class 'Pool'
+
+                /**
+                 * @brief Default constructor.
+                 *
+                 * @param a_config See \link Config \link.
+                 */
+                inline Pool::Pool (const Config& a_config)
+                    : config_(a_config)
+                {
+                    static std::once_flag s_once;
+                    std::call_once(s_once, [] () {
+                        curl_global_init(CURL_GLOBAL_DEFAULT);
+                    });
+                    multi_   = curl_multi_init();
+                    thread_  = nullptr;
+                    running_ = false;
+                    ticket_  = 0;
+                    stats_   = { 0, 0, 0 };
+                    warming_ = 0;
+                    if ( nullptr == multi_ ) {
+                        throw ::cc::Exception("%s", "Unable to create HTTP connection pool!");
+                    }
+                    curl_multi_setopt(multi_, CURLMOPT_PIPELINING          , ( true == config_.multiplex_ ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING ));
+                    curl_multi_setopt(multi_, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(config_.max_connections_));
+                    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS , static_cast<long>(config_.max_host_connections_));
+                    // ... connection cache must hold all open connections, otherwise they're closed after each burst ...
+                    if ( config_.max_connections_ > 0 ) {
+                        curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, static_cast<long>(config_.max_connections_));
+                    }
+                }
+
+                /**
+                 * @brief Destructor.
+                 */
+                inline Pool::~Pool ()
+                {
+                    Stop();
+                    for ( auto easy : idle_ ) {
+                        curl_easy_cleanup(easy);
+                    }
+                    curl_multi_cleanup(multi_);
+                }
+
+                /**
+                 * @brief Start pool thread.
+                 */
+                inline void Pool::Start ()
+                {
+                    if ( nullptr != thread_ ) {
+                        throw ::cc::Exception("%s", "HTTP connection pool already started!");
+                    }
+                    running_ = true;
+                    thread_  = new std::thread(&Pool::Loop, this);
+                }
+
+                /**
+                 * @brief Stop pool thread, pending requests are completed with a '503 Service Unavailable' error.
+                 */
+                inline void Pool::Stop ()
+                {
+                    if ( nullptr == thread_ ) {
+                        return;
+                    }
+                    running_ = false;
+                    curl_multi_wakeup(multi_);
+                    thread_->join();
+                    delete thread_;
+                    thread_ = nullptr;
+                    for ( auto transfer : active_ ) {
+                        curl_multi_remove_handle(multi_, transfer->easy_);
+                        Abort(transfer);
+                    }
+                    active_.clear();
+                    std::deque<Transfer*> queue;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        queue.swap(queue_);
+                    }
+                    for ( auto transfer : queue ) {
+                        Abort(transfer);
+                    }
+                }
+
+                /**
+                 * @brief Submit a request, can be called from any thread.
+                 *
+                 * @param a_request  See \link Request \link.
+                 * @param a_callback Function to call, on pool thread, when request is completed.
+                 *
+                 * @return Ticket, to be used to cancel this request.
+                 */
+                inline uint64_t Pool::Submit (const Request& a_request, Callback a_callback)
+                {
+                    return Enqueue(new Transfer({ 0, nullptr, nullptr, a_request, a_callback, { 0, "", {}, "", 0, "", false }, /* warm_up_ */ false, { 0 } }));
+                }
+
+                /**
+                 * @brief Cancel a request callback, can be called from any thread.
+                 *
+                 * @param a_ticket Ticket returned by \link Submit \link.
+                 *
+                 * @note When this function returns, the callback is not running and will not be called.
+                 */
+                inline void Pool::Cancel (const uint64_t& a_ticket)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    const auto it = tickets_.find(a_ticket);
+                    if ( tickets_.end() != it ) {
+                        it->second->callback_ = nullptr;
+                    }
+                }
+
+                /**
+                 * @brief Open connections ahead of first use, without waiting for them: requests submitted meanwhile
+                 *        share them once they're established.
+                 *
+                 * @param a_urls        URLs to connect to.
+                 * @param a_connections Number of connections per URL.
+                 */
+                inline void Pool::WarmUp (const std::vector<std::string>& a_urls, const size_t a_connections)
+                {
+                    if ( nullptr == thread_ ) {
+                        throw ::cc::Exception("%s", "HTTP connection pool not started!");
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        warming_ += a_urls.size() * a_connections;
+                    }
+                    for ( const auto& url : a_urls ) {
+                        for ( size_t idx = 0 ; idx < a_connections ; ++idx ) {
+                            Enqueue(new Transfer({ 0, nullptr, nullptr, { "HEAD", url, {}, "", config_.connect_timeout_ }, nullptr, { 0, "", {}, "", 0, "", false }, /* warm_up_ */ true, { 0 } }));
+                        }
+                    }
+                }
+
+                /**
+                 * @return A copy of current \link Stats \link, can be called from any thread.
+                 */
+                inline Pool::Stats Pool::Snapshot ()
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    return stats_;
+                }
+
+                /**
+                 * @brief Queue a transfer and wake up pool thread.
+                 *
+                 * @param a_transfer Transfer to queue, ownership is transferred to this object.
+                 *
+                 * @return Transfer ticket.
+                 */
+                inline uint64_t Pool::Enqueue (Transfer* a_transfer)
+                {
+                    uint64_t ticket;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        ticket = a_transfer->ticket_ = ++ticket_;
+                        tickets_[ticket] = a_transfer;
+                        queue_.push_back(a_transfer);
+                    }
+                    curl_multi_wakeup(multi_);
+                    return ticket;
+                }
+
+                /**
+                 * @brief Pool thread loop.
+                 */
+                inline void Pool::Loop ()
+                {
+                    std::deque<Transfer*> queue;
+                    while ( true == running_ ) {
+                        // ... launch submitted transfers ...
+                        {
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            queue.swap(queue_);
+                        }
+                        for ( auto transfer : queue ) {
+                            Launch(transfer);
+                        }
+                        queue.clear();
+                        // ... perform ...
+                        int running = 0;
+                        curl_multi_perform(multi_, &running);
+                        // ... collect completed transfers ...
+                        CURLMsg* message;
+                        int      left;
+                        while ( nullptr != ( message = curl_multi_info_read(multi_, &left) ) ) {
+                            if ( CURLMSG_DONE != message->msg ) {
+                                continue;
+                            }
+                            Transfer*      transfer = nullptr;
+                            CURL*          easy     = message->easy_handle;
+                            const CURLcode code     = message->data.result;
+                            curl_easy_getinfo(easy, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+                            curl_multi_remove_handle(multi_, easy);
+                            active_.erase(transfer);
+                            Finish(transfer, code);
+                        }
+                        // ... wait for I/O or for new transfers ...
+                        curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+                    }
+                }
+
+                /**
+                 * @brief Configure an easy handle for a transfer and hand it over to multi handle.
+                 *
+                 * @param a_transfer Transfer to launch.
+                 */
+                inline void Pool::Launch (Transfer* a_transfer)
+                {
+                    CURL* easy;
+                    if ( idle_.size() > 0 ) {
+                        easy = idle_.back();
+                        idle_.pop_back();
+                        curl_easy_reset(easy);
+                    } else {
+                        easy = curl_easy_init();
+                    }
+                    a_transfer->easy_ = easy;
+
+                    const Request& request = a_transfer->request_;
+
+                    curl_easy_setopt(easy, CURLOPT_PRIVATE          , a_transfer);
+                    curl_easy_setopt(easy, CURLOPT_URL              , request.url_.c_str());
+                    curl_easy_setopt(easy, CURLOPT_ERRORBUFFER      , a_transfer->error_);
+                    curl_easy_setopt(easy, CURLOPT_NOSIGNAL         , 1L);
+                    curl_easy_setopt(easy, CURLOPT_TCP_NODELAY      , 1L);
+                    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE    , 1L);
+                    curl_easy_setopt(easy, CURLOPT_MAXAGE_CONN      , static_cast<long>(config_.max_idle_));
+                    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(config_.connect_timeout_));
+                    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS       , static_cast<long>(request.timeout_ > 0 ? request.timeout_ : config_.timeout_));
+                    if ( true == config_.multiplex_ ) {
+                        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, ( true == config_.prior_knowledge_ ? CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE : CURL_HTTP_VERSION_2TLS ));
+                        // ... warm-up must open new connections, requests should rather wait for a stream on an existing one ...
+                        curl_easy_setopt(easy, CURLOPT_PIPEWAIT, ( true == a_transfer->warm_up_ ? 0L : 1L ));
+                    } else {
+                        curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+                    }
+                    // ... method and body ...
+                    if ( 0 == strcasecmp(request.method_.c_str(), "HEAD") ) {
+                        curl_easy_setopt(easy, CURLOPT_NOBODY, 1L);
+                    } else {
+                        if ( request.body_.length() > 0 ) {
+                            curl_easy_setopt(easy, CURLOPT_POSTFIELDS          , request.body_.c_str());
+                            curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE_LARGE , static_cast<curl_off_t>(request.body_.length()));
+                        }
+                        if ( request.method_.length() > 0 && 0 != strcasecmp(request.method_.c_str(), "GET") && 0 != strcasecmp(request.method_.c_str(), "POST") ) {
+                            curl_easy_setopt(easy, CURLOPT_CUSTOMREQUEST, request.method_.c_str());
+                        }
+                    }
+                    // ... headers, 'Expect: 100-continue' costs an extra RTT per request with a body ...
+                    a_transfer->headers_ = curl_slist_append(nullptr, "Expect:");
+                    for ( const auto& header : request.headers_ ) {
+                        a_transfer->headers_ = curl_slist_append(a_transfer->headers_, ( header.first + ": " + header.second ).c_str());
+                    }
+                    curl_easy_setopt(easy, CURLOPT_HTTPHEADER    , a_transfer->headers_);
+                    curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, &Pool::OnHeader);
+                    curl_easy_setopt(easy, CURLOPT_HEADERDATA    , a_transfer);
+                    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION , &Pool::OnBody);
+                    curl_easy_setopt(easy, CURLOPT_WRITEDATA     , a_transfer);
+                    // ... go ...
+                    active_.insert(a_transfer);
+                    curl_multi_add_handle(multi_, easy);
+                }
+
+                /**
+                 * @brief Collect transfer result and deliver it.
+                 *
+                 * @param a_transfer Completed transfer.
+                 * @param a_code     libcurl result code.
+                 */
+                inline void Pool::Finish (Transfer* a_transfer, const CURLcode a_code)
+                {
+                    Result& result = a_transfer->result_;
+                    long         code     = 0;
+                    long         connects = 0;
+                    curl_off_t   total    = 0;
+                    char*        type     = nullptr;
+                    curl_easy_getinfo(a_transfer->easy_, CURLINFO_RESPONSE_CODE, &code);
+                    curl_easy_getinfo(a_transfer->easy_, CURLINFO_NUM_CONNECTS , &connects);
+                    curl_easy_getinfo(a_transfer->easy_, CURLINFO_TOTAL_TIME_T , &total);
+                    curl_easy_getinfo(a_transfer->easy_, CURLINFO_CONTENT_TYPE , &type);
+                    result.code_         = static_cast<uint16_t>(code);
+                    result.content_type_ = ( nullptr != type ? type : "" );
+                    result.rtt_          = static_cast<size_t>(total / 1000);
+                    if ( CURLE_OK != a_code ) {
+                        result.error_   = ( '\0' != a_transfer->error_[0] ? a_transfer->error_ : curl_easy_strerror(a_code) );
+                        result.timeout_ = ( CURLE_OPERATION_TIMEDOUT == a_code );
+                    }
+                    // ... deliver ...
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stats_.connects_ += static_cast<uint64_t>(connects);
+                    if ( true == a_transfer->warm_up_ ) {
+                        warming_--;
+                    } else {
+                        stats_.requests_++;
+                        if ( CURLE_OK != a_code ) {
+                            stats_.failed_++;
+                        }
+                        if ( nullptr != a_transfer->callback_ ) {
+                            a_transfer->callback_(result);
+                        }
+                    }
+                    tickets_.erase(a_transfer->ticket_);
+                    Release(a_transfer);
+                }
+
+                /**
+                 * @brief Complete a transfer that will not be performed, pool is stopping.
+                 *
+                 * @param a_transfer Submitted or launched transfer.
+                 */
+                inline void Pool::Abort (Transfer* a_transfer)
+                {
+                    Result& result = a_transfer->result_;
+                    result.code_    = 503;
+                    result.error_   = "HTTP connection pool stopped";
+                    result.timeout_ = false;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if ( true == a_transfer->warm_up_ ) {
+                        warming_--;
+                    } else {
+                        stats_.requests_++;
+                        stats_.failed_++;
+                        if ( nullptr != a_transfer->callback_ ) {
+                            a_transfer->callback_(result);
+                        }
+                    }
+                    tickets_.erase(a_transfer->ticket_);
+                    Release(a_transfer);
+                }
+
+                /**
+                 * @brief Release a transfer, keeping it's easy handle for reuse.
+                 *
+                 * @param a_transfer Transfer to release.
+                 */
+                inline void Pool::Release (Transfer* a_transfer)
+                {
+                    if ( nullptr != a_transfer->headers_ ) {
+                        curl_slist_free_all(a_transfer->headers_);
+                    }
+                    if ( nullptr != a_transfer->easy_ ) {
+                        idle_.push_back(a_transfer->easy_);
+                    }
+                    delete a_transfer;
+                }
+
+                /**
+                 * @brief libcurl body callback.
+                 */
+                inline size_t Pool::OnBody (char* a_data, size_t a_size, size_t a_count, void* a_transfer)
+                {
+                    static_cast<Transfer*>(a_transfer)->result_.body_.append(a_data, a_size * a_count);
+                    return a_size * a_count;
+                }
+
+                /**
+                 * @brief libcurl header callback, called once per header line.
+                 */
+                inline size_t Pool::OnHeader (char* a_data, size_t a_size, size_t a_count, void* a_transfer)
+                {
+                    const size_t length = a_size * a_count;
+                    Result&      result = static_cast<Transfer*>(a_transfer)->result_;
+                    // ... a new status line ( redirect, 100 continue ) starts a new set of headers ...
+                    if ( length > 5 && 0 == strncasecmp(a_data, "HTTP/", 5) ) {
+                        result.headers_.clear();
+                        return length;
+                    }
+                    const char* colon = static_cast<const char*>(memchr(a_data, ':', length));
+                    if ( nullptr == colon ) {
+                        return length;
+                    }
+                    const char* value = colon + 1;
+                    const char* end   = a_data + length;
+                    while ( value < end && ( ' ' == *value || '\t' == *value ) ) {
+                        value++;
+                    }
+                    while ( end > value && ( '\r' == end[-1] || '\n' == end[-1] || ' ' == end[-1] ) ) {
+                        end--;
+                    }
+                    result.headers_[std::string(a_data, static_cast<size_t>(colon - a_data))] = std::string(value, static_cast<size_t>(end - value));
+                    return length;
+                }
+
+            } // end of namespace 'http'
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_HTTP_POOL_H_
@@ -0,0 +1,316 @@
+/**
+ * @file keeper.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_KEEPER_H_
+#define CASPER_JOB_DEFERRABLE_KEEPER_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <map>
+#include <vector>
+#include <chrono>
+#include <limits>    // std::numeric_limits
+#include <algorithm> // std::min
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief TTR keep-alive schedule: tracks jobs that are waiting for deferred requests and tells when they must be
+             *        touched, so that beanstalkd does not release them to another worker while they are still being processed.
+             *
+             * Jobs due within \link Config::window_ \link of each other are touched together.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Keeper final
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool   enabled_;
+                    size_t margin_; //!< In ms, how long before TTR expires a job is touched; at most half of it's TTR.
+                    size_t window_; //!< In ms, jobs due within this window are touched in the same batch.
+                } Config;
+
+                typedef struct {
+                    size_t   jobs_;     //!< Jobs being kept alive.
+                    uint64_t batches_;  //!< Touch batches issued.
+                    uint64_t touches_;  //!< Jobs touched.
+                    uint64_t failures_; //!< Touches that failed, those jobs are no longer kept alive.
+                    uint64_t avoided_;  //!< Jobs that finished after their original TTR, each one would have been delivered again.
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+                typedef struct {
+                    size_t    ttr_;      //!< In ms.
+                    TimePoint started_;
+                    TimePoint deadline_; //!< When beanstalkd releases the job, unless it's touched.
+                    bool      touching_; //!< True while a touch is in-flight.
+                    bool      touched_;  //!< True if job was touched at least once.
+                } Entry;
+
+            private: // Data
+
+                Config                    config_;
+                std::map<uint64_t, Entry> jobs_;
+                Stats                     stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Keeper ();
+                virtual ~Keeper ();
+
+            public: // Method(s) / Function(s)
+
+                void   Setup   (const Config& a_config);
+                void   Track   (const uint64_t& a_id, const uint64_t a_ttr, const std::chrono::steady_clock::time_point& a_reserved);
+                bool   Untrack (const uint64_t& a_id);
+                void   Due     (std::vector<uint64_t>& o_ids);
+                void   Touched (const uint64_t& a_id, const bool a_ok);
+                size_t Next    () const;
+                void   Reset   ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            private: // Method(s) / Function(s)
+
+                TimePoint At (const Entry& a_entry) const;
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if keep-alive is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Keeper'
+
+            /**
+             * @brief Default constructor, keep-alive is disabled.
+             */
+            inline Keeper::Keeper ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Keeper::~Keeper ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, tracked jobs are forgotten.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Keeper::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Start keeping a job alive.
+             *
+             * @param a_id       Job ID.
+             * @param a_ttr      Job TTR, in seconds; 0 means no TTR and job is not tracked.
+             * @param a_reserved When job was reserved, beanstalkd started it's TTR countdown then.
+             */
+            inline void Keeper::Track (const uint64_t& a_id, const uint64_t a_ttr, const std::chrono::steady_clock::time_point& a_reserved)
+            {
+                if ( false == config_.enabled_ || 0 == a_ttr || jobs_.end() != jobs_.find(a_id) ) {
+                    return;
+                }
+                const size_t ttr = static_cast<size_t>(a_ttr) * 1000;
+                jobs_[a_id] = { ttr, a_reserved, a_reserved + std::chrono::milliseconds(ttr), false, false };
+                stats_.jobs_ = jobs_.size();
+            }
+
+            /**
+             * @brief Stop keeping a job alive, it's finished.
+             *
+             * @param a_id Job ID.
+             *
+             * @return True if job outlived it's original TTR thanks to touches.
+             */
+            inline bool Keeper::Untrack (const uint64_t& a_id)
+            {
+                const auto it = jobs_.find(a_id);
+                if ( jobs_.end() == it ) {
+                    return false;
+                }
+                const bool avoided = ( true == it->second.touched_ && std::chrono::steady_clock::now() >= it->second.started_ + std::chrono::milliseconds(it->second.ttr_) );
+                if ( true == avoided ) {
+                    stats_.avoided_++;
+                }
+                jobs_.erase(it);
+                stats_.jobs_ = jobs_.size();
+                return avoided;
+            }
+
+            /**
+             * @brief Collect jobs that must be touched now, they are marked as being touched.
+             *
+             * @param o_ids Job IDs, cleared first.
+             */
+            inline void Keeper::Due (std::vector<uint64_t>& o_ids)
+            {
+                o_ids.clear();
+                const TimePoint limit = std::chrono::steady_clock::now() + std::chrono::milliseconds(config_.window_);
+                for ( auto& job : jobs_ ) {
+                    if ( false == job.second.touching_ && At(job.second) <= limit ) {
+                        job.second.touching_ = true;
+                        o_ids.push_back(job.first);
+                    }
+                }
+                if ( 0 != o_ids.size() ) {
+                    stats_.batches_++;
+                    stats_.touches_ += o_ids.size();
+                }
+            }
+
+            /**
+             * @brief Account a touch outcome.
+             *
+             * @param a_id Job ID.
+             * @param a_ok True if beanstalkd accepted the touch, otherwise job reservation is lost and it's no longer tracked.
+             */
+            inline void Keeper::Touched (const uint64_t& a_id, const bool a_ok)
+            {
+                const auto it = jobs_.find(a_id);
+                if ( jobs_.end() == it ) {
+                    // ... finished while touch was in-flight ...
+                    return;
+                }
+                if ( false == a_ok ) {
+                    stats_.failures_++;
+                    jobs_.erase(it);
+                    stats_.jobs_ = jobs_.size();
+                    return;
+                }
+                it->second.touching_ = false;
+                it->second.touched_  = true;
+                it->second.deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(it->second.ttr_);
+            }
+
+            /**
+             * @return Time, in ms, until the next job must be touched; max size_t if there's none.
+             */
+            inline size_t Keeper::Next () const
+            {
+                const TimePoint now  = std::chrono::steady_clock::now();
+                size_t          next = std::numeric_limits<size_t>::max();
+                for ( const auto& job : jobs_ ) {
+                    if ( true == job.second.touching_ ) {
+                        continue;
+                    }
+                    const TimePoint at = At(job.second);
+                    if ( at <= now ) {
+                        return 0;
+                    }
+                    next = std::min(next, static_cast<size_t>(std::chrono::duration_cast<std::chrono::milliseconds>(at - now).count()));
+                }
+                return next;
+            }
+
+            /**
+             * @brief Forget all tracked jobs and stats.
+             */
+            inline void Keeper::Reset ()
+            {
+                jobs_.clear();
+                stats_ = { 0, 0, 0, 0, 0 };
+            }
+
+            /**
+             * @brief Load a keep-alive configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for disabled keep-alive.
+             *
+             * @return See \link Config \link.
+             */
+            inline Keeper::Config Keeper::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_margin = 5000;
+                const Json::Value c_window = 1000;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                const Config rv = {
+                    /* enabled_ */ ( false == config.isNull() ),
+                    /* margin_  */ static_cast<size_t>(json.Get(config, "margin", Json::ValueType::uintValue, &c_margin).asUInt64()),
+                    /* window_  */ static_cast<size_t>(json.Get(config, "window", Json::ValueType::uintValue, &c_window).asUInt64())
+                };
+                if ( true == rv.enabled_ && 0 == rv.margin_ ) {
+                    throw ::cc::Exception("%s", "Invalid keep-alive configuration!");
+                }
+                return rv;
+            }
+
+            /**
+             * @return When a job must be touched.
+             *
+             * @param a_entry Tracked job.
+             */
+            inline Keeper::TimePoint Keeper::At (const Entry& a_entry) const
+            {
+                return a_entry.deadline_ - std::chrono::milliseconds(std::min(config_.margin_, a_entry.ttr_ / 2));
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_KEEPER_H_
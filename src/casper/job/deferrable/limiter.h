@@ -0,0 +1,301 @@
+/**
+ * @file limiter.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_LIMITER_H_
+#define CASPER_JOB_DEFERRABLE_LIMITER_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <algorithm> // std::min, std::max
+#include <cmath>     // std::sqrt
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Adaptive concurrency limit, gradient style.
+             *
+             * The limit grows while observed RTT stays close to it's long term average ( the backend is not queuing )
+             * and shrinks proportionally when RTT inflates; backend errors cut it multiplicatively.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Limiter final
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool   enabled_;
+                    size_t initial_;   //!< Initial limit.
+                    size_t min_;       //!< Minimum limit.
+                    size_t max_;       //!< Maximum limit.
+                    size_t queue_;     //!< Maximum number of requests waiting for a slot, excess is rejected.
+                    double tolerance_; //!< How much RTT inflation is tolerated before backing off, >= 1.0.
+                    double smoothing_; //!< 0..1, weight of each new limit estimate.
+                    double backoff_;   //!< 0..1, limit multiplier on backend errors.
+                    size_t window_;    //!< Number of samples of the long term RTT average.
+                } Config;
+
+                typedef struct {
+                    size_t   limit_;
+                    size_t   in_flight_;
+                    uint64_t rejected_;
+                    double   rtt_;       //!< Last RTT sample, in ms.
+                    double   baseline_;  //!< Long term RTT average, in ms.
+                } Metrics;
+
+            private: // Data
+
+                Config   config_;
+                double   limit_;
+                size_t   in_flight_;
+                uint64_t rejected_;
+                double   rtt_;
+                double   baseline_;
+
+            public: // Constructor(s) / Destructor
+
+                Limiter ();
+                virtual ~Limiter ();
+
+            public: // Method(s) / Function(s)
+
+                void    Setup   (const Config& a_config);
+                bool    Acquire ();
+                void    Release (const size_t a_rtt, const bool a_failed);
+                void    Abort   ();
+                void    Reject  ();
+                void    Reset   ();
+                Metrics metrics () const;
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if limiter is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Config \link.
+                 */
+                inline const Config& config () const
+                {
+                    return config_;
+                }
+
+            }; // end of class 'Limiter'
+
+            /**
+             * @brief Default constructor, limiter is disabled.
+             */
+            inline Limiter::Limiter ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Limiter::~Limiter ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, resets all state.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Limiter::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Try to obtain a slot.
+             *
+             * @return True if a slot was obtained, false if limit was reached.
+             */
+            inline bool Limiter::Acquire ()
+            {
+                if ( false == config_.enabled_ ) {
+                    in_flight_++;
+                    return true;
+                }
+                if ( in_flight_ >= static_cast<size_t>(limit_) ) {
+                    return false;
+                }
+                in_flight_++;
+                return true;
+            }
+
+            /**
+             * @brief Release a slot and update limit.
+             *
+             * @param a_rtt    Request RTT, in ms.
+             * @param a_failed True if the backend failed ( or was unreachable ).
+             */
+            inline void Limiter::Release (const size_t a_rtt, const bool a_failed)
+            {
+                const size_t in_flight = in_flight_;
+                if ( in_flight_ > 0 ) {
+                    in_flight_--;
+                }
+                if ( false == config_.enabled_ ) {
+                    return;
+                }
+                // ... backend error: back off ...
+                if ( true == a_failed ) {
+                    limit_ = std::max(static_cast<double>(config_.min_), limit_ * config_.backoff_);
+                    return;
+                }
+                // ... RTT sample, sub-millisecond responses count as 1ms ...
+                rtt_ = static_cast<double>(std::max(a_rtt, static_cast<size_t>(1)));
+                if ( 0.0 == baseline_ ) {
+                    baseline_ = rtt_;
+                } else {
+                    baseline_ += ( rtt_ - baseline_ ) / static_cast<double>(config_.window_);
+                }
+                // ... recovering from a long period of inflated RTT: let baseline drift down faster ...
+                if ( baseline_ / rtt_ > 2.0 ) {
+                    baseline_ *= 0.95;
+                }
+                // ... not using the limit we have: don't raise it ...
+                if ( static_cast<double>(in_flight) < limit_ / 2.0 ) {
+                    return;
+                }
+                const double gradient = std::max(0.5, std::min(1.0, config_.tolerance_ * baseline_ / rtt_));
+                const double estimate = limit_ * gradient + std::sqrt(limit_);
+                limit_ = limit_ * ( 1.0 - config_.smoothing_ ) + estimate * config_.smoothing_;
+                limit_ = std::max(static_cast<double>(config_.min_), std::min(static_cast<double>(config_.max_), limit_));
+            }
+
+            /**
+             * @brief Release a slot without updating limit, e.g. held by a request that was never performed or was cancelled.
+             */
+            inline void Limiter::Abort ()
+            {
+                if ( in_flight_ > 0 ) {
+                    in_flight_--;
+                }
+            }
+
+            /**
+             * @brief Account a rejected request.
+             */
+            inline void Limiter::Reject ()
+            {
+                rejected_++;
+            }
+
+            /**
+             * @brief Forget all in-flight requests and restart from initial limit.
+             */
+            inline void Limiter::Reset ()
+            {
+                limit_     = static_cast<double>(config_.initial_);
+                in_flight_ = 0;
+                rejected_  = 0;
+                rtt_       = 0.0;
+                baseline_  = 0.0;
+            }
+
+            /**
+             * @return Current \link Metrics \link.
+             */
+            inline Limiter::Metrics Limiter::metrics () const
+            {
+                return {
+                    /* limit_     */ static_cast<size_t>(limit_),
+                    /* in_flight_ */ in_flight_,
+                    /* rejected_  */ rejected_,
+                    /* rtt_       */ rtt_,
+                    /* baseline_  */ baseline_
+                };
+            }
+
+            /**
+             * @brief Load a limiter configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for a disabled limiter.
+             *
+             * @return See \link Config \link.
+             */
+            inline Limiter::Config Limiter::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_initial   = 20;
+                const Json::Value c_min       = 1;
+                const Json::Value c_max       = 200;
+                const Json::Value c_queue     = 1000;
+                const Json::Value c_tolerance = 1.5;
+                const Json::Value c_smoothing = 0.2;
+                const Json::Value c_backoff   = 0.9;
+                const Json::Value c_window    = 600;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                Config rv = {
+                    /* enabled_   */ ( false == config.isNull() ),
+                    /* initial_   */ static_cast<size_t>(json.Get(config, "initial"  , Json::ValueType::uintValue, &c_initial).asUInt64()),
+                    /* min_       */ static_cast<size_t>(json.Get(config, "min"      , Json::ValueType::uintValue, &c_min).asUInt64()),
+                    /* max_       */ static_cast<size_t>(json.Get(config, "max"      , Json::ValueType::uintValue, &c_max).asUInt64()),
+                    /* queue_     */ static_cast<size_t>(json.Get(config, "queue"    , Json::ValueType::uintValue, &c_queue).asUInt64()),
+                    /* tolerance_ */ json.Get(config, "tolerance", Json::ValueType::realValue, &c_tolerance).asDouble(),
+                    /* smoothing_ */ json.Get(config, "smoothing", Json::ValueType::realValue, &c_smoothing).asDouble(),
+                    /* backoff_   */ json.Get(config, "backoff"  , Json::ValueType::realValue, &c_backoff).asDouble(),
+                    /* window_    */ static_cast<size_t>(json.Get(config, "window"   , Json::ValueType::uintValue, &c_window).asUInt64())
+                };
+                if ( 0 == rv.min_ || rv.min_ > rv.max_ || rv.initial_ < rv.min_ || rv.initial_ > rv.max_ ) {
+                    throw ::cc::Exception("Invalid limiter bounds: initial " SIZET_FMT ", min " SIZET_FMT ", max " SIZET_FMT "!", rv.initial_, rv.min_, rv.max_);
+                }
+                if ( rv.tolerance_ < 1.0 || rv.smoothing_ <= 0.0 || rv.smoothing_ > 1.0 || rv.backoff_ <= 0.0 || rv.backoff_ >= 1.0 || 0 == rv.window_ ) {
+                    throw ::cc::Exception("%s", "Invalid limiter tuning!");
+                }
+                return rv;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_LIMITER_H_
@@ -0,0 +1,430 @@
+/**
+ * @file listener.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_LISTENER_H_
+#define CASPER_JOB_DEFERRABLE_LISTENER_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h> // memset
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief REDIS cancellation listener: subscribes a channel ( or pattern ) where clients publish the REDIS channel ID
+             *        of jobs they gave up on.
+             *
+             * Runs on it's own thread and reconnects ( and re-subscribes ) whenever the connection is lost.
+             */
+            class Listener final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool        enabled_;
+                    std::string host_;
+                    uint16_t    port_;
+                    std::string channel_; //!< Channel, or glob-style pattern, to subscribe.
+                    size_t      retry_;   //!< In ms, delay between connection attempts.
+                } Config;
+
+                typedef struct {
+                    uint64_t connects_; //!< Successful subscriptions.
+                    uint64_t messages_; //!< Cancellation messages received.
+                    uint64_t errors_;   //!< Connection attempts failed or connections lost.
+                } Stats;
+
+                typedef std::function<void(const std::string&)> Callback; //!< REDIS channel ID of job to cancel, called on listener thread.
+
+            private: // Const Data
+
+                const Config   config_;
+                const Callback callback_;
+
+            private: // Data
+
+                std::thread*      thread_;
+                std::atomic<bool> running_;
+                int               wakeup_[2];
+                std::mutex        mutex_;
+                Stats             stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Listener () = delete;
+                Listener (const Config& a_config, Callback a_callback);
+                virtual ~Listener ();
+
+            public: // Method(s) / Function(s)
+
+                void  Start    ();
+                void  Stop     ();
+                Stats Snapshot ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            private: // Method(s) / Function(s)
+
+                void Loop    ();
+                int  Connect ();
+                void Consume (const int a_fd);
+                bool Wait    (const int a_fd, const int a_timeout);
+                void Account (uint64_t Stats::* a_counter);
+
+            private: // Static Method(s) / Function(s)
+
+                static bool Parse (std::string& a_buffer, std::vector<std::string>& o_reply);
+                static bool Line  (const std::string& a_buffer, size_t& io_offset, std::string& o_line);
+
+            }; // end of class 'Listener'
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_config   See \link Config \link.
+             * @param a_callback Function to call for each cancellation message.
+             */
+            inline Listener::Listener (const Config& a_config, Callback a_callback)
+                : config_(a_config), callback_(a_callback)
+            {
+                thread_    = nullptr;
+                running_   = false;
+                wakeup_[0] = wakeup_[1] = -1;
+                stats_     = { 0, 0, 0 };
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Listener::~Listener ()
+            {
+                Stop();
+            }
+
+            /**
+             * @brief Start listener thread.
+             */
+            inline void Listener::Start ()
+            {
+                if ( nullptr != thread_ ) {
+                    throw ::cc::Exception("%s", "Cancellation listener already started!");
+                }
+                if ( 0 != pipe(wakeup_) ) {
+                    throw ::cc::Exception("Unable to create cancellation listener pipe: %s!", strerror(errno));
+                }
+                fcntl(wakeup_[0], F_SETFL, fcntl(wakeup_[0], F_GETFL, 0) | O_NONBLOCK);
+                running_ = true;
+                thread_  = new std::thread(&Listener::Loop, this);
+            }
+
+            /**
+             * @brief Stop listener thread, no callback is called after this call returns.
+             */
+            inline void Listener::Stop ()
+            {
+                if ( nullptr == thread_ ) {
+                    return;
+                }
+                running_ = false;
+                const char byte = 0;
+                (void)write(wakeup_[1], &byte, sizeof(byte));
+                thread_->join();
+                delete thread_;
+                thread_ = nullptr;
+                close(wakeup_[0]);
+                close(wakeup_[1]);
+                wakeup_[0] = wakeup_[1] = -1;
+            }
+
+            /**
+             * @return A copy of the current stats, can be called from any thread.
+             */
+            inline Listener::Stats Listener::Snapshot ()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stats_;
+            }
+
+            /**
+             * @brief Load a cancellation listener configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for a disabled listener.
+             *
+             * @return See \link Config \link.
+             */
+            inline Listener::Config Listener::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_host    = "127.0.0.1";
+                const Json::Value c_port    = 6379;
+                const Json::Value c_channel = "casper-job:cancel";
+                const Json::Value c_retry   = 1000;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                const Config rv = {
+                    /* enabled_ */ ( false == config.isNull() ),
+                    /* host_    */ json.Get(config, "host"   , Json::ValueType::stringValue, &c_host).asString(),
+                    /* port_    */ static_cast<uint16_t>(json.Get(config, "port" , Json::ValueType::uintValue  , &c_port).asUInt()),
+                    /* channel_ */ json.Get(config, "channel", Json::ValueType::stringValue, &c_channel).asString(),
+                    /* retry_   */ static_cast<size_t>(json.Get(config, "retry", Json::ValueType::uintValue  , &c_retry).asUInt64())
+                };
+                if ( true == rv.enabled_ && ( 0 == rv.host_.length() || 0 == rv.port_ || 0 == rv.channel_.length() || 0 == rv.retry_ ) ) {
+                    throw ::cc::Exception("%s", "Invalid cancellation listener configuration!");
+                }
+                return rv;
+            }
+
+            /**
+             * @brief Listener loop: connect, subscribe and consume messages until stopped.
+             */
+            inline void Listener::Loop ()
+            {
+                while ( true == running_ ) {
+                    const int fd = Connect();
+                    if ( -1 != fd ) {
+                        Consume(fd);
+                        close(fd);
+                    }
+                    if ( true == running_ ) {
+                        Account(&Stats::errors_);
+                        // ... back off, unless stopped meanwhile ...
+                        Wait(-1, static_cast<int>(config_.retry_));
+                    }
+                }
+            }
+
+            /**
+             * @brief Connect to REDIS and subscribe to cancellation channel.
+             *
+             * @return Connected socket, -1 on failure.
+             */
+            inline int Listener::Connect ()
+            {
+                struct addrinfo hints;
+                memset(&hints, 0, sizeof(hints));
+                hints.ai_family   = AF_UNSPEC;
+                hints.ai_socktype = SOCK_STREAM;
+                struct addrinfo* addresses = nullptr;
+                if ( 0 != getaddrinfo(config_.host_.c_str(), std::to_string(config_.port_).c_str(), &hints, &addresses) ) {
+                    return -1;
+                }
+                int fd = -1;
+                for ( struct addrinfo* address = addresses ; nullptr != address && -1 == fd ; address = address->ai_next ) {
+                    fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                    if ( -1 != fd && 0 != connect(fd, address->ai_addr, address->ai_addrlen) ) {
+                        close(fd);
+                        fd = -1;
+                    }
+                }
+                freeaddrinfo(addresses);
+                if ( -1 == fd ) {
+                    return -1;
+                }
+                const int nodelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                // ... pattern subscription also matches plain channel names ...
+                const std::string command = "*2\r\n$10\r\nPSUBSCRIBE\r\n$" + std::to_string(config_.channel_.length()) + "\r\n" + config_.channel_ + "\r\n";
+                size_t written = 0;
+                while ( written < command.length() ) {
+                    const ssize_t count = write(fd, command.c_str() + written, command.length() - written);
+                    if ( count <= 0 ) {
+                        close(fd);
+                        return -1;
+                    }
+                    written += static_cast<size_t>(count);
+                }
+                return fd;
+            }
+
+            /**
+             * @brief Read and dispatch messages until connection is lost or listener is stopped.
+             *
+             * @param a_fd Subscribed socket.
+             */
+            inline void Listener::Consume (const int a_fd)
+            {
+                std::string              buffer;
+                std::vector<std::string> reply;
+                char                     chunk[4096];
+                while ( true == running_ ) {
+                    if ( false == Wait(a_fd, -1) ) {
+                        continue;
+                    }
+                    const ssize_t count = read(a_fd, chunk, sizeof(chunk));
+                    if ( count <= 0 ) {
+                        if ( count < 0 && ( EINTR == errno || EAGAIN == errno ) ) {
+                            continue;
+                        }
+                        return;
+                    }
+                    buffer.append(chunk, static_cast<size_t>(count));
+                    while ( true == Parse(buffer, reply) ) {
+                        if ( 3 == reply.size() && "psubscribe" == reply[0] ) {
+                            Account(&Stats::connects_);
+                        } else if ( 4 == reply.size() && "pmessage" == reply[0] && 0 != reply[3].length() ) {
+                            Account(&Stats::messages_);
+                            callback_(reply[3]);
+                        } else if ( 1 == reply.size() && 0 != reply[0].length() && '-' == reply[0][0] ) {
+                            // ... subscription refused ...
+                            return;
+                        }
+                    }
+                }
+            }
+
+            /**
+             * @brief Wait for data on a socket, or for a stop request.
+             *
+             * @param a_fd      Socket to watch, -1 for none.
+             * @param a_timeout In ms, -1 for infinite.
+             *
+             * @return True if socket is readable ( or closed ).
+             */
+            inline bool Listener::Wait (const int a_fd, const int a_timeout)
+            {
+                struct pollfd fds[2] = {
+                    { wakeup_[0], POLLIN, 0 },
+                    { a_fd      , POLLIN, 0 }
+                };
+                const int rv = poll(fds, ( -1 != a_fd ? 2 : 1 ), a_timeout);
+                if ( rv <= 0 ) {
+                    return false;
+                }
+                return ( -1 != a_fd && 0 != fds[1].revents );
+            }
+
+            /**
+             * @brief Increment a stats counter.
+             *
+             * @param a_counter Counter to increment.
+             */
+            inline void Listener::Account (uint64_t Stats::* a_counter)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.*a_counter += 1;
+            }
+
+            /**
+             * @brief Parse a RESP reply: an array of bulk strings / integers, or a single status or error line.
+             *
+             * @param a_buffer Input buffer, consumed bytes are erased.
+             * @param o_reply  Reply elements; a status or error line is kept with it's '+' or '-' prefix.
+             *
+             * @return True if a reply was parsed, false if more data is needed.
+             */
+            inline bool Listener::Parse (std::string& a_buffer, std::vector<std::string>& o_reply)
+            {
+                o_reply.clear();
+                size_t      offset = 0;
+                std::string line;
+                if ( false == Line(a_buffer, offset, line) ) {
+                    return false;
+                }
+                if ( '*' != line[0] ) {
+                    o_reply.push_back(line);
+                    a_buffer.erase(0, offset);
+                    return true;
+                }
+                const long count = strtol(line.c_str() + 1, nullptr, 10);
+                for ( long idx = 0 ; idx < count ; ++idx ) {
+                    if ( false == Line(a_buffer, offset, line) ) {
+                        return false;
+                    }
+                    if ( '$' != line[0] ) {
+                        // ... integer ...
+                        o_reply.push_back(line.substr(1));
+                        continue;
+                    }
+                    const long length = strtol(line.c_str() + 1, nullptr, 10);
+                    if ( length < 0 ) {
+                        o_reply.push_back("");
+                        continue;
+                    }
+                    if ( a_buffer.length() < offset + static_cast<size_t>(length) + 2 ) {
+                        return false;
+                    }
+                    o_reply.push_back(a_buffer.substr(offset, static_cast<size_t>(length)));
+                    offset += static_cast<size_t>(length) + 2;
+                }
+                a_buffer.erase(0, offset);
+                return true;
+            }
+
+            /**
+             * @brief Read a CRLF terminated line.
+             *
+             * @param a_buffer  Input buffer.
+             * @param io_offset Where line starts, on success moved past it's CRLF.
+             * @param o_line    Line, without CRLF.
+             *
+             * @return True if a non-empty line was read, false if more data is needed.
+             */
+            inline bool Listener::Line (const std::string& a_buffer, size_t& io_offset, std::string& o_line)
+            {
+                const size_t eol = a_buffer.find("\r\n", io_offset);
+                if ( std::string::npos == eol || eol == io_offset ) {
+                    return false;
+                }
+                o_line    = a_buffer.substr(io_offset, eol - io_offset);
+                io_offset = eol + 2;
+                return true;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_LISTENER_H_
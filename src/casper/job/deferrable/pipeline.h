@@ -0,0 +1,339 @@
+/**
+ * @file pipeline.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_PIPELINE_H_
+#define CASPER_JOB_DEFERRABLE_PIPELINE_H_
+
+#include "casper/job/deferrable/types.h"
+#include "casper/job/deferrable/hedger.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>     // std::shared_ptr
+#include <chrono>
+#include <functional>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Multi-stage job plan: a graph of stages, each one performed by a single deferred request that is launched
+             *        as soon as all the stages it depends on succeeded.
+             *
+             * Stage outputs are shared, never copied, with the stages that depend on them.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            template <typename S>
+            class Pipeline final
+            {
+
+            public: // Data Type(s)
+
+                typedef std::map<std::string, std::shared_ptr<const Response>> Outputs; //!< Stage name -> Response
+
+                typedef struct {
+                    std::string              name_;
+                    S                        step_;  //!< Published when stage is launched.
+                    std::vector<std::string> after_; //!< Names of the stages it depends on.
+                    std::function<void(const std::string& a_id, const Outputs& a_outputs)> launch_; //!< Dispatch stage request with the provided ID.
+                } Stage;
+
+                typedef std::function<uint16_t(const Outputs&, Json::Value&)> Conclusion; //!< All stage outputs -> job response code.
+
+                typedef struct {
+                    uint64_t runs_;
+                    uint64_t failures_;
+                    uint64_t total_; //!< In ms, sum of all runs.
+                    uint64_t max_;   //!< In ms.
+                } Timing;
+
+            private: // Data Type(s)
+
+                typedef struct {
+                    bool                                  launched_;
+                    bool                                  done_;
+                    std::chrono::steady_clock::time_point launched_at_;
+                } State;
+
+            private: // Const Data
+
+                const std::string        prefix_;
+                const std::vector<Stage> stages_;
+                const Conclusion         conclusion_;
+
+            private: // Data
+
+                std::vector<State> states_;
+                Outputs            outputs_;
+                size_t             running_;
+                size_t             done_;
+                bool               settled_; //!< True once job outcome is known, late stages are just accounted.
+
+            public: // Constructor(s) / Destructor
+
+                Pipeline () = delete;
+                Pipeline (const std::string& a_prefix, const std::vector<Stage>& a_stages, Conclusion a_conclusion);
+                virtual ~Pipeline ();
+
+            public: // Method(s) / Function(s)
+
+                void   Ready    (std::vector<size_t>& o_stages);
+                size_t Find     (const std::string& a_id) const;
+                size_t Complete (const size_t a_stage, const Response& a_response, const bool a_succeeded);
+                void   Settle   ();
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return Request ID of a stage.
+                 *
+                 * @param a_stage Stage index.
+                 */
+                inline std::string id (const size_t a_stage) const
+                {
+                    return prefix_ + "@" + stages_[a_stage].name_;
+                }
+
+                /**
+                 * @return R/O access to a stage.
+                 *
+                 * @param a_stage Stage index.
+                 */
+                inline const Stage& stage (const size_t a_stage) const
+                {
+                    return stages_[a_stage];
+                }
+
+                /**
+                 * @return R/O access to outputs of stages that succeeded so far.
+                 */
+                inline const Outputs& outputs () const
+                {
+                    return outputs_;
+                }
+
+                /**
+                 * @return Function to call when all stages succeeded.
+                 */
+                inline const Conclusion& conclusion () const
+                {
+                    return conclusion_;
+                }
+
+                /**
+                 * @return Number of stages.
+                 */
+                inline size_t size () const
+                {
+                    return stages_.size();
+                }
+
+                /**
+                 * @return True when all stages succeeded.
+                 */
+                inline bool finished () const
+                {
+                    return done_ == stages_.size();
+                }
+
+                /**
+                 * @return True if job outcome is known.
+                 */
+                inline bool settled () const
+                {
+                    return settled_;
+                }
+
+                /**
+                 * @return Number of launched stages not completed yet.
+                 */
+                inline size_t running () const
+                {
+                    return running_;
+                }
+
+            }; // end of class 'Pipeline'
+
+            /**
+             * @brief Default constructor, validates stages graph.
+             *
+             * @param a_prefix     Stage request IDs prefix, usually job's REDIS channel ID.
+             * @param a_stages     Stages, names must be unique and dependencies must not form a cycle.
+             * @param a_conclusion Function to call when all stages succeeded.
+             */
+            template <typename S>
+            inline Pipeline<S>::Pipeline (const std::string& a_prefix, const std::vector<Stage>& a_stages, Conclusion a_conclusion)
+                : prefix_(a_prefix), stages_(a_stages), conclusion_(a_conclusion)
+            {
+                if ( 0 == stages_.size() || nullptr == conclusion_ ) {
+                    throw ::cc::Exception("%s", "Invalid pipeline, at least one stage and a conclusion are required!");
+                }
+                std::map<std::string, size_t> names;
+                for ( size_t idx = 0 ; idx < stages_.size() ; ++idx ) {
+                    if ( 0 == stages_[idx].name_.length() || nullptr == stages_[idx].launch_ || false == names.insert(std::make_pair(stages_[idx].name_, idx)).second ) {
+                        throw ::cc::Exception("Invalid pipeline stage #" SIZET_FMT ", a unique name and a launch function are required!", idx);
+                    }
+                }
+                // ... dependencies must exist and, peeling stages whose dependencies are all peeled, every stage must be reached ...
+                std::vector<size_t> pending(stages_.size(), 0);
+                for ( size_t idx = 0 ; idx < stages_.size() ; ++idx ) {
+                    for ( const auto& name : stages_[idx].after_ ) {
+                        if ( names.end() == names.find(name) ) {
+                            throw ::cc::Exception("Invalid pipeline stage '%s', unknown dependency '%s'!", stages_[idx].name_.c_str(), name.c_str());
+                        }
+                    }
+                    pending[idx] = stages_[idx].after_.size();
+                }
+                std::vector<size_t> peeled;
+                for ( size_t idx = 0 ; idx < stages_.size() ; ++idx ) {
+                    if ( 0 == pending[idx] ) {
+                        peeled.push_back(idx);
+                    }
+                }
+                for ( size_t next = 0 ; next < peeled.size() ; ++next ) {
+                    for ( size_t idx = 0 ; idx < stages_.size() ; ++idx ) {
+                        for ( const auto& name : stages_[idx].after_ ) {
+                            if ( name == stages_[peeled[next]].name_ && 0 == --pending[idx] ) {
+                                peeled.push_back(idx);
+                            }
+                        }
+                    }
+                }
+                if ( peeled.size() != stages_.size() ) {
+                    throw ::cc::Exception("%s", "Invalid pipeline, stage dependencies form a cycle!");
+                }
+                states_.resize(stages_.size(), State({ false, false, std::chrono::steady_clock::time_point() }));
+                running_ = 0;
+                done_    = 0;
+                settled_ = false;
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            template <typename S>
+            inline Pipeline<S>::~Pipeline ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Collect stages that can be launched now, they are marked as launched.
+             *
+             * @param o_stages Stage indexes, cleared first.
+             */
+            template <typename S>
+            inline void Pipeline<S>::Ready (std::vector<size_t>& o_stages)
+            {
+                o_stages.clear();
+                if ( true == settled_ ) {
+                    return;
+                }
+                const auto now = std::chrono::steady_clock::now();
+                for ( size_t idx = 0 ; idx < stages_.size() ; ++idx ) {
+                    if ( true == states_[idx].launched_ ) {
+                        continue;
+                    }
+                    bool ready = true;
+                    for ( const auto& name : stages_[idx].after_ ) {
+                        if ( outputs_.end() == outputs_.find(name) ) {
+                            ready = false;
+                            break;
+                        }
+                    }
+                    if ( true == ready ) {
+                        states_[idx].launched_    = true;
+                        states_[idx].launched_at_ = now;
+                        running_++;
+                        o_stages.push_back(idx);
+                    }
+                }
+            }
+
+            /**
+             * @return Index of the stage a request belongs to, stages.size() if none.
+             *
+             * @param a_id Request ID, an hedge that won it's race answers for it's primary.
+             */
+            template <typename S>
+            inline size_t Pipeline<S>::Find (const std::string& a_id) const
+            {
+                const std::string primary = Hedger::Primary(a_id);
+                for ( size_t idx = 0 ; idx < stages_.size() ; ++idx ) {
+                    if ( primary == this->id(idx) ) {
+                        return idx;
+                    }
+                }
+                return stages_.size();
+            }
+
+            /**
+             * @brief Account a completed stage, if it succeeded it's output becomes available to it's dependents.
+             *
+             * @param a_stage     Stage index.
+             * @param a_response  Stage request response.
+             * @param a_succeeded True if stage succeeded.
+             *
+             * @return Stage duration, in ms.
+             */
+            template <typename S>
+            inline size_t Pipeline<S>::Complete (const size_t a_stage, const Response& a_response, const bool a_succeeded)
+            {
+                State& state = states_[a_stage];
+                if ( false == state.launched_ || true == state.done_ ) {
+                    return 0;
+                }
+                state.done_ = true;
+                running_--;
+                if ( true == a_succeeded ) {
+                    outputs_[stages_[a_stage].name_] = std::make_shared<const Response>(a_response);
+                    done_++;
+                }
+                return static_cast<size_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - state.launched_at_).count());
+            }
+
+            /**
+             * @brief Job outcome is known, no more stages are launched.
+             */
+            template <typename S>
+            inline void Pipeline<S>::Settle ()
+            {
+                settled_ = true;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_PIPELINE_H_
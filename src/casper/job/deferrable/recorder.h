@@ -0,0 +1,428 @@
+/**
+ * @file recorder.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_RECORDER_H_
+#define CASPER_JOB_DEFERRABLE_RECORDER_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "cc/exception.h"
+
+#include "casper/job/deferrable/types.h"
+
+#include "json/json.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h> // strerror
+#include <errno.h>
+#include <string>
+#include <map>
+#include <mutex>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Job traffic recording, append-only binary file.
+             *
+             * File layout:
+             *
+             * header: 'CJRR' <version:u8> <tube length:u16> <tube>
+             * record: <kind:u8> <job id:u64> <length:u32> <data>
+             *
+             * All integers are little endian, record data is compact JSON text.
+             */
+            class Recording
+            {
+
+            public: // Data Type(s)
+
+                enum class Kind : uint8_t {
+                    Payload  = 1, //!< Raw payload passed to Run.
+                    Response = 2, //!< A deferred request response.
+                    Finished = 3  //!< Final response published by 'Finished'.
+                };
+
+                typedef struct {
+                    Kind        kind_;
+                    uint64_t    bjid_;
+                    std::string data_;
+                } Record;
+
+            public: // Static Const Data
+
+                constexpr static const char*   const sk_magic_   = "CJRR";
+                constexpr static const uint8_t       sk_version_ = 1;
+
+            public: // Static Method(s) / Function(s)
+
+                static void Encode (const Response& a_response, Json::Value& o_value);
+                static void Decode (const Json::Value& a_value, Response& o_response);
+
+            }; // end of class 'Recording'
+
+            /**
+             * @brief Writes a \link Recording \link.
+             *
+             * Recorders of the same file, e.g. of tubes running on different threads, share it's handle and append whole records under it's lock.
+             */
+            class Recorder final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            private: // Data Type(s)
+
+                typedef struct {
+                    FILE*      file_;
+                    std::mutex mutex_;
+                    size_t     references_;
+                } Tape;
+
+                typedef struct {
+                    std::mutex                    mutex_;
+                    std::map<std::string, Tape*> tapes_; //!< URI -> Tape
+                } Tapes;
+
+            private: // Data
+
+                std::string      uri_;
+                Tape*            tape_;
+                Json::FastWriter writer_;
+                uint64_t         failures_;
+
+            public: // Constructor(s) / Destructor
+
+                Recorder () = delete;
+                Recorder (const std::string& a_uri, const std::string& a_tube);
+                virtual ~Recorder ();
+
+            public: // Method(s) / Function(s)
+
+                void Payload  (const uint64_t& a_bjid, const std::string& a_payload);
+                void Response (const uint64_t& a_bjid, const deferrable::Response& a_response);
+                void Finished (const uint64_t& a_bjid, const Json::Value& a_response);
+
+            private: // Method(s) / Function(s)
+
+                void Write (const Recording::Kind a_kind, const uint64_t& a_bjid, const std::string& a_data, const bool a_flush);
+
+            private: // Static Method(s) / Function(s)
+
+                static Tapes& Shared ();
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return Number of records that could not be written.
+                 */
+                inline const uint64_t& failures () const
+                {
+                    return failures_;
+                }
+
+            }; // end of class 'Recorder'
+
+            /**
+             * @brief Reads a \link Recording \link.
+             */
+            class Player final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            private: // Data
+
+                FILE*       file_;
+                std::string tube_;
+
+            public: // Constructor(s) / Destructor
+
+                Player () = delete;
+                Player (const std::string& a_uri);
+                virtual ~Player ();
+
+            public: // Method(s) / Function(s)
+
+                bool Next (Recording::Record& o_record);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return R/O access to recorded tube name.
+                 */
+                inline const std::string& tube () const
+                {
+                    return tube_;
+                }
+
+            }; // end of class 'Player'
+
+            // MARK: - Recording
+
+            /**
+             * @brief Serialize a response.
+             *
+             * @param a_response Response to serialize.
+             * @param o_value    JSON object to fill.
+             */
+            inline void Recording::Encode (const deferrable::Response& a_response, Json::Value& o_value)
+            {
+                o_value                 = Json::Value(Json::ValueType::objectValue);
+                o_value["code"]         = a_response.code();
+                o_value["content_type"] = a_response.content_type();
+                o_value["body"]         = a_response.body();
+                o_value["rtt"]          = static_cast<Json::UInt64>(a_response.rtt());
+                o_value["parsed"]       = ( false == a_response.json().isNull() );
+                Json::Value& headers = ( o_value["headers"] = Json::Value(Json::ValueType::objectValue) );
+                for ( const auto& header : a_response.headers() ) {
+                    headers[header.first] = header.second;
+                }
+                if ( nullptr != a_response.exception() ) {
+                    o_value["exception"] = a_response.exception()->what();
+                }
+            }
+
+            /**
+             * @brief Deserialize a response.
+             *
+             * @param a_value    JSON object.
+             * @param o_response Response to fill.
+             */
+            inline void Recording::Decode (const Json::Value& a_value, deferrable::Response& o_response)
+            {
+                const uint16_t code = static_cast<uint16_t>(a_value["code"].asUInt());
+                if ( true == a_value.isMember("exception") ) {
+                    o_response.Set(code, ::cc::Exception("%s", a_value["exception"].asCString()));
+                    return;
+                }
+                std::map<std::string, std::string> headers;
+                const Json::Value& object = a_value["headers"];
+                for ( const auto& name : object.getMemberNames() ) {
+                    headers[name] = object[name].asString();
+                }
+                o_response.Set(code, a_value["content_type"].asString(), headers, a_value["body"].asString(),
+                               static_cast<size_t>(a_value["rtt"].asUInt64()), /* a_parse */ a_value["parsed"].asBool());
+            }
+
+            // MARK: - Recorder
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_uri  Local file URI, created if it does not exist.
+             * @param a_tube Tube name.
+             */
+            inline Recorder::Recorder (const std::string& a_uri, const std::string& a_tube)
+                : uri_(a_uri)
+            {
+                writer_.omitEndingLineFeed();
+                failures_ = 0;
+                Tapes& tapes = Shared();
+                std::lock_guard<std::mutex> lock(tapes.mutex_);
+                const auto it = tapes.tapes_.find(a_uri);
+                if ( tapes.tapes_.end() != it ) {
+                    tape_ = it->second;
+                    tape_->references_++;
+                    return;
+                }
+                FILE* file = fopen(a_uri.c_str(), "ab");
+                if ( nullptr == file ) {
+                    throw ::cc::Exception("Unable to open recording file '%s': %s!", a_uri.c_str(), strerror(errno));
+                }
+                // ... new file?
+                if ( 0 == ftell(file) ) {
+                    const uint16_t length = static_cast<uint16_t>(a_tube.length());
+                    const uint8_t  header[7] = {
+                        static_cast<uint8_t>(Recording::sk_magic_[0]), static_cast<uint8_t>(Recording::sk_magic_[1]),
+                        static_cast<uint8_t>(Recording::sk_magic_[2]), static_cast<uint8_t>(Recording::sk_magic_[3]),
+                        Recording::sk_version_,
+                        static_cast<uint8_t>(length & 0xFF), static_cast<uint8_t>(( length >> 8 ) & 0xFF)
+                    };
+                    fwrite(header, sizeof(header), 1, file);
+                    fwrite(a_tube.c_str(), length, 1, file);
+                    fflush(file);
+                }
+                tape_ = new Tape();
+                tape_->file_       = file;
+                tape_->references_ = 1;
+                tapes.tapes_[a_uri] = tape_;
+            }
+
+            /**
+             * @brief Destructor, file is closed by it's last recorder.
+             */
+            inline Recorder::~Recorder ()
+            {
+                Tapes& tapes = Shared();
+                std::lock_guard<std::mutex> lock(tapes.mutex_);
+                if ( 0 != --tape_->references_ ) {
+                    return;
+                }
+                tapes.tapes_.erase(uri_);
+                fclose(tape_->file_);
+                delete tape_;
+            }
+
+            /**
+             * @brief Record a job raw payload.
+             *
+             * @param a_bjid    BEANSTALKD job id.
+             * @param a_payload Payload, compact JSON text.
+             */
+            inline void Recorder::Payload (const uint64_t& a_bjid, const std::string& a_payload)
+            {
+                Write(Recording::Kind::Payload, a_bjid, a_payload, /* a_flush */ false);
+            }
+
+            /**
+             * @brief Record a deferred request response.
+             *
+             * @param a_bjid     BEANSTALKD job id.
+             * @param a_response Response.
+             */
+            inline void Recorder::Response (const uint64_t& a_bjid, const deferrable::Response& a_response)
+            {
+                Json::Value value;
+                Recording::Encode(a_response, value);
+                Write(Recording::Kind::Response, a_bjid, writer_.write(value), /* a_flush */ false);
+            }
+
+            /**
+             * @brief Record a job final response, job records are flushed.
+             *
+             * @param a_bjid     BEANSTALKD job id.
+             * @param a_response Final response.
+             */
+            inline void Recorder::Finished (const uint64_t& a_bjid, const Json::Value& a_response)
+            {
+                Write(Recording::Kind::Finished, a_bjid, writer_.write(a_response), /* a_flush */ true);
+            }
+
+            /**
+             * @brief Append a record, a failure is only accounted - recording must never fail a job.
+             *
+             * @param a_kind  Record kind.
+             * @param a_bjid  BEANSTALKD job id.
+             * @param a_data  Record data.
+             * @param a_flush True to flush file once record is written.
+             */
+            inline void Recorder::Write (const Recording::Kind a_kind, const uint64_t& a_bjid, const std::string& a_data, const bool a_flush)
+            {
+                uint8_t header[13];
+                header[0] = static_cast<uint8_t>(a_kind);
+                for ( size_t idx = 0 ; idx < 8 ; ++idx ) {
+                    header[1 + idx] = static_cast<uint8_t>(( a_bjid >> ( 8 * idx ) ) & 0xFF);
+                }
+                const uint32_t length = static_cast<uint32_t>(a_data.length());
+                for ( size_t idx = 0 ; idx < 4 ; ++idx ) {
+                    header[9 + idx] = static_cast<uint8_t>(( length >> ( 8 * idx ) ) & 0xFF);
+                }
+                // ... other recorders of this file must not interleave their records ...
+                std::lock_guard<std::mutex> lock(tape_->mutex_);
+                if ( 1 != fwrite(header, sizeof(header), 1, tape_->file_) || ( length > 0 && 1 != fwrite(a_data.c_str(), length, 1, tape_->file_) ) ) {
+                    failures_++;
+                }
+                if ( true == a_flush ) {
+                    fflush(tape_->file_);
+                }
+            }
+
+            /**
+             * @return Process wide open recording files.
+             */
+            inline Recorder::Tapes& Recorder::Shared ()
+            {
+                static Tapes s_tapes;
+                return s_tapes;
+            }
+
+            // MARK: - Player
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_uri Local file URI.
+             */
+            inline Player::Player (const std::string& a_uri)
+            {
+                file_ = fopen(a_uri.c_str(), "rb");
+                if ( nullptr == file_ ) {
+                    throw ::cc::Exception("Unable to open recording file '%s': %s!", a_uri.c_str(), strerror(errno));
+                }
+                uint8_t header[7];
+                if ( 1 != fread(header, sizeof(header), 1, file_) || 0 != memcmp(header, Recording::sk_magic_, 4) || Recording::sk_version_ != header[4] ) {
+                    fclose(file_);
+                    throw ::cc::Exception("File '%s' is not a supported recording!", a_uri.c_str());
+                }
+                tube_.resize(static_cast<size_t>(header[5]) | ( static_cast<size_t>(header[6]) << 8 ));
+                if ( tube_.length() > 0 && 1 != fread(&tube_[0], tube_.length(), 1, file_) ) {
+                    fclose(file_);
+                    throw ::cc::Exception("File '%s' is not a supported recording!", a_uri.c_str());
+                }
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Player::~Player ()
+            {
+                fclose(file_);
+            }
+
+            /**
+             * @brief Read next record.
+             *
+             * @param o_record Record to fill.
+             *
+             * @return False when there are no more ( complete ) records.
+             */
+            inline bool Player::Next (Recording::Record& o_record)
+            {
+                uint8_t header[13];
+                if ( 1 != fread(header, sizeof(header), 1, file_) ) {
+                    return false;
+                }
+                o_record.kind_ = static_cast<Recording::Kind>(header[0]);
+                o_record.bjid_ = 0;
+                for ( size_t idx = 0 ; idx < 8 ; ++idx ) {
+                    o_record.bjid_ |= ( static_cast<uint64_t>(header[1 + idx]) << ( 8 * idx ) );
+                }
+                uint32_t length = 0;
+                for ( size_t idx = 0 ; idx < 4 ; ++idx ) {
+                    length |= ( static_cast<uint32_t>(header[9 + idx]) << ( 8 * idx ) );
+                }
+                o_record.data_.resize(length);
+                // ... a truncated record ( writer crashed ) is ignored ...
+                return ( 0 == length || 1 == fread(&o_record.data_[0], length, 1, file_) );
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_RECORDER_H_
@@ -0,0 +1,278 @@
+/**
+ * @file replay.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_REPLAY_H_
+#define CASPER_JOB_DEFERRABLE_REPLAY_H_
+
+#include "casper/job/deferrable/recorder.h"
+
+#include "cc/easy/json.h"
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief A loaded \link Recording \link, shared by a replay driver and the dispatcher(s) that serve recorded responses.
+             *
+             * Replayed jobs are bound to recorded ones by payload, in recorded order, so that neither the driver
+             * nor the beanstalkd server have to know about recorded job ids.
+             */
+            class Script final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    uint64_t                 bjid_;      //!< Recorded BEANSTALKD job id.
+                    std::string              payload_;
+                    std::vector<Json::Value> responses_;
+                    Json::Value              finished_;
+                } Job;
+
+                typedef struct {
+                    uint64_t              bound_;
+                    uint64_t              unbound_;    //!< Replayed payloads not found in recording.
+                    uint64_t              exhausted_;  //!< Deferred requests without a recorded response.
+                    uint64_t              matched_;    //!< Final responses equal to recorded ones.
+                    uint64_t              mismatched_;
+                    std::vector<uint64_t> mismatches_; //!< First recorded job ids whose final response differs.
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef struct {
+                    size_t index_;  //!< @ jobs_.
+                    size_t cursor_; //!< Next response.
+                } Binding;
+
+            private: // Data
+
+                std::mutex                                 mutex_;
+                std::string                                tube_;
+                std::vector<Job>                           jobs_;     //!< In recorded order.
+                std::map<std::string, std::deque<size_t>>  pending_;  //!< Payload -> unbound indexes @ jobs_.
+                std::map<uint64_t, Binding>                bindings_; //!< Replay job id -> recorded job.
+                Stats                                      stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Script () = delete;
+                Script (const std::string& a_uri);
+                virtual ~Script ();
+
+            public: // Method(s) / Function(s)
+
+                bool  Bind  (const uint64_t& a_bjid, const std::string& a_payload);
+                bool  Next  (const uint64_t& a_bjid, Response& o_response);
+                void  Check (const uint64_t& a_bjid, const Json::Value& a_finished);
+                Stats Snapshot ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Script& Load (const std::string& a_uri);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return R/O access to recorded tube name.
+                 */
+                inline const std::string& tube () const
+                {
+                    return tube_;
+                }
+
+                /**
+                 * @return R/O access to recorded jobs, in recorded order.
+                 */
+                inline const std::vector<Job>& jobs () const
+                {
+                    return jobs_;
+                }
+
+            }; // end of class 'Script'
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_uri Recording local file URI.
+             */
+            inline Script::Script (const std::string& a_uri)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+                Player                     player(a_uri);
+                Recording::Record          record;
+                std::map<uint64_t, size_t> index; // recorded job id -> index @ jobs_
+                tube_  = player.tube();
+                stats_ = { 0, 0, 0, 0, 0, {} };
+                while ( true == player.Next(record) ) {
+                    auto it = index.find(record.bjid_);
+                    if ( index.end() == it ) {
+                        // ... only jobs whose payload was recorded can be replayed ...
+                        if ( Recording::Kind::Payload != record.kind_ ) {
+                            continue;
+                        }
+                        it = index.insert(std::make_pair(record.bjid_, jobs_.size())).first;
+                        jobs_.push_back({ record.bjid_, "", {}, Json::Value::null });
+                    }
+                    Job& job = jobs_[it->second];
+                    switch (record.kind_) {
+                        case Recording::Kind::Payload:
+                            job.payload_ = record.data_;
+                            break;
+                        case Recording::Kind::Response:
+                            job.responses_.push_back(Json::Value::null);
+                            json.Parse(record.data_, job.responses_.back());
+                            break;
+                        case Recording::Kind::Finished:
+                            json.Parse(record.data_, job.finished_);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                for ( size_t idx = 0 ; idx < jobs_.size() ; ++idx ) {
+                    pending_[jobs_[idx].payload_].push_back(idx);
+                }
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Script::~Script ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Bind a replay job to the first unbound recorded job with the same payload, can be called from any thread.
+             *
+             * @param a_bjid    Replay BEANSTALKD job id.
+             * @param a_payload Replay payload, compact JSON text.
+             *
+             * @return False if there's no such recorded job.
+             */
+            inline bool Script::Bind (const uint64_t& a_bjid, const std::string& a_payload)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto it = pending_.find(a_payload);
+                if ( pending_.end() == it || 0 == it->second.size() ) {
+                    stats_.unbound_++;
+                    return false;
+                }
+                bindings_[a_bjid] = { it->second.front(), 0 };
+                it->second.pop_front();
+                stats_.bound_++;
+                return true;
+            }
+
+            /**
+             * @brief Obtain the next recorded response for a replay job, can be called from any thread.
+             *
+             * @param a_bjid     Replay BEANSTALKD job id.
+             * @param o_response Response to fill.
+             *
+             * @return False if job is not bound or if there are no more recorded responses.
+             */
+            inline bool Script::Next (const uint64_t& a_bjid, Response& o_response)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto it = bindings_.find(a_bjid);
+                if ( bindings_.end() == it || it->second.cursor_ >= jobs_[it->second.index_].responses_.size() ) {
+                    stats_.exhausted_++;
+                    return false;
+                }
+                Recording::Decode(jobs_[it->second.index_].responses_[it->second.cursor_++], o_response);
+                return true;
+            }
+
+            /**
+             * @brief Compare a replay job final response with the recorded one, can be called from any thread.
+             *
+             * @param a_bjid     Replay BEANSTALKD job id.
+             * @param a_finished Final response.
+             */
+            inline void Script::Check (const uint64_t& a_bjid, const Json::Value& a_finished)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto it = bindings_.find(a_bjid);
+                if ( bindings_.end() == it ) {
+                    return;
+                }
+                const Job& job = jobs_[it->second.index_];
+                if ( job.finished_ == a_finished ) {
+                    stats_.matched_++;
+                } else {
+                    stats_.mismatched_++;
+                    if ( stats_.mismatches_.size() < 10 ) {
+                        stats_.mismatches_.push_back(job.bjid_);
+                    }
+                }
+                bindings_.erase(it);
+            }
+
+            /**
+             * @return A copy of current \link Stats \link, can be called from any thread.
+             */
+            inline Script::Stats Script::Snapshot ()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stats_;
+            }
+
+            /**
+             * @brief Load a recording, once per process.
+             *
+             * @param a_uri Recording local file URI.
+             *
+             * @return Process wide script for the provided recording.
+             */
+            inline Script& Script::Load (const std::string& a_uri)
+            {
+                static std::mutex                      s_mutex;
+                static std::map<std::string, Script*>  s_scripts;
+                std::lock_guard<std::mutex> lock(s_mutex);
+                const auto it = s_scripts.find(a_uri);
+                if ( s_scripts.end() != it ) {
+                    return *it->second;
+                }
+                Script* script = new Script(a_uri);
+                s_scripts[a_uri] = script;
+                return *script;
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_REPLAY_H_
@@ -0,0 +1,326 @@
+/**
+ * @file throttle.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_DEFERRABLE_THROTTLE_H_
+#define CASPER_JOB_DEFERRABLE_THROTTLE_H_
+
+#include "cc/easy/json.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <chrono>
+#include <cmath>     // std::ceil
+#include <algorithm> // std::min, std::max
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace deferrable
+        {
+
+            /**
+             * @brief Token bucket rate limiter, with an optional bucket per tenant.
+             *
+             * A request needs one token from the dispatcher bucket and, if tenants are limited, one from it's tenant bucket.
+             *
+             * Not thread safe, owner must serialize calls.
+             */
+            class Throttle final
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    bool        enabled_;
+                    double      rate_;         //!< Tokens per second, 0 for no dispatcher limit.
+                    double      burst_;        //!< Bucket capacity.
+                    std::string tenant_;       //!< Payload field that identifies a tenant, empty for no tenant limit.
+                    double      tenant_rate_;  //!< Tokens per second, per tenant, 0 for no tenant limit.
+                    double      tenant_burst_; //!< Tenant bucket capacity.
+                    size_t      max_wait_;     //!< In ms, how long a request can wait for a token.
+                } Config;
+
+                typedef struct {
+                    uint64_t passed_;  //!< Requests that got a token.
+                    uint64_t delayed_; //!< Requests that had to wait for a token.
+                    uint64_t expired_; //!< Requests that waited longer than allowed.
+                    size_t   tenants_; //!< Tenant buckets being tracked.
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+                typedef struct {
+                    double    tokens_;
+                    TimePoint last_;
+                } Bucket;
+
+            private: // Data
+
+                Config                        config_;
+                Bucket                        bucket_;
+                std::map<std::string, Bucket> tenants_;
+                Stats                         stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Throttle ();
+                virtual ~Throttle ();
+
+            public: // Method(s) / Function(s)
+
+                void   Setup  (const Config& a_config);
+                size_t Take   (const std::string& a_tenant);
+                void   Delay  ();
+                void   Expire ();
+                void   Reset  ();
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            private: // Method(s) / Function(s)
+
+                void   Refill (Bucket& a_bucket, const double a_rate, const double a_burst, const TimePoint& a_now) const;
+                double Need   (const Bucket& a_bucket, const double a_rate) const;
+                void   Sweep  (const TimePoint& a_now);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return True if throttling is enabled.
+                 */
+                inline bool enabled () const
+                {
+                    return config_.enabled_;
+                }
+
+                /**
+                 * @return R/O access to \link Config \link.
+                 */
+                inline const Config& config () const
+                {
+                    return config_;
+                }
+
+                /**
+                 * @return R/O access to \link Stats \link.
+                 */
+                inline const Stats& stats () const
+                {
+                    return stats_;
+                }
+
+            }; // end of class 'Throttle'
+
+            /**
+             * @brief Default constructor, throttling is disabled.
+             */
+            inline Throttle::Throttle ()
+            {
+                Setup(Load(Json::Value::null));
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Throttle::~Throttle ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Apply a new configuration, buckets start full.
+             *
+             * @param a_config See \link Config \link.
+             */
+            inline void Throttle::Setup (const Config& a_config)
+            {
+                config_ = a_config;
+                Reset();
+            }
+
+            /**
+             * @brief Try to take a token.
+             *
+             * @param a_tenant Tenant, empty if unknown.
+             *
+             * @return 0 if token was taken, otherwise amount of time ( in ms ) until one might be available.
+             */
+            inline size_t Throttle::Take (const std::string& a_tenant)
+            {
+                const TimePoint now = std::chrono::steady_clock::now();
+                Refill(bucket_, config_.rate_, config_.burst_, now);
+                Bucket* tenant = nullptr;
+                if ( config_.tenant_rate_ > 0.0 && 0 != a_tenant.length() ) {
+                    auto it = tenants_.find(a_tenant);
+                    if ( tenants_.end() == it ) {
+                        if ( tenants_.size() >= 4096 ) {
+                            Sweep(now);
+                        }
+                        it = tenants_.insert(std::make_pair(a_tenant, Bucket({ config_.tenant_burst_, now }))).first;
+                        stats_.tenants_ = tenants_.size();
+                    }
+                    tenant = &it->second;
+                    Refill(*tenant, config_.tenant_rate_, config_.tenant_burst_, now);
+                }
+                const double need = std::max(Need(bucket_, config_.rate_), ( nullptr != tenant ? Need(*tenant, config_.tenant_rate_) : 0.0 ));
+                if ( need > 0.0 ) {
+                    return std::max(static_cast<size_t>(std::ceil(need * 1000.0)), static_cast<size_t>(1));
+                }
+                if ( config_.rate_ > 0.0 ) {
+                    bucket_.tokens_ -= 1.0;
+                }
+                if ( nullptr != tenant ) {
+                    tenant->tokens_ -= 1.0;
+                }
+                stats_.passed_++;
+                return 0;
+            }
+
+            /**
+             * @brief Account a request that must wait for a token.
+             */
+            inline void Throttle::Delay ()
+            {
+                stats_.delayed_++;
+            }
+
+            /**
+             * @brief Account a request that waited too long for a token.
+             */
+            inline void Throttle::Expire ()
+            {
+                stats_.expired_++;
+            }
+
+            /**
+             * @brief Refill all buckets and forget stats.
+             */
+            inline void Throttle::Reset ()
+            {
+                bucket_ = { config_.burst_, std::chrono::steady_clock::now() };
+                tenants_.clear();
+                stats_  = { 0, 0, 0, 0 };
+            }
+
+            /**
+             * @brief Load a throttle configuration from it's JSON representation.
+             *
+             * @param a_config JSON object, null for disabled throttling.
+             *
+             * @return See \link Config \link.
+             */
+            inline Throttle::Config Throttle::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_zero     = 0.0;
+                const Json::Value c_tenant   = "";
+                const Json::Value c_max_wait = 30000;
+
+                const Json::Value& config = ( true == a_config.isObject() ? a_config : Json::Value::null );
+
+                Config rv = {
+                    /* enabled_      */ ( false == config.isNull() ),
+                    /* rate_         */ json.Get(config, "rate"        , Json::ValueType::realValue  , &c_zero).asDouble(),
+                    /* burst_        */ json.Get(config, "burst"       , Json::ValueType::realValue  , &c_zero).asDouble(),
+                    /* tenant_       */ json.Get(config, "tenant"      , Json::ValueType::stringValue, &c_tenant).asString(),
+                    /* tenant_rate_  */ json.Get(config, "tenant-rate" , Json::ValueType::realValue  , &c_zero).asDouble(),
+                    /* tenant_burst_ */ json.Get(config, "tenant-burst", Json::ValueType::realValue  , &c_zero).asDouble(),
+                    /* max_wait_     */ static_cast<size_t>(json.Get(config, "max-wait", Json::ValueType::uintValue, &c_max_wait).asUInt64())
+                };
+                if ( false == rv.enabled_ ) {
+                    return rv;
+                }
+                if ( 0 == rv.tenant_.length() ) {
+                    rv.tenant_rate_ = 0.0;
+                }
+                // ... burst defaults to one second worth of tokens ...
+                rv.burst_        = ( rv.burst_        > 0.0 ? rv.burst_        : std::max(rv.rate_, 1.0) );
+                rv.tenant_burst_ = ( rv.tenant_burst_ > 0.0 ? rv.tenant_burst_ : std::max(rv.tenant_rate_, 1.0) );
+                if ( rv.rate_ < 0.0 || rv.tenant_rate_ < 0.0 || ( 0.0 == rv.rate_ && 0.0 == rv.tenant_rate_ ) || rv.burst_ < 1.0 || rv.tenant_burst_ < 1.0 ) {
+                    throw ::cc::Exception("%s", "Invalid throttle configuration!");
+                }
+                return rv;
+            }
+
+            /**
+             * @brief Add tokens accrued since last refill.
+             *
+             * @param a_bucket Bucket to refill.
+             * @param a_rate   Tokens per second.
+             * @param a_burst  Bucket capacity.
+             * @param a_now    Current time.
+             */
+            inline void Throttle::Refill (Bucket& a_bucket, const double a_rate, const double a_burst, const TimePoint& a_now) const
+            {
+                const double elapsed = std::chrono::duration<double>(a_now - a_bucket.last_).count();
+                a_bucket.tokens_ = std::min(a_burst, a_bucket.tokens_ + elapsed * a_rate);
+                a_bucket.last_   = a_now;
+            }
+
+            /**
+             * @return Time, in seconds, until a bucket holds a token; 0 if it already does or if it's not limited.
+             *
+             * @param a_bucket Bucket to check.
+             * @param a_rate   Tokens per second.
+             */
+            inline double Throttle::Need (const Bucket& a_bucket, const double a_rate) const
+            {
+                if ( a_rate <= 0.0 || a_bucket.tokens_ >= 1.0 ) {
+                    return 0.0;
+                }
+                return ( 1.0 - a_bucket.tokens_ ) / a_rate;
+            }
+
+            /**
+             * @brief Forget tenant buckets that are full, they are recreated as full when needed.
+             *
+             * @param a_now Current time.
+             */
+            inline void Throttle::Sweep (const TimePoint& a_now)
+            {
+                for ( auto it = tenants_.begin() ; tenants_.end() != it ; ) {
+                    Refill(it->second, config_.tenant_rate_, config_.tenant_burst_, a_now);
+                    if ( it->second.tokens_ >= config_.tenant_burst_ ) {
+                        it = tenants_.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                stats_.tenants_ = tenants_.size();
+            }
+
+        } // end of namespace 'deferrable'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_DEFERRABLE_THROTTLE_H_
@@ -24,6 +24,7 @@
 
 #include <inttypes.h>
 #include <string>
+#include <memory> // std::shared_ptr
 
 #include "json/json.h"
 
@@ -32,6 +33,9 @@
 #include "cc/i18n/singleton.h"
 #include "cc/exception.h"
 
+// ... non-standard 'Client Closed Request', a job's client gave up waiting for it ...
+#define CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED 499
+
 namespace casper
 {
 
@@ -56,8 +60,8 @@ namespace casper
                 
                 uint16_t                           code_;
                 std::map<std::string, std::string> headers_;
-                std::string                        body_;
-                Json::Value                        json_;
+                std::shared_ptr<const std::string> body_; //!< Immutable once set, shared between copies.
+                std::shared_ptr<const Json::Value> json_; //!< Immutable once set, shared between copies.
                 std::string                        content_type_;
                 size_t                             rtt_;
                 cc::Exception*                     exception_;
@@ -112,7 +116,6 @@ namespace casper
                     code_         = a_response.code_;
                     headers_      = a_response.headers_;
                     body_         = a_response.body_;
-                    json_.clear();
                     json_         = a_response.json_;
                     content_type_ = a_response.content_type_;
                     rtt_          = a_response.rtt_;
@@ -135,7 +138,7 @@ namespace casper
                 {
                     code_         = a_code;
                     headers_.clear();
-                    body_         = a_body;
+                    body_         = std::make_shared<const std::string>(a_body);
                     content_type_ = a_content_type;
                     if ( nullptr != exception_ ) {
                         delete exception_;
@@ -145,7 +148,7 @@ namespace casper
                     if ( true == a_parse ) {
                         Parse();
                     } else {
-                        json_.clear(); json_ = Json::Value::null;
+                        json_ = nullptr;
                     }
                 }
                 
@@ -172,7 +175,7 @@ namespace casper
                             headers_["Content-Length"] = std::to_string(a_body.length());
                         }
                     }
-                    body_         = a_body;
+                    body_         = std::make_shared<const std::string>(a_body);
                     content_type_ = a_content_type;
                     if ( nullptr != exception_ ) {
                         delete exception_;
@@ -182,7 +185,7 @@ namespace casper
                     if ( true == a_parse ) {
                         Parse();
                     } else {
-                        json_.clear(); json_ = Json::Value::null;
+                        json_ = nullptr;
                     }
                 }
                 
@@ -200,17 +203,17 @@ namespace casper
                 {
                     code_ = a_code;
                     headers_.clear();
-                    body_.clear();
+                    body_         = nullptr;
                     content_type_ = a_content_type;
                     if ( nullptr != exception_ ) {
                         delete exception_;
                         exception_ = nullptr;
                     }
                     rtt_ = a_rtt;
-                    json_.clear();
-                    json_                      = Json::Value(Json::ValueType::objectValue);
-                    json_["error"]             = a_error;
-                    json_["error_description"] = a_error_description;
+                    const auto json = std::make_shared<Json::Value>(Json::ValueType::objectValue);
+                    (*json)["error"]             = a_error;
+                    (*json)["error_description"] = a_error_description;
+                    json_ = json;
                 }
                 
                 /**
@@ -218,9 +221,11 @@ namespace casper
                  */
                 inline void Parse ()
                 {
-                    json_.clear(); json_ = Json::Value::null;
+                    json_ = nullptr;
                     if ( 0 == strncasecmp(content_type_.c_str(), "application/json", sizeof(char) * 16) ) {
-                        const ::cc::easy::JSON<::cc::Exception> json; json.Parse(body_, json_);
+                        const auto value = std::make_shared<Json::Value>();
+                        const ::cc::easy::JSON<::cc::Exception> json; json.Parse(body(), *value);
+                        json_ = value;
                     } else {
                         throw ::cc::Exception("Content-Type '%s' as JSON not supported!", content_type_.c_str());
                     }
@@ -251,9 +256,8 @@ namespace casper
                 {
                     code_         = a_code;
                     headers_.clear();
-                    body_.clear();
-                    json_.clear();
-                    json_         = Json::Value::null;
+                    body_         = nullptr;
+                    json_         = nullptr;
                     content_type_ = "";
                     rtt_          = 0;
                     if ( nullptr != exception_ ) {
@@ -295,7 +299,8 @@ namespace casper
                  */
                 inline const std::string& body () const
                 {
-                    return body_;
+                    static const std::string s_empty;
+                    return ( nullptr != body_ ? *body_ : s_empty );
                 }
                 
                 /**
@@ -303,7 +308,7 @@ namespace casper
                  */
                 inline const Json::Value& json () const
                 {
-                    return json_;
+                    return ( nullptr != json_ ? *json_ : Json::Value::null );
                 }
                 
                 /**
@@ -0,0 +1,490 @@
+/**
+ * @file envelope.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_ENVELOPE_H_
+#define CASPER_JOB_ENVELOPE_H_
+
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <limits>   // std::numeric_limits
+#include <string.h> // strlen, strncmp
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        /**
+         * @brief Job envelope pre-scanner: reads only the control fields of a job payload straight from it's raw text,
+         *        so that a job can be rejected before it's ( possibly huge ) payload is parsed.
+         *
+         * Values are skipped, not parsed nor fully validated, and nothing is allocated for them; only header strings and member
+         * names are copied.
+         */
+        class Envelope final
+        {
+
+        public: // Data Type(s)
+
+            typedef struct {
+                bool                     wrapped_;      //!< Has 'body' and 'headers', control fields are read from 'body'.
+                bool                     broker_;       //!< Wrapped and has '__nginx_broker__', injected by nginx-broker.
+                bool                     has_ttr_;
+                uint64_t                 ttr_;          //!< In seconds, valid if \link has_ttr_ \link.
+                bool                     has_validity_;
+                uint64_t                 validity_;     //!< In seconds, valid if \link has_validity_ \link.
+                std::vector<std::string> headers_;      //!< 'headers' strings, if wrapped.
+                size_t                   body_offset_;  //!< Where 'body' value starts in raw text, if wrapped.
+                size_t                   body_length_;  //!< 'body' value length, 0 if there's none.
+            } Fields;
+
+        public: // Constructor(s) / Destructor
+
+            Envelope () = delete;
+
+        public: // Static Method(s) / Function(s)
+
+            static bool Peek (const char* const a_data, const size_t a_length, Fields& o_fields);
+
+        private: // Static Method(s) / Function(s)
+
+            template <typename F>
+            static bool Members  (const char* const a_data, const size_t a_length, size_t& io_offset, F a_visit);
+            static bool Skip     (const char* const a_data, const size_t a_length, size_t& io_offset);
+            static bool String   (const char* const a_data, const size_t a_length, size_t& io_offset, std::string* o_value);
+            static bool Unsigned (const char* const a_data, const size_t a_length, size_t& io_offset, bool& o_set, uint64_t& o_value);
+            static void Space    (const char* const a_data, const size_t a_length, size_t& io_offset);
+            static void Append   (const uint32_t a_code_point, std::string& o_value);
+
+        private: // Static Inline Method(s) / Function(s)
+
+            /**
+             * @return True if a character may be part of a number.
+             *
+             * @param a_c Character to test.
+             */
+            static inline bool Numeric (const char a_c)
+            {
+                return ( ( a_c >= '0' && a_c <= '9' ) || '-' == a_c || '+' == a_c || '.' == a_c || 'e' == a_c || 'E' == a_c );
+            }
+
+        }; // end of class 'Envelope'
+
+        /**
+         * @brief Scan a job payload raw text.
+         *
+         * @param a_data   Payload text.
+         * @param a_length Payload text length.
+         * @param o_fields See \link Fields \link, fields absent or of an unexpected type are reported as not set.
+         *
+         * @return False if payload is not a well formed JSON object, it must be fully parsed to find out why.
+         */
+        inline bool Envelope::Peek (const char* const a_data, const size_t a_length, Fields& o_fields)
+        {
+            o_fields.wrapped_      = false;
+            o_fields.broker_       = false;
+            o_fields.has_ttr_      = false;
+            o_fields.ttr_          = 0;
+            o_fields.has_validity_ = false;
+            o_fields.validity_     = 0;
+            o_fields.headers_.clear();
+            o_fields.body_offset_  = 0;
+            o_fields.body_length_  = 0;
+
+            bool     has_body = false, has_headers = false, has_marker = false;
+            bool     has_ttr[2]      = { false, false }; //!< [0] top-level, [1] 'body'
+            uint64_t ttr[2]          = { 0, 0 };
+            bool     has_validity[2] = { false, false };
+            uint64_t validity[2]     = { 0, 0 };
+
+            const auto control = [a_data, a_length] (const std::string& a_key, size_t& io_offset, bool& o_has_ttr, uint64_t& o_ttr, bool& o_has_validity, uint64_t& o_validity) -> bool {
+                if ( 0 == a_key.compare("ttr") ) {
+                    return Unsigned(a_data, a_length, io_offset, o_has_ttr, o_ttr);
+                } else if ( 0 == a_key.compare("validity") ) {
+                    return Unsigned(a_data, a_length, io_offset, o_has_validity, o_validity);
+                }
+                return Skip(a_data, a_length, io_offset);
+            };
+
+            size_t offset = 0;
+            const bool rv = Members(a_data, a_length, offset, [&] (const std::string& a_key, size_t& io_offset) -> bool {
+                if ( 0 == a_key.compare("body") ) {
+                    has_body = true;
+                    o_fields.body_offset_ = io_offset;
+                    has_ttr[1] = has_validity[1] = false;
+                    bool ok;
+                    if ( '{' == a_data[io_offset] ) {
+                        ok = Members(a_data, a_length, io_offset, [&] (const std::string& a_member, size_t& io_member_offset) -> bool {
+                            return control(a_member, io_member_offset, has_ttr[1], ttr[1], has_validity[1], validity[1]);
+                        });
+                    } else {
+                        ok = Skip(a_data, a_length, io_offset);
+                    }
+                    o_fields.body_length_ = io_offset - o_fields.body_offset_;
+                    return ok;
+                } else if ( 0 == a_key.compare("headers") ) {
+                    has_headers = true;
+                    o_fields.headers_.clear();
+                    if ( '[' != a_data[io_offset] ) {
+                        return Skip(a_data, a_length, io_offset);
+                    }
+                    io_offset++;
+                    Space(a_data, a_length, io_offset);
+                    if ( io_offset < a_length && ']' == a_data[io_offset] ) {
+                        io_offset++;
+                        return true;
+                    }
+                    while ( io_offset < a_length ) {
+                        if ( '"' == a_data[io_offset] ) {
+                            std::string header;
+                            if ( false == String(a_data, a_length, io_offset, &header) ) {
+                                return false;
+                            }
+                            o_fields.headers_.push_back(header);
+                        } else if ( false == Skip(a_data, a_length, io_offset) ) {
+                            return false;
+                        }
+                        Space(a_data, a_length, io_offset);
+                        if ( io_offset >= a_length ) {
+                            return false;
+                        } else if ( ']' == a_data[io_offset] ) {
+                            io_offset++;
+                            return true;
+                        } else if ( ',' != a_data[io_offset] ) {
+                            return false;
+                        }
+                        io_offset++;
+                        Space(a_data, a_length, io_offset);
+                    }
+                    return false;
+                } else if ( 0 == a_key.compare("__nginx_broker__") ) {
+                    has_marker = true;
+                    return Skip(a_data, a_length, io_offset);
+                }
+                return control(a_key, io_offset, has_ttr[0], ttr[0], has_validity[0], validity[0]);
+            });
+            if ( false == rv ) {
+                return false;
+            }
+            // ... nothing but white space may follow ...
+            Space(a_data, a_length, offset);
+            if ( offset != a_length ) {
+                return false;
+            }
+            // ... same rules as Basic::Payload ...
+            o_fields.wrapped_ = ( true == has_body && true == has_headers );
+            o_fields.broker_  = ( true == o_fields.wrapped_ && true == has_marker );
+            const size_t idx  = ( true == o_fields.wrapped_ ? 1 : 0 );
+            o_fields.has_ttr_      = has_ttr[idx];
+            o_fields.ttr_          = ttr[idx];
+            o_fields.has_validity_ = has_validity[idx];
+            o_fields.validity_     = validity[idx];
+            if ( false == o_fields.wrapped_ ) {
+                o_fields.headers_.clear();
+                o_fields.body_offset_ = 0;
+                o_fields.body_length_ = 0;
+            }
+            return true;
+        }
+
+        /**
+         * @brief Walk an object members, a visitor must consume each value.
+         *
+         * @param a_data    Raw text.
+         * @param a_length  Raw text length.
+         * @param io_offset Where the object starts, on success moved past it's end.
+         * @param a_visit   Called with member name and value offset, returns false to abort.
+         *
+         * @return False if object is not well formed or visitor aborted.
+         */
+        template <typename F>
+        inline bool Envelope::Members (const char* const a_data, const size_t a_length, size_t& io_offset, F a_visit)
+        {
+            Space(a_data, a_length, io_offset);
+            if ( io_offset >= a_length || '{' != a_data[io_offset] ) {
+                return false;
+            }
+            io_offset++;
+            Space(a_data, a_length, io_offset);
+            if ( io_offset < a_length && '}' == a_data[io_offset] ) {
+                io_offset++;
+                return true;
+            }
+            std::string key;
+            while ( io_offset < a_length ) {
+                key.clear();
+                if ( false == String(a_data, a_length, io_offset, &key) ) {
+                    return false;
+                }
+                Space(a_data, a_length, io_offset);
+                if ( io_offset >= a_length || ':' != a_data[io_offset] ) {
+                    return false;
+                }
+                io_offset++;
+                Space(a_data, a_length, io_offset);
+                if ( io_offset >= a_length || false == a_visit(key, io_offset) ) {
+                    return false;
+                }
+                Space(a_data, a_length, io_offset);
+                if ( io_offset >= a_length ) {
+                    return false;
+                } else if ( '}' == a_data[io_offset] ) {
+                    io_offset++;
+                    return true;
+                } else if ( ',' != a_data[io_offset] ) {
+                    return false;
+                }
+                io_offset++;
+                Space(a_data, a_length, io_offset);
+            }
+            return false;
+        }
+
+        /**
+         * @brief Skip a value, without parsing it.
+         *
+         * @param a_data    Raw text.
+         * @param a_length  Raw text length.
+         * @param io_offset Where the value starts, on success moved past it's end.
+         *
+         * @return False if value is not well formed.
+         */
+        inline bool Envelope::Skip (const char* const a_data, const size_t a_length, size_t& io_offset)
+        {
+            if ( io_offset >= a_length ) {
+                return false;
+            }
+            switch ( a_data[io_offset] ) {
+                case '"':
+                    return String(a_data, a_length, io_offset, nullptr);
+                case '{':
+                case '[':
+                {
+                    // ... only brackets outside strings count, nesting is validated by full parse ...
+                    size_t depth = 0;
+                    while ( io_offset < a_length ) {
+                        const char c = a_data[io_offset];
+                        if ( '"' == c ) {
+                            if ( false == String(a_data, a_length, io_offset, nullptr) ) {
+                                return false;
+                            }
+                            continue;
+                        }
+                        if ( '{' == c || '[' == c ) {
+                            depth++;
+                        } else if ( '}' == c || ']' == c ) {
+                            if ( 0 == --depth ) {
+                                io_offset++;
+                                return true;
+                            }
+                        }
+                        io_offset++;
+                    }
+                    return false;
+                }
+                case 't':
+                case 'f':
+                case 'n':
+                {
+                    for ( const char* const literal : { "true", "false", "null" } ) {
+                        const size_t length = strlen(literal);
+                        if ( io_offset + length <= a_length && 0 == strncmp(a_data + io_offset, literal, length) ) {
+                            io_offset += length;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                default:
+                {
+                    const size_t start = io_offset;
+                    while ( io_offset < a_length && true == Numeric(a_data[io_offset]) ) {
+                        io_offset++;
+                    }
+                    return ( io_offset > start );
+                }
+            }
+        }
+
+        /**
+         * @brief Read, or skip, a string.
+         *
+         * @param a_data    Raw text.
+         * @param a_length  Raw text length.
+         * @param io_offset Where the string starts, on success moved past it's closing quote.
+         * @param o_value   If not null, unescaped string is appended to it.
+         *
+         * @return False if string is not well formed.
+         */
+        inline bool Envelope::String (const char* const a_data, const size_t a_length, size_t& io_offset, std::string* o_value)
+        {
+            if ( io_offset >= a_length || '"' != a_data[io_offset] ) {
+                return false;
+            }
+            io_offset++;
+            while ( io_offset < a_length ) {
+                const char c = a_data[io_offset++];
+                if ( '"' == c ) {
+                    return true;
+                } else if ( '\\' != c ) {
+                    if ( nullptr != o_value ) {
+                        o_value->push_back(c);
+                    }
+                    continue;
+                }
+                if ( io_offset >= a_length ) {
+                    return false;
+                }
+                const char e = a_data[io_offset++];
+                if ( 'u' == e ) {
+                    // ... \uXXXX, possibly a surrogate pair ...
+                    const auto hex = [a_data, a_length] (size_t& io_at, uint32_t& o_unit) -> bool {
+                        if ( io_at + 4 > a_length ) {
+                            return false;
+                        }
+                        o_unit = 0;
+                        for ( size_t idx = 0 ; idx < 4 ; ++idx ) {
+                            const char h = a_data[io_at++];
+                            o_unit <<= 4;
+                            if ( h >= '0' && h <= '9' ) {
+                                o_unit |= static_cast<uint32_t>(h - '0');
+                            } else if ( h >= 'a' && h <= 'f' ) {
+                                o_unit |= static_cast<uint32_t>(h - 'a' + 10);
+                            } else if ( h >= 'A' && h <= 'F' ) {
+                                o_unit |= static_cast<uint32_t>(h - 'A' + 10);
+                            } else {
+                                return false;
+                            }
+                        }
+                        return true;
+                    };
+                    uint32_t unit;
+                    if ( false == hex(io_offset, unit) ) {
+                        return false;
+                    }
+                    if ( unit >= 0xD800 && unit <= 0xDBFF && io_offset + 6 <= a_length && '\\' == a_data[io_offset] && 'u' == a_data[io_offset + 1] ) {
+                        size_t   at = io_offset + 2;
+                        uint32_t low;
+                        if ( true == hex(at, low) && low >= 0xDC00 && low <= 0xDFFF ) {
+                            unit      = 0x10000 + ( ( unit - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+                            io_offset = at;
+                        }
+                    }
+                    if ( nullptr != o_value ) {
+                        Append(unit, *o_value);
+                    }
+                    continue;
+                }
+                if ( nullptr == o_value ) {
+                    continue;
+                }
+                switch ( e ) {
+                    case 'b': o_value->push_back('\b'); break;
+                    case 'f': o_value->push_back('\f'); break;
+                    case 'n': o_value->push_back('\n'); break;
+                    case 'r': o_value->push_back('\r'); break;
+                    case 't': o_value->push_back('\t'); break;
+                    default : o_value->push_back(e);    break;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @brief Read an unsigned integer value, any other value is skipped.
+         *
+         * @param a_data    Raw text.
+         * @param a_length  Raw text length.
+         * @param io_offset Where the value starts, on success moved past it's end.
+         * @param o_set     True if value is an unsigned integer.
+         * @param o_value   Value, if \link o_set \link.
+         *
+         * @return False if value is not well formed.
+         */
+        inline bool Envelope::Unsigned (const char* const a_data, const size_t a_length, size_t& io_offset, bool& o_set, uint64_t& o_value)
+        {
+            const size_t start = io_offset;
+            uint64_t     value = 0;
+            while ( io_offset < a_length && a_data[io_offset] >= '0' && a_data[io_offset] <= '9' ) {
+                const uint64_t digit = static_cast<uint64_t>(a_data[io_offset] - '0');
+                if ( value > ( std::numeric_limits<uint64_t>::max() - digit ) / 10 ) {
+                    break;
+                }
+                value = value * 10 + digit;
+                io_offset++;
+            }
+            if ( io_offset > start && ( io_offset >= a_length || false == Numeric(a_data[io_offset]) ) ) {
+                o_set   = true;
+                o_value = value;
+                return true;
+            }
+            // ... not an unsigned integer, leave it to full parse ...
+            o_set     = false;
+            io_offset = start;
+            return Skip(a_data, a_length, io_offset);
+        }
+
+        /**
+         * @brief Skip white space.
+         *
+         * @param a_data    Raw text.
+         * @param a_length  Raw text length.
+         * @param io_offset Current offset, moved to next non white space character.
+         */
+        inline void Envelope::Space (const char* const a_data, const size_t a_length, size_t& io_offset)
+        {
+            while ( io_offset < a_length && ( ' ' == a_data[io_offset] || '\t' == a_data[io_offset] || '\n' == a_data[io_offset] || '\r' == a_data[io_offset] ) ) {
+                io_offset++;
+            }
+        }
+
+        /**
+         * @brief Append a code point, UTF-8 encoded.
+         *
+         * @param a_code_point Unicode code point.
+         * @param o_value      String to append to.
+         */
+        inline void Envelope::Append (const uint32_t a_code_point, std::string& o_value)
+        {
+            if ( a_code_point < 0x80 ) {
+                o_value.push_back(static_cast<char>(a_code_point));
+            } else if ( a_code_point < 0x800 ) {
+                o_value.push_back(static_cast<char>(0xC0 | ( a_code_point >> 6 )));
+                o_value.push_back(static_cast<char>(0x80 | ( a_code_point & 0x3F )));
+            } else if ( a_code_point < 0x10000 ) {
+                o_value.push_back(static_cast<char>(0xE0 | ( a_code_point >> 12 )));
+                o_value.push_back(static_cast<char>(0x80 | ( ( a_code_point >> 6 ) & 0x3F )));
+                o_value.push_back(static_cast<char>(0x80 | ( a_code_point & 0x3F )));
+            } else {
+                o_value.push_back(static_cast<char>(0xF0 | ( a_code_point >> 18 )));
+                o_value.push_back(static_cast<char>(0x80 | ( ( a_code_point >> 12 ) & 0x3F )));
+                o_value.push_back(static_cast<char>(0x80 | ( ( a_code_point >> 6 ) & 0x3F )));
+                o_value.push_back(static_cast<char>(0x80 | ( a_code_point & 0x3F )));
+            }
+        }
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_ENVELOPE_H_
@@ -0,0 +1,502 @@
+/**
+ * @file beanstalkd.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_FAKE_BEANSTALKD_H_
+#define CASPER_JOB_FAKE_BEANSTALKD_H_
+
+#include "casper/job/fake/server.h"
+
+#include <set>
+#include <list>
+#include <chrono>
+#include <sstream>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace fake
+        {
+
+            /**
+             * @brief In-process beanstalkd stand-in.
+             *
+             * Implements the subset of the beanstalkd text protocol used by job consumers:
+             * use, watch, ignore, put, reserve, reserve-with-timeout, delete, release, bury, touch, list-tube-used and quit.
+             */
+            class Beanstalkd final : public Server
+            {
+
+            public: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+                typedef struct {
+                    std::function<void(const uint64_t&, const std::string&)> on_reserved_; //!< Job ID, tube.
+                    std::function<void(const uint64_t&, const std::string&)> on_deleted_;  //!< Job ID, tube.
+                    std::function<void(const uint64_t&, const std::string&)> on_buried_;   //!< Job ID, tube.
+                    std::function<void(const uint64_t&, const std::string&)> on_expired_;  //!< Job ID, tube - TTR expired, job is ready again.
+                } Listener;
+
+                typedef struct {
+                    uint64_t puts_;
+                    uint64_t reserves_;
+                    uint64_t deletes_;
+                    uint64_t releases_;
+                    uint64_t buries_;
+                    uint64_t touches_;
+                    uint64_t expirations_;
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef struct {
+                    uint64_t    id_;
+                    std::string tube_;
+                    uint32_t    priority_;
+                    uint32_t    ttr_;
+                    std::string data_;
+                    TimePoint   ready_at_;    //!< For delayed jobs.
+                    TimePoint   deadline_;    //!< For reserved jobs.
+                    Connection* owner_;       //!< For reserved jobs.
+                    bool        buried_;
+                } Job;
+
+                typedef struct {
+                    std::string           used_;
+                    std::set<std::string> watched_;
+                    bool                  waiting_;
+                    bool                  with_timeout_;
+                    TimePoint             timeout_;
+                } Session;
+
+                typedef std::set<std::pair<uint32_t, uint64_t>> ReadyQueue; //!< ( priority, id )
+
+            private: // Data
+
+                std::mutex                           data_mutex_;
+                uint64_t                             next_id_;
+                std::map<uint64_t, Job*>             jobs_;
+                std::map<std::string, ReadyQueue>    ready_;
+                std::set<uint64_t>                   delayed_;
+                std::set<uint64_t>                   reserved_;
+                std::map<Connection*, Session>       sessions_;
+                std::list<Connection*>               waiting_;
+                Listener                             listener_;
+                Stats                                stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Beanstalkd ();
+                virtual ~Beanstalkd ();
+
+            public: // Method(s) / Function(s)
+
+                void     Observe (Listener a_listener);
+                uint64_t Put     (const std::string& a_tube, const std::string& a_data,
+                                  const uint32_t a_priority = 1024, const uint32_t a_delay = 0, const uint32_t a_ttr = 60);
+                Stats    Snapshot ();
+
+            protected: // Inherited Virtual Method(s) / Function(s) - from fake::Server
+
+                virtual void OnData       (Connection* a_connection);
+                virtual void OnDisconnect (Connection* a_connection);
+                virtual int  OnIdle       ();
+
+            private: // Method(s) / Function(s)
+
+                bool     Command  (Connection* a_connection, Session& a_session);
+                uint64_t Insert   (const std::string& a_tube, const std::string& a_data, const uint32_t a_priority, const uint32_t a_delay, const uint32_t a_ttr);
+                void     Ready    (Job* a_job);
+                void     Dispatch ();
+                Job*     Take     (const std::set<std::string>& a_tubes);
+                void     Notify   (const std::function<void(const uint64_t&, const std::string&)>& a_callback, const Job* a_job);
+
+            }; // end of class 'Beanstalkd'
+
+            /**
+             * @brief Default constructor.
+             */
+            inline Beanstalkd::Beanstalkd ()
+                : Server("beanstalkd")
+            {
+                next_id_  = 1;
+                listener_ = { nullptr, nullptr, nullptr, nullptr };
+                stats_    = { 0, 0, 0, 0, 0, 0, 0 };
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Beanstalkd::~Beanstalkd ()
+            {
+                Stop();
+                for ( auto it : jobs_ ) {
+                    delete it.second;
+                }
+            }
+
+            /**
+             * @brief Set job life-cycle listener, must be called before \link Start \link.
+             *
+             * @param a_listener See \link Listener \link.
+             */
+            inline void Beanstalkd::Observe (Listener a_listener)
+            {
+                listener_ = a_listener;
+            }
+
+            /**
+             * @brief Put a job, can be called from any thread.
+             *
+             * @param a_tube     Tube name.
+             * @param a_data     Job payload.
+             * @param a_priority Job priority.
+             * @param a_delay    Delay in seconds.
+             * @param a_ttr      Time to run in seconds.
+             *
+             * @return New job id.
+             */
+            inline uint64_t Beanstalkd::Put (const std::string& a_tube, const std::string& a_data, const uint32_t a_priority, const uint32_t a_delay, const uint32_t a_ttr)
+            {
+                uint64_t id;
+                {
+                    std::lock_guard<std::mutex> lock(data_mutex_);
+                    id = Insert(a_tube, a_data, a_priority, a_delay, a_ttr);
+                }
+                Post([this]() {
+                    std::lock_guard<std::mutex> lock(data_mutex_);
+                    Dispatch();
+                });
+                return id;
+            }
+
+            /**
+             * @return A copy of the current stats.
+             */
+            inline Beanstalkd::Stats Beanstalkd::Snapshot ()
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                return stats_;
+            }
+
+            /**
+             * @brief Consume as many complete commands as possible.
+             *
+             * @param a_connection Connection with new data.
+             */
+            inline void Beanstalkd::OnData (Connection* a_connection)
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                auto it = sessions_.find(a_connection);
+                if ( sessions_.end() == it ) {
+                    it = sessions_.insert(std::make_pair(a_connection, Session({ "default", { "default" }, false, false, TimePoint() }))).first;
+                }
+                while ( false == it->second.waiting_ && true == Command(a_connection, it->second) ) {
+                    // ... next ...
+                }
+                Dispatch();
+            }
+
+            /**
+             * @brief Release session and all jobs reserved by a connection.
+             *
+             * @param a_connection Connection being closed.
+             */
+            inline void Beanstalkd::OnDisconnect (Connection* a_connection)
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                waiting_.remove(a_connection);
+                sessions_.erase(a_connection);
+                for ( auto it = reserved_.begin() ; reserved_.end() != it ; ) {
+                    Job* job = jobs_[*it];
+                    if ( a_connection == job->owner_ ) {
+                        it = reserved_.erase(it);
+                        Ready(job);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            /**
+             * @brief Handle TTR expirations, delayed jobs and reserve timeouts.
+             *
+             * @return Maximum amount of time to wait ( in ms ) for the next iteration.
+             */
+            inline int Beanstalkd::OnIdle ()
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                const TimePoint now  = std::chrono::steady_clock::now();
+                TimePoint       next = now + std::chrono::seconds(1);
+                // ... TTR expired?
+                for ( auto it = reserved_.begin() ; reserved_.end() != it ; ) {
+                    Job* job = jobs_[*it];
+                    if ( job->deadline_ <= now ) {
+                        it = reserved_.erase(it);
+                        stats_.expirations_++;
+                        Notify(listener_.on_expired_, job);
+                        Ready(job);
+                    } else {
+                        next = std::min(next, job->deadline_);
+                        ++it;
+                    }
+                }
+                // ... delayed jobs ready?
+                for ( auto it = delayed_.begin() ; delayed_.end() != it ; ) {
+                    Job* job = jobs_[*it];
+                    if ( job->ready_at_ <= now ) {
+                        it = delayed_.erase(it);
+                        ready_[job->tube_].insert(std::make_pair(job->priority_, job->id_));
+                    } else {
+                        next = std::min(next, job->ready_at_);
+                        ++it;
+                    }
+                }
+                // ... reserve timeouts ...
+                for ( auto it = waiting_.begin() ; waiting_.end() != it ; ) {
+                    Session& session = sessions_[*it];
+                    if ( true == session.with_timeout_ && session.timeout_ <= now ) {
+                        session.waiting_ = false;
+                        Write(*it, "TIMED_OUT\r\n");
+                        it = waiting_.erase(it);
+                    } else {
+                        if ( true == session.with_timeout_ ) {
+                            next = std::min(next, session.timeout_);
+                        }
+                        ++it;
+                    }
+                }
+                Dispatch();
+                return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count()) + 1;
+            }
+
+            /**
+             * @brief Process a command, if fully available.
+             *
+             * @param a_connection Connection.
+             * @param a_session    Connection session.
+             *
+             * @return True if a command was consumed, false if more data is needed.
+             */
+            inline bool Beanstalkd::Command (Connection* a_connection, Session& a_session)
+            {
+                const size_t eol = a_connection->in_.find("\r\n");
+                if ( std::string::npos == eol ) {
+                    return false;
+                }
+                std::istringstream line(a_connection->in_.substr(0, eol));
+                std::string        name;
+                line >> name;
+                size_t consumed = eol + 2;
+                if ( "put" == name ) {
+                    uint32_t priority = 0, delay = 0, ttr = 0; size_t bytes = 0;
+                    line >> priority >> delay >> ttr >> bytes;
+                    if ( a_connection->in_.length() < consumed + bytes + 2 ) {
+                        return false;
+                    }
+                    const uint64_t id = Insert(a_session.used_, a_connection->in_.substr(consumed, bytes), priority, delay, ttr);
+                    consumed += bytes + 2;
+                    Write(a_connection, "INSERTED " + std::to_string(id) + "\r\n");
+                } else if ( "use" == name ) {
+                    line >> a_session.used_;
+                    Write(a_connection, "USING " + a_session.used_ + "\r\n");
+                } else if ( "list-tube-used" == name ) {
+                    Write(a_connection, "USING " + a_session.used_ + "\r\n");
+                } else if ( "watch" == name ) {
+                    std::string tube; line >> tube;
+                    a_session.watched_.insert(tube);
+                    Write(a_connection, "WATCHING " + std::to_string(a_session.watched_.size()) + "\r\n");
+                } else if ( "ignore" == name ) {
+                    std::string tube; line >> tube;
+                    if ( 1 == a_session.watched_.size() && 1 == a_session.watched_.count(tube) ) {
+                        Write(a_connection, "NOT_IGNORED\r\n");
+                    } else {
+                        a_session.watched_.erase(tube);
+                        Write(a_connection, "WATCHING " + std::to_string(a_session.watched_.size()) + "\r\n");
+                    }
+                } else if ( "reserve" == name || "reserve-with-timeout" == name ) {
+                    a_session.waiting_      = true;
+                    a_session.with_timeout_ = ( "reserve-with-timeout" == name );
+                    if ( true == a_session.with_timeout_ ) {
+                        uint32_t timeout = 0; line >> timeout;
+                        a_session.timeout_ = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+                    }
+                    waiting_.push_back(a_connection);
+                } else if ( "delete" == name || "release" == name || "bury" == name || "touch" == name ) {
+                    uint64_t id = 0; uint32_t priority = 0, delay = 0;
+                    line >> id >> priority >> delay;
+                    const auto it = jobs_.find(id);
+                    if ( jobs_.end() == it || ( "delete" != name && ( a_connection != it->second->owner_ || 0 == reserved_.count(id) ) ) ) {
+                        Write(a_connection, "NOT_FOUND\r\n");
+                    } else {
+                        Job* job = it->second;
+                        if ( "delete" == name ) {
+                            reserved_.erase(id); delayed_.erase(id);
+                            ready_[job->tube_].erase(std::make_pair(job->priority_, job->id_));
+                            jobs_.erase(it);
+                            stats_.deletes_++;
+                            Notify(listener_.on_deleted_, job);
+                            delete job;
+                            Write(a_connection, "DELETED\r\n");
+                        } else if ( "release" == name ) {
+                            reserved_.erase(id);
+                            job->priority_ = priority;
+                            job->ready_at_ = std::chrono::steady_clock::now() + std::chrono::seconds(delay);
+                            stats_.releases_++;
+                            Ready(job);
+                            Write(a_connection, "RELEASED\r\n");
+                        } else if ( "bury" == name ) {
+                            reserved_.erase(id);
+                            job->priority_ = priority;
+                            job->buried_   = true;
+                            job->owner_    = nullptr;
+                            stats_.buries_++;
+                            Notify(listener_.on_buried_, job);
+                            Write(a_connection, "BURIED\r\n");
+                        } else {
+                            job->deadline_ = std::chrono::steady_clock::now() + std::chrono::seconds(job->ttr_);
+                            stats_.touches_++;
+                            Write(a_connection, "TOUCHED\r\n");
+                        }
+                    }
+                } else if ( "quit" == name ) {
+                    a_connection->close_ = true;
+                } else {
+                    Write(a_connection, "UNKNOWN_COMMAND\r\n");
+                }
+                a_connection->in_.erase(0, consumed);
+                return true;
+            }
+
+            /**
+             * @brief Create a new job, data mutex must be locked.
+             *
+             * @return New job id.
+             */
+            inline uint64_t Beanstalkd::Insert (const std::string& a_tube, const std::string& a_data, const uint32_t a_priority, const uint32_t a_delay, const uint32_t a_ttr)
+            {
+                Job* job = new Job({
+                    /* id_       */ next_id_++,
+                    /* tube_     */ a_tube,
+                    /* priority_ */ a_priority,
+                    /* ttr_      */ std::max(a_ttr, static_cast<uint32_t>(1)),
+                    /* data_     */ a_data,
+                    /* ready_at_ */ std::chrono::steady_clock::now() + std::chrono::seconds(a_delay),
+                    /* deadline_ */ TimePoint(),
+                    /* owner_    */ nullptr,
+                    /* buried_   */ false
+                });
+                jobs_[job->id_] = job;
+                stats_.puts_++;
+                Ready(job);
+                return job->id_;
+            }
+
+            /**
+             * @brief Move a job to 'ready' ( or 'delayed' ) state, data mutex must be locked.
+             *
+             * @param a_job Job to move.
+             */
+            inline void Beanstalkd::Ready (Job* a_job)
+            {
+                a_job->owner_ = nullptr;
+                if ( a_job->ready_at_ > std::chrono::steady_clock::now() ) {
+                    delayed_.insert(a_job->id_);
+                } else {
+                    ready_[a_job->tube_].insert(std::make_pair(a_job->priority_, a_job->id_));
+                }
+            }
+
+            /**
+             * @brief Hand ready jobs to waiting connections, data mutex must be locked.
+             */
+            inline void Beanstalkd::Dispatch ()
+            {
+                for ( auto it = waiting_.begin() ; waiting_.end() != it ; ) {
+                    Session& session = sessions_[*it];
+                    Job*     job     = Take(session.watched_);
+                    if ( nullptr == job ) {
+                        ++it;
+                        continue;
+                    }
+                    job->owner_    = *it;
+                    job->deadline_ = std::chrono::steady_clock::now() + std::chrono::seconds(job->ttr_);
+                    reserved_.insert(job->id_);
+                    stats_.reserves_++;
+                    session.waiting_ = false;
+                    Write(*it, "RESERVED " + std::to_string(job->id_) + " " + std::to_string(job->data_.length()) + "\r\n" + job->data_ + "\r\n");
+                    Notify(listener_.on_reserved_, job);
+                    // ... pipelined commands?
+                    Connection* connection = *it;
+                    it = waiting_.erase(it);
+                    while ( false == session.waiting_ && true == Command(connection, session) ) {
+                        // ... next ...
+                    }
+                }
+            }
+
+            /**
+             * @brief Pick the most urgent ready job from a set of tubes, data mutex must be locked.
+             *
+             * @param a_tubes Watched tubes.
+             *
+             * @return Job or nullptr if none is ready.
+             */
+            inline Beanstalkd::Job* Beanstalkd::Take (const std::set<std::string>& a_tubes)
+            {
+                ReadyQueue* best = nullptr;
+                for ( const auto& tube : a_tubes ) {
+                    const auto it = ready_.find(tube);
+                    if ( ready_.end() == it || 0 == it->second.size() ) {
+                        continue;
+                    }
+                    if ( nullptr == best || *it->second.begin() < *best->begin() ) {
+                        best = &it->second;
+                    }
+                }
+                if ( nullptr == best ) {
+                    return nullptr;
+                }
+                const uint64_t id = best->begin()->second;
+                best->erase(best->begin());
+                return jobs_[id];
+            }
+
+            /**
+             * @brief Call a listener function, if set.
+             */
+            inline void Beanstalkd::Notify (const std::function<void(const uint64_t&, const std::string&)>& a_callback, const Job* a_job)
+            {
+                if ( nullptr != a_callback ) {
+                    a_callback(a_job->id_, a_job->tube_);
+                }
+            }
+
+        } // end of namespace 'fake'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_FAKE_BEANSTALKD_H_
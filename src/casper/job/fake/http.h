@@ -0,0 +1,325 @@
+/**
+ * @file http.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_FAKE_HTTP_H_
+#define CASPER_JOB_FAKE_HTTP_H_
+
+#include "casper/job/fake/server.h"
+
+#include <deque>
+#include <chrono>
+#include <ctype.h>   // tolower
+#include <stdlib.h>  // strtoull
+#include <strings.h> // strcasecmp
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace fake
+        {
+
+            /**
+             * @brief In-process HTTP/1.1 server stand-in.
+             *
+             * Connections are kept alive unless the client asks otherwise, pipelined requests are answered in order.
+             * Request bodies must be sent with 'Content-Length', chunked requests and HTTP/2 are not supported.
+             */
+            class HTTP final : public Server
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    std::string                        method_;
+                    std::string                        target_;
+                    std::map<std::string, std::string> headers_; //!< Lower case names.
+                    std::string                        body_;
+                } Request;
+
+                typedef struct {
+                    uint16_t    code_;
+                    std::string content_type_;
+                    std::string body_;
+                    size_t      delay_; //!< In ms.
+                } Reply;
+
+                typedef std::function<Reply(const Request&)> Handler;
+
+                typedef struct {
+                    uint64_t connections_; //!< Accepted connections that sent at least one request.
+                    uint64_t requests_;
+                    uint64_t pipelined_;   //!< Requests received while a previous response was still pending.
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+                typedef struct {
+                    TimePoint   due_;
+                    std::string data_;
+                    bool        close_;
+                } Pending;
+
+            private: // Data
+
+                std::mutex                                data_mutex_;
+                Handler                                   handler_;
+                std::map<Connection*, std::deque<Pending>> pending_;
+                Stats                                     stats_;
+
+            public: // Constructor(s) / Destructor
+
+                HTTP ();
+                virtual ~HTTP ();
+
+            public: // Method(s) / Function(s)
+
+                void  Route    (Handler a_handler);
+                Stats Snapshot ();
+
+            protected: // Inherited Virtual Method(s) / Function(s) - from fake::Server
+
+                virtual void OnData       (Connection* a_connection);
+                virtual void OnDisconnect (Connection* a_connection);
+                virtual int  OnIdle       ();
+
+            private: // Method(s) / Function(s)
+
+                bool Parse (std::string& a_buffer, Request& o_request, bool& o_close) const;
+
+            private: // Static Method(s) / Function(s)
+
+                static std::string Serialize (const std::string& a_method, const Reply& a_reply, const bool a_close);
+
+            }; // end of class 'HTTP'
+
+            /**
+             * @brief Default constructor.
+             */
+            inline HTTP::HTTP ()
+                : Server("http")
+            {
+                stats_   = { 0, 0, 0 };
+                handler_ = [] (const Request& a_request) -> Reply {
+                    return { 200, "application/json", "{\"method\":\"" + a_request.method_ + "\",\"target\":\"" + a_request.target_ + "\"}", 0 };
+                };
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline HTTP::~HTTP ()
+            {
+                Stop();
+            }
+
+            /**
+             * @brief Set the request handler, must be called before \link Start \link.
+             *
+             * @param a_handler Function to call on server thread for every request.
+             */
+            inline void HTTP::Route (Handler a_handler)
+            {
+                handler_ = a_handler;
+            }
+
+            /**
+             * @return A copy of the current stats.
+             */
+            inline HTTP::Stats HTTP::Snapshot ()
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                return stats_;
+            }
+
+            /**
+             * @brief Consume as many complete requests as possible.
+             *
+             * @param a_connection Connection with new data.
+             */
+            inline void HTTP::OnData (Connection* a_connection)
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                auto it = pending_.find(a_connection);
+                if ( pending_.end() == it ) {
+                    it = pending_.insert(std::make_pair(a_connection, std::deque<Pending>())).first;
+                    stats_.connections_++;
+                }
+                std::deque<Pending>& queue = it->second;
+                Request request;
+                bool    close = false;
+                while ( false == a_connection->close_ && true == Parse(a_connection->in_, request, close) ) {
+                    stats_.requests_++;
+                    if ( queue.size() > 0 ) {
+                        stats_.pipelined_++;
+                    }
+                    const Reply reply = handler_(request);
+                    // ... responses must be sent in request order ...
+                    if ( 0 == reply.delay_ && 0 == queue.size() ) {
+                        Write(a_connection, Serialize(request.method_, reply, close));
+                        a_connection->close_ = close;
+                    } else {
+                        queue.push_back({ std::chrono::steady_clock::now() + std::chrono::milliseconds(reply.delay_), Serialize(request.method_, reply, close), close });
+                    }
+                    if ( true == close ) {
+                        break;
+                    }
+                    request = Request();
+                }
+            }
+
+            /**
+             * @brief Forget pending responses of a closed connection.
+             *
+             * @param a_connection Connection being closed.
+             */
+            inline void HTTP::OnDisconnect (Connection* a_connection)
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                pending_.erase(a_connection);
+            }
+
+            /**
+             * @brief Send delayed responses that are due.
+             *
+             * @return Maximum amount of time to wait ( in ms ) for the next iteration.
+             */
+            inline int HTTP::OnIdle ()
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                const TimePoint now     = std::chrono::steady_clock::now();
+                bool            flushed = false;
+                int             wait    = -1;
+                for ( auto& it : pending_ ) {
+                    std::deque<Pending>& queue = it.second;
+                    while ( queue.size() > 0 && queue.front().due_ <= now ) {
+                        Write(it.first, queue.front().data_);
+                        it.first->close_ = queue.front().close_;
+                        queue.pop_front();
+                        flushed = true;
+                    }
+                    if ( queue.size() > 0 ) {
+                        const int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(queue.front().due_ - now).count()) + 1;
+                        wait = ( -1 == wait ? ms : std::min(wait, ms) );
+                    }
+                }
+                // ... written data is only polled for on next iteration ...
+                return ( true == flushed ? 0 : wait );
+            }
+
+            /**
+             * @brief Parse a request.
+             *
+             * @param a_buffer  Input buffer, consumed bytes are erased.
+             * @param o_request Parsed request.
+             * @param o_close   True if client asked for the connection to be closed after the response.
+             *
+             * @return True if a request was parsed, false if more data is needed.
+             */
+            inline bool HTTP::Parse (std::string& a_buffer, Request& o_request, bool& o_close) const
+            {
+                const size_t end = a_buffer.find("\r\n\r\n");
+                if ( std::string::npos == end ) {
+                    return false;
+                }
+                // ... request line ...
+                size_t eol = a_buffer.find("\r\n");
+                const std::string line = a_buffer.substr(0, eol);
+                const size_t      sp1  = line.find(' ');
+                const size_t      sp2  = line.find(' ', sp1 + 1);
+                o_request.method_ = line.substr(0, sp1);
+                o_request.target_ = ( std::string::npos != sp1 ? line.substr(sp1 + 1, sp2 - sp1 - 1) : "" );
+                const bool http10 = ( std::string::npos != sp2 && 0 == line.compare(sp2 + 1, std::string::npos, "HTTP/1.0") );
+                // ... headers ...
+                o_request.headers_.clear();
+                size_t offset = eol + 2;
+                while ( offset < end ) {
+                    eol = a_buffer.find("\r\n", offset);
+                    const size_t colon = a_buffer.find(':', offset);
+                    if ( std::string::npos != colon && colon < eol ) {
+                        std::string name  = a_buffer.substr(offset, colon - offset);
+                        size_t      value = colon + 1;
+                        while ( value < eol && ' ' == a_buffer[value] ) {
+                            value++;
+                        }
+                        for ( auto& c : name ) {
+                            c = static_cast<char>(tolower(c));
+                        }
+                        o_request.headers_[name] = a_buffer.substr(value, eol - value);
+                    }
+                    offset = eol + 2;
+                }
+                // ... body ...
+                const auto   length = o_request.headers_.find("content-length");
+                const size_t size   = ( o_request.headers_.end() != length ? static_cast<size_t>(strtoull(length->second.c_str(), nullptr, 10)) : 0 );
+                if ( a_buffer.length() < end + 4 + size ) {
+                    return false;
+                }
+                o_request.body_ = a_buffer.substr(end + 4, size);
+                a_buffer.erase(0, end + 4 + size);
+                // ... keep-alive?
+                const auto connection = o_request.headers_.find("connection");
+                if ( o_request.headers_.end() != connection ) {
+                    o_close = ( 0 == strcasecmp(connection->second.c_str(), "close") || ( true == http10 && 0 != strcasecmp(connection->second.c_str(), "keep-alive") ) );
+                } else {
+                    o_close = http10;
+                }
+                return true;
+            }
+
+            /**
+             * @brief Serialize a response.
+             *
+             * @param a_method Request method, a response to 'HEAD' carries no body ( RFC 7231 4.3.2 ).
+             * @param a_reply  Reply to serialize.
+             * @param a_close  True if connection will be closed after this response.
+             */
+            inline std::string HTTP::Serialize (const std::string& a_method, const Reply& a_reply, const bool a_close)
+            {
+                const char* reason;
+                switch (a_reply.code_) {
+                    case 200: reason = "OK";                    break;
+                    case 204: reason = "No Content";            break;
+                    case 400: reason = "Bad Request";           break;
+                    case 404: reason = "Not Found";             break;
+                    case 500: reason = "Internal Server Error"; break;
+                    case 503: reason = "Service Unavailable";   break;
+                    default:  reason = "Unknown";               break;
+                }
+                return "HTTP/1.1 " + std::to_string(a_reply.code_) + " " + reason + "\r\n"
+                        + "Content-Type: " + a_reply.content_type_ + "\r\n"
+                        + "Content-Length: " + std::to_string(a_reply.body_.length()) + "\r\n"
+                        + ( true == a_close ? "Connection: close\r\n" : "" )
+                        + "\r\n"
+                        + ( 0 == strcasecmp(a_method.c_str(), "HEAD") ? "" : a_reply.body_ );
+            }
+
+        } // end of namespace 'fake'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_FAKE_HTTP_H_
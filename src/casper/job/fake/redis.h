@@ -0,0 +1,390 @@
+/**
+ * @file redis.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_FAKE_REDIS_H_
+#define CASPER_JOB_FAKE_REDIS_H_
+
+#include "casper/job/fake/server.h"
+
+#include <set>
+#include <fnmatch.h>
+#include <strings.h> // strcasecmp
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace fake
+        {
+
+            /**
+             * @brief In-process REDIS stand-in.
+             *
+             * Speaks RESP and implements the subset of commands used by job consumers: strings, hashes, expirations and pub/sub.
+             * Unknown commands are acknowledged with '+OK' and counted, so a consumer is never stalled by this stand-in.
+             */
+            class Redis final : public Server
+            {
+
+            public: // Data Type(s)
+
+                typedef std::function<void(const std::string&, const std::string&)> Observer; //!< Channel, message.
+
+                typedef struct {
+                    uint64_t commands_;
+                    uint64_t publishes_;
+                    uint64_t unknown_;
+                } Stats;
+
+            private: // Data Type(s)
+
+                typedef std::vector<std::string> Command;
+
+                typedef struct {
+                    std::set<std::string> channels_;
+                    std::set<std::string> patterns_;
+                } Session;
+
+            private: // Data
+
+                std::mutex                                                  data_mutex_;
+                std::map<std::string, std::string>                          strings_;
+                std::map<std::string, std::map<std::string, std::string>>   hashes_;
+                std::map<Connection*, Session>                              subscribers_;
+                std::vector<Observer>                                       observers_;
+                Stats                                                       stats_;
+
+            public: // Constructor(s) / Destructor
+
+                Redis ();
+                virtual ~Redis ();
+
+            public: // Method(s) / Function(s)
+
+                void     Observe  (Observer a_observer);
+                void     Publish  (const std::string& a_channel, const std::string& a_message);
+                Stats    Snapshot ();
+
+            protected: // Inherited Virtual Method(s) / Function(s) - from fake::Server
+
+                virtual void OnData       (Connection* a_connection);
+                virtual void OnDisconnect (Connection* a_connection);
+
+            private: // Method(s) / Function(s)
+
+                bool   Parse     (std::string& a_buffer, Command& o_command) const;
+                void   Execute   (Connection* a_connection, const Command& a_command);
+                size_t Broadcast (const std::string& a_channel, const std::string& a_message);
+
+            private: // Static Method(s) / Function(s)
+
+                static std::string Bulk    (const std::string& a_value);
+                static std::string Integer (const int64_t a_value);
+
+            }; // end of class 'Redis'
+
+            /**
+             * @brief Default constructor.
+             */
+            inline Redis::Redis ()
+                : Server("redis")
+            {
+                stats_ = { 0, 0, 0 };
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Redis::~Redis ()
+            {
+                Stop();
+            }
+
+            /**
+             * @brief Register an in-process observer for published messages, must be called before \link Start \link.
+             *
+             * @param a_observer Function to call on server thread for every published message.
+             */
+            inline void Redis::Observe (Observer a_observer)
+            {
+                observers_.push_back(a_observer);
+            }
+
+            /**
+             * @brief Publish a message from this process, can be called from any thread.
+             *
+             * @param a_channel Channel name.
+             * @param a_message Message.
+             */
+            inline void Redis::Publish (const std::string& a_channel, const std::string& a_message)
+            {
+                Post([this, a_channel, a_message]() {
+                    std::lock_guard<std::mutex> lock(data_mutex_);
+                    Broadcast(a_channel, a_message);
+                });
+            }
+
+            /**
+             * @return A copy of the current stats.
+             */
+            inline Redis::Stats Redis::Snapshot ()
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                return stats_;
+            }
+
+            /**
+             * @brief Consume as many complete commands as possible.
+             *
+             * @param a_connection Connection with new data.
+             */
+            inline void Redis::OnData (Connection* a_connection)
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                Command command;
+                while ( true == Parse(a_connection->in_, command) ) {
+                    if ( command.size() > 0 ) {
+                        stats_.commands_++;
+                        Execute(a_connection, command);
+                    }
+                    command.clear();
+                }
+            }
+
+            /**
+             * @brief Forget subscriptions of a closed connection.
+             *
+             * @param a_connection Connection being closed.
+             */
+            inline void Redis::OnDisconnect (Connection* a_connection)
+            {
+                std::lock_guard<std::mutex> lock(data_mutex_);
+                subscribers_.erase(a_connection);
+            }
+
+            /**
+             * @brief Parse a RESP array of bulk strings ( or an inline command ).
+             *
+             * @param a_buffer  Input buffer, consumed bytes are erased.
+             * @param o_command Parsed command.
+             *
+             * @return True if a command was parsed, false if more data is needed.
+             */
+            inline bool Redis::Parse (std::string& a_buffer, Command& o_command) const
+            {
+                size_t eol = a_buffer.find("\r\n");
+                if ( std::string::npos == eol ) {
+                    return false;
+                }
+                // ... inline command?
+                if ( '*' != a_buffer[0] ) {
+                    std::string line = a_buffer.substr(0, eol);
+                    size_t      start = 0, end;
+                    while ( std::string::npos != ( end = line.find(' ', start) ) ) {
+                        if ( end > start ) {
+                            o_command.push_back(line.substr(start, end - start));
+                        }
+                        start = end + 1;
+                    }
+                    if ( start < line.length() ) {
+                        o_command.push_back(line.substr(start));
+                    }
+                    a_buffer.erase(0, eol + 2);
+                    return true;
+                }
+                // ... array of bulk strings ...
+                const long count  = strtol(a_buffer.c_str() + 1, nullptr, 10);
+                size_t     offset = eol + 2;
+                for ( long idx = 0 ; idx < count ; ++idx ) {
+                    eol = a_buffer.find("\r\n", offset);
+                    if ( std::string::npos == eol ) {
+                        return false;
+                    }
+                    const size_t length = static_cast<size_t>(strtol(a_buffer.c_str() + offset + 1, nullptr, 10));
+                    if ( a_buffer.length() < eol + 2 + length + 2 ) {
+                        return false;
+                    }
+                    o_command.push_back(a_buffer.substr(eol + 2, length));
+                    offset = eol + 2 + length + 2;
+                }
+                a_buffer.erase(0, offset);
+                return true;
+            }
+
+            /**
+             * @brief Execute a command, data mutex must be locked.
+             *
+             * @param a_connection Connection that issued the command.
+             * @param a_command    Command and arguments.
+             */
+            inline void Redis::Execute (Connection* a_connection, const Command& a_command)
+            {
+                const char* const name = a_command[0].c_str();
+                const size_t      argc = a_command.size();
+                if ( 0 == strcasecmp(name, "PING") ) {
+                    Write(a_connection, "+PONG\r\n");
+                } else if ( 0 == strcasecmp(name, "ECHO") && argc > 1 ) {
+                    Write(a_connection, Bulk(a_command[1]));
+                } else if ( 0 == strcasecmp(name, "GET") && argc > 1 ) {
+                    const auto it = strings_.find(a_command[1]);
+                    Write(a_connection, strings_.end() != it ? Bulk(it->second) : "$-1\r\n");
+                } else if ( 0 == strcasecmp(name, "SET") && argc > 2 ) {
+                    strings_[a_command[1]] = a_command[2];
+                    Write(a_connection, "+OK\r\n");
+                } else if ( 0 == strcasecmp(name, "DEL") ) {
+                    int64_t count = 0;
+                    for ( size_t idx = 1 ; idx < argc ; ++idx ) {
+                        count += static_cast<int64_t>(strings_.erase(a_command[idx]) + hashes_.erase(a_command[idx]));
+                    }
+                    Write(a_connection, Integer(count));
+                } else if ( 0 == strcasecmp(name, "EXISTS") ) {
+                    int64_t count = 0;
+                    for ( size_t idx = 1 ; idx < argc ; ++idx ) {
+                        count += static_cast<int64_t>(strings_.count(a_command[idx]) + hashes_.count(a_command[idx]));
+                    }
+                    Write(a_connection, Integer(count));
+                } else if ( 0 == strcasecmp(name, "EXPIRE") || 0 == strcasecmp(name, "PEXPIRE") ) {
+                    // ... expirations are not enforced, keys live as long as this process ...
+                    Write(a_connection, Integer(argc > 1 && ( strings_.count(a_command[1]) + hashes_.count(a_command[1]) ) > 0 ? 1 : 0));
+                } else if ( 0 == strcasecmp(name, "INCR") && argc > 1 ) {
+                    const int64_t value = strtoll(strings_[a_command[1]].c_str(), nullptr, 10) + 1;
+                    strings_[a_command[1]] = std::to_string(value);
+                    Write(a_connection, Integer(value));
+                } else if ( ( 0 == strcasecmp(name, "HSET") || 0 == strcasecmp(name, "HMSET") ) && argc > 3 ) {
+                    auto&   hash  = hashes_[a_command[1]];
+                    int64_t added = 0;
+                    for ( size_t idx = 2 ; idx + 1 < argc ; idx += 2 ) {
+                        added += ( hash.end() == hash.find(a_command[idx]) ? 1 : 0 );
+                        hash[a_command[idx]] = a_command[idx + 1];
+                    }
+                    Write(a_connection, 0 == strcasecmp(name, "HSET") ? Integer(added) : "+OK\r\n");
+                } else if ( 0 == strcasecmp(name, "HGET") && argc > 2 ) {
+                    const auto hit = hashes_.find(a_command[1]);
+                    if ( hashes_.end() == hit || hit->second.end() == hit->second.find(a_command[2]) ) {
+                        Write(a_connection, "$-1\r\n");
+                    } else {
+                        Write(a_connection, Bulk(hit->second[a_command[2]]));
+                    }
+                } else if ( 0 == strcasecmp(name, "HGETALL") && argc > 1 ) {
+                    const auto hit = hashes_.find(a_command[1]);
+                    if ( hashes_.end() == hit ) {
+                        Write(a_connection, "*0\r\n");
+                    } else {
+                        std::string reply = "*" + std::to_string(hit->second.size() * 2) + "\r\n";
+                        for ( const auto& field : hit->second ) {
+                            reply += Bulk(field.first) + Bulk(field.second);
+                        }
+                        Write(a_connection, reply);
+                    }
+                } else if ( 0 == strcasecmp(name, "HDEL") && argc > 2 ) {
+                    int64_t count = 0;
+                    const auto hit = hashes_.find(a_command[1]);
+                    if ( hashes_.end() != hit ) {
+                        for ( size_t idx = 2 ; idx < argc ; ++idx ) {
+                            count += static_cast<int64_t>(hit->second.erase(a_command[idx]));
+                        }
+                    }
+                    Write(a_connection, Integer(count));
+                } else if ( 0 == strcasecmp(name, "PUBLISH") && argc > 2 ) {
+                    stats_.publishes_++;
+                    Write(a_connection, Integer(static_cast<int64_t>(Broadcast(a_command[1], a_command[2]))));
+                } else if ( 0 == strcasecmp(name, "SUBSCRIBE") || 0 == strcasecmp(name, "PSUBSCRIBE") ) {
+                    const bool pattern = ( 0 == strcasecmp(name, "PSUBSCRIBE") );
+                    Session&   session = subscribers_[a_connection];
+                    for ( size_t idx = 1 ; idx < argc ; ++idx ) {
+                        ( true == pattern ? session.patterns_ : session.channels_ ).insert(a_command[idx]);
+                        Write(a_connection, "*3\r\n" + Bulk(pattern ? "psubscribe" : "subscribe") + Bulk(a_command[idx])
+                                            + Integer(static_cast<int64_t>(session.channels_.size() + session.patterns_.size())));
+                    }
+                } else if ( 0 == strcasecmp(name, "UNSUBSCRIBE") || 0 == strcasecmp(name, "PUNSUBSCRIBE") ) {
+                    const bool pattern = ( 0 == strcasecmp(name, "PUNSUBSCRIBE") );
+                    Session&   session = subscribers_[a_connection];
+                    auto&      set     = ( true == pattern ? session.patterns_ : session.channels_ );
+                    const std::set<std::string> targets = ( argc > 1 ? std::set<std::string>(a_command.begin() + 1, a_command.end()) : set );
+                    for ( const auto& target : targets ) {
+                        set.erase(target);
+                        Write(a_connection, "*3\r\n" + Bulk(pattern ? "punsubscribe" : "unsubscribe") + Bulk(target)
+                                            + Integer(static_cast<int64_t>(session.channels_.size() + session.patterns_.size())));
+                    }
+                } else if ( 0 == strcasecmp(name, "QUIT") ) {
+                    Write(a_connection, "+OK\r\n");
+                    a_connection->close_ = true;
+                } else {
+                    // ... AUTH, SELECT, CLIENT, etc ...
+                    stats_.unknown_++;
+                    Write(a_connection, "+OK\r\n");
+                }
+            }
+
+            /**
+             * @brief Deliver a message to all subscribers and observers, data mutex must be locked.
+             *
+             * @param a_channel Channel name.
+             * @param a_message Message.
+             *
+             * @return Number of subscribers that received the message.
+             */
+            inline size_t Redis::Broadcast (const std::string& a_channel, const std::string& a_message)
+            {
+                size_t count = 0;
+                for ( auto& it : subscribers_ ) {
+                    if ( 1 == it.second.channels_.count(a_channel) ) {
+                        Write(it.first, "*3\r\n" + Bulk("message") + Bulk(a_channel) + Bulk(a_message));
+                        count++;
+                    }
+                    for ( const auto& pattern : it.second.patterns_ ) {
+                        if ( 0 == fnmatch(pattern.c_str(), a_channel.c_str(), 0) ) {
+                            Write(it.first, "*4\r\n" + Bulk("pmessage") + Bulk(pattern) + Bulk(a_channel) + Bulk(a_message));
+                            count++;
+                        }
+                    }
+                }
+                for ( const auto& observer : observers_ ) {
+                    observer(a_channel, a_message);
+                }
+                return count;
+            }
+
+            /**
+             * @return RESP bulk string representation of a value.
+             */
+            inline std::string Redis::Bulk (const std::string& a_value)
+            {
+                return "$" + std::to_string(a_value.length()) + "\r\n" + a_value + "\r\n";
+            }
+
+            /**
+             * @return RESP integer representation of a value.
+             */
+            inline std::string Redis::Integer (const int64_t a_value)
+            {
+                return ":" + std::to_string(a_value) + "\r\n";
+            }
+
+        } // end of namespace 'fake'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_FAKE_REDIS_H_
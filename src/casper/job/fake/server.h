@@ -0,0 +1,375 @@
+/**
+ * @file server.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_FAKE_SERVER_H_
+#define CASPER_JOB_FAKE_SERVER_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "cc/exception.h"
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h> // strerror
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace fake
+        {
+
+            /**
+             * @brief A minimalist, single threaded, loopback only TCP server.
+             *
+             * Used as foundation for in-process stand-ins of the services a job talks to ( beanstalkd, REDIS, HTTP ),
+             * so that an entire handler can be exercised on a single offline box.
+             */
+            class Server : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            protected: // Data Type(s)
+
+                typedef struct {
+                    int         fd_;
+                    std::string in_;   //!< Received, not yet consumed, bytes.
+                    std::string out_;  //!< Pending bytes to write.
+                    bool        close_;//!< When true, connection will be closed after all pending bytes are written.
+                } Connection;
+
+            private: // Const Data
+
+                const std::string name_;
+
+            private: // Data
+
+                int                               listener_;
+                uint16_t                          port_;
+                int                               wakeup_[2];
+                std::thread*                      thread_;
+                std::atomic<bool>                 running_;
+                std::map<int, Connection*>        connections_;
+                std::mutex                        mutex_;
+                std::vector<std::function<void()>> pending_;
+
+            public: // Constructor(s) / Destructor
+
+                Server () = delete;
+                Server (const std::string& a_name);
+                virtual ~Server ();
+
+            public: // Method(s) / Function(s)
+
+                void Start (const uint16_t a_port = 0);
+                void Stop  ();
+
+            protected: // Method(s) / Function(s)
+
+                void Post  (std::function<void()> a_function);
+                void Write (Connection* a_connection, const std::string& a_data);
+
+            protected: // Virtual Method(s) / Function(s)
+
+                /**
+                 * @brief Called on server thread when new data is available.
+                 *
+                 * @param a_connection Connection with new data ( at \link Connection::in_ \link ).
+                 */
+                virtual void OnData       (Connection* a_connection) = 0;
+
+                /**
+                 * @brief Called on server thread before a connection is released.
+                 *
+                 * @param a_connection Connection that will be closed.
+                 */
+                virtual void OnDisconnect (Connection* /* a_connection */) {}
+
+                /**
+                 * @brief Called on server thread on every loop iteration.
+                 *
+                 * @return Maximum amount of time to wait ( in ms ) for the next iteration, -1 for infinite.
+                 */
+                virtual int  OnIdle       () { return -1; }
+
+            private: // Method(s) / Function(s)
+
+                void Loop  ();
+                void Close (Connection* a_connection);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return R/O access to the port this server is listening on.
+                 */
+                inline const uint16_t& port () const
+                {
+                    return port_;
+                }
+
+                /**
+                 * @return R/O access to this server name.
+                 */
+                inline const std::string& name () const
+                {
+                    return name_;
+                }
+
+            }; // end of class 'Server'
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_name Server name, for logging purposes.
+             */
+            inline Server::Server (const std::string& a_name)
+                : name_(a_name)
+            {
+                listener_  = -1;
+                port_      = 0;
+                wakeup_[0] = wakeup_[1] = -1;
+                thread_    = nullptr;
+                running_   = false;
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Server::~Server ()
+            {
+                Stop();
+            }
+
+            /**
+             * @brief Start listening on loopback interface.
+             *
+             * @param a_port Port to bind to, 0 to let the kernel pick one.
+             */
+            inline void Server::Start (const uint16_t a_port)
+            {
+                // ... sanity check ...
+                if ( nullptr != thread_ ) {
+                    throw ::cc::Exception("%s server already started!", name_.c_str());
+                }
+                // ... listen ...
+                listener_ = socket(AF_INET, SOCK_STREAM, 0);
+                if ( -1 == listener_ ) {
+                    throw ::cc::Exception("Unable to create %s server socket: %s!", name_.c_str(), strerror(errno));
+                }
+                const int reuse = 1;
+                setsockopt(listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+                struct sockaddr_in address;
+                memset(&address, 0, sizeof(address));
+                address.sin_family      = AF_INET;
+                address.sin_port        = htons(a_port);
+                address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                if ( 0 != bind(listener_, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) || 0 != listen(listener_, 128) ) {
+                    const int error = errno;
+                    close(listener_);
+                    listener_ = -1;
+                    throw ::cc::Exception("Unable to bind %s server to port " UINT16_FMT ": %s!", name_.c_str(), a_port, strerror(error));
+                }
+                socklen_t length = sizeof(address);
+                getsockname(listener_, reinterpret_cast<struct sockaddr*>(&address), &length);
+                port_ = ntohs(address.sin_port);
+                fcntl(listener_, F_SETFL, fcntl(listener_, F_GETFL, 0) | O_NONBLOCK);
+                // ... wake up pipe ...
+                if ( 0 != pipe(wakeup_) ) {
+                    const int error = errno;
+                    close(listener_);
+                    listener_ = -1;
+                    throw ::cc::Exception("Unable to create %s server pipe: %s!", name_.c_str(), strerror(error));
+                }
+                fcntl(wakeup_[0], F_SETFL, fcntl(wakeup_[0], F_GETFL, 0) | O_NONBLOCK);
+                // ... run ...
+                running_ = true;
+                thread_  = new std::thread(&Server::Loop, this);
+            }
+
+            /**
+             * @brief Stop server and release all connections.
+             */
+            inline void Server::Stop ()
+            {
+                if ( nullptr == thread_ ) {
+                    return;
+                }
+                running_ = false;
+                Post(nullptr);
+                thread_->join();
+                delete thread_;
+                thread_ = nullptr;
+                for ( auto it : connections_ ) {
+                    close(it.first);
+                    delete it.second;
+                }
+                connections_.clear();
+                close(listener_);
+                close(wakeup_[0]);
+                close(wakeup_[1]);
+                listener_  = -1;
+                wakeup_[0] = wakeup_[1] = -1;
+            }
+
+            /**
+             * @brief Schedule a function to be called on server thread.
+             *
+             * @param a_function Function to call, nullptr to just wake up loop.
+             */
+            inline void Server::Post (std::function<void()> a_function)
+            {
+                if ( nullptr != a_function ) {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pending_.push_back(a_function);
+                }
+                const char byte = 0;
+                (void)write(wakeup_[1], &byte, sizeof(byte));
+            }
+
+            /**
+             * @brief Queue data to be written to a connection, must be called on server thread.
+             *
+             * @param a_connection Target connection.
+             * @param a_data       Data to write.
+             */
+            inline void Server::Write (Connection* a_connection, const std::string& a_data)
+            {
+                a_connection->out_ += a_data;
+            }
+
+            /**
+             * @brief Server loop.
+             */
+            inline void Server::Loop ()
+            {
+                std::vector<struct pollfd> fds;
+                std::vector<std::function<void()>> functions;
+                char buffer[16384];
+                while ( true == running_ ) {
+                    // ... prepare ...
+                    fds.clear();
+                    fds.push_back({ wakeup_[0], POLLIN, 0 });
+                    fds.push_back({ listener_ , POLLIN, 0 });
+                    for ( auto it : connections_ ) {
+                        fds.push_back({ it.first, static_cast<short>(POLLIN | ( it.second->out_.length() > 0 ? POLLOUT : 0 )), 0 });
+                    }
+                    // ... wait ...
+                    const int rv = poll(fds.data(), fds.size(), OnIdle());
+                    if ( rv < 0 ) {
+                        if ( EINTR == errno ) {
+                            continue;
+                        }
+                        break;
+                    }
+                    // ... pending functions ...
+                    if ( 0 != ( fds[0].revents & POLLIN ) ) {
+                        while ( read(wakeup_[0], buffer, sizeof(buffer)) > 0 ) {
+                            // ... drain ...
+                        }
+                        {
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            functions.swap(pending_);
+                        }
+                        for ( auto& function : functions ) {
+                            function();
+                        }
+                        functions.clear();
+                    }
+                    // ... new connections ...
+                    if ( 0 != ( fds[1].revents & POLLIN ) ) {
+                        int fd;
+                        while ( -1 != ( fd = accept(listener_, nullptr, nullptr) ) ) {
+                            const int nodelay = 1;
+                            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+                            connections_[fd] = new Connection({ fd, "", "", false });
+                        }
+                    }
+                    // ... connections I/O ...
+                    for ( size_t idx = 2 ; idx < fds.size() ; ++idx ) {
+                        const auto it = connections_.find(fds[idx].fd);
+                        if ( connections_.end() == it ) {
+                            continue;
+                        }
+                        Connection* connection = it->second;
+                        bool        closed     = ( 0 != ( fds[idx].revents & ( POLLERR | POLLHUP | POLLNVAL ) ) );
+                        if ( false == closed && 0 != ( fds[idx].revents & POLLIN ) ) {
+                            ssize_t count;
+                            while ( ( count = read(connection->fd_, buffer, sizeof(buffer)) ) > 0 ) {
+                                connection->in_.append(buffer, static_cast<size_t>(count));
+                            }
+                            closed = ( 0 == count || ( count < 0 && EAGAIN != errno && EWOULDBLOCK != errno ) );
+                            if ( connection->in_.length() > 0 ) {
+                                OnData(connection);
+                            }
+                        }
+                        if ( false == closed && connection->out_.length() > 0 ) {
+                            const ssize_t count = write(connection->fd_, connection->out_.c_str(), connection->out_.length());
+                            if ( count > 0 ) {
+                                connection->out_.erase(0, static_cast<size_t>(count));
+                            } else if ( count < 0 && EAGAIN != errno && EWOULDBLOCK != errno ) {
+                                closed = true;
+                            }
+                        }
+                        if ( true == closed || ( true == connection->close_ && 0 == connection->out_.length() ) ) {
+                            Close(connection);
+                        }
+                    }
+                }
+            }
+
+            /**
+             * @brief Close and release a connection.
+             *
+             * @param a_connection Connection to close.
+             */
+            inline void Server::Close (Connection* a_connection)
+            {
+                OnDisconnect(a_connection);
+                connections_.erase(a_connection->fd_);
+                close(a_connection->fd_);
+                delete a_connection;
+            }
+
+        } // end of namespace 'fake'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_FAKE_SERVER_H_
@@ -0,0 +1,439 @@
+/**
+ * @file generator.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_LOAD_GENERATOR_H_
+#define CASPER_JOB_LOAD_GENERATOR_H_
+
+#include "casper/job/fake/beanstalkd.h"
+#include "casper/job/fake/redis.h"
+
+#include "cc/easy/json.h"
+
+#include "json/json.h"
+
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <condition_variable>
+
+#include <sys/resource.h> // getrusage
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace load
+        {
+
+            /**
+             * @brief Open-loop job generator, feeds an in-process beanstalkd stand-in and measures job completion.
+             *
+             * A job is considered completed when the consumer deletes ( or buries ) it.
+             */
+            class Generator final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            public: // Data Type(s)
+
+                enum class Mode : uint8_t {
+                    Fixed = 0, //!< Constant inter-arrival time.
+                    Poisson    //!< Exponentially distributed inter-arrival time.
+                };
+
+                typedef struct {
+                    std::string tube_;
+                    double      weight_;
+                    Json::Value payload_;
+                    size_t      padding_; //!< Number of filler bytes to add to payload.
+                } Entry;
+
+                typedef struct {
+                    Mode               mode_;
+                    double             rate_;      //!< Jobs per second.
+                    double             duration_;  //!< In seconds.
+                    double             warm_up_;   //!< In seconds, jobs started during warm-up are not measured.
+                    double             drain_;     //!< In seconds, maximum time to wait for outstanding jobs.
+                    uint32_t           ttr_;
+                    uint32_t           validity_;
+                    uint64_t           seed_;
+                    std::vector<Entry> mix_;
+                } Config;
+
+                typedef struct {
+                    uint64_t submitted_;
+                    uint64_t completed_;
+                    uint64_t buried_;
+                    uint64_t expired_;     //!< TTR expirations ( duplicated deliveries ).
+                    uint64_t outstanding_;
+                    double   elapsed_;     //!< Measured window, in seconds.
+                    double   throughput_;  //!< Completed jobs per second.
+                    double   p50_;         //!< Latency percentiles, in ms.
+                    double   p90_;
+                    double   p99_;
+                    double   p999_;
+                    double   max_;
+                    double   cpu_per_job_; //!< User + system CPU time per completed job, in microseconds.
+                    uint64_t rss_;         //!< Current resident set size, in KB.
+                    uint64_t peak_rss_;    //!< Peak resident set size, in KB.
+                } Report;
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+            private: // Data
+
+                fake::Beanstalkd&           beanstalkd_;
+                Config                      config_;
+                std::mutex                  mutex_;
+                std::condition_variable     condition_;  //!< Wakes \link Run \link up when it's stopped.
+                bool                        stopped_;
+                std::map<uint64_t, TimePoint> started_;    //!< Job ID -> put time.
+                std::map<uint64_t, TimePoint> early_;      //!< Job ID -> completion time, for completions that arrived before put returned.
+                std::set<uint64_t>          measured_;   //!< Job IDs put after warm-up.
+                std::vector<double>         latencies_;  //!< In ms.
+                uint64_t                    submitted_;
+                uint64_t                    completed_;
+                uint64_t                    buried_;
+                uint64_t                    expired_;
+
+            public: // Constructor(s) / Destructor
+
+                Generator () = delete;
+                Generator (fake::Beanstalkd& a_beanstalkd, const Config& a_config);
+                virtual ~Generator ();
+
+            public: // Method(s) / Function(s)
+
+                Report Run   ();
+                void   Stop  ();
+                void   Print (const Report& a_report, FILE* a_stream) const;
+
+            public: // Static Method(s) / Function(s)
+
+                static Config   Load       (const Json::Value& a_config);
+                static double   Percentile (const std::vector<double>& a_sorted, const double a_percentile);
+                static double   CPU        ();
+                static uint64_t Status     (const char* const a_key);
+
+            private: // Method(s) / Function(s)
+
+                void OnFinished (const uint64_t& a_id, const bool a_buried);
+
+            }; // end of class 'Generator'
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_beanstalkd Beanstalkd stand-in, not started yet.
+             * @param a_config     See \link Config \link.
+             */
+            inline Generator::Generator (fake::Beanstalkd& a_beanstalkd, const Config& a_config)
+                : beanstalkd_(a_beanstalkd), config_(a_config)
+            {
+                submitted_ = completed_ = buried_ = expired_ = 0;
+                stopped_   = false;
+                if ( 0 == config_.mix_.size() ) {
+                    throw ::cc::Exception("%s", "Load generator requires at least one payload mix entry!");
+                }
+                beanstalkd_.Observe({
+                    /* on_reserved_ */ nullptr,
+                    /* on_deleted_  */ [this] (const uint64_t& a_id, const std::string&) { OnFinished(a_id, /* a_buried */ false); },
+                    /* on_buried_   */ [this] (const uint64_t& a_id, const std::string&) { OnFinished(a_id, /* a_buried */ true);  },
+                    /* on_expired_  */ [this] (const uint64_t&, const std::string&) {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        expired_++;
+                    }
+                });
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Generator::~Generator ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Submit jobs for the configured duration and wait for them to complete.
+             *
+             * @return Measurements, see \link Report \link.
+             */
+            inline Generator::Report Generator::Run ()
+            {
+                std::mt19937_64                       engine(config_.seed_);
+                std::exponential_distribution<double> arrivals(config_.rate_);
+                std::vector<double>                   weights;
+                for ( const auto& entry : config_.mix_ ) {
+                    weights.push_back(entry.weight_);
+                }
+                std::discrete_distribution<size_t>    picker(weights.begin(), weights.end());
+
+                Json::FastWriter jfw; jfw.omitEndingLineFeed();
+
+                const TimePoint start   = std::chrono::steady_clock::now();
+                const TimePoint measure = start + std::chrono::microseconds(static_cast<int64_t>(config_.warm_up_ * 1000000.0));
+                const TimePoint end     = start + std::chrono::microseconds(static_cast<int64_t>(( config_.warm_up_ + config_.duration_ ) * 1000000.0));
+                TimePoint       next    = start;
+                double          cpu     = 0.0;
+                bool            warm    = false;
+                uint64_t        sequence = 0;
+
+                // ... submit ...
+                while ( next < end ) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        if ( true == condition_.wait_until(lock, next, [this] { return stopped_; }) ) {
+                            break;
+                        }
+                    }
+                    const TimePoint now = std::chrono::steady_clock::now();
+                    if ( false == warm && now >= measure ) {
+                        cpu  = CPU();
+                        warm = true;
+                    }
+                    // ... build payload ...
+                    const Entry& entry   = config_.mix_[picker(engine)];
+                    Json::Value  payload = entry.payload_;
+                    payload["id"]       = std::to_string(++sequence);
+                    payload["tube"]     = entry.tube_;
+                    payload["ttr"]      = static_cast<Json::UInt>(config_.ttr_);
+                    payload["validity"] = static_cast<Json::UInt>(config_.validity_);
+                    if ( entry.padding_ > 0 ) {
+                        payload["__padding__"] = std::string(entry.padding_, 'x');
+                    }
+                    // ... put ...
+                    const uint64_t id = beanstalkd_.Put(entry.tube_, jfw.write(payload), /* a_priority */ 1024, /* a_delay */ 0, config_.ttr_);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        submitted_++;
+                        if ( true == warm ) {
+                            measured_.insert(id);
+                        }
+                        const auto it = early_.find(id);
+                        if ( early_.end() != it ) {
+                            if ( true == warm ) {
+                                latencies_.push_back(std::chrono::duration<double, std::milli>(it->second - now).count());
+                            }
+                            early_.erase(it);
+                        } else {
+                            started_[id] = now;
+                        }
+                    }
+                    // ... next arrival ...
+                    const double interval = ( Mode::Poisson == config_.mode_ ? arrivals(engine) : 1.0 / config_.rate_ );
+                    next += std::chrono::microseconds(static_cast<int64_t>(interval * 1000000.0));
+                }
+
+                // ... drain ...
+                const TimePoint deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<int64_t>(config_.drain_ * 1000000.0));
+                while ( std::chrono::steady_clock::now() < deadline ) {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    if ( 0 == started_.size() || true == condition_.wait_for(lock, std::chrono::milliseconds(10), [this] { return stopped_; }) ) {
+                        break;
+                    }
+                }
+
+                // ... report ...
+                std::lock_guard<std::mutex> lock(mutex_);
+                const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - measure).count();
+                std::sort(latencies_.begin(), latencies_.end());
+                const double used = CPU() - cpu;
+                return {
+                    /* submitted_   */ submitted_,
+                    /* completed_   */ completed_,
+                    /* buried_      */ buried_,
+                    /* expired_     */ expired_,
+                    /* outstanding_ */ static_cast<uint64_t>(started_.size()),
+                    /* elapsed_     */ elapsed,
+                    /* throughput_  */ ( elapsed > 0 ? static_cast<double>(latencies_.size()) / elapsed : 0.0 ),
+                    /* p50_         */ Percentile(latencies_, 50.0),
+                    /* p90_         */ Percentile(latencies_, 90.0),
+                    /* p99_         */ Percentile(latencies_, 99.0),
+                    /* p999_        */ Percentile(latencies_, 99.9),
+                    /* max_         */ ( latencies_.size() > 0 ? latencies_.back() : 0.0 ),
+                    /* cpu_per_job_ */ ( latencies_.size() > 0 ? ( used * 1000000.0 ) / static_cast<double>(latencies_.size()) : 0.0 ),
+                    /* rss_         */ Status("VmRSS:"),
+                    /* peak_rss_    */ Status("VmHWM:")
+                };
+            }
+
+            /**
+             * @brief Ask \link Run \link to stop submitting ( and waiting for ) jobs, it returns a report of what was done so far.
+             *
+             * @note Safe to call from any thread.
+             */
+            inline void Generator::Stop ()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopped_ = true;
+                condition_.notify_all();
+            }
+
+            /**
+             * @brief Print a report.
+             *
+             * @param a_report Report to print.
+             * @param a_stream Where to write to.
+             */
+            inline void Generator::Print (const Report& a_report, FILE* a_stream) const
+            {
+                fprintf(a_stream, "\n--- load ( %s, %.1f job(s)/s target, %.1fs ) ---\n",
+                        ( Mode::Poisson == config_.mode_ ? "poisson" : "fixed" ), config_.rate_, config_.duration_);
+                fprintf(a_stream, "submitted   : " UINT64_FMT "\n", a_report.submitted_);
+                fprintf(a_stream, "completed   : " UINT64_FMT " ( " UINT64_FMT " buried )\n", a_report.completed_, a_report.buried_);
+                fprintf(a_stream, "outstanding : " UINT64_FMT "\n", a_report.outstanding_);
+                fprintf(a_stream, "ttr expired : " UINT64_FMT "\n", a_report.expired_);
+                fprintf(a_stream, "throughput  : %.1f job(s)/s\n", a_report.throughput_);
+                fprintf(a_stream, "latency     : p50 %.3fms, p90 %.3fms, p99 %.3fms, p99.9 %.3fms, max %.3fms\n",
+                        a_report.p50_, a_report.p90_, a_report.p99_, a_report.p999_, a_report.max_);
+                fprintf(a_stream, "cpu         : %.1fus / job ( process wide, includes stand-ins )\n", a_report.cpu_per_job_);
+                fprintf(a_stream, "rss         : " UINT64_FMT " KB ( peak " UINT64_FMT " KB )\n", a_report.rss_, a_report.peak_rss_);
+                fflush(a_stream);
+            }
+
+            /**
+             * @brief Load a generator configuration from it's JSON representation.
+             *
+             * @param a_config JSON object.
+             *
+             * @return See \link Config \link.
+             */
+            inline Generator::Config Generator::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_mode     = "fixed";
+                const Json::Value c_rate     = 100.0;
+                const Json::Value c_duration = 10.0;
+                const Json::Value c_warm_up  = 1.0;
+                const Json::Value c_drain    = 10.0;
+                const Json::Value c_ttr      = 60;
+                const Json::Value c_validity = 3600;
+                const Json::Value c_seed     = 1;
+                const Json::Value c_weight   = 1.0;
+                const Json::Value c_padding  = 0;
+                const Json::Value c_payload  = Json::Value(Json::ValueType::objectValue);
+
+                Config config = {
+                    /* mode_     */ ( "poisson" == json.Get(a_config, "mode", Json::ValueType::stringValue, &c_mode).asString() ? Mode::Poisson : Mode::Fixed ),
+                    /* rate_     */ json.Get(a_config, "rate"    , Json::ValueType::realValue, &c_rate).asDouble(),
+                    /* duration_ */ json.Get(a_config, "duration", Json::ValueType::realValue, &c_duration).asDouble(),
+                    /* warm_up_  */ json.Get(a_config, "warm-up" , Json::ValueType::realValue, &c_warm_up).asDouble(),
+                    /* drain_    */ json.Get(a_config, "drain"   , Json::ValueType::realValue, &c_drain).asDouble(),
+                    /* ttr_      */ json.Get(a_config, "ttr"     , Json::ValueType::uintValue, &c_ttr).asUInt(),
+                    /* validity_ */ json.Get(a_config, "validity", Json::ValueType::uintValue, &c_validity).asUInt(),
+                    /* seed_     */ json.Get(a_config, "seed"    , Json::ValueType::uintValue, &c_seed).asUInt64(),
+                    /* mix_      */ {}
+                };
+                if ( config.rate_ <= 0.0 ) {
+                    throw ::cc::Exception("Invalid load rate %lf!", config.rate_);
+                }
+                const Json::Value& mix = json.Get(a_config, "mix", Json::ValueType::arrayValue, nullptr);
+                for ( Json::ArrayIndex idx = 0 ; idx < mix.size() ; ++idx ) {
+                    config.mix_.push_back({
+                        /* tube_    */ json.Get(mix[idx], "tube"   , Json::ValueType::stringValue, nullptr).asString(),
+                        /* weight_  */ json.Get(mix[idx], "weight" , Json::ValueType::realValue  , &c_weight).asDouble(),
+                        /* payload_ */ json.Get(mix[idx], "payload", Json::ValueType::objectValue, &c_payload),
+                        /* padding_ */ static_cast<size_t>(json.Get(mix[idx], "padding", Json::ValueType::uintValue, &c_padding).asUInt64())
+                    });
+                }
+                return config;
+            }
+
+            /**
+             * @brief Called on beanstalkd stand-in thread when a job is deleted or buried.
+             *
+             * @param a_id     Job ID.
+             * @param a_buried True if job was buried.
+             */
+            inline void Generator::OnFinished (const uint64_t& a_id, const bool a_buried)
+            {
+                const TimePoint now = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed_++;
+                if ( true == a_buried ) {
+                    buried_++;
+                }
+                const auto it = started_.find(a_id);
+                if ( started_.end() == it ) {
+                    early_[a_id] = now;
+                    return;
+                }
+                if ( 1 == measured_.count(a_id) ) {
+                    latencies_.push_back(std::chrono::duration<double, std::milli>(now - it->second).count());
+                    measured_.erase(a_id);
+                }
+                started_.erase(it);
+            }
+
+            /**
+             * @return Percentile value from a sorted sample.
+             */
+            inline double Generator::Percentile (const std::vector<double>& a_sorted, const double a_percentile)
+            {
+                if ( 0 == a_sorted.size() ) {
+                    return 0.0;
+                }
+                const size_t index = static_cast<size_t>(( a_percentile / 100.0 ) * static_cast<double>(a_sorted.size() - 1) + 0.5);
+                return a_sorted[std::min(index, a_sorted.size() - 1)];
+            }
+
+            /**
+             * @return User + system CPU time used by this process, in seconds.
+             */
+            inline double Generator::CPU ()
+            {
+                struct rusage usage;
+                getrusage(RUSAGE_SELF, &usage);
+                return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+                        + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+            }
+
+            /**
+             * @brief Read a value ( in KB ) from /proc/self/status.
+             *
+             * @param a_key Key, including ':'.
+             *
+             * @return Value or 0 if not available.
+             */
+            inline uint64_t Generator::Status (const char* const a_key)
+            {
+                std::ifstream status("/proc/self/status");
+                std::string   line;
+                while ( std::getline(status, line) ) {
+                    if ( 0 == line.compare(0, strlen(a_key), a_key) ) {
+                        return strtoull(line.c_str() + strlen(a_key), nullptr, 10);
+                    }
+                }
+                return 0;
+            }
+
+        } // end of namespace 'load'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_LOAD_GENERATOR_H_
@@ -0,0 +1,310 @@
+/**
+ * @file replayer.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_LOAD_REPLAYER_H_
+#define CASPER_JOB_LOAD_REPLAYER_H_
+
+#include "casper/job/load/generator.h"
+
+#include "casper/job/deferrable/replay.h"
+
+#include <condition_variable>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace load
+        {
+
+            /**
+             * @brief Closed-loop replay driver, feeds recorded payloads to an in-process beanstalkd stand-in as fast as
+             *        the consumer takes them ( up to \link Config::window_ \link jobs in flight ).
+             *
+             * The consumer must run with the same recording configured as 'replay' so that its dispatcher
+             * serves recorded responses and final responses are checked against recorded ones.
+             */
+            class Replayer final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            public: // Data Type(s)
+
+                typedef struct {
+                    std::string path_;
+                    size_t      window_; //!< Maximum number of jobs in flight.
+                    double      drain_;  //!< In seconds, maximum time to wait for outstanding jobs.
+                    uint32_t    ttr_;
+                } Config;
+
+                typedef struct {
+                    uint64_t                      submitted_;
+                    uint64_t                      completed_;
+                    uint64_t                      buried_;
+                    uint64_t                      outstanding_;
+                    double                        elapsed_;     //!< In seconds.
+                    double                        throughput_;  //!< Completed jobs per second.
+                    double                        p50_;         //!< Latency percentiles, in ms.
+                    double                        p99_;
+                    double                        max_;
+                    double                        cpu_per_job_; //!< User + system CPU time per completed job, in microseconds.
+                    deferrable::Script::Stats     script_;
+                } Report;
+
+            private: // Data Type(s)
+
+                typedef std::chrono::steady_clock::time_point TimePoint;
+
+            private: // Data
+
+                fake::Beanstalkd&             beanstalkd_;
+                const Config                  config_;
+                deferrable::Script&           script_;
+                std::mutex                    mutex_;
+                std::condition_variable       condition_;
+                bool                          stopped_;
+                std::map<uint64_t, TimePoint> started_;   //!< Job ID -> put time.
+                std::map<uint64_t, TimePoint> early_;     //!< Job ID -> completion time, for completions that arrived before put returned.
+                std::vector<double>           latencies_; //!< In ms.
+                uint64_t                      completed_;
+                uint64_t                      buried_;
+
+            public: // Constructor(s) / Destructor
+
+                Replayer () = delete;
+                Replayer (fake::Beanstalkd& a_beanstalkd, const Config& a_config);
+                virtual ~Replayer ();
+
+            public: // Method(s) / Function(s)
+
+                Report Run    ();
+                void   Stop   ();
+                void   Print  (const Report& a_report, FILE* a_stream) const;
+                bool   Verify (const Report& a_report) const;
+
+            public: // Static Method(s) / Function(s)
+
+                static Config Load (const Json::Value& a_config);
+
+            private: // Method(s) / Function(s)
+
+                void OnFinished (const uint64_t& a_id, const bool a_buried);
+
+            }; // end of class 'Replayer'
+
+            /**
+             * @brief Default constructor.
+             *
+             * @param a_beanstalkd Beanstalkd stand-in, not started yet.
+             * @param a_config     See \link Config \link.
+             */
+            inline Replayer::Replayer (fake::Beanstalkd& a_beanstalkd, const Config& a_config)
+                : beanstalkd_(a_beanstalkd), config_(a_config), script_(deferrable::Script::Load(a_config.path_))
+            {
+                completed_ = buried_ = 0;
+                stopped_   = false;
+                if ( 0 == script_.jobs().size() ) {
+                    throw ::cc::Exception("Recording '%s' has no replayable jobs!", config_.path_.c_str());
+                }
+                beanstalkd_.Observe({
+                    /* on_reserved_ */ nullptr,
+                    /* on_deleted_  */ [this] (const uint64_t& a_id, const std::string&) { OnFinished(a_id, /* a_buried */ false); },
+                    /* on_buried_   */ [this] (const uint64_t& a_id, const std::string&) { OnFinished(a_id, /* a_buried */ true);  },
+                    /* on_expired_  */ nullptr
+                });
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Replayer::~Replayer ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Submit all recorded jobs and wait for them to complete.
+             *
+             * @return Measurements, see \link Report \link.
+             */
+            inline Replayer::Report Replayer::Run ()
+            {
+                const TimePoint start     = std::chrono::steady_clock::now();
+                const double    cpu       = Generator::CPU();
+                uint64_t        submitted = 0;
+
+                // ... submit ...
+                for ( const auto& job : script_.jobs() ) {
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        condition_.wait(lock, [this] { return started_.size() < config_.window_ || true == stopped_; });
+                        if ( true == stopped_ ) {
+                            break;
+                        }
+                    }
+                    const TimePoint now = std::chrono::steady_clock::now();
+                    const uint64_t  id  = beanstalkd_.Put(script_.tube(), job.payload_, /* a_priority */ 1024, /* a_delay */ 0, config_.ttr_);
+                    submitted++;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    const auto it = early_.find(id);
+                    if ( early_.end() != it ) {
+                        latencies_.push_back(std::chrono::duration<double, std::milli>(it->second - now).count());
+                        early_.erase(it);
+                    } else {
+                        started_[id] = now;
+                    }
+                }
+
+                // ... drain ...
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    condition_.wait_for(lock, std::chrono::microseconds(static_cast<int64_t>(config_.drain_ * 1000000.0)),
+                                        [this] { return 0 == started_.size() || true == stopped_; });
+                }
+
+                // ... report ...
+                std::lock_guard<std::mutex> lock(mutex_);
+                const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::sort(latencies_.begin(), latencies_.end());
+                const double used = Generator::CPU() - cpu;
+                return {
+                    /* submitted_   */ submitted,
+                    /* completed_   */ completed_,
+                    /* buried_      */ buried_,
+                    /* outstanding_ */ static_cast<uint64_t>(started_.size()),
+                    /* elapsed_     */ elapsed,
+                    /* throughput_  */ ( elapsed > 0 ? static_cast<double>(completed_) / elapsed : 0.0 ),
+                    /* p50_         */ Generator::Percentile(latencies_, 50.0),
+                    /* p99_         */ Generator::Percentile(latencies_, 99.0),
+                    /* max_         */ ( latencies_.size() > 0 ? latencies_.back() : 0.0 ),
+                    /* cpu_per_job_ */ ( completed_ > 0 ? ( used * 1000000.0 ) / static_cast<double>(completed_) : 0.0 ),
+                    /* script_      */ script_.Snapshot()
+                };
+            }
+
+            /**
+             * @brief Ask \link Run \link to stop submitting ( and waiting for ) jobs, it returns a report of what was done so far.
+             *
+             * @note Safe to call from any thread.
+             */
+            inline void Replayer::Stop ()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopped_ = true;
+                condition_.notify_all();
+            }
+
+            /**
+             * @brief Print a report.
+             *
+             * @param a_report Report to print.
+             * @param a_stream Where to write to.
+             */
+            inline void Replayer::Print (const Report& a_report, FILE* a_stream) const
+            {
+                fprintf(a_stream, "\n--- replay ( %s, tube %s, window " SIZET_FMT " ) ---\n", config_.path_.c_str(), script_.tube().c_str(), config_.window_);
+                fprintf(a_stream, "submitted   : " UINT64_FMT "\n", a_report.submitted_);
+                fprintf(a_stream, "completed   : " UINT64_FMT " ( " UINT64_FMT " buried )\n", a_report.completed_, a_report.buried_);
+                fprintf(a_stream, "outstanding : " UINT64_FMT "\n", a_report.outstanding_);
+                fprintf(a_stream, "throughput  : %.1f job(s)/s\n", a_report.throughput_);
+                fprintf(a_stream, "latency     : p50 %.3fms, p99 %.3fms, max %.3fms\n", a_report.p50_, a_report.p99_, a_report.max_);
+                fprintf(a_stream, "cpu         : %.1fus / job ( process wide, includes stand-ins )\n", a_report.cpu_per_job_);
+                fprintf(a_stream, "bound       : " UINT64_FMT " ( " UINT64_FMT " unbound, " UINT64_FMT " without recorded response )\n",
+                        a_report.script_.bound_, a_report.script_.unbound_, a_report.script_.exhausted_);
+                fprintf(a_stream, "responses   : " UINT64_FMT " matched, " UINT64_FMT " mismatched\n", a_report.script_.matched_, a_report.script_.mismatched_);
+                for ( const auto& bjid : a_report.script_.mismatches_ ) {
+                    fprintf(a_stream, "              recorded job #" UINT64_FMT " differs\n", bjid);
+                }
+                fflush(a_stream);
+            }
+
+            /**
+             * @brief Regression check.
+             *
+             * @param a_report Report to check.
+             *
+             * @return True if all recorded jobs were replayed and all final responses match the recorded ones.
+             */
+            inline bool Replayer::Verify (const Report& a_report) const
+            {
+                return a_report.completed_ == a_report.submitted_ && 0 == a_report.outstanding_
+                        && 0 == a_report.script_.unbound_ && 0 == a_report.script_.exhausted_ && 0 == a_report.script_.mismatched_;
+            }
+
+            /**
+             * @brief Load a replayer configuration from it's JSON representation.
+             *
+             * @param a_config JSON object.
+             *
+             * @return See \link Config \link.
+             */
+            inline Replayer::Config Replayer::Load (const Json::Value& a_config)
+            {
+                const ::cc::easy::JSON<::cc::Exception> json;
+
+                const Json::Value c_window = 64;
+                const Json::Value c_drain  = 10.0;
+                const Json::Value c_ttr    = 60;
+
+                Config config = {
+                    /* path_   */ json.Get(a_config, "path"  , Json::ValueType::stringValue, nullptr).asString(),
+                    /* window_ */ static_cast<size_t>(json.Get(a_config, "window", Json::ValueType::uintValue, &c_window).asUInt64()),
+                    /* drain_  */ json.Get(a_config, "drain" , Json::ValueType::realValue, &c_drain).asDouble(),
+                    /* ttr_    */ json.Get(a_config, "ttr"   , Json::ValueType::uintValue, &c_ttr).asUInt()
+                };
+                if ( 0 == config.window_ ) {
+                    throw ::cc::Exception("%s", "Invalid replay window 0!");
+                }
+                return config;
+            }
+
+            /**
+             * @brief Called on beanstalkd stand-in thread when a job is deleted or buried.
+             *
+             * @param a_id     Job ID.
+             * @param a_buried True if job was buried.
+             */
+            inline void Replayer::OnFinished (const uint64_t& a_id, const bool a_buried)
+            {
+                const TimePoint now = std::chrono::steady_clock::now();
+                std::lock_guard<std::mutex> lock(mutex_);
+                completed_++;
+                if ( true == a_buried ) {
+                    buried_++;
+                }
+                const auto it = started_.find(a_id);
+                if ( started_.end() == it ) {
+                    early_[a_id] = now;
+                    return;
+                }
+                latencies_.push_back(std::chrono::duration<double, std::milli>(now - it->second).count());
+                started_.erase(it);
+                condition_.notify_all();
+            }
+
+        } // end of namespace 'load'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_LOAD_REPLAYER_H_
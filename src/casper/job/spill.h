@@ -0,0 +1,746 @@
+/**
+ * @file spill.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_SPILL_H_
+#define CASPER_JOB_SPILL_H_
+
+#include "cc/non-copyable.h"
+#include "cc/non-movable.h"
+
+#include "cc/exception.h"
+
+#include "json/json.h"
+
+#include <inttypes.h>
+#include <string>
+#include <memory>     // std::unique_ptr
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <streambuf>
+#include <functional>
+
+#include <stdio.h>    // fopen, fwrite, fclose
+#include <errno.h>
+#include <string.h>   // strerror
+#include <unistd.h>   // close, unlink, getpid
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap, munmap, madvise
+#include <sys/stat.h> // fstat
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        /**
+         * @brief Spill large job outputs to files in the output directory, so that only a small reference travels through
+         *        REDIS: { "__spilled__": { "path": ..., "size": ..., "crc32": ..., "content_type": ... } }.
+         *
+         * Outputs are streamed, memory in use is bounded by the threshold; once written, a file can be mapped with
+         * \link Mapping \link for local processing. Files are owned by whoever consumes the reference.
+         *
+         * Not thread safe, each tube owns one.
+         */
+        class Spill final : public ::cc::NonCopyable, public ::cc::NonMovable
+        {
+
+        public: // Data Type(s)
+
+            typedef struct {
+                bool        enabled_;
+                size_t      threshold_; //!< Outputs larger than this, in bytes, are spilled.
+                std::string directory_; //!< Where files are written, with trailing slash.
+            } Config;
+
+            typedef struct {
+                uint64_t spilled_;  //!< Outputs written to a file.
+                uint64_t kept_;     //!< Outputs at or below threshold, not written.
+                uint64_t bytes_;    //!< Bytes written to files.
+                uint64_t write_us_; //!< Time spent serializing and writing spilled outputs, in microseconds.
+            } Stats;
+
+            typedef struct {
+                std::string path_;
+                size_t      size_;         //!< In bytes.
+                uint32_t    crc32_;        //!< CRC-32 ( IEEE ) of the whole file.
+                std::string content_type_;
+            } File;
+
+            typedef std::function<void(std::ostream&)> Producer; //!< Writes an output to a stream.
+
+            /**
+             * @brief Read-only memory mapping of a spilled file.
+             */
+            class Mapping final : public ::cc::NonCopyable, public ::cc::NonMovable
+            {
+
+            private: // Data
+
+                const char* data_;
+                size_t      size_;
+
+            public: // Constructor(s) / Destructor
+
+                Mapping () = delete;
+                Mapping (const File& a_file, const bool a_verify = true);
+                virtual ~Mapping ();
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return Mapped file contents, nullptr if it's empty.
+                 */
+                inline const char* data () const
+                {
+                    return data_;
+                }
+
+                /**
+                 * @return Mapped file size, in bytes.
+                 */
+                inline size_t size () const
+                {
+                    return size_;
+                }
+
+            }; // end of class 'Mapping'
+
+        public: // Const Data
+
+            static constexpr const char* k_reference_ = "__spilled__";
+
+        private: // Data Type(s)
+
+            /**
+             * @brief Stream buffer that keeps data in memory up to a threshold and moves it, and everything that follows, to
+             *        a file once it's crossed.
+             */
+            class Spool final : public std::streambuf
+            {
+
+            private: // Data
+
+                char              area_[64 * 1024];
+                const size_t      threshold_;
+                const std::string path_;
+                std::string       memory_;
+                FILE*             file_;
+                size_t            size_;
+                uint32_t          crc32_;
+
+            public: // Constructor(s) / Destructor
+
+                Spool (const size_t a_threshold, const std::string& a_path);
+                virtual ~Spool ();
+
+            public: // Method(s) / Function(s)
+
+                bool Close (const bool a_force);
+
+            public: // Inline Method(s) / Function(s)
+
+                inline size_t   size  () const { return size_;  }
+                inline uint32_t crc32 () const { return crc32_; }
+
+            protected: // Inherited Virtual Method(s) / Function(s) - from std::streambuf
+
+                virtual int_type overflow (int_type a_c);
+                virtual int      sync     ();
+
+            private: // Method(s) / Function(s)
+
+                void Drain (const bool a_force);
+                void Open  ();
+
+            }; // end of class 'Spool'
+
+            /**
+             * @brief Stream buffer that only counts data, and refuses it once a limit is crossed.
+             */
+            class Counter final : public std::streambuf
+            {
+
+            private: // Data
+
+                char         area_[4 * 1024];
+                const size_t limit_;
+                size_t       size_;
+
+            public: // Constructor(s) / Destructor
+
+                Counter (const size_t a_limit);
+                virtual ~Counter ();
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return Number of bytes counted, larger than limit if it was crossed.
+                 */
+                inline size_t size () const
+                {
+                    return size_ + static_cast<size_t>(pptr() - pbase());
+                }
+
+            protected: // Inherited Virtual Method(s) / Function(s) - from std::streambuf
+
+                virtual int_type overflow (int_type a_c);
+
+            }; // end of class 'Counter'
+
+        private: // Data
+
+            const Config config_;
+            Stats        stats_;
+
+        public: // Constructor(s) / Destructor
+
+            Spill () = delete;
+            Spill (const Config& a_config);
+            virtual ~Spill ();
+
+        public: // Method(s) / Function(s)
+
+            bool Write (const std::string& a_prefix, const Producer& a_producer, const std::string& a_content_type, File& o_file, const bool a_force = false);
+            bool Write (const std::string& a_prefix, const Json::Value& a_value, File& o_file);
+            bool Write (const std::string& a_prefix, const std::string& a_data, const std::string& a_content_type, File& o_file);
+
+        public: // Inline Method(s) / Function(s)
+
+            /**
+             * @return R/O access to configuration.
+             */
+            inline const Config& config () const
+            {
+                return config_;
+            }
+
+            /**
+             * @return R/O access to statistics.
+             */
+            inline const Stats& stats () const
+            {
+                return stats_;
+            }
+
+        public: // Static Method(s) / Function(s)
+
+            static Config   Load       (const Json::Value& a_config, const std::string& a_directory);
+            static void     Reference  (const File& a_file, Json::Value& o_reference);
+            static bool     Referenced (const Json::Value& a_value);
+            static void     Resolve    (const Json::Value& a_reference, File& o_file);
+            static uint32_t CRC32      (uint32_t a_crc, const char* const a_data, const size_t a_length);
+
+        private: // Static Method(s) / Function(s)
+
+            static const std::string& Instance ();
+            static uint64_t           Sequence ();
+            static size_t             Measure  (const Producer& a_producer, const size_t a_limit);
+
+        }; // end of class 'Spill'
+
+        /**
+         * @brief Default constructor.
+         *
+         * @param a_config See \link Config \link.
+         */
+        inline Spill::Spill (const Config& a_config)
+            : config_(a_config)
+        {
+            stats_ = { 0, 0, 0, 0 };
+        }
+
+        /**
+         * @brief Destructor.
+         */
+        inline Spill::~Spill ()
+        {
+            /* empty */
+        }
+
+        /**
+         * @brief Load a tube's spill configuration from it's JSON representation.
+         *
+         * @param a_config    JSON object, { "threshold": <bytes>, "directory": <path> }, null to disable spilling.
+         * @param a_directory Default directory, the tube's output directory.
+         *
+         * @return See \link Config \link.
+         */
+        inline Spill::Config Spill::Load (const Json::Value& a_config, const std::string& a_directory)
+        {
+            Config config = { /* enabled_ */ false, /* threshold_ */ 1024 * 1024, /* directory_ */ a_directory };
+            if ( true == a_config.isNull() ) {
+                return config;
+            }
+            if ( false == a_config.isObject() ) {
+                throw ::cc::Exception("%s", "Invalid spill configuration, expecting an object!");
+            }
+            const Json::Value& threshold = a_config["threshold"];
+            if ( false == threshold.isNull() ) {
+                if ( false == threshold.isUInt64() ) {
+                    throw ::cc::Exception("%s", "Invalid spill configuration, 'threshold' must be an unsigned integer!");
+                }
+                config.threshold_ = static_cast<size_t>(threshold.asUInt64());
+            }
+            const Json::Value& directory = a_config["directory"];
+            if ( false == directory.isNull() ) {
+                if ( false == directory.isString() ) {
+                    throw ::cc::Exception("%s", "Invalid spill configuration, 'directory' must be a string!");
+                }
+                config.directory_ = directory.asString();
+            }
+            if ( 0 == config.directory_.length() ) {
+                throw ::cc::Exception("%s", "Invalid spill configuration, no 'directory' and 'directories.tmp' is not set!");
+            }
+            if ( '/' != config.directory_.back() ) {
+                config.directory_ += '/';
+            }
+            config.enabled_ = true;
+            return config;
+        }
+
+        /**
+         * @brief Stream an output to a file, if it's larger than threshold.
+         *
+         * @param a_prefix       File name prefix, this process \link Instance \link, a sequence number and extension are appended.
+         * @param a_producer     Function that writes output.
+         * @param a_content_type Output content type.
+         * @param o_file         Written file, untouched if false is returned.
+         * @param a_force        When true output is written to a file whatever it's size.
+         *
+         * @return True if output was written to a file, false if disabled or small enough to be kept in memory.
+         */
+        inline bool Spill::Write (const std::string& a_prefix, const Producer& a_producer, const std::string& a_content_type, File& o_file, const bool a_force)
+        {
+            if ( false == config_.enabled_ ) {
+                return false;
+            }
+            const auto        start = std::chrono::steady_clock::now();
+            const std::string path  = config_.directory_ + a_prefix + "-" + Instance() + "-" + std::to_string(Sequence())
+                                          + ( 0 == a_content_type.compare("application/json") ? ".json" : ".bin" );
+            std::unique_ptr<Spool> spool(new Spool(config_.threshold_, path));
+            {
+                std::ostream stream(spool.get());
+                a_producer(stream);
+                stream.flush();
+                if ( true == stream.bad() ) {
+                    throw ::cc::Exception("Unable to write spill file '%s'!", path.c_str());
+                }
+            }
+            if ( false == spool->Close(a_force) ) {
+                stats_.kept_++;
+                return false;
+            }
+            o_file.path_         = path;
+            o_file.size_         = spool->size();
+            o_file.crc32_        = spool->crc32();
+            o_file.content_type_ = a_content_type;
+            stats_.spilled_++;
+            stats_.bytes_    += o_file.size_;
+            stats_.write_us_ += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+            return true;
+        }
+
+        /**
+         * @brief Serialize a JSON value to a file, if it's larger than threshold, without building it's text in memory.
+         *
+         * Value is first measured, without keeping it's text, so that the common case of a small value costs a single
+         * serialization and no copies; only values that cross threshold are serialized again, straight to a file.
+         *
+         * @param a_prefix File name prefix.
+         * @param a_value  Value to write.
+         * @param o_file   Written file, untouched if false is returned.
+         *
+         * @return True if value was written to a file.
+         */
+        inline bool Spill::Write (const std::string& a_prefix, const Json::Value& a_value, File& o_file)
+        {
+            if ( false == config_.enabled_ ) {
+                return false;
+            }
+            const Producer producer = [&a_value] (std::ostream& a_stream) {
+                Json::StreamWriterBuilder builder;
+                builder["indentation"]  = "";
+                builder["commentStyle"] = "None";
+                const std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
+                writer->write(a_value, &a_stream);
+            };
+            if ( Measure(producer, config_.threshold_) <= config_.threshold_ ) {
+                stats_.kept_++;
+                return false;
+            }
+            return Write(a_prefix, producer, "application/json", o_file, /* a_force */ true);
+        }
+
+        /**
+         * @brief Write data to a file, if it's larger than threshold.
+         *
+         * @param a_prefix       File name prefix.
+         * @param a_data         Data to write, e.g. a deferred request response body.
+         * @param a_content_type Data content type.
+         * @param o_file         Written file, untouched if false is returned.
+         *
+         * @return True if data was written to a file.
+         */
+        inline bool Spill::Write (const std::string& a_prefix, const std::string& a_data, const std::string& a_content_type, File& o_file)
+        {
+            if ( false == config_.enabled_ || a_data.length() <= config_.threshold_ ) {
+                if ( true == config_.enabled_ ) {
+                    stats_.kept_++;
+                }
+                return false;
+            }
+            return Write(a_prefix, [&a_data] (std::ostream& a_stream) {
+                a_stream.write(a_data.c_str(), static_cast<std::streamsize>(a_data.length()));
+            }, a_content_type, o_file, /* a_force */ true);
+        }
+
+        /**
+         * @brief Build a spilled file reference.
+         *
+         * @param a_file      See \link File \link.
+         * @param o_reference JSON object to publish instead of output.
+         */
+        inline void Spill::Reference (const File& a_file, Json::Value& o_reference)
+        {
+            o_reference = Json::Value(Json::ValueType::objectValue);
+            Json::Value& file = o_reference[k_reference_];
+            file["path"]         = a_file.path_;
+            file["size"]         = static_cast<Json::UInt64>(a_file.size_);
+            file["crc32"]        = static_cast<Json::UInt>(a_file.crc32_);
+            file["content_type"] = a_file.content_type_;
+        }
+
+        /**
+         * @return True if value is a spilled file reference.
+         *
+         * @param a_value Value to test.
+         */
+        inline bool Spill::Referenced (const Json::Value& a_value)
+        {
+            return ( true == a_value.isObject() && 1 == a_value.size() && true == a_value[k_reference_].isObject() );
+        }
+
+        /**
+         * @brief Read a spilled file reference.
+         *
+         * @param a_reference See \link Reference \link.
+         * @param o_file      See \link File \link.
+         */
+        inline void Spill::Resolve (const Json::Value& a_reference, File& o_file)
+        {
+            if ( false == Referenced(a_reference) ) {
+                throw ::cc::Exception("%s", "Invalid spilled file reference!");
+            }
+            const Json::Value& file = a_reference[k_reference_];
+            if ( false == file["path"].isString() || false == file["size"].isUInt64() || false == file["crc32"].isUInt() ) {
+                throw ::cc::Exception("%s", "Invalid spilled file reference, missing or invalid 'path', 'size' or 'crc32'!");
+            }
+            o_file.path_         = file["path"].asString();
+            o_file.size_         = static_cast<size_t>(file["size"].asUInt64());
+            o_file.crc32_        = static_cast<uint32_t>(file["crc32"].asUInt());
+            o_file.content_type_ = ( true == file["content_type"].isString() ? file["content_type"].asString() : "" );
+        }
+
+        /**
+         * @brief Compute or update a CRC-32 ( IEEE 802.3, as zlib ).
+         *
+         * @param a_crc    Previous value, 0 to start.
+         * @param a_data   Data.
+         * @param a_length Data length.
+         *
+         * @return Updated value.
+         */
+        inline uint32_t Spill::CRC32 (uint32_t a_crc, const char* const a_data, const size_t a_length)
+        {
+            static const struct Table {
+                uint32_t entries_[256];
+                Table ()
+                {
+                    for ( uint32_t idx = 0 ; idx < 256 ; ++idx ) {
+                        uint32_t c = idx;
+                        for ( size_t bit = 0 ; bit < 8 ; ++bit ) {
+                            c = ( 0 != ( c & 1 ) ? 0xEDB88320U ^ ( c >> 1 ) : ( c >> 1 ) );
+                        }
+                        entries_[idx] = c;
+                    }
+                }
+            } s_table;
+            a_crc = ~a_crc;
+            for ( size_t idx = 0 ; idx < a_length ; ++idx ) {
+                a_crc = s_table.entries_[( a_crc ^ static_cast<uint8_t>(a_data[idx]) ) & 0xFF] ^ ( a_crc >> 8 );
+            }
+            return ~a_crc;
+        }
+
+        /**
+         * @return This process id and start time, in ms since epoch, so that a restarted process never reuses a file name.
+         */
+        inline const std::string& Spill::Instance ()
+        {
+            static const std::string s_instance = std::to_string(static_cast<uint64_t>(getpid())) + "-"
+                + std::to_string(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+            return s_instance;
+        }
+
+        /**
+         * @return Next file sequence number, shared by all tubes of this process, so that re-creating a \link Spill \link
+         *         never reuses a file name either.
+         */
+        inline uint64_t Spill::Sequence ()
+        {
+            static std::atomic<uint64_t> s_sequence(0);
+            return ++s_sequence;
+        }
+
+        /**
+         * @brief Count the bytes an output is made of, without keeping them.
+         *
+         * @param a_producer Function that writes output.
+         * @param a_limit    Counting stops once output is larger than this.
+         *
+         * @return Output size, in bytes, or a value larger than \link a_limit \link if it was crossed.
+         */
+        inline size_t Spill::Measure (const Producer& a_producer, const size_t a_limit)
+        {
+            Counter counter(a_limit);
+            {
+                // ... once limit is crossed stream goes bad and producer's writes are no-ops ...
+                std::ostream stream(&counter);
+                a_producer(stream);
+            }
+            return counter.size();
+        }
+
+        /**
+         * @brief Default constructor.
+         *
+         * @param a_threshold Data larger than this is moved to a file.
+         * @param a_path      File path.
+         */
+        inline Spill::Spool::Spool (const size_t a_threshold, const std::string& a_path)
+            : threshold_(a_threshold), path_(a_path), file_(nullptr), size_(0), crc32_(0)
+        {
+            setp(area_, area_ + sizeof(area_));
+        }
+
+        /**
+         * @brief Destructor, a file left open means output was not completed: it's removed.
+         */
+        inline Spill::Spool::~Spool ()
+        {
+            if ( nullptr != file_ ) {
+                fclose(file_);
+                unlink(path_.c_str());
+            }
+        }
+
+        /**
+         * @brief Finish writing.
+         *
+         * @param a_force When true data is moved to a file even if it did not cross threshold.
+         *
+         * @return True if data is in a file, false if it was kept in memory ( and is now discarded ).
+         */
+        inline bool Spill::Spool::Close (const bool a_force)
+        {
+            Drain(a_force);
+            if ( nullptr == file_ ) {
+                memory_.clear();
+                return false;
+            }
+            FILE* file = file_;
+            file_ = nullptr;
+            if ( 0 != fclose(file) ) {
+                const int error = errno;
+                unlink(path_.c_str());
+                throw ::cc::Exception("Unable to close spill file '%s': %s!", path_.c_str(), strerror(error));
+            }
+            return true;
+        }
+
+        /**
+         * @brief Called when put area is full.
+         *
+         * @param a_c Character that did not fit.
+         */
+        inline Spill::Spool::int_type Spill::Spool::overflow (int_type a_c)
+        {
+            Drain(/* a_force */ false);
+            if ( false == traits_type::eq_int_type(a_c, traits_type::eof()) ) {
+                *pptr() = traits_type::to_char_type(a_c);
+                pbump(1);
+            }
+            return traits_type::not_eof(a_c);
+        }
+
+        /**
+         * @brief Called on stream flush.
+         */
+        inline int Spill::Spool::sync ()
+        {
+            Drain(/* a_force */ false);
+            return 0;
+        }
+
+        /**
+         * @brief Move put area contents to memory or, once threshold is crossed, to file.
+         *
+         * @param a_force When true, open file even if threshold was not crossed.
+         */
+        inline void Spill::Spool::Drain (const bool a_force)
+        {
+            const size_t count = static_cast<size_t>(pptr() - pbase());
+            crc32_  = CRC32(crc32_, pbase(), count);
+            size_  += count;
+            if ( nullptr == file_ && false == a_force && size_ <= threshold_ ) {
+                memory_.append(pbase(), count);
+            } else {
+                if ( nullptr == file_ ) {
+                    Open();
+                }
+                if ( count > 0 && count != fwrite(pbase(), 1, count, file_) ) {
+                    throw ::cc::Exception("Unable to write spill file '%s': %s!", path_.c_str(), strerror(errno));
+                }
+            }
+            setp(area_, area_ + sizeof(area_));
+        }
+
+        /**
+         * @brief Create file and move data kept in memory to it.
+         */
+        inline void Spill::Spool::Open ()
+        {
+            const int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+            if ( -1 == fd ) {
+                throw ::cc::Exception("Unable to create spill file '%s': %s!", path_.c_str(), strerror(errno));
+            }
+            file_ = fdopen(fd, "wb");
+            if ( nullptr == file_ ) {
+                const int error = errno;
+                close(fd);
+                unlink(path_.c_str());
+                throw ::cc::Exception("Unable to open spill file '%s': %s!", path_.c_str(), strerror(error));
+            }
+            if ( memory_.length() > 0 && memory_.length() != fwrite(memory_.c_str(), 1, memory_.length(), file_) ) {
+                throw ::cc::Exception("Unable to write spill file '%s': %s!", path_.c_str(), strerror(errno));
+            }
+            std::string().swap(memory_);
+        }
+
+        /**
+         * @brief Default constructor.
+         *
+         * @param a_limit Data is refused once more than this was counted.
+         */
+        inline Spill::Counter::Counter (const size_t a_limit)
+            : limit_(a_limit), size_(0)
+        {
+            setp(area_, area_ + sizeof(area_));
+        }
+
+        /**
+         * @brief Destructor.
+         */
+        inline Spill::Counter::~Counter ()
+        {
+            /* empty */
+        }
+
+        /**
+         * @brief Called when put area is full, it's contents are counted and discarded.
+         *
+         * @param a_c Character that did not fit.
+         */
+        inline Spill::Counter::int_type Spill::Counter::overflow (int_type a_c)
+        {
+            size_ += static_cast<size_t>(pptr() - pbase());
+            setp(area_, area_ + sizeof(area_));
+            if ( size_ > limit_ ) {
+                return traits_type::eof();
+            }
+            if ( false == traits_type::eq_int_type(a_c, traits_type::eof()) ) {
+                *pptr() = traits_type::to_char_type(a_c);
+                pbump(1);
+            }
+            return traits_type::not_eof(a_c);
+        }
+
+        /**
+         * @brief Map a spilled file.
+         *
+         * @param a_file   See \link File \link.
+         * @param a_verify When true, file size and checksum are verified.
+         */
+        inline Spill::Mapping::Mapping (const File& a_file, const bool a_verify)
+            : data_(nullptr), size_(0)
+        {
+            const int fd = open(a_file.path_.c_str(), O_RDONLY | O_CLOEXEC);
+            if ( -1 == fd ) {
+                throw ::cc::Exception("Unable to open spilled file '%s': %s!", a_file.path_.c_str(), strerror(errno));
+            }
+            struct stat st;
+            if ( 0 != fstat(fd, &st) ) {
+                const int error = errno;
+                close(fd);
+                throw ::cc::Exception("Unable to stat spilled file '%s': %s!", a_file.path_.c_str(), strerror(error));
+            }
+            if ( static_cast<size_t>(st.st_size) != a_file.size_ ) {
+                close(fd);
+                throw ::cc::Exception("Spilled file '%s' size mismatch, expecting " SIZET_FMT " byte(s) got " SIZET_FMT "!",
+                                      a_file.path_.c_str(), a_file.size_, static_cast<size_t>(st.st_size));
+            }
+            size_ = a_file.size_;
+            if ( size_ > 0 ) {
+                void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if ( MAP_FAILED == data ) {
+                    const int error = errno;
+                    close(fd);
+                    throw ::cc::Exception("Unable to map spilled file '%s': %s!", a_file.path_.c_str(), strerror(error));
+                }
+                (void)madvise(data, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(data);
+            }
+            close(fd);
+            if ( true == a_verify && a_file.crc32_ != CRC32(0, data_, size_) ) {
+                if ( nullptr != data_ ) {
+                    munmap(const_cast<char*>(data_), size_);
+                }
+                throw ::cc::Exception("Spilled file '%s' checksum mismatch!", a_file.path_.c_str());
+            }
+        }
+
+        /**
+         * @brief Destructor.
+         */
+        inline Spill::Mapping::~Mapping ()
+        {
+            if ( nullptr != data_ ) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+        }
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_SPILL_H_
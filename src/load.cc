@@ -0,0 +1,211 @@
+/**
+* @file load.cc
+*
+* Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+*
+* This file is part of casper-job.
+*
+* casper-job is free software: you can redistribute it and/or modify
+* it under the terms of the GNU Affero General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* casper-job is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Affero General Public License
+* along with casper-job if not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <signal.h>
+
+#include "version.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "cc/easy/job/handler.h"
+
+#include "casper/job/demo/basic.h"
+#include "casper/job/demo/base.h"
+
+#include "casper/job/fake/beanstalkd.h"
+#include "casper/job/fake/redis.h"
+#include "casper/job/load/generator.h"
+#include "casper/job/load/replayer.h"
+
+//
+// USAGE:
+//
+// casper-job-load <load-config.json> <handler argument(s)>
+//
+// load-config.json:
+//
+// {
+//    "beanstalkd": { "port": 11300 },
+//    "redis": { "port": 6379 },
+//    "mode": "fixed" | "poisson",
+//    "rate": <jobs per second>,
+//    "duration": <seconds>,
+//    "warm-up": <seconds>,
+//    "drain": <seconds>,
+//    "ttr": <seconds>,
+//    "validity": <seconds>,
+//    "seed": <numeric>,
+//    "mix": [
+//      { "tube": "casper-job-demo-basic", "weight": 1, "payload": { }, "padding": 0 }
+//    ]
+// }
+//
+// or, to replay a recording at maximum speed:
+//
+// {
+//    "beanstalkd": { "port": 11300 },
+//    "redis": { "port": 6379 },
+//    "replay": { "path": <recording>, "window": <jobs in flight>, "drain": <seconds>, "ttr": <seconds> }
+// }
+//
+// ( handler configuration must also point it's 'replay' object to the same recording; exit status is non-zero
+//   when the replay regression check fails )
+//
+// Handler configuration must point both beanstalkd and REDIS to 127.0.0.1 and to the ports above.
+//
+int main(int argc, const char * argv[]) {
+
+    if ( argc < 2 ) {
+        fprintf(stderr, "usage: %s <load-config.json> [handler argument(s)]\n", argv[0]);
+        return -1;
+    }
+
+    const char* short_info = strrchr(CASPER_JOB_INFO, '-');
+    if ( nullptr == short_info ) {
+        short_info = CASPER_JOB_INFO;
+    } else {
+        short_info++;
+    }
+
+    // ... show banner ...
+    fprintf(stdout, "%s\n", CASPER_JOB_BANNER);
+    fflush(stdout);
+
+    // ... load config ...
+    Json::Value config;
+    try {
+        std::ifstream     file(argv[1]);
+        std::stringstream contents; contents << file.rdbuf();
+        const ::cc::easy::JSON<::cc::Exception> json; json.Parse(contents.str(), config);
+    } catch (const ::cc::Exception& a_cc_exception) {
+        fprintf(stderr, "Unable to load '%s': %s\n", argv[1], a_cc_exception.what());
+        return -1;
+    }
+
+    // ... start stand-ins ...
+    ::casper::job::fake::Beanstalkd beanstalkd;
+    ::casper::job::fake::Redis      redis;
+    ::casper::job::load::Generator* generator = nullptr;
+    ::casper::job::load::Replayer*  replayer  = nullptr;
+    std::thread*                    thread    = nullptr;
+    bool                            verified  = true;
+    std::mutex                      mutex;
+    bool                            stopping  = false;
+    try {
+        if ( true == config.isMember("replay") ) {
+            replayer = new ::casper::job::load::Replayer(beanstalkd, ::casper::job::load::Replayer::Load(config["replay"]));
+        } else {
+            generator = new ::casper::job::load::Generator(beanstalkd, ::casper::job::load::Generator::Load(config));
+        }
+        beanstalkd.Start(static_cast<uint16_t>(config["beanstalkd"].get("port", 11300).asUInt()));
+        redis.Start(static_cast<uint16_t>(config["redis"].get("port", 6379).asUInt()));
+    } catch (const ::cc::Exception& a_cc_exception) {
+        fprintf(stderr, "%s\n", a_cc_exception.what());
+        if ( nullptr != generator ) {
+            delete generator;
+        }
+        if ( nullptr != replayer ) {
+            delete replayer;
+        }
+        return -1;
+    }
+    fprintf(stdout, "beanstalkd stand-in @ 127.0.0.1:" UINT16_FMT ", redis stand-in @ 127.0.0.1:" UINT16_FMT "\n", beanstalkd.port(), redis.port());
+    fflush(stdout);
+
+    // ... generate ( or replay ) load, report and stop handler ...
+    thread = new std::thread([generator, replayer, &verified, &mutex, &stopping] () {
+        if ( nullptr != replayer ) {
+            const auto report = replayer->Run();
+            replayer->Print(report, stdout);
+            verified = replayer->Verify(report);
+        } else {
+            const auto report = generator->Run();
+            generator->Print(report, stdout);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if ( false == stopping ) {
+            raise(SIGTERM);
+        }
+    });
+
+    // ... run handler with remaining arguments ...
+    std::vector<const char*> arguments = { argv[0] };
+    for ( int idx = 2 ; idx < argc ; ++idx ) {
+        arguments.push_back(argv[idx]);
+    }
+    const int rv = cc::easy::job::Handler::GetInstance().Start(
+        /* a_arguments */
+        {
+            /* abbr_           */ CASPER_JOB_ABBR,
+            /* name_           */ CASPER_JOB_NAME,
+            /* version_        */ CASPER_JOB_VERSION,
+            /* rel_date_       */ CASPER_JOB_REL_DATE,
+            /* rel_branch_     */ CASPER_JOB_REL_BRANCH,
+            /* rel_hash_       */ CASPER_JOB_REL_HASH,
+            /* rel_target_     */ CASPER_JOB_REL_TARGET,
+            /* info_           */ short_info, // short version of CASPER_JOB_INFO
+            /* banner_         */ CASPER_JOB_BANNER,
+            /* argc_           */ static_cast<int>(arguments.size()),
+            /* argv_           */ const_cast<const char** const >(arguments.data()),
+        },
+        /* a_factories */
+        {
+            {
+                ::casper::job::demo::Basic::sk_tube_, [] (const ev::Loggable::Data& a_loggable_data, const cc::easy::job::Job::Config& a_config) -> cc::easy::job::Job* {
+                    return new ::casper::job::demo::Basic(a_loggable_data, a_config);
+                }
+            },
+            {
+                ::casper::job::demo::Base::sk_tube_, [] (const ev::Loggable::Data& a_loggable_data, const cc::easy::job::Job::Config& a_config) -> cc::easy::job::Job* {
+                    return new ::casper::job::demo::Base(a_loggable_data, a_config);
+                }
+            }
+        },
+        /* a_polling_timeout */ 20.0 /* milliseconds */
+    );
+
+    // ... clean up, handler might have returned early: stop load before waiting for it ...
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    if ( nullptr != generator ) {
+        generator->Stop();
+    }
+    if ( nullptr != replayer ) {
+        replayer->Stop();
+    }
+    thread->join();
+    delete thread;
+    if ( nullptr != generator ) {
+        delete generator;
+    }
+    if ( nullptr != replayer ) {
+        delete replayer;
+    }
+    redis.Stop();
+    beanstalkd.Stop();
+
+    return ( 0 == rv && false == verified ? -1 : rv );
+}
@@ -0,0 +1,212 @@
+/**
+ * @file batch.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/base.h"
+
+#include "check.h"
+
+#include <vector>
+#include <chrono>
+
+/**
+ * @brief Job steps, only 'done' is used.
+ */
+enum class Step : uint8_t {
+    Done = 100
+};
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Batch mode tube: jobs double their 'value', a job with 'bad' set is rejected.
+ */
+class Tube final : public ::casper::job::Base<Step, Step::Done>
+{
+
+public: // Data
+
+    bool   bulk_;       //!< When set, \link InnerRunBatch \link is overridden, it fails as a whole if any job is bad.
+    size_t batches_;    //!< \link InnerRunBatch \link calls.
+    std::vector<uint64_t> runs_; //!< \link InnerRun \link calls, by job ID.
+
+public: // Constructor(s) / Destructor
+
+    Tube (const bool a_bulk, const Json::Value& a_config)
+        : ::casper::job::Base<Step, Step::Done>("batch", ::ev::Loggable::Data(), ::cc::easy::job::Job::Config(a_config)),
+          bulk_(a_bulk), batches_(0)
+    {
+        /* empty */
+    }
+
+public: // Method(s) / Function(s)
+
+    using ::casper::job::Base<Step, Step::Done>::Process;
+
+protected: // Inherited Virtual Method(s) / Function(s) - from ::casper::job::Base
+
+    virtual void InnerRun (const uint64_t& a_id, const Json::Value& a_payload, cc::easy::job::Job::Response& o_response)
+    {
+        runs_.push_back(a_id);
+        if ( true == a_payload.isMember("bad") ) {
+            throw ::cc::BadRequest("Job " UINT64_FMT " is bad!", a_id);
+        }
+        o_response.code_ = CC_STATUS_CODE_OK;
+        o_response.payload_ = Json::Value(Json::ValueType::objectValue);
+        o_response.payload_["value"] = a_payload["value"].asInt() * 2;
+    }
+
+    virtual void InnerRunBatch (const std::vector<const Batched*>& a_jobs, std::vector<cc::easy::job::Job::Response>& o_responses)
+    {
+        batches_++;
+        if ( false == bulk_ ) {
+            ::casper::job::Base<Step, Step::Done>::InnerRunBatch(a_jobs, o_responses);
+            return;
+        }
+        // ... one call for all jobs, e.g. a bulk insert, fails as a whole ...
+        for ( size_t idx = 0 ; idx < a_jobs.size() ; ++idx ) {
+            if ( true == a_jobs[idx]->payload_.isMember("bad") ) {
+                throw ::cc::Exception("Bulk call failed, job " UINT64_FMT " is bad!", a_jobs[idx]->id_);
+            }
+            o_responses[idx].code_ = CC_STATUS_CODE_OK;
+            o_responses[idx].payload_ = Json::Value(Json::ValueType::objectValue);
+            o_responses[idx].payload_["value"] = a_jobs[idx]->payload_["value"].asInt() * 2;
+        }
+    }
+
+}; // end of class 'Tube'
+
+/**
+ * @return Jobs to batch, payloads as JSON strings.
+ *
+ * @param a_payloads Payloads, job IDs are 1..N.
+ * @param a_reserved When jobs were reserved.
+ */
+static std::vector<Tube::Batched> Jobs (const std::vector<const char*>& a_payloads,
+                                        const std::chrono::steady_clock::time_point a_reserved = std::chrono::steady_clock::now())
+{
+    std::vector<Tube::Batched> jobs;
+    for ( size_t idx = 0 ; idx < a_payloads.size() ; ++idx ) {
+        jobs.push_back({ /* id_ */ idx + 1, /* rcid_ */ "rcid", /* rjid_ */ "rjid", /* payload_ */ Parse(a_payloads[idx]), /* reserved_ */ a_reserved });
+    }
+    return jobs;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    const Json::Value config = Parse("{\"batch\": {\"max\": 4}}");
+
+    check.Case("a failed batch runs it's jobs one by one", [&check, &config] () {
+        Tube tube(/* a_bulk */ true, config);
+        tube.Setup();
+        std::vector<cc::easy::job::Job::Response> responses;
+        tube.Process(Jobs({ "{\"value\": 1}", "{\"value\": 2}", "{\"value\": 3, \"bad\": true}", "{\"value\": 4}" }), responses);
+        CASPER_JOB_TEST_ASSERT(check, 1 == tube.batches_);
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<uint64_t>{ 1, 2, 3, 4 } ) == tube.runs_);
+        CASPER_JOB_TEST_ASSERT(check, 4 == responses.size());
+        for ( const size_t idx : { 0, 1, 3 } ) {
+            CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == responses[idx].code_);
+            CASPER_JOB_TEST_ASSERT(check, static_cast<int>(( idx + 1 ) * 2) == responses[idx].payload_["value"].asInt());
+        }
+        // ... only the bad job fails ...
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_BAD_REQUEST == responses[2].code_);
+    });
+
+    check.Case("a successful batch runs once", [&check, &config] () {
+        Tube tube(/* a_bulk */ true, config);
+        tube.Setup();
+        std::vector<cc::easy::job::Job::Response> responses;
+        tube.Process(Jobs({ "{\"value\": 5}", "{\"value\": 6}", "{\"value\": 7}" }), responses);
+        CASPER_JOB_TEST_ASSERT(check, 1 == tube.batches_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == tube.runs_.size());
+        CASPER_JOB_TEST_ASSERT(check, 3 == responses.size());
+        for ( size_t idx = 0 ; idx < responses.size() ; ++idx ) {
+            CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == responses[idx].code_);
+            CASPER_JOB_TEST_ASSERT(check, static_cast<int>(( idx + 5 ) * 2) == responses[idx].payload_["value"].asInt());
+        }
+    });
+
+    check.Case("default batch isolates each job", [&check, &config] () {
+        Tube tube(/* a_bulk */ false, config);
+        tube.Setup();
+        std::vector<cc::easy::job::Job::Response> responses;
+        tube.Process(Jobs({ "{\"value\": 1, \"bad\": true}", "{\"value\": 2}", "{\"value\": 3, \"bad\": true}" }), responses);
+        // ... no fallback needed, each job already ran on it's own ...
+        CASPER_JOB_TEST_ASSERT(check, 1 == tube.batches_);
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<uint64_t>{ 1, 2, 3 } ) == tube.runs_);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_BAD_REQUEST == responses[0].code_);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK          == responses[1].code_);
+        CASPER_JOB_TEST_ASSERT(check, 4                          == responses[1].payload_["value"].asInt());
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_BAD_REQUEST == responses[2].code_);
+    });
+
+    check.Case("expired jobs are not run", [&check, &config] () {
+        Tube tube(/* a_bulk */ true, config);
+        tube.Setup();
+        std::vector<Tube::Batched> jobs = Jobs({ "{\"value\": 1}", "{\"value\": 2, \"validity\": 1}" });
+        jobs[1].reserved_ = std::chrono::steady_clock::now() - std::chrono::seconds(10);
+        std::vector<cc::easy::job::Job::Response> responses;
+        tube.Process(jobs, responses);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK              == responses[0].code_);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_GATEWAY_TIMEOUT == responses[1].code_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == tube.misses().before_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == tube.runs_.size());
+    });
+
+    check.Case("oversized batches are refused", [&check, &config] () {
+        Tube tube(/* a_bulk */ true, config);
+        tube.Setup();
+        bool thrown = false;
+        try {
+            tube.RunBatch(Jobs({ "{}", "{}", "{}", "{}", "{}" }));
+        } catch (const ::cc::Exception& /* a_cc_exception */) {
+            thrown = true;
+        }
+        CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        CASPER_JOB_TEST_ASSERT(check, 0 == tube.batches_);
+    });
+
+    check.Case("gathered payloads are moved", [&check, &config] () {
+        Tube tube(/* a_bulk */ true, config);
+        tube.Setup();
+        Json::Value payload = Parse("{\"value\": 1}");
+        cc::easy::job::Job::Response response;
+        tube.Run(1, payload, response);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == response.code_);
+        CASPER_JOB_TEST_ASSERT(check, true == payload.isNull());
+        CASPER_JOB_TEST_ASSERT(check, 0 == tube.batches_);
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,160 @@
+/**
+ * @file breaker.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+#include <thread>
+#include <chrono>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+typedef ::casper::job::deferrable::Breaker                     Breaker;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("trips on error rate", [&check] () {
+        Breaker breaker;
+        breaker.Setup(Breaker::Load(Parse("{\"window\": 10, \"min-requests\": 4, \"error-rate\": 0.5, \"open-time\": 60000}")));
+        // ... not enough outcomes yet ...
+        breaker.Record(10, /* a_failed */ true);
+        breaker.Record(10, /* a_failed */ true);
+        breaker.Record(10, /* a_failed */ true);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Closed == breaker.stats().state_);
+        breaker.Record(10, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Open == breaker.stats().state_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == breaker.stats().trips_);
+        CASPER_JOB_TEST_ASSERT(check, false == breaker.Permit());
+        CASPER_JOB_TEST_ASSERT(check, false == breaker.Allow());
+        CASPER_JOB_TEST_ASSERT(check, 2 == breaker.stats().rejected_);
+    });
+
+    check.Case("trips on slow rate", [&check] () {
+        Breaker breaker;
+        breaker.Setup(Breaker::Load(Parse("{\"window\": 4, \"min-requests\": 4, \"slow-rtt\": 100, \"slow-rate\": 0.75}")));
+        for ( const size_t rtt : { 10, 200, 200 } ) {
+            breaker.Record(rtt, /* a_failed */ false);
+        }
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Closed == breaker.stats().state_);
+        breaker.Record(99, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Closed == breaker.stats().state_);
+        // ... oldest, fast, outcome leaves the window ...
+        breaker.Record(150, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Open == breaker.stats().state_);
+    });
+
+    check.Case("half-open trials close or re-open it", [&check] () {
+        Breaker breaker;
+        breaker.Setup(Breaker::Load(Parse("{\"window\": 2, \"min-requests\": 2, \"error-rate\": 1.0, \"open-time\": 20, \"trials\": 2}")));
+        breaker.Record(10, /* a_failed */ true);
+        breaker.Record(10, /* a_failed */ true);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Open == breaker.stats().state_);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        // ... permit does not take a trial ...
+        CASPER_JOB_TEST_ASSERT(check, true == breaker.Permit());
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Open == breaker.stats().state_);
+        CASPER_JOB_TEST_ASSERT(check, true  == breaker.Allow());
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::HalfOpen == breaker.stats().state_);
+        CASPER_JOB_TEST_ASSERT(check, true  == breaker.Allow());
+        CASPER_JOB_TEST_ASSERT(check, false == breaker.Allow());
+        breaker.Record(10, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::HalfOpen == breaker.stats().state_);
+        breaker.Record(10, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Closed == breaker.stats().state_);
+        // ... a failed trial re-opens it ...
+        breaker.Record(10, /* a_failed */ true);
+        breaker.Record(10, /* a_failed */ true);
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        CASPER_JOB_TEST_ASSERT(check, true == breaker.Allow());
+        breaker.Record(10, /* a_failed */ true);
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Open == breaker.stats().state_);
+        CASPER_JOB_TEST_ASSERT(check, 3 == breaker.stats().trips_);
+    });
+
+    check.Case("disabled breaker always allows", [&check] () {
+        Breaker breaker;
+        for ( size_t idx = 0 ; idx < 100 ; ++idx ) {
+            breaker.Record(10, /* a_failed */ true);
+        }
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Closed == breaker.stats().state_);
+        CASPER_JOB_TEST_ASSERT(check, true == breaker.Allow());
+    });
+
+    check.Case("dispatcher fails fast while open", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        std::map<std::string, size_t>   completed_at;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&loop, &codes, &completed_at] (const Deferred* a_deferred) {
+            codes[a_deferred->id_]        = a_deferred->response().code();
+            completed_at[a_deferred->id_] = loop.now();
+        }));
+        dispatcher.Protect(Breaker::Load(Parse("{\"window\": 4, \"min-requests\": 4, \"error-rate\": 0.5, \"open-time\": 60000}")));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 100.0, \"error-rate\": 1.0}")));
+        for ( uint64_t id = 1 ; id <= 4 ; ++id ) {
+            dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(id));
+        }
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, Breaker::State::Open == dispatcher.metrics().breaker_.state_);
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-4"]);
+        // ... backend is not called ...
+        dispatcher.Perform({ 5, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-5");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_SERVICE_UNAVAILABLE == codes["rq-5"]);
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-5"]);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().breaker_.rejected_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().breaker_.trips_);
+    });
+
+    check.Case("invalid configuration", [&check] () {
+        for ( const char* const config : { "{\"window\": 0}", "{\"error-rate\": 1.5}", "{\"open-time\": 0}", "{\"trials\": 0}" } ) {
+            bool thrown = false;
+            try {
+                (void)Breaker::Load(Parse(config));
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,192 @@
+/**
+ * @file cache.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+typedef ::casper::job::deferrable::Cache                       Cache;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @return A successful response.
+ *
+ * @param a_body    Body.
+ * @param a_headers HTTP headers.
+ */
+static ::casper::job::deferrable::Response Response (const std::string& a_body, const std::map<std::string, std::string>& a_headers = {})
+{
+    ::casper::job::deferrable::Response response;
+    response.Set(CC_STATUS_CODE_OK, "text/plain", a_headers, a_body, /* a_rtt */ 10);
+    return response;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("stored responses are served", [&check] () {
+        Cache cache;
+        cache.Setup(Cache::Load(Parse("{}")));
+        ::casper::job::deferrable::Response response;
+        std::string                         etag;
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Miss == cache.Lookup("a", response, etag));
+        cache.Store("a", Response("alpha"));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit  == cache.Lookup("a", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, "alpha" == response.body());
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Miss == cache.Lookup("b", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, 1 == cache.stats().hits_);
+        CASPER_JOB_TEST_ASSERT(check, 2 == cache.stats().misses_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == cache.stats().entries_);
+    });
+
+    check.Case("cache control is honoured", [&check] () {
+        Cache cache;
+        cache.Setup(Cache::Load(Parse("{}")));
+        ::casper::job::deferrable::Response response;
+        std::string                         etag;
+        cache.Store("no-store", Response("x", { { "Cache-Control", "private, no-store" } }));
+        cache.Store("no-cache", Response("x", { { "Cache-Control", "no-cache" } }));
+        cache.Store("max-age" , Response("x", { { "Cache-Control", "max-age=0" } }));
+        // ... can't be served without revalidation, and there's nothing to revalidate with ...
+        CASPER_JOB_TEST_ASSERT(check, 0 == cache.stats().stores_);
+        // ... must be revalidated, using it's entity tag ...
+        cache.Store("etag", Response("x", { { "cache-control", "no-cache" }, { "ETag", "\"v1\"" } }));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Stale == cache.Lookup("etag", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, "\"v1\"" == etag);
+        ::casper::job::deferrable::Response not_modified;
+        not_modified.Set(304, "text/plain", std::map<std::string, std::string>({ { "Cache-Control", "max-age=60" } }), "", /* a_rtt */ 10);
+        CASPER_JOB_TEST_ASSERT(check, true == cache.Refresh("etag", not_modified));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit == cache.Lookup("etag", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, 1 == cache.stats().revalidated_);
+    });
+
+    check.Case("least recently used entries are evicted", [&check] () {
+        Cache cache;
+        cache.Setup(Cache::Load(Parse("{\"admission\": \"lru\", \"max-bytes\": 3000}")));
+        ::casper::job::deferrable::Response response;
+        std::string                         etag;
+        cache.Store("a", Response(std::string(1000, 'a')));
+        cache.Store("b", Response(std::string(1000, 'b')));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit == cache.Lookup("a", response, etag));
+        cache.Store("c", Response(std::string(1000, 'c')));
+        CASPER_JOB_TEST_ASSERT(check, 1 == cache.stats().evictions_);
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Miss == cache.Lookup("b", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit  == cache.Lookup("a", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit  == cache.Lookup("c", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, cache.stats().bytes_ <= 3000);
+        // ... never bigger than budget ...
+        cache.Store("d", Response(std::string(4000, 'd')));
+        CASPER_JOB_TEST_ASSERT(check, 1 == cache.stats().rejected_);
+    });
+
+    check.Case("tinylfu keeps popular entries", [&check] () {
+        Cache cache;
+        cache.Setup(Cache::Load(Parse("{\"max-bytes\": 3000}")));
+        ::casper::job::deferrable::Response response;
+        std::string                         etag;
+        for ( size_t idx = 0 ; idx < 3 ; ++idx ) {
+            (void)cache.Lookup("a", response, etag);
+            (void)cache.Lookup("b", response, etag);
+        }
+        cache.Store("a", Response(std::string(1000, 'a')));
+        cache.Store("b", Response(std::string(1000, 'b')));
+        // ... a one-hit wonder does not displace them ...
+        cache.Store("c", Response(std::string(1000, 'c')));
+        CASPER_JOB_TEST_ASSERT(check, 1 == cache.stats().rejected_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == cache.stats().evictions_);
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit == cache.Lookup("a", response, etag));
+        CASPER_JOB_TEST_ASSERT(check, Cache::Result::Hit == cache.Lookup("b", response, etag));
+    });
+
+    check.Case("dispatcher serves identical requests from cache", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, size_t>      completed_at;
+        std::map<std::string, std::string> bodies;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&loop, &completed_at, &bodies] (const Deferred* a_deferred) {
+            completed_at[a_deferred->id_] = loop.now();
+            bodies[a_deferred->id_]       = a_deferred->response().body();
+        }));
+        dispatcher.Memoize(Cache::Load(Parse("{}")));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 100.0}")));
+        dispatcher.Perform({ 1, "", "", "", "", "" }, Arguments(Parse("{\"q\": 1}")), "rq-1");
+        loop.Run();
+        dispatcher.Perform({ 2, "", "", "", "", "" }, Arguments(Parse("{\"q\": 1}")), "rq-2");
+        dispatcher.Perform({ 3, "", "", "", "", "" }, Arguments(Parse("{\"q\": 2}")), "rq-3");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-1"]);
+        // ... backend was skipped ...
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-2"]);
+        CASPER_JOB_TEST_ASSERT(check, 200 == completed_at["rq-3"]);
+        CASPER_JOB_TEST_ASSERT(check, bodies["rq-1"] == bodies["rq-2"]);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().cache_.hits_);
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().cache_.stores_);
+    });
+
+    check.Case("failed responses are not cached", [&check] () {
+        ::casper::job::test::Loop loop;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([] (const Deferred* /* a_deferred */) { }));
+        dispatcher.Memoize(Cache::Load(Parse("{}")));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"error-rate\": 1.0}")));
+        for ( uint64_t id = 1 ; id <= 2 ; ++id ) {
+            dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Parse("{\"q\": 1}")), "rq-" + std::to_string(id));
+            loop.Run();
+        }
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().cache_.hits_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().cache_.stores_);
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().cache_.misses_);
+    });
+
+    check.Case("invalid configuration", [&check] () {
+        for ( const char* const config : { "{\"ttl\": 0}", "{\"max-bytes\": 0}", "{\"admission\": \"fifo\"}" } ) {
+            bool thrown = false;
+            try {
+                (void)Cache::Load(Parse(config));
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,155 @@
+/**
+ * @file cancellation.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+#include <vector>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Perform a request on behalf of a job.
+ *
+ * @param a_dispatcher Dispatcher to perform request with.
+ * @param a_job        Job ID.
+ * @param a_rcid       Job REDIS channel ID.
+ * @param a_id         Request ID.
+ */
+static void Perform (Dispatcher& a_dispatcher, const uint64_t a_job, const std::string& a_rcid, const std::string& a_id)
+{
+    a_dispatcher.Perform({ a_job, "", "", a_rcid, "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), a_id);
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("revoke fails queued and launched requests", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        std::vector<std::string>        order;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&codes, &order] (const Deferred* a_deferred) {
+            codes[a_deferred->id_] = a_deferred->response().code();
+            order.push_back(a_deferred->id_);
+        }));
+        dispatcher.Limit(::casper::job::deferrable::Limiter::Load(Parse("{\"initial\": 1, \"min\": 1, \"max\": 1}")));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 100.0}")));
+        dispatcher.Enlist(1, "ch-1");
+        dispatcher.Enlist(2, "ch-2");
+        Perform(dispatcher, 1, "", "1-a"); // launched
+        Perform(dispatcher, 2, "", "2-a"); // queued
+        Perform(dispatcher, 1, "", "1-b"); // queued
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().queued_);
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.Revoke("ch-1"));
+        CASPER_JOB_TEST_ASSERT(check, true  == dispatcher.Revoked(1));
+        CASPER_JOB_TEST_ASSERT(check, false == dispatcher.Revoked(2));
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().cancelled_);
+        // ... other job's request took the released slot ...
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().queued_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().limiter_.in_flight_);
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 3 == order.size());
+        CASPER_JOB_TEST_ASSERT(check, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED == codes["1-a"]);
+        CASPER_JOB_TEST_ASSERT(check, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED == codes["1-b"]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes["2-a"]);
+        CASPER_JOB_TEST_ASSERT(check, "2-a" == order.back());
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().limiter_.in_flight_);
+    });
+
+    check.Case("revoked job's later requests are refused", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&codes] (const Deferred* a_deferred) {
+            codes[a_deferred->id_] = a_deferred->response().code();
+        }));
+        // ... channel taken from tracking, not enlisted ...
+        Perform(dispatcher, 7, "ch-7", "7-a");
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.Revoke("ch-7"));
+        Perform(dispatcher, 7, "ch-7", "7-b");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 2 == codes.size());
+        CASPER_JOB_TEST_ASSERT(check, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED == codes["7-a"]);
+        CASPER_JOB_TEST_ASSERT(check, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED == codes["7-b"]);
+        // ... refused requests are not accounted as cancelled ...
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().cancelled_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == loop.pending());
+    });
+
+    check.Case("unknown or finished jobs can't be revoked", [&check] () {
+        ::casper::job::test::Loop loop;
+        size_t completed = 0;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&completed] (const Deferred* a_deferred) {
+            completed += ( CC_STATUS_CODE_OK == a_deferred->response().code() ? 1 : 0 );
+        }));
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.Revoke("ch-unknown"));
+        dispatcher.Enlist(3, "ch-3");
+        Perform(dispatcher, 3, "", "3-a");
+        loop.Run();
+        dispatcher.Drop(3);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.Revoke("ch-3"));
+        CASPER_JOB_TEST_ASSERT(check, false == dispatcher.Revoked(3));
+        CASPER_JOB_TEST_ASSERT(check, 1 == completed);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().cancelled_);
+    });
+
+    check.Case("drop forgets revocation", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&codes] (const Deferred* a_deferred) {
+            codes[a_deferred->id_] = a_deferred->response().code();
+        }));
+        dispatcher.Enlist(4, "ch-4");
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.Revoke("ch-4"));
+        CASPER_JOB_TEST_ASSERT(check, true == dispatcher.Revoked(4));
+        dispatcher.Drop(4);
+        CASPER_JOB_TEST_ASSERT(check, false == dispatcher.Revoked(4));
+        // ... job ID reused, e.g. buried and kicked ...
+        Perform(dispatcher, 4, "", "4-a");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes["4-a"]);
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file chain.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/chain.h"
+
+#include "check.h"
+
+#include <vector>
+
+/**
+ * @return Chained job identifiers.
+ *
+ * @param a_id Job ID.
+ */
+static ::casper::job::Chain::Origin Origin (const uint64_t a_id)
+{
+    return { a_id, "rcid-" + std::to_string(a_id), "rjid-" + std::to_string(a_id), std::chrono::steady_clock::now() };
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    // ... chain is process wide, each case uses it's own tubes ...
+    ::casper::job::Chain& chain = ::casper::job::Chain::GetInstance();
+
+    check.Case("parsed payloads are moved", [&check, &chain] () {
+        int instance = 0;
+        std::vector<std::shared_ptr<::casper::job::Chain::Payload>> received;
+        chain.Register("moved", &instance, [&received] (const ::casper::job::Chain::Origin&, std::shared_ptr<::casper::job::Chain::Payload> a_payload) -> bool {
+            received.push_back(a_payload);
+            return true;
+        });
+        Json::Value payload = Json::Value(Json::ValueType::objectValue);
+        payload["items"] = Json::Value(Json::ValueType::arrayValue);
+        for ( Json::Int idx = 0 ; idx < 1000 ; ++idx ) {
+            payload["items"].append(idx);
+        }
+        const Json::Value expected = payload;
+        const Json::Value* items = &payload["items"][0];
+        CASPER_JOB_TEST_ASSERT(check, true == chain.Forward("moved", Origin(1), payload));
+        CASPER_JOB_TEST_ASSERT(check, true == payload.isNull());
+        CASPER_JOB_TEST_ASSERT(check, 1 == received.size());
+        CASPER_JOB_TEST_ASSERT(check, expected == received[0]->value_);
+        CASPER_JOB_TEST_ASSERT(check, true == received[0]->raw_.empty());
+        // ... same storage, not a copy ...
+        CASPER_JOB_TEST_ASSERT(check, items == &received[0]->value_["items"][0]);
+        chain.Unregister("moved", &instance);
+    });
+
+    check.Case("raw payloads are handed as text", [&check, &chain] () {
+        int instance = 0;
+        std::vector<std::shared_ptr<::casper::job::Chain::Payload>> received;
+        chain.Register("raw", &instance, [&received] (const ::casper::job::Chain::Origin&, std::shared_ptr<::casper::job::Chain::Payload> a_payload) -> bool {
+            received.push_back(a_payload);
+            return true;
+        });
+        std::string payload = "{\"validity\": 1, \"a\": 1}";
+        const std::string expected = payload;
+        CASPER_JOB_TEST_ASSERT(check, true == chain.Forward("raw", Origin(2), payload));
+        CASPER_JOB_TEST_ASSERT(check, true == payload.empty());
+        CASPER_JOB_TEST_ASSERT(check, 1 == received.size());
+        CASPER_JOB_TEST_ASSERT(check, expected == received[0]->raw_);
+        CASPER_JOB_TEST_ASSERT(check, true == received[0]->value_.isNull());
+        chain.Unregister("raw", &instance);
+    });
+
+    check.Case("unregistered tubes refuse payloads", [&check, &chain] () {
+        const ::casper::job::Chain::Stats before = chain.Snapshot();
+        CASPER_JOB_TEST_ASSERT(check, false == chain.Linked("nowhere"));
+        Json::Value payload = Json::Value(Json::ValueType::objectValue);
+        payload["a"] = 1;
+        CASPER_JOB_TEST_ASSERT(check, false == chain.Forward("nowhere", Origin(3), payload));
+        CASPER_JOB_TEST_ASSERT(check, 1 == payload["a"].asInt());
+        std::string raw = "{}";
+        CASPER_JOB_TEST_ASSERT(check, false == chain.Forward("nowhere", Origin(3), raw));
+        CASPER_JOB_TEST_ASSERT(check, "{}" == raw);
+        CASPER_JOB_TEST_ASSERT(check, before.refused_ + 2 == chain.Snapshot().refused_);
+        CASPER_JOB_TEST_ASSERT(check, before.forwarded_ == chain.Snapshot().forwarded_);
+    });
+
+    check.Case("instances of a tube are registered apart", [&check, &chain] () {
+        int first = 0, second = 0;
+        size_t counts[2] = { 0, 0 };
+        chain.Register("instances", &first, [&counts] (const ::casper::job::Chain::Origin&, std::shared_ptr<::casper::job::Chain::Payload>) -> bool {
+            counts[0]++;
+            return true;
+        });
+        chain.Register("instances", &second, [&counts] (const ::casper::job::Chain::Origin&, std::shared_ptr<::casper::job::Chain::Payload>) -> bool {
+            counts[1]++;
+            return true;
+        });
+        // ... in turn ...
+        for ( uint64_t id = 0 ; id < 10 ; ++id ) {
+            Json::Value payload = Json::Value(Json::ValueType::objectValue);
+            CASPER_JOB_TEST_ASSERT(check, true == chain.Forward("instances", Origin(id), payload));
+        }
+        CASPER_JOB_TEST_ASSERT(check, 5 == counts[0]);
+        CASPER_JOB_TEST_ASSERT(check, 5 == counts[1]);
+        // ... disposing one instance keeps the other ...
+        chain.Unregister("instances", &first);
+        CASPER_JOB_TEST_ASSERT(check, true == chain.Linked("instances"));
+        for ( uint64_t id = 0 ; id < 4 ; ++id ) {
+            Json::Value payload = Json::Value(Json::ValueType::objectValue);
+            CASPER_JOB_TEST_ASSERT(check, true == chain.Forward("instances", Origin(id), payload));
+        }
+        CASPER_JOB_TEST_ASSERT(check, 5 == counts[0]);
+        CASPER_JOB_TEST_ASSERT(check, 9 == counts[1]);
+        chain.Unregister("instances", &second);
+        CASPER_JOB_TEST_ASSERT(check, false == chain.Linked("instances"));
+        // ... unknown instance, nothing to do ...
+        chain.Unregister("instances", &second);
+    });
+
+    check.Case("instances being disposed are skipped", [&check, &chain] () {
+        int gone = 0, alive = 0;
+        bool   accept   = true;
+        size_t received = 0;
+        chain.Register("disposed", &gone, [] (const ::casper::job::Chain::Origin&, std::shared_ptr<::casper::job::Chain::Payload>) -> bool {
+            return false;
+        });
+        chain.Register("disposed", &alive, [&accept, &received] (const ::casper::job::Chain::Origin&, std::shared_ptr<::casper::job::Chain::Payload>) -> bool {
+            if ( false == accept ) {
+                return false;
+            }
+            received++;
+            return true;
+        });
+        for ( uint64_t id = 0 ; id < 4 ; ++id ) {
+            Json::Value payload = Json::Value(Json::ValueType::objectValue);
+            CASPER_JOB_TEST_ASSERT(check, true == chain.Forward("disposed", Origin(id), payload));
+        }
+        CASPER_JOB_TEST_ASSERT(check, 4 == received);
+        // ... no instance takes it, caller keeps it's payload ...
+        accept = false;
+        const ::casper::job::Chain::Stats before = chain.Snapshot();
+        Json::Value payload = Json::Value(Json::ValueType::objectValue);
+        payload["kept"] = true;
+        CASPER_JOB_TEST_ASSERT(check, false == chain.Forward("disposed", Origin(5), payload));
+        CASPER_JOB_TEST_ASSERT(check, true == payload["kept"].asBool());
+        CASPER_JOB_TEST_ASSERT(check, before.refused_ + 1 == chain.Snapshot().refused_);
+        chain.Unregister("disposed", &gone);
+        chain.Unregister("disposed", &alive);
+    });
+
+    return check.Summary(argv[0]);
+}
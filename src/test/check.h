@@ -0,0 +1,152 @@
+/**
+ * @file check.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_TEST_CHECK_H_
+#define CASPER_JOB_TEST_CHECK_H_
+
+#include "cc/exception.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <exception>
+#include <functional>
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace test
+        {
+
+            /**
+             * @brief Minimal test harness: named cases, failed assertions are reported and counted.
+             *
+             * An exception escaping a case fails that case only, the remaining cases still run.
+             */
+            class Check final
+            {
+
+            private: // Data
+
+                size_t cases_;
+                size_t failures_;
+
+            public: // Constructor(s) / Destructor
+
+                Check ();
+                virtual ~Check ();
+
+            public: // Method(s) / Function(s)
+
+                void Case    (const char* const a_name, const std::function<void()>& a_body);
+                bool Assert  (const bool a_condition, const char* const a_expression, const char* const a_file, const int a_line);
+                int  Summary (const char* const a_program) const;
+
+            }; // end of class 'Check'
+
+            /**
+             * @brief Default constructor.
+             */
+            inline Check::Check ()
+                : cases_(0), failures_(0)
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Destructor.
+             */
+            inline Check::~Check ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Run a test case.
+             *
+             * @param a_name Case name, for reporting.
+             * @param a_body Case body.
+             */
+            inline void Check::Case (const char* const a_name, const std::function<void()>& a_body)
+            {
+                const size_t failures = failures_;
+                cases_++;
+                try {
+                    a_body();
+                } catch (const ::cc::Exception& a_cc_exception) {
+                    fprintf(stderr, "    %s: unexpected exception - %s\n", a_name, a_cc_exception.what());
+                    failures_++;
+                } catch (const std::exception& a_std_exception) {
+                    fprintf(stderr, "    %s: unexpected exception - %s\n", a_name, a_std_exception.what());
+                    failures_++;
+                } catch (...) {
+                    fprintf(stderr, "    %s: unexpected exception\n", a_name);
+                    failures_++;
+                }
+                fprintf(stdout, "[%s] %s\n", ( failures == failures_ ? " OK " : "FAIL" ), a_name);
+                fflush(stdout);
+            }
+
+            /**
+             * @brief Report and count a failed assertion, use \link CASPER_JOB_TEST_ASSERT \link.
+             *
+             * @param a_condition  Assertion outcome.
+             * @param a_expression Asserted expression, for reporting.
+             * @param a_file       Source file, for reporting.
+             * @param a_line       Source line, for reporting.
+             *
+             * @return \link a_condition \link.
+             */
+            inline bool Check::Assert (const bool a_condition, const char* const a_expression, const char* const a_file, const int a_line)
+            {
+                if ( false == a_condition ) {
+                    fprintf(stderr, "    %s:%d: assertion failed - %s\n", a_file, a_line, a_expression);
+                    failures_++;
+                }
+                return a_condition;
+            }
+
+            /**
+             * @brief Print a summary of all cases run so far.
+             *
+             * @param a_program Program name, for reporting.
+             *
+             * @return Process exit code, 0 if no assertion failed.
+             */
+            inline int Check::Summary (const char* const a_program) const
+            {
+                fprintf(stdout, "%s: " SIZET_FMT " case(s), " SIZET_FMT " failure(s)\n", a_program, cases_, failures_);
+                fflush(stdout);
+                return ( 0 == failures_ ? 0 : -1 );
+            }
+
+        } // end of namespace 'test'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#define CASPER_JOB_TEST_ASSERT(a_check, a_condition) \
+    (a_check).Assert(( a_condition ), #a_condition, __FILE__, __LINE__)
+
+#endif // CASPER_JOB_TEST_CHECK_H_
@@ -0,0 +1,150 @@
+/**
+ * @file coalescing.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Perform a request on behalf of a job.
+ *
+ * @param a_dispatcher Dispatcher to perform request with.
+ * @param a_job        Job ID.
+ * @param a_parameters Request parameters, as a JSON string; equal parameters make identical requests.
+ * @param a_id         Request ID.
+ */
+static void Perform (Dispatcher& a_dispatcher, const uint64_t a_job, const char* const a_parameters, const std::string& a_id)
+{
+    a_dispatcher.Perform({ a_job, "", "", "", "", "" }, Arguments(Parse(a_parameters)), a_id);
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("identical in-flight requests share a response", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        std::map<std::string, size_t>   completed_at;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&loop, &codes, &completed_at] (const Deferred* a_deferred) {
+            codes[a_deferred->id_]        = a_deferred->response().code();
+            completed_at[a_deferred->id_] = loop.now();
+        }));
+        dispatcher.Coalesce(true);
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 100.0}")));
+        Perform(dispatcher, 1, "{\"q\": 1, \"p\": 2}", "rq-1");
+        loop.Post([&dispatcher] () {
+            // ... members order does not matter ...
+            Perform(dispatcher, 2, "{\"p\": 2, \"q\": 1}", "rq-2");
+            Perform(dispatcher, 3, "{\"q\": 1, \"p\": 2}", "rq-3");
+            Perform(dispatcher, 4, "{\"q\": 2, \"p\": 2}", "rq-4");
+        }, 50);
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().coalesced_);
+        CASPER_JOB_TEST_ASSERT(check, 4 == codes.size());
+        for ( const auto& it : codes ) {
+            CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == it.second);
+        }
+        // ... followers land with their leader, a different request flies on it's own ...
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-1"]);
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-2"]);
+        CASPER_JOB_TEST_ASSERT(check, 100 == completed_at["rq-3"]);
+        CASPER_JOB_TEST_ASSERT(check, 150 == completed_at["rq-4"]);
+    });
+
+    check.Case("landed flights are not joined", [&check] () {
+        ::casper::job::test::Loop loop;
+        size_t completed = 0;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&completed] (const Deferred* /* a_deferred */) {
+            completed++;
+        }));
+        dispatcher.Coalesce(true);
+        Perform(dispatcher, 1, "{\"q\": 1}", "rq-1");
+        loop.Run();
+        Perform(dispatcher, 2, "{\"q\": 1}", "rq-2");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 2 == completed);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().coalesced_);
+    });
+
+    check.Case("disabled coalescing launches every request", [&check] () {
+        ::casper::job::test::Loop loop;
+        size_t completed = 0;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&completed] (const Deferred* /* a_deferred */) {
+            completed++;
+        }));
+        for ( uint64_t id = 1 ; id <= 3 ; ++id ) {
+            Perform(dispatcher, id, "{\"q\": 1}", "rq-" + std::to_string(id));
+        }
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 3 == completed);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().coalesced_);
+    });
+
+    check.Case("cancelled job's leader still serves it's followers", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&codes] (const Deferred* a_deferred) {
+            codes[a_deferred->id_] = a_deferred->response().code();
+        }));
+        dispatcher.Coalesce(true);
+        dispatcher.Enlist(1, "ch-1");
+        Perform(dispatcher, 1, "{\"q\": 1}", "rq-1");
+        Perform(dispatcher, 2, "{\"q\": 1}", "rq-2");
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().coalesced_);
+        // ... leader is shared, it's not failed along with it's job ...
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.Revoke("ch-1"));
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes["rq-1"]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes["rq-2"]);
+        // ... but the job's later requests are refused ...
+        Perform(dispatcher, 1, "{\"q\": 1}", "rq-3");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, CASPER_JOB_DEFERRABLE_STATUS_CODE_CANCELLED == codes["rq-3"]);
+    });
+
+    return check.Summary(argv[0]);
+}
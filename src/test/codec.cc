@@ -0,0 +1,159 @@
+/**
+ * @file codec.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/codec.h"
+
+#include "check.h"
+
+#include <limits>
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Encode and decode a value.
+ *
+ * @param a_value    Value to encode.
+ * @param a_encoding See \link ::casper::job::Codec::Encoding \link.
+ *
+ * @return Decoded value.
+ */
+static Json::Value RoundTrip (const Json::Value& a_value, const ::casper::job::Codec::Encoding a_encoding)
+{
+    std::string data;
+    ::casper::job::Codec::Encode(a_value, a_encoding, data);
+    Json::Value value;
+    ::casper::job::Codec::Decode(data, value);
+    return value;
+}
+
+/**
+ * @return True if decoding data throws.
+ *
+ * @param a_data Data to decode.
+ */
+static bool Rejected (const std::string& a_data)
+{
+    try {
+        Json::Value value;
+        ::casper::job::Codec::Decode(a_data, value);
+    } catch (const ::cc::Exception& /* a_cc_exception */) {
+        return true;
+    }
+    return false;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("scalars round-trip", [&check] () {
+        const Json::Value values[] = {
+            Json::Value::null, Json::Value(true), Json::Value(false),
+            Json::Value(0), Json::Value(127), Json::Value(128), Json::Value(255), Json::Value(256), Json::Value(65535), Json::Value(65536),
+            Json::Value(-1), Json::Value(-32), Json::Value(-33), Json::Value(-128), Json::Value(-129), Json::Value(-32768), Json::Value(-32769),
+            Json::Value(static_cast<Json::Int64>(std::numeric_limits<int32_t>::min()) - 1),
+            Json::Value(static_cast<Json::Int64>(std::numeric_limits<int64_t>::min())),
+            Json::Value(static_cast<Json::Int64>(std::numeric_limits<uint32_t>::max()) + 1),
+            Json::Value(static_cast<Json::UInt64>(std::numeric_limits<uint64_t>::max())),
+            Json::Value(0.5), Json::Value(-1.25), Json::Value(0.1), Json::Value(1e300),
+            Json::Value(""), Json::Value("caf\xC3\xA9"), Json::Value(std::string(31, 'a')), Json::Value(std::string(32, 'b')),
+            Json::Value(std::string(255, 'c')), Json::Value(std::string(256, 'd')), Json::Value(std::string(70000, 'e')),
+            Json::Value(std::string("nul\0byte", 8))
+        };
+        for ( const auto& value : values ) {
+            CASPER_JOB_TEST_ASSERT(check, value == RoundTrip(value, ::casper::job::Codec::Encoding::MessagePack));
+        }
+    });
+
+    check.Case("containers round-trip", [&check] () {
+        Json::Value value = Parse("{\"id\": 42, \"name\": \"job\", \"tags\": [\"a\", \"b\", null, 1.5], \"nested\": {\"empty\": {}, \"list\": []}}");
+        Json::Value big   = Json::Value(Json::ValueType::arrayValue);
+        for ( Json::Int idx = 0 ; idx < 70000 ; ++idx ) {
+            big.append(idx);
+        }
+        value["big"] = big;
+        Json::Value wide = Json::Value(Json::ValueType::objectValue);
+        for ( size_t idx = 0 ; idx < 20 ; ++idx ) {
+            wide["k" + std::to_string(idx)] = static_cast<Json::Int64>(idx);
+        }
+        value["wide"] = wide;
+        CASPER_JOB_TEST_ASSERT(check, value == RoundTrip(value, ::casper::job::Codec::Encoding::MessagePack));
+        CASPER_JOB_TEST_ASSERT(check, value == RoundTrip(value, ::casper::job::Codec::Encoding::JSON));
+    });
+
+    check.Case("encoding is detected", [&check] () {
+        const Json::Value value = Parse("{\"a\": [1, 2, 3]}");
+        std::string json;
+        std::string msgpack;
+        ::casper::job::Codec::Encode(value, ::casper::job::Codec::Encoding::JSON, json);
+        ::casper::job::Codec::Encode(value, ::casper::job::Codec::Encoding::MessagePack, msgpack);
+        CASPER_JOB_TEST_ASSERT(check, false == ::casper::job::Codec::Binary(json));
+        CASPER_JOB_TEST_ASSERT(check, true  == ::casper::job::Codec::Binary(msgpack));
+        CASPER_JOB_TEST_ASSERT(check, false == ::casper::job::Codec::Binary(""));
+        CASPER_JOB_TEST_ASSERT(check, msgpack.length() < json.length());
+        // ... marker, fixmap of 1, fixstr "a", fixarray of 3 ...
+        CASPER_JOB_TEST_ASSERT(check, std::string("\xC1\x81\xA1" "a" "\x93\x01\x02\x03", 8) == msgpack);
+    });
+
+    check.Case("encoding configuration", [&check] () {
+        CASPER_JOB_TEST_ASSERT(check, ::casper::job::Codec::Encoding::JSON        == ::casper::job::Codec::Load(Json::Value::null));
+        CASPER_JOB_TEST_ASSERT(check, ::casper::job::Codec::Encoding::JSON        == ::casper::job::Codec::Load(Json::Value("json")));
+        CASPER_JOB_TEST_ASSERT(check, ::casper::job::Codec::Encoding::MessagePack == ::casper::job::Codec::Load(Json::Value("msgpack")));
+        bool thrown = false;
+        try {
+            (void)::casper::job::Codec::Load(Json::Value("bson"));
+        } catch (const ::cc::Exception& /* a_cc_exception */) {
+            thrown = true;
+        }
+        CASPER_JOB_TEST_ASSERT(check, true == thrown);
+    });
+
+    check.Case("malformed data is rejected", [&check] () {
+        std::string data;
+        ::casper::job::Codec::Encode(Parse("{\"key\": \"value\", \"list\": [1, 2, 3]}"), ::casper::job::Codec::Encoding::MessagePack, data);
+        // ... every truncation ...
+        for ( size_t length = 1 ; length < data.length() ; ++length ) {
+            CASPER_JOB_TEST_ASSERT(check, true == Rejected(data.substr(0, length)));
+        }
+        // ... trailing bytes ...
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(data + '\x01'));
+        // ... marker as a value ...
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(std::string("\xC1\xC1", 2)));
+        // ... length way past end ...
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(std::string("\xC1\xDB\xFF\xFF\xFF\xFF", 6)));
+        // ... too deep ...
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(std::string(1, '\xC1') + std::string(1000, '\x91') + std::string(1, '\x01')));
+    });
+
+    return check.Summary(argv[0]);
+}
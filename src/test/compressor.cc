@@ -0,0 +1,242 @@
+/**
+ * @file compressor.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/compressor.h"
+
+#include "cc/easy/json.h"
+
+#include "check.h"
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Generate data that does not compress.
+ *
+ * @param a_length Number of bytes.
+ * @param a_seed   Generator seed, same seed same data.
+ *
+ * @return Data.
+ */
+static std::string Noise (const size_t a_length, uint64_t a_seed)
+{
+    std::string data;
+    data.reserve(a_length);
+    for ( size_t idx = 0 ; idx < a_length ; ++idx ) {
+        // ... xorshift64 ...
+        a_seed ^= a_seed << 13;
+        a_seed ^= a_seed >> 7;
+        a_seed ^= a_seed << 17;
+        data.push_back(static_cast<char>(a_seed & 0xFF));
+    }
+    return data;
+}
+
+/**
+ * @brief Generate JSON like data, it compresses well.
+ *
+ * @param a_records Number of records.
+ *
+ * @return Data.
+ */
+static std::string Records (const size_t a_records)
+{
+    std::string data = "[";
+    for ( size_t idx = 0 ; idx < a_records ; ++idx ) {
+        data += ( 0 == idx ? "" : "," );
+        data += "{\"id\":" + std::to_string(idx) + ",\"name\":\"record-" + std::to_string(idx % 97) + "\",\"active\":" + ( 0 == idx % 3 ? "true" : "false" ) + "}";
+    }
+    return data + "]";
+}
+
+/**
+ * @return True if expanding a frame throws.
+ *
+ * @param a_compressor Compressor to expand with.
+ * @param a_frame      Frame to expand.
+ */
+static bool Rejected (::casper::job::Compressor& a_compressor, const std::string& a_frame)
+{
+    try {
+        std::string data;
+        a_compressor.Inflate(a_frame, data);
+    } catch (const ::cc::Exception& /* a_cc_exception */) {
+        return true;
+    }
+    return false;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("compressible data round-trips", [&check] () {
+        ::casper::job::Compressor compressor(::casper::job::Compressor::Load(Parse("{\"threshold\": 64}")));
+        const std::string inputs[] = {
+            Records(2000),
+            std::string(100000, 'a'),                                    // overlapping matches
+            Noise(60000, 7) + std::string(10000, 'z') + Noise(60000, 7), // repeat further away than a match can reach
+            Noise(1000, 3) + std::string(5000, ' ') + Noise(1000, 5)
+        };
+        for ( const auto& input : inputs ) {
+            std::string frame;
+            std::string output;
+            CASPER_JOB_TEST_ASSERT(check, true == compressor.Deflate(input, frame));
+            CASPER_JOB_TEST_ASSERT(check, true == ::casper::job::Compressor::Framed(frame));
+            CASPER_JOB_TEST_ASSERT(check, frame.length() < input.length());
+            compressor.Inflate(frame, output);
+            CASPER_JOB_TEST_ASSERT(check, input == output);
+        }
+        CASPER_JOB_TEST_ASSERT(check, 4 == compressor.stats().compressed_);
+        CASPER_JOB_TEST_ASSERT(check, 4 == compressor.stats().expanded_);
+        CASPER_JOB_TEST_ASSERT(check, compressor.ratio() > 1.0);
+    });
+
+    check.Case("block end rules hold for every small size", [&check] () {
+        ::casper::job::Compressor compressor(::casper::job::Compressor::Load(Parse("{\"threshold\": 0}")));
+        const std::string pattern = "abcabcabcabcabcabcabcabcabcabcabcabcabcabcabcabc";
+        for ( size_t length = 0 ; length <= pattern.length() ; ++length ) {
+            const std::string input = pattern.substr(0, length);
+            std::string frame;
+            if ( false == compressor.Deflate(input, frame) ) {
+                continue;
+            }
+            std::string output;
+            compressor.Inflate(frame, output);
+            CASPER_JOB_TEST_ASSERT(check, input == output);
+        }
+        CASPER_JOB_TEST_ASSERT(check, compressor.stats().compressed_ > 0);
+    });
+
+    check.Case("not worth it", [&check] () {
+        ::casper::job::Compressor disabled(::casper::job::Compressor::Load(Json::Value::null));
+        ::casper::job::Compressor compressor(::casper::job::Compressor::Load(Parse("{\"threshold\": 1024}")));
+        std::string frame;
+        CASPER_JOB_TEST_ASSERT(check, false == disabled.config().enabled_);
+        CASPER_JOB_TEST_ASSERT(check, false == disabled.Deflate(Records(1000), frame));
+        // ... below threshold ...
+        CASPER_JOB_TEST_ASSERT(check, false == compressor.Deflate(std::string(1023, 'a'), frame));
+        CASPER_JOB_TEST_ASSERT(check, true  == compressor.Deflate(std::string(1024, 'a'), frame));
+        // ... did not shrink ...
+        std::string untouched = "untouched";
+        CASPER_JOB_TEST_ASSERT(check, false == compressor.Deflate(Noise(4096, 11), untouched));
+        CASPER_JOB_TEST_ASSERT(check, "untouched" == untouched);
+        CASPER_JOB_TEST_ASSERT(check, 1 == compressor.stats().skipped_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == compressor.stats().compressed_);
+    });
+
+    check.Case("envelopes round-trip", [&check] () {
+        ::casper::job::Compressor compressor(::casper::job::Compressor::Load(Parse("{}")));
+        const std::string input = Records(500);
+        Json::Value envelope;
+        std::string output;
+        CASPER_JOB_TEST_ASSERT(check, true == compressor.Pack(input, envelope));
+        CASPER_JOB_TEST_ASSERT(check, true == ::casper::job::Compressor::Enveloped(envelope));
+        CASPER_JOB_TEST_ASSERT(check, "lz4" == envelope["__compressed__"].asString());
+        compressor.Unpack(envelope, output);
+        CASPER_JOB_TEST_ASSERT(check, input == output);
+        // ... wrapped, not compressed, binary data; every base64 padding length ...
+        for ( size_t length = 0 ; length < 4 ; ++length ) {
+            const std::string binary = std::string("\xC1\x00\xFF", 3) + Noise(length, 13);
+            Json::Value wrapped;
+            ::casper::job::Compressor::Wrap(binary, wrapped);
+            CASPER_JOB_TEST_ASSERT(check, true == ::casper::job::Compressor::Enveloped(wrapped));
+            CASPER_JOB_TEST_ASSERT(check, "none" == wrapped["__compressed__"].asString());
+            compressor.Unpack(wrapped, output);
+            CASPER_JOB_TEST_ASSERT(check, binary == output);
+        }
+        // ... not an envelope ...
+        CASPER_JOB_TEST_ASSERT(check, false == ::casper::job::Compressor::Enveloped(Parse("{\"data\": \"abc\"}")));
+        bool thrown = false;
+        try {
+            compressor.Unpack(Parse("{\"__compressed__\": \"zstd\", \"data\": \"\"}"), output);
+        } catch (const ::cc::Exception& /* a_cc_exception */) {
+            thrown = true;
+        }
+        CASPER_JOB_TEST_ASSERT(check, true == thrown);
+    });
+
+    check.Case("corrupted frames are rejected", [&check] () {
+        ::casper::job::Compressor compressor(::casper::job::Compressor::Load(Parse("{\"threshold\": 0, \"limit\": 1048576}")));
+        const std::string input = Records(200);
+        std::string frame;
+        CASPER_JOB_TEST_ASSERT(check, true == compressor.Deflate(input, frame));
+        // ... every truncation ...
+        for ( size_t length = 0 ; length < frame.length() ; ++length ) {
+            CASPER_JOB_TEST_ASSERT(check, true == Rejected(compressor, frame.substr(0, length)));
+        }
+        // ... unsupported algorithm ...
+        std::string other = frame;
+        other[1] = '\x02';
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(compressor, other));
+        // ... original size above limit ...
+        std::string huge = frame;
+        huge[2] = '\x7F';
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(compressor, huge));
+        // ... original size that does not match block ...
+        std::string lying = frame;
+        lying[5] = static_cast<char>(static_cast<uint8_t>(lying[5]) ^ 0x01);
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(compressor, lying));
+        // ... any flipped byte either fails or expands to original size, never out of bounds ...
+        for ( size_t idx = 6 ; idx < frame.length() ; ++idx ) {
+            std::string flipped = frame;
+            flipped[idx] = static_cast<char>(~static_cast<uint8_t>(flipped[idx]));
+            try {
+                std::string output;
+                compressor.Inflate(flipped, output);
+                CASPER_JOB_TEST_ASSERT(check, input.length() == output.length());
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                /* expected */
+            }
+        }
+    });
+
+    check.Case("invalid configuration", [&check] () {
+        const char* const configs[] = {
+            "[]",
+            "{\"threshold\": -1}",
+            "{\"threshold\": \"1KB\"}",
+            "{\"limit\": 8589934592}"
+        };
+        for ( const auto config : configs ) {
+            bool thrown = false;
+            try {
+                (void)::casper::job::Compressor::Load(Parse(config));
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}
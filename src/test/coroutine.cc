@@ -0,0 +1,274 @@
+/**
+ * @file coroutine.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/coroutine.h"
+
+#ifdef CASPER_JOB_DEFERRABLE_COROUTINES
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+typedef ::casper::job::deferrable::coroutine::Scheduler        Scheduler;
+typedef ::casper::job::deferrable::coroutine::Task             Task;
+typedef ::casper::job::deferrable::Tracking                    Tracking;
+typedef ::casper::job::deferrable::Response                    Response;
+
+/**
+ * @brief Sets a flag when destroyed, to tell if a coroutine frame was disposed.
+ */
+class Sentinel final
+{
+
+private: // Data
+
+    bool& destroyed_;
+
+public: // Constructor(s) / Destructor
+
+    Sentinel (bool& a_destroyed)
+        : destroyed_(a_destroyed)
+    {
+        destroyed_ = false;
+    }
+
+    ~Sentinel ()
+    {
+        destroyed_ = true;
+    }
+
+}; // end of class 'Sentinel'
+
+/**
+ * @brief Build scheduler callbacks that run on a test loop.
+ *
+ * @param a_loop         Loop to run on.
+ * @param a_on_concluded See \link Scheduler::Callbacks::on_concluded_ \link.
+ * @param a_on_exception See \link Scheduler::Callbacks::on_exception_ \link.
+ */
+static Scheduler::Callbacks Callbacks (::casper::job::test::Loop& a_loop, std::function<void(const Tracking&)> a_on_concluded,
+                                       std::function<void(std::exception_ptr)> a_on_exception = nullptr)
+{
+    return {
+        /* on_main_thread_          */ [&a_loop] (std::function<void()> a_function) {
+            a_loop.Post(a_function, 0);
+        },
+        /* on_main_thread_deferred_ */ [&a_loop] (std::function<void()> a_function, const size_t a_delay) {
+            a_loop.Post(a_function, a_delay);
+        },
+        /* on_looper_thread_        */ [&a_loop] (const std::string& a_id, std::function<void(const std::string&)> a_function) {
+            a_loop.Post(a_id, a_function, 0);
+        },
+        /* on_exception_            */ a_on_exception,
+        /* on_concluded_            */ a_on_concluded
+    };
+}
+
+/**
+ * @brief Job that awaits one request and concludes with it's response code.
+ *
+ * @param a_scheduler  Scheduler, frame is allocated from it's pool.
+ * @param a_dispatcher Dispatcher to perform request with.
+ * @param a_tracking   Job tracking info.
+ */
+static Task Fetch (Scheduler& a_scheduler, Dispatcher& a_dispatcher, const Tracking a_tracking)
+{
+    // ... named, not temporary, awaitable arguments: some compilers mishandle temporaries that live across a suspension point ...
+    const std::string                       id     = "rq-" + std::to_string(a_tracking.bjid_);
+    std::function<void(const std::string&)> launch = [&a_dispatcher, a_tracking] (const std::string& a_id) {
+        a_dispatcher.Perform(a_tracking, Arguments(Json::Value(Json::ValueType::objectValue)), a_id);
+    };
+    const Response response = co_await Scheduler::Perform(a_scheduler, id, launch);
+    Json::Value payload = Json::Value(Json::ValueType::objectValue);
+    payload["rtt"] = static_cast<Json::UInt64>(response.rtt());
+    a_scheduler.Conclude(a_tracking, response.code(), payload);
+}
+
+/**
+ * @brief Job that waits, hops to looper thread and back, and then concludes.
+ *
+ * @param a_scheduler Scheduler, frame is allocated from it's pool.
+ * @param a_tracking  Job tracking info.
+ * @param a_delay     In ms.
+ */
+static Task Wait (Scheduler& a_scheduler, const Tracking a_tracking, const size_t a_delay)
+{
+    co_await Scheduler::Delay(a_scheduler, a_delay);
+    const std::string id = "wait-" + std::to_string(a_tracking.bjid_);
+    co_await Scheduler::Looper(a_scheduler, id);
+    co_await Scheduler::Main(a_scheduler);
+    a_scheduler.Conclude(a_tracking, CC_STATUS_CODE_OK, Json::Value("waited"));
+}
+
+/**
+ * @brief Job that awaits a request that never completes.
+ *
+ * @param a_scheduler Scheduler, frame is allocated from it's pool.
+ * @param a_destroyed Set when frame is disposed.
+ */
+static Task Hang (Scheduler& a_scheduler, bool& a_destroyed)
+{
+    const Sentinel sentinel(a_destroyed);
+    const std::string                       id     = "rq-hang";
+    std::function<void(const std::string&)> launch = [] (const std::string&) { };
+    (void)co_await Scheduler::Perform(a_scheduler, id, launch);
+    a_destroyed = false; // unreachable
+}
+
+/**
+ * @brief Job that sleeps long enough to be outlived by it's scheduler.
+ *
+ * @param a_scheduler Scheduler, frame is allocated from it's pool.
+ * @param a_destroyed Set when frame is disposed.
+ */
+static Task Sleep (Scheduler& a_scheduler, bool& a_destroyed)
+{
+    const Sentinel sentinel(a_destroyed);
+    co_await Scheduler::Delay(a_scheduler, 60000);
+    a_destroyed = false; // unreachable
+}
+
+/**
+ * @brief Job that fails after being resumed.
+ *
+ * @param a_scheduler Scheduler, frame is allocated from it's pool.
+ */
+static Task Fail (Scheduler& a_scheduler)
+{
+    co_await Scheduler::Main(a_scheduler);
+    throw ::cc::Exception("%s", "simulated failure");
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("completion collects outcome", [&check] () {
+        ::casper::job::test::Loop  loop;
+        size_t                     concluded = 0;
+        std::map<uint64_t, uint16_t> codes;
+        Scheduler  scheduler(Callbacks(loop, [&concluded] (const Tracking&) { concluded++; }));
+        Dispatcher dispatcher;
+        dispatcher.Setup(Dispatcher::Load(Json::Value::null));
+        dispatcher.Bind(loop.Callbacks<Arguments>([&scheduler, &codes] (const Deferred* a_deferred) {
+            // ... as a job does: resume waiting coroutine, it's outcome is then ready ...
+            if ( true == scheduler.Resume(a_deferred->id_, a_deferred->response()) ) {
+                Json::Value payload;
+                codes[a_deferred->tracking_.bjid_] = scheduler.Outcome(a_deferred->tracking_.bjid_, payload);
+            }
+        }));
+        for ( uint64_t id = 1 ; id <= 3 ; ++id ) {
+            Fetch(scheduler, dispatcher, { id, "", "", "", "", "" });
+        }
+        CASPER_JOB_TEST_ASSERT(check, true  == scheduler.Waiting("rq-1"));
+        CASPER_JOB_TEST_ASSERT(check, true  == scheduler.Waiting("rq-1-hedge"));
+        CASPER_JOB_TEST_ASSERT(check, false == scheduler.Waiting("rq-4"));
+        CASPER_JOB_TEST_ASSERT(check, 3 == scheduler.frames().Snapshot().live_);
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 3 == codes.size());
+        for ( const auto& code : codes ) {
+            CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == code.second);
+        }
+        // ... outcomes were collected by completions, no late conclusion ...
+        CASPER_JOB_TEST_ASSERT(check, 0 == concluded);
+        CASPER_JOB_TEST_ASSERT(check, false == scheduler.Waiting("rq-1"));
+        CASPER_JOB_TEST_ASSERT(check, 0 == scheduler.frames().Snapshot().live_);
+        // ... frames are reused ...
+        Fetch(scheduler, dispatcher, { 4, "", "", "", "", "" });
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes[4]);
+        CASPER_JOB_TEST_ASSERT(check, scheduler.frames().Snapshot().reused_ >= 1);
+    });
+
+    check.Case("conclusion outside a completion is posted", [&check] () {
+        ::casper::job::test::Loop  loop;
+        std::map<uint64_t, uint16_t> codes;
+        Json::Value                payload;
+        Scheduler* scheduler = nullptr;
+        scheduler = new Scheduler(Callbacks(loop, [&scheduler, &codes, &payload] (const Tracking& a_tracking) {
+            codes[a_tracking.bjid_] = scheduler->Outcome(a_tracking.bjid_, payload);
+        }));
+        Wait(*scheduler, { 9, "", "", "", "", "" }, 250);
+        CASPER_JOB_TEST_ASSERT(check, 0 == codes.size());
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 1 == codes.size());
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes[9]);
+        CASPER_JOB_TEST_ASSERT(check, "waited" == payload.asString());
+        CASPER_JOB_TEST_ASSERT(check, loop.now() >= 250);
+        // ... collected once ...
+        CASPER_JOB_TEST_ASSERT(check, 0 == scheduler->Outcome(9, payload));
+        delete scheduler;
+    });
+
+    check.Case("disposed scheduler destroys suspended frames", [&check] () {
+        ::casper::job::test::Loop loop;
+        bool       awaiting = false;
+        bool       sleeping = false;
+        Scheduler* scheduler = new Scheduler(Callbacks(loop, [] (const Tracking&) { }));
+        Hang(*scheduler, awaiting);
+        Sleep(*scheduler, sleeping);
+        CASPER_JOB_TEST_ASSERT(check, false == awaiting);
+        CASPER_JOB_TEST_ASSERT(check, false == sleeping);
+        CASPER_JOB_TEST_ASSERT(check, true  == scheduler->Waiting("rq-hang"));
+        delete scheduler;
+        CASPER_JOB_TEST_ASSERT(check, true == awaiting);
+        CASPER_JOB_TEST_ASSERT(check, true == sleeping);
+        // ... posted resume must not touch destroyed frame ...
+        CASPER_JOB_TEST_ASSERT(check, 1 == loop.Run());
+    });
+
+    check.Case("exceptions are forwarded", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::string               what;
+        Scheduler scheduler(Callbacks(loop, [] (const Tracking&) { }, [&what] (std::exception_ptr a_exception) {
+            try {
+                std::rethrow_exception(a_exception);
+            } catch (const ::cc::Exception& a_cc_exception) {
+                what = a_cc_exception.what();
+            }
+        }));
+        Fail(scheduler);
+        CASPER_JOB_TEST_ASSERT(check, 0 == what.length());
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, "simulated failure" == what);
+        CASPER_JOB_TEST_ASSERT(check, 0 == scheduler.frames().Snapshot().live_);
+    });
+
+    return check.Summary(argv[0]);
+}
+
+#else
+
+#include <stdio.h>
+
+int main (int /* argc */, char** argv)
+{
+    fprintf(stdout, "%s: coroutines not supported, skipped\n", argv[0]);
+    return 0;
+}
+
+#endif // CASPER_JOB_DEFERRABLE_COROUTINES
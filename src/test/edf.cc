@@ -0,0 +1,128 @@
+/**
+ * @file edf.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+#include <vector>
+#include <chrono>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Perform one request per job, behind a single slot, and collect completion order.
+ *
+ * @param a_edf       True to launch waiting requests earliest deadline first.
+ * @param a_validity  Job ID -> Validity, in seconds; 0 for no deadline.
+ *
+ * @return Job IDs, in completion order.
+ */
+static std::vector<uint64_t> Run (const bool a_edf, const std::vector<std::pair<uint64_t, uint64_t>>& a_validity)
+{
+    ::casper::job::test::Loop loop;
+    std::vector<uint64_t>     order;
+    Dispatcher dispatcher;
+    dispatcher.Bind(loop.Callbacks<Arguments>([&order] (const Deferred* a_deferred) {
+        order.push_back(a_deferred->tracking_.bjid_);
+    }));
+    dispatcher.Limit(::casper::job::deferrable::Limiter::Load(Parse("{\"initial\": 1, \"min\": 1, \"max\": 1}")));
+    dispatcher.Prioritize(a_edf);
+    const auto reserved = std::chrono::steady_clock::now();
+    for ( const auto& job : a_validity ) {
+        dispatcher.Deadline(job.first, job.second, reserved);
+        dispatcher.Perform({ job.first, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(job.first));
+    }
+    loop.Run();
+    return order;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    // ... job #1 takes the only slot, others wait ...
+    const std::vector<std::pair<uint64_t, uint64_t>> jobs = {
+        { 1, 500 }, { 2, 300 }, { 3, 200 }, { 4, 0 }, { 5, 100 }, { 6, 200 }
+    };
+
+    check.Case("earliest deadline first", [&check, &jobs] () {
+        const std::vector<uint64_t> order = Run(/* a_edf */ true, jobs);
+        // ... ties keep arrival order, no deadline goes last ...
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<uint64_t>({ 1, 5, 3, 6, 2, 4 }) == order ));
+    });
+
+    check.Case("arrival order without edf", [&check, &jobs] () {
+        const std::vector<uint64_t> order = Run(/* a_edf */ false, jobs);
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<uint64_t>({ 1, 2, 3, 4, 5, 6 }) == order ));
+    });
+
+    check.Case("expired requests leave the queue", [&check] () {
+        ::casper::job::test::Loop       loop;
+        std::map<uint64_t, uint16_t>    codes;
+        std::vector<uint64_t>           order;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&codes, &order] (const Deferred* a_deferred) {
+            codes[a_deferred->tracking_.bjid_] = a_deferred->response().code();
+            order.push_back(a_deferred->tracking_.bjid_);
+        }));
+        dispatcher.Limit(::casper::job::deferrable::Limiter::Load(Parse("{\"initial\": 1, \"min\": 1, \"max\": 1}")));
+        dispatcher.Prioritize(true);
+        const auto now = std::chrono::steady_clock::now();
+        // ... job #2 was reserved long ago, it's deadline already passed ...
+        dispatcher.Deadline(1, 60, now);
+        dispatcher.Deadline(2, 1, now - std::chrono::seconds(10));
+        dispatcher.Deadline(3, 60, now);
+        for ( uint64_t id = 1 ; id <= 3 ; ++id ) {
+            dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(id));
+        }
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().queued_);
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<uint64_t>({ 2, 1, 3 }) == order ));
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_GATEWAY_TIMEOUT == codes[2]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes[1]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == codes[3]);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().expired_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().overdue_);
+        // ... never reached the backend, it's slot went to the next one ...
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().limiter_.in_flight_);
+    });
+
+    return check.Summary(argv[0]);
+}
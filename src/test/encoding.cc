@@ -0,0 +1,165 @@
+/**
+ * @file encoding.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/base.h"
+
+#include "check.h"
+
+/**
+ * @brief Job steps, only 'done' is used.
+ */
+enum class Step : uint8_t {
+    Done = 100
+};
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Tube that exposes result negotiation, it never runs jobs.
+ */
+class Tube final : public ::casper::job::Base<Step, Step::Done>
+{
+
+public: // Constructor(s) / Destructor
+
+    Tube (const Json::Value& a_config)
+        : ::casper::job::Base<Step, Step::Done>("encoding", ::ev::Loggable::Data(), ::cc::easy::job::Job::Config(a_config))
+    {
+        /* empty */
+    }
+
+public: // Method(s) / Function(s)
+
+    using ::casper::job::Base<Step, Step::Done>::Negotiate;
+    using ::casper::job::Base<Step, Step::Done>::Deflate;
+    using ::casper::job::Base<Step, Step::Done>::Inflate;
+    using ::casper::job::Base<Step, Step::Done>::Forget;
+
+protected: // Inherited Virtual Method(s) / Function(s) - from ::casper::job::Base
+
+    virtual void InnerRun (const uint64_t& /* a_id */, const Json::Value& /* a_payload */, cc::easy::job::Job::Response& o_response)
+    {
+        o_response.code_ = CC_STATUS_CODE_OK;
+    }
+
+}; // end of class 'Tube'
+
+/**
+ * @return A result big enough to be compressed.
+ */
+static Json::Value Result ()
+{
+    Json::Value result = Json::Value(Json::ValueType::objectValue);
+    result["text"] = std::string(1024, 'x');
+    return result;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    const Json::Value config = Parse("{\"encoding\": \"msgpack\", \"compression\": { \"threshold\": 64 }}");
+
+    check.Case("producers that did not negotiate get plain json", [&check, &config] () {
+        Tube tube(config);
+        tube.Setup();
+        tube.Negotiate(1, Parse("{\"value\": 1}"));
+        Json::Value payload = Result();
+        tube.Deflate(1, CC_STATUS_CODE_OK, payload);
+        CASPER_JOB_TEST_ASSERT(check, Result() == payload);
+    });
+
+    check.Case("negotiated encoding is wrapped", [&check, &config] () {
+        Tube tube(config);
+        tube.Setup();
+        tube.Negotiate(1, Parse("{\"encoding\": \"msgpack\"}"));
+        Json::Value payload = Result();
+        tube.Deflate(1, CC_STATUS_CODE_OK, payload);
+        CASPER_JOB_TEST_ASSERT(check, true == ::casper::job::Compressor::Enveloped(payload));
+        CASPER_JOB_TEST_ASSERT(check, "none" == payload["__compressed__"].asString());
+        Json::Value value;
+        CASPER_JOB_TEST_ASSERT(check, true == tube.Inflate(payload, value));
+        CASPER_JOB_TEST_ASSERT(check, Result() == value);
+    });
+
+    check.Case("negotiated encoding in broker body", [&check, &config] () {
+        Tube tube(config);
+        tube.Setup();
+        tube.Negotiate(1, Parse("{\"headers\": {}, \"body\": { \"encoding\": \"msgpack\"}}"));
+        Json::Value payload = Result();
+        tube.Deflate(1, CC_STATUS_CODE_OK, payload);
+        CASPER_JOB_TEST_ASSERT(check, "none" == payload["__compressed__"].asString());
+    });
+
+    check.Case("unknown or other encodings get plain json", [&check, &config] () {
+        Tube tube(config);
+        tube.Setup();
+        tube.Negotiate(1, Parse("{\"encoding\": \"bson\"}"));
+        tube.Negotiate(2, Parse("{\"encoding\": \"json\"}"));
+        for ( const uint64_t id : { 1, 2 } ) {
+            Json::Value payload = Result();
+            tube.Deflate(id, CC_STATUS_CODE_OK, payload);
+            CASPER_JOB_TEST_ASSERT(check, Result() == payload);
+        }
+    });
+
+    check.Case("compression alone keeps json inside", [&check, &config] () {
+        Tube tube(config);
+        tube.Setup();
+        tube.Negotiate(1, Parse("{\"compression\": \"lz4\"}"));
+        Json::Value payload = Result();
+        tube.Deflate(1, CC_STATUS_CODE_OK, payload);
+        CASPER_JOB_TEST_ASSERT(check, "lz4" == payload["__compressed__"].asString());
+        std::string data;
+        ::casper::job::Compressor(::casper::job::Compressor::Load(config["compression"])).Unpack(payload, data);
+        CASPER_JOB_TEST_ASSERT(check, false == ::casper::job::Codec::Binary(data));
+        Json::Value value;
+        CASPER_JOB_TEST_ASSERT(check, true == tube.Inflate(payload, value));
+        CASPER_JOB_TEST_ASSERT(check, Result() == value);
+    });
+
+    check.Case("failed results and forgotten jobs are left as is", [&check, &config] () {
+        Tube tube(config);
+        tube.Setup();
+        tube.Negotiate(1, Parse("{\"encoding\": \"msgpack\", \"compression\": \"lz4\"}"));
+        Json::Value payload = Result();
+        tube.Deflate(1, CC_STATUS_CODE_BAD_REQUEST, payload);
+        CASPER_JOB_TEST_ASSERT(check, Result() == payload);
+        tube.Negotiate(2, Parse("{\"encoding\": \"msgpack\"}"));
+        tube.Forget(2);
+        tube.Deflate(2, CC_STATUS_CODE_OK, payload);
+        CASPER_JOB_TEST_ASSERT(check, Result() == payload);
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file envelope.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/base.h"
+
+#include "check.h"
+
+#include <vector>
+
+/**
+ * @brief Job steps, only 'done' is used.
+ */
+enum class Step : uint8_t {
+    Done = 100
+};
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const std::string& a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Scan a payload raw text.
+ *
+ * @param a_raw    Payload text.
+ * @param o_fields See \link ::casper::job::Envelope::Fields \link.
+ *
+ * @return See \link ::casper::job::Envelope::Peek \link.
+ */
+static bool Peek (const std::string& a_raw, ::casper::job::Envelope::Fields& o_fields)
+{
+    return ::casper::job::Envelope::Peek(a_raw.c_str(), a_raw.length(), o_fields);
+}
+
+/**
+ * @brief Tube that exposes payload inspection, it never runs jobs.
+ */
+class Tube final : public ::casper::job::Base<Step, Step::Done>
+{
+
+public: // Constructor(s) / Destructor
+
+    Tube ()
+        : ::casper::job::Base<Step, Step::Done>("envelope", ::ev::Loggable::Data(), ::cc::easy::job::Job::Config(Json::Value::null))
+    {
+        /* empty */
+    }
+
+public: // Method(s) / Function(s)
+
+    using ::casper::job::Base<Step, Step::Done>::Peek;
+    using ::casper::job::Base<Step, Step::Done>::Payload;
+    using ::casper::job::Base<Step, Step::Done>::TTR;
+    using ::casper::job::Base<Step, Step::Done>::Validity;
+    using ::casper::job::Base<Step, Step::Done>::SetTTRAndValidity;
+
+protected: // Inherited Virtual Method(s) / Function(s) - from ::casper::job::Base
+
+    virtual void InnerRun (const uint64_t& /* a_id */, const Json::Value& /* a_payload */, cc::easy::job::Job::Response& o_response)
+    {
+        o_response.code_ = CC_STATUS_CODE_OK;
+    }
+
+}; // end of class 'Tube'
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("control fields of a plain payload", [&check] () {
+        ::casper::job::Envelope::Fields fields;
+        CASPER_JOB_TEST_ASSERT(check, true == Peek("{\"data\": [1, {\"ttr\": 1, \"x\": \"}]\"}], \"ttr\": 30, \"validity\" : 60 }", fields));
+        CASPER_JOB_TEST_ASSERT(check, false == fields.wrapped_);
+        CASPER_JOB_TEST_ASSERT(check, true == fields.has_ttr_      && 30 == fields.ttr_);
+        CASPER_JOB_TEST_ASSERT(check, true == fields.has_validity_ && 60 == fields.validity_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == fields.body_length_);
+    });
+
+    check.Case("control fields of a wrapped payload are read from it's body", [&check] () {
+        const std::string body = "{\"ttr\": 5, \"data\": \"...\"}";
+        const std::string raw  = "{\"ttr\": 99, \"headers\": [\"X-CASPER-ROLE-MASK: 0x40000000\", 1, \"X-A: \\u00e9\"], \"body\": " + body + ", \"__nginx_broker__\": true}";
+        ::casper::job::Envelope::Fields fields;
+        CASPER_JOB_TEST_ASSERT(check, true == Peek(raw, fields));
+        CASPER_JOB_TEST_ASSERT(check, true  == fields.wrapped_);
+        CASPER_JOB_TEST_ASSERT(check, true  == fields.broker_);
+        CASPER_JOB_TEST_ASSERT(check, true  == fields.has_ttr_ && 5 == fields.ttr_);
+        CASPER_JOB_TEST_ASSERT(check, false == fields.has_validity_);
+        // ... only strings, unescaped ...
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<std::string>{ "X-CASPER-ROLE-MASK: 0x40000000", "X-A: \xC3\xA9" } ) == fields.headers_);
+        CASPER_JOB_TEST_ASSERT(check, body == raw.substr(fields.body_offset_, fields.body_length_));
+    });
+
+    check.Case("unexpected types are not set", [&check] () {
+        ::casper::job::Envelope::Fields fields;
+        CASPER_JOB_TEST_ASSERT(check, true == Peek("{\"ttr\": \"30\", \"validity\": -1}", fields));
+        CASPER_JOB_TEST_ASSERT(check, false == fields.has_ttr_);
+        CASPER_JOB_TEST_ASSERT(check, false == fields.has_validity_);
+        CASPER_JOB_TEST_ASSERT(check, true == Peek("{\"ttr\": 1.5, \"body\": {\"ttr\": 1}}", fields));
+        CASPER_JOB_TEST_ASSERT(check, false == fields.has_ttr_);
+        CASPER_JOB_TEST_ASSERT(check, false == fields.wrapped_);
+    });
+
+    check.Case("malformed payloads are left to the full parse", [&check] () {
+        const std::vector<std::string> malformed = {
+            "", "[]", "{", "{\"a\": }", "{\"a\" 1}", "{\"a\": 1,}", "{\"a\": 1} x", "{\"a\": \"\\u12\"}", "{\"headers\": [\"x\" \"y\"], \"body\": {}}"
+        };
+        for ( const auto& raw : malformed ) {
+            ::casper::job::Envelope::Fields fields;
+            CASPER_JOB_TEST_ASSERT(check, false == Peek(raw, fields));
+        }
+    });
+
+    check.Case("tube peek agrees with payload parsing", [&check] () {
+        const std::vector<std::string> payloads = {
+            "{\"ttr\": 30, \"validity\": 60}",
+            "{\"headers\": [], \"body\": {\"ttr\": 10}}",
+            "{\"headers\": [\"X-CASPER-ROLE-MASK: 1073741824\"], \"body\": {\"validity\": 20}, \"__nginx_broker__\": true}",
+            "{\"headers\": [\"X-CASPER-ROLE-MASK: 0x1\"], \"body\": {}, \"__nginx_broker__\": true}"
+        };
+        for ( const auto& raw : payloads ) {
+            Tube tube;
+            ::casper::job::Envelope::Fields fields;
+            bool peeked_broker = true, peeked_role = true;
+            tube.SetTTRAndValidity(300, 3600);
+            CASPER_JOB_TEST_ASSERT(check, true == tube.Peek(raw, fields, &peeked_broker, &peeked_role));
+            const uint64_t peeked_ttr      = tube.TTR();
+            const uint64_t peeked_validity = tube.Validity();
+            bool parsed_broker = true, parsed_role = true;
+            tube.SetTTRAndValidity(300, 3600);
+            (void)tube.Payload(Parse(raw), &parsed_broker, &parsed_role);
+            CASPER_JOB_TEST_ASSERT(check, parsed_broker   == peeked_broker);
+            CASPER_JOB_TEST_ASSERT(check, parsed_role     == peeked_role);
+            CASPER_JOB_TEST_ASSERT(check, tube.TTR()      == peeked_ttr);
+            CASPER_JOB_TEST_ASSERT(check, tube.Validity() == peeked_validity);
+        }
+    });
+
+    check.Case("binary payloads are not peeked", [&check] () {
+        std::string data;
+        ::casper::job::Codec::Encode(Parse("{\"ttr\": 30}"), ::casper::job::Codec::Encoding::MessagePack, data);
+        Tube tube;
+        ::casper::job::Envelope::Fields fields;
+        CASPER_JOB_TEST_ASSERT(check, false == tube.Peek(data, fields));
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,164 @@
+/**
+ * @file fan.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fan.h"
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+#include <vector>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+typedef ::casper::job::deferrable::Fan                         Fan;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Merge sub-request responses codes, in fan-out order.
+ */
+static uint16_t Codes (const std::vector<::casper::job::deferrable::Response>& a_responses, Json::Value& o_payload)
+{
+    o_payload = Json::Value(Json::ValueType::arrayValue);
+    for ( const auto& response : a_responses ) {
+        o_payload.append(response.code());
+    }
+    return CC_STATUS_CODE_OK;
+}
+
+/**
+ * @brief Fan out sub-requests, one per profile, and account their completions.
+ *
+ * @param a_fan      Fan to account completions in.
+ * @param a_profiles Simulated backend profile of each sub-request, as JSON strings.
+ * @param o_outcomes Completion time and outcome, in completion order.
+ * @param o_merged   Merged responses, once settled.
+ */
+static void Run (Fan& a_fan, const std::vector<const char*>& a_profiles, std::vector<std::pair<size_t, Fan::Outcome>>& o_outcomes, Json::Value& o_merged)
+{
+    ::casper::job::test::Loop loop;
+    Dispatcher dispatcher;
+    dispatcher.Bind(loop.Callbacks<Arguments>([&loop, &a_fan, &o_outcomes, &o_merged] (const Deferred* a_deferred) {
+        o_outcomes.push_back(std::make_pair(loop.now(), a_fan.Complete(a_fan.Find(a_deferred->id_), a_deferred->response())));
+        if ( Fan::Outcome::Settled == o_outcomes.back().second ) {
+            (void)a_fan.merge()(a_fan.responses(), o_merged);
+        }
+    }));
+    for ( size_t idx = 0 ; idx < a_profiles.size() ; ++idx ) {
+        dispatcher.Setup(Dispatcher::Load(Parse(a_profiles[idx])));
+        dispatcher.Perform({ 1, "", "", "ch-1", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), a_fan.ids()[idx]);
+    }
+    loop.Run();
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("settles as soon as quorum is reached", [&check] () {
+        Fan fan("ch-1", 3, 2, Codes);
+        std::vector<std::pair<size_t, Fan::Outcome>> outcomes;
+        Json::Value                                  merged;
+        Run(fan, { "{\"latency\": 30.0}", "{\"latency\": 10.0}", "{\"latency\": 20.0}" }, outcomes, merged);
+        CASPER_JOB_TEST_ASSERT(check, 3 == outcomes.size());
+        CASPER_JOB_TEST_ASSERT(check, std::make_pair(static_cast<size_t>(10), Fan::Outcome::Pending) == outcomes[0]);
+        CASPER_JOB_TEST_ASSERT(check, std::make_pair(static_cast<size_t>(20), Fan::Outcome::Settled) == outcomes[1]);
+        // ... late sub-request is just accounted ...
+        CASPER_JOB_TEST_ASSERT(check, std::make_pair(static_cast<size_t>(30), Fan::Outcome::Ignored) == outcomes[2]);
+        CASPER_JOB_TEST_ASSERT(check, Parse("[499, 200, 200]") == merged);
+        CASPER_JOB_TEST_ASSERT(check, true == fan.finished());
+    });
+
+    check.Case("responses are merged in fan-out order", [&check] () {
+        Fan fan("ch-1", 3, 2, Codes);
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<std::string>{ "ch-1#0", "ch-1#1", "ch-1#2" } ) == fan.ids());
+        ::casper::job::deferrable::Response ok, failed;
+        ok.Set(CC_STATUS_CODE_OK, "application/json", "{}", /* a_rtt */ 10);
+        failed.Set(CC_STATUS_CODE_SERVICE_UNAVAILABLE, "application/json", "{}", /* a_rtt */ 10);
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Pending == fan.Complete(2, ok));
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Pending == fan.Complete(1, failed));
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Settled == fan.Complete(0, ok));
+        Json::Value payload;
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == fan.merge()(fan.responses(), payload));
+        CASPER_JOB_TEST_ASSERT(check, Parse("[200, 503, 200]") == payload);
+    });
+
+    check.Case("settles as soon as quorum is unreachable", [&check] () {
+        Fan fan("ch-1", 3, 3, Codes);
+        std::vector<std::pair<size_t, Fan::Outcome>> outcomes;
+        Json::Value                                  merged;
+        Run(fan, { "{\"latency\": 10.0}", "{\"latency\": 20.0, \"error-rate\": 1.0}", "{\"latency\": 30.0}" }, outcomes, merged);
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Pending == outcomes[0].second);
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Settled == outcomes[1].second);
+        CASPER_JOB_TEST_ASSERT(check, 20 == outcomes[1].first);
+        // ... outstanding sub-request did not answer in time ...
+        CASPER_JOB_TEST_ASSERT(check, Parse("[200, 503, 499]") == merged);
+    });
+
+    check.Case("hedges answer for their primary, once", [&check] () {
+        Fan fan("ch-1", 2, 2, Codes);
+        ::casper::job::deferrable::Response ok;
+        ok.Set(CC_STATUS_CODE_OK, "application/json", "{}", /* a_rtt */ 10);
+        const size_t idx = fan.Find(::casper::job::deferrable::Hedger::Hedge("ch-1#1"));
+        CASPER_JOB_TEST_ASSERT(check, 1 == idx);
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Pending == fan.Complete(idx, ok));
+        CASPER_JOB_TEST_ASSERT(check, Fan::Outcome::Ignored == fan.Complete(fan.Find("ch-1#1"), ok));
+        CASPER_JOB_TEST_ASSERT(check, 1 == fan.completed());
+        CASPER_JOB_TEST_ASSERT(check, fan.size() == fan.Find("ch-2#1"));
+    });
+
+    check.Case("invalid fan-out", [&check] () {
+        const std::vector<std::pair<size_t, size_t>> invalid = { { 0, 0 }, { 2, 0 }, { 2, 3 } };
+        for ( const auto& it : invalid ) {
+            bool thrown = false;
+            try {
+                Fan fan("ch-1", it.first, it.second, Codes);
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+        bool thrown = false;
+        try {
+            Fan fan("ch-1", 1, 1, nullptr);
+        } catch (const ::cc::Exception& /* a_cc_exception */) {
+            thrown = true;
+        }
+        CASPER_JOB_TEST_ASSERT(check, true == thrown);
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,230 @@
+/**
+ * @file hedging.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value> Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>    Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @brief Perform a batch of requests, one per job, and run them to completion.
+ *
+ * @param a_loop       Loop dispatcher runs on.
+ * @param a_dispatcher Dispatcher to perform requests with.
+ * @param a_first      First job ID.
+ * @param a_count      Number of jobs.
+ */
+static void Perform (::casper::job::test::Loop& a_loop, Dispatcher& a_dispatcher, const uint64_t a_first, const size_t a_count)
+{
+    for ( uint64_t id = a_first ; id < a_first + a_count ; ++id ) {
+        a_dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(id));
+    }
+    a_loop.Run();
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("delay is a percentile of rtt samples", [&check] () {
+        ::casper::job::deferrable::Hedger hedger;
+        hedger.Setup(::casper::job::deferrable::Hedger::Load(Parse("{\"percentile\": 50.0, \"min-delay\": 1, \"max-rate\": 1.0, \"window\": 10, \"warm-up\": 10}")));
+        for ( size_t rtt = 10 ; rtt > 0 ; --rtt ) {
+            // ... still warming up ...
+            CASPER_JOB_TEST_ASSERT(check, 0 == hedger.Track());
+            hedger.Sample(rtt * 10);
+        }
+        CASPER_JOB_TEST_ASSERT(check, 60 == hedger.stats().delay_);
+        CASPER_JOB_TEST_ASSERT(check, 60 == hedger.Track());
+        // ... oldest samples are replaced, percentile is refreshed every window / 10 samples ...
+        for ( size_t idx = 0 ; idx < 10 ; ++idx ) {
+            hedger.Sample(500);
+        }
+        CASPER_JOB_TEST_ASSERT(check, 500 == hedger.stats().delay_);
+    });
+
+    check.Case("delay has a floor", [&check] () {
+        ::casper::job::deferrable::Hedger hedger;
+        hedger.Setup(::casper::job::deferrable::Hedger::Load(Parse("{\"percentile\": 50.0, \"min-delay\": 25, \"window\": 10, \"warm-up\": 10}")));
+        for ( size_t idx = 0 ; idx < 10 ; ++idx ) {
+            hedger.Sample(2);
+        }
+        CASPER_JOB_TEST_ASSERT(check, 25 == hedger.stats().delay_);
+    });
+
+    check.Case("hedges are capped by max rate", [&check] () {
+        ::casper::job::deferrable::Hedger hedger;
+        hedger.Setup(::casper::job::deferrable::Hedger::Load(Parse("{\"max-rate\": 0.1}")));
+        for ( size_t idx = 0 ; idx < 10 ; ++idx ) {
+            (void)hedger.Track();
+        }
+        CASPER_JOB_TEST_ASSERT(check, true  == hedger.Fire());
+        CASPER_JOB_TEST_ASSERT(check, false == hedger.Fire());
+        for ( size_t idx = 0 ; idx < 10 ; ++idx ) {
+            (void)hedger.Track();
+        }
+        CASPER_JOB_TEST_ASSERT(check, true  == hedger.Fire());
+        CASPER_JOB_TEST_ASSERT(check, 2 == hedger.stats().hedged_);
+        CASPER_JOB_TEST_ASSERT(check, 20 == hedger.stats().requests_);
+    });
+
+    check.Case("disabled hedger never hedges", [&check] () {
+        ::casper::job::deferrable::Hedger hedger;
+        hedger.Sample(10);
+        CASPER_JOB_TEST_ASSERT(check, 0 == hedger.Track());
+        CASPER_JOB_TEST_ASSERT(check, 0 == hedger.stats().requests_);
+    });
+
+    check.Case("hedge ids map back to their primary", [&check] () {
+        CASPER_JOB_TEST_ASSERT(check, "rq-1-hedge" == ::casper::job::deferrable::Hedger::Hedge("rq-1"));
+        CASPER_JOB_TEST_ASSERT(check, "rq-1" == ::casper::job::deferrable::Hedger::Primary(::casper::job::deferrable::Hedger::Hedge("rq-1")));
+        CASPER_JOB_TEST_ASSERT(check, "rq-1" == ::casper::job::deferrable::Hedger::Primary("rq-1"));
+        CASPER_JOB_TEST_ASSERT(check, "-hedge" == ::casper::job::deferrable::Hedger::Primary("-hedge"));
+    });
+
+    check.Case("slow requests are hedged, each completes once", [&check] () {
+        ::casper::job::test::Loop   loop;
+        std::map<uint64_t, size_t> completions;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&completions] (const Deferred* a_deferred) {
+            completions[a_deferred->tracking_.bjid_]++;
+        }));
+        dispatcher.Hedge(::casper::job::deferrable::Hedger::Load(Parse("{\"percentile\": 50.0, \"min-delay\": 50, \"max-rate\": 0.5, \"window\": 10, \"warm-up\": 10}")));
+        // ... warm up with fast responses ...
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 10.0}")));
+        Perform(loop, dispatcher, 1, 10);
+        CASPER_JOB_TEST_ASSERT(check, 50 == dispatcher.metrics().hedger_.delay_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().hedger_.hedged_);
+        // ... half of the responses are now slow ...
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"distribution\": \"bimodal\", \"latency\": 10.0, \"slow-latency\": 1000.0, \"slow-ratio\": 0.5, \"seed\": 7}")));
+        Perform(loop, dispatcher, 11, 30);
+        const auto hedger = dispatcher.metrics().hedger_;
+        CASPER_JOB_TEST_ASSERT(check, 40 == completions.size());
+        for ( const auto& completion : completions ) {
+            CASPER_JOB_TEST_ASSERT(check, 1 == completion.second);
+        }
+        CASPER_JOB_TEST_ASSERT(check, hedger.hedged_ > 0);
+        CASPER_JOB_TEST_ASSERT(check, hedger.won_ > 0);
+        CASPER_JOB_TEST_ASSERT(check, hedger.won_ <= hedger.hedged_);
+        CASPER_JOB_TEST_ASSERT(check, static_cast<double>(hedger.hedged_) <= 0.5 * static_cast<double>(hedger.requests_));
+        CASPER_JOB_TEST_ASSERT(check, dispatcher.stats().dispatched_ == 40 + hedger.hedged_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == loop.pending());
+    });
+
+    check.Case("hedges need a free limiter slot", [&check] () {
+        ::casper::job::test::Loop   loop;
+        std::map<uint64_t, size_t> completions;
+        size_t                     in_flight = 0;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&completions, &in_flight, &dispatcher] (const Deferred* a_deferred) {
+            completions[a_deferred->tracking_.bjid_]++;
+            in_flight = std::max(in_flight, dispatcher.metrics().limiter_.in_flight_);
+        }));
+        dispatcher.Limit(::casper::job::deferrable::Limiter::Load(Parse("{\"initial\": 1, \"min\": 1, \"max\": 1}")));
+        dispatcher.Hedge(::casper::job::deferrable::Hedger::Load(Parse("{\"percentile\": 50.0, \"min-delay\": 50, \"max-rate\": 1.0, \"window\": 10, \"warm-up\": 10}")));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 10.0}")));
+        Perform(loop, dispatcher, 1, 10);
+        CASPER_JOB_TEST_ASSERT(check, 50 == dispatcher.metrics().hedger_.delay_);
+        // ... every request outlives hedge delay, but holds the only slot ...
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 500.0}")));
+        Perform(loop, dispatcher, 11, 5);
+        const auto metrics = dispatcher.metrics();
+        CASPER_JOB_TEST_ASSERT(check, 15 == completions.size());
+        for ( const auto& completion : completions ) {
+            CASPER_JOB_TEST_ASSERT(check, 1 == completion.second);
+        }
+        CASPER_JOB_TEST_ASSERT(check, metrics.hedger_.requests_ > 0);
+        CASPER_JOB_TEST_ASSERT(check, 0 == metrics.hedger_.hedged_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == in_flight);
+        CASPER_JOB_TEST_ASSERT(check, 0 == metrics.limiter_.in_flight_);
+        CASPER_JOB_TEST_ASSERT(check, 15 == dispatcher.stats().dispatched_);
+    });
+
+    check.Case("setup while requests are in flight", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<uint64_t, std::string> bodies;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&bodies] (const Deferred* a_deferred) {
+            bodies[a_deferred->tracking_.bjid_] = a_deferred->response().body();
+        }));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 10.0, \"content-type\": \"text/plain\", \"body-size\": 4096}")));
+        for ( uint64_t id = 1 ; id < 4 ; ++id ) {
+            dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(id));
+        }
+        // ... previous body is released by dispatcher, but not by requests already launched ...
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 10.0, \"content-type\": \"text/plain\", \"body-size\": 2}")));
+        dispatcher.Perform({ 4, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-4");
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 4 == bodies.size());
+        for ( uint64_t id = 1 ; id < 4 ; ++id ) {
+            CASPER_JOB_TEST_ASSERT(check, std::string(4096, 'x') == bodies[id]);
+        }
+        CASPER_JOB_TEST_ASSERT(check, "xx" == bodies[4]);
+    });
+
+    check.Case("pending hedge timer outlives dispatcher", [&check] () {
+        ::casper::job::test::Loop loop;
+        size_t completions = 0;
+        Dispatcher* dispatcher = new Dispatcher();
+        dispatcher->Bind(loop.Callbacks<Arguments>([&completions] (const Deferred* /* a_deferred */) {
+            completions++;
+        }));
+        dispatcher->Hedge(::casper::job::deferrable::Hedger::Load(Parse("{\"percentile\": 50.0, \"min-delay\": 50, \"max-rate\": 1.0, \"window\": 10, \"warm-up\": 10}")));
+        dispatcher->Setup(Dispatcher::Load(Parse("{\"latency\": 10.0}")));
+        Perform(loop, *dispatcher, 1, 10);
+        CASPER_JOB_TEST_ASSERT(check, 10 == completions);
+        // ... requests are revoked but their hedge timers stay armed, dispatcher is gone before they fire ...
+        dispatcher->Setup(Dispatcher::Load(Parse("{\"latency\": 500.0}")));
+        for ( uint64_t id = 11 ; id < 16 ; ++id ) {
+            dispatcher->Enlist(id, "ch-" + std::to_string(id));
+            dispatcher->Perform({ id, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(id));
+            CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher->Revoke("ch-" + std::to_string(id)));
+        }
+        CASPER_JOB_TEST_ASSERT(check, 15 == completions);
+        CASPER_JOB_TEST_ASSERT(check, loop.pending() > 0);
+        delete dispatcher;
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, 15 == completions);
+        CASPER_JOB_TEST_ASSERT(check, 0 == loop.pending());
+    });
+
+    return check.Summary(argv[0]);
+}
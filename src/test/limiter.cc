@@ -0,0 +1,173 @@
+/**
+ * @file limiter.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/limiter.h"
+
+#include "check.h"
+
+/**
+ * @brief Load a limiter configuration from a JSON string.
+ *
+ * @param a_json JSON object.
+ *
+ * @return See \link ::casper::job::deferrable::Limiter::Config \link.
+ */
+static ::casper::job::deferrable::Limiter::Config Load (const char* const a_json)
+{
+    Json::Value config;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, config);
+    return ::casper::job::deferrable::Limiter::Load(config);
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("acquire up to limit", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 3, \"min\": 1, \"max\": 10}"));
+        for ( size_t idx = 0 ; idx < 3 ; ++idx ) {
+            CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        }
+        CASPER_JOB_TEST_ASSERT(check, false == limiter.Acquire());
+        CASPER_JOB_TEST_ASSERT(check, 3 == limiter.metrics().in_flight_);
+        // ... a released slot can be acquired again ...
+        limiter.Abort();
+        CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        CASPER_JOB_TEST_ASSERT(check, false == limiter.Acquire());
+    });
+
+    check.Case("grow while rtt is steady", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 4, \"min\": 1, \"max\": 10, \"smoothing\": 1.0}"));
+        size_t previous = limiter.metrics().limit_;
+        for ( size_t round = 0 ; round < 5 ; ++round ) {
+            while ( true == limiter.Acquire() ) {
+                /* saturate */
+            }
+            limiter.Release(/* a_rtt */ 10, /* a_failed */ false);
+            CASPER_JOB_TEST_ASSERT(check, limiter.metrics().limit_ >= previous);
+            previous = limiter.metrics().limit_;
+            while ( limiter.metrics().in_flight_ > 0 ) {
+                limiter.Abort();
+            }
+        }
+        CASPER_JOB_TEST_ASSERT(check, 10 == limiter.metrics().limit_);
+    });
+
+    check.Case("no growth while under used", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 8, \"min\": 1, \"max\": 20, \"smoothing\": 1.0}"));
+        for ( size_t round = 0 ; round < 10 ; ++round ) {
+            CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+            limiter.Release(/* a_rtt */ 10, /* a_failed */ false);
+        }
+        CASPER_JOB_TEST_ASSERT(check, 8 == limiter.metrics().limit_);
+    });
+
+    check.Case("shrink when rtt inflates", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 10, \"min\": 1, \"max\": 10, \"smoothing\": 1.0, \"window\": 1000}"));
+        // ... establish baseline ...
+        while ( true == limiter.Acquire() ) {
+            /* saturate */
+        }
+        limiter.Release(/* a_rtt */ 10, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, 10 == limiter.metrics().limit_);
+        // ... 10x RTT, gradient is clamped to 0.5 ...
+        limiter.Release(/* a_rtt */ 100, /* a_failed */ false);
+        CASPER_JOB_TEST_ASSERT(check, limiter.metrics().limit_ < 10);
+        CASPER_JOB_TEST_ASSERT(check, 100.0 == limiter.metrics().rtt_);
+    });
+
+    check.Case("back off to min on failures", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 16, \"min\": 2, \"max\": 32, \"backoff\": 0.5}"));
+        CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        limiter.Release(/* a_rtt */ 10, /* a_failed */ true);
+        CASPER_JOB_TEST_ASSERT(check, 8 == limiter.metrics().limit_);
+        for ( size_t round = 0 ; round < 10 ; ++round ) {
+            CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+            limiter.Release(/* a_rtt */ 10, /* a_failed */ true);
+        }
+        CASPER_JOB_TEST_ASSERT(check, 2 == limiter.metrics().limit_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == limiter.metrics().in_flight_);
+    });
+
+    check.Case("abort keeps limit", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 2, \"min\": 1, \"max\": 10}"));
+        CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        limiter.Abort();
+        limiter.Abort();
+        // ... extra aborts must not underflow ...
+        limiter.Abort();
+        CASPER_JOB_TEST_ASSERT(check, 0 == limiter.metrics().in_flight_);
+        CASPER_JOB_TEST_ASSERT(check, 2 == limiter.metrics().limit_);
+        CASPER_JOB_TEST_ASSERT(check, 0.0 == limiter.metrics().baseline_);
+    });
+
+    check.Case("reject is accounted", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        limiter.Setup(Load("{\"initial\": 1, \"min\": 1, \"max\": 1}"));
+        CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        CASPER_JOB_TEST_ASSERT(check, false == limiter.Acquire());
+        limiter.Reject();
+        CASPER_JOB_TEST_ASSERT(check, 1 == limiter.metrics().rejected_);
+        limiter.Reset();
+        CASPER_JOB_TEST_ASSERT(check, 0 == limiter.metrics().rejected_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == limiter.metrics().in_flight_);
+    });
+
+    check.Case("disabled limiter always acquires", [&check] () {
+        ::casper::job::deferrable::Limiter limiter;
+        CASPER_JOB_TEST_ASSERT(check, false == limiter.enabled());
+        for ( size_t idx = 0 ; idx < 1000 ; ++idx ) {
+            CASPER_JOB_TEST_ASSERT(check, true == limiter.Acquire());
+        }
+        limiter.Release(/* a_rtt */ 10, /* a_failed */ true);
+        CASPER_JOB_TEST_ASSERT(check, 999 == limiter.metrics().in_flight_);
+    });
+
+    check.Case("invalid configuration", [&check] () {
+        const char* const configs[] = {
+            "{\"initial\": 0, \"min\": 0}",
+            "{\"initial\": 5, \"min\": 10, \"max\": 20}",
+            "{\"initial\": 5, \"min\": 1, \"max\": 4}",
+            "{\"tolerance\": 0.5}",
+            "{\"backoff\": 1.0}",
+            "{\"smoothing\": 0.0}",
+            "{\"window\": 0}"
+        };
+        for ( const auto config : configs ) {
+            bool thrown = false;
+            try {
+                (void)Load(config);
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}
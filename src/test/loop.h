@@ -0,0 +1,221 @@
+/**
+ * @file loop.h
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+#ifndef CASPER_JOB_TEST_LOOP_H_
+#define CASPER_JOB_TEST_LOOP_H_
+
+#include "casper/job/deferrable/deferred.h"
+
+#include <inttypes.h>
+#include <string>
+#include <map>
+#include <utility>    // std::pair
+#include <functional> // std::function
+
+namespace casper
+{
+
+    namespace job
+    {
+
+        namespace test
+        {
+
+            /**
+             * @brief Single threaded, virtual time, stand-in for 'main' and 'looper' threads.
+             *
+             * Callbacks run in due time order, ties in scheduling order; time only advances when a callback runs,
+             * so delays of any size cost nothing and a run is reproducible.
+             */
+            class Loop final
+            {
+
+            private: // Data Type(s)
+
+                typedef struct {
+                    std::string           id_;       //!< Looper callback ID, empty for 'main' thread callbacks.
+                    std::function<void()> function_;
+                } Event;
+
+                typedef std::map<std::pair<size_t, uint64_t>, Event> EventsMap; //!< Due time and scheduling order -> Event
+
+            private: // Data
+
+                size_t    now_;      //!< Virtual time, in ms.
+                uint64_t  sequence_; //!< Last scheduling order.
+                EventsMap events_;
+
+            public: // Constructor(s) / Destructor
+
+                Loop ();
+                virtual ~Loop ();
+
+            public: // Method(s) / Function(s)
+
+                void   Post   (std::function<void()> a_function, const size_t a_delay);
+                void   Post   (const std::string& a_id, std::function<void(const std::string&)> a_function, const size_t a_delay);
+                void   Cancel (const std::string& a_id);
+                size_t Run    ();
+
+                template <class A>
+                typename ::casper::job::deferrable::Deferred<A>::Callbacks Callbacks (std::function<void(const ::casper::job::deferrable::Deferred<A>*)> a_on_completed);
+
+            public: // Inline Method(s) / Function(s)
+
+                /**
+                 * @return Virtual time, in ms.
+                 */
+                inline size_t now () const
+                {
+                    return now_;
+                }
+
+                /**
+                 * @return Number of pending callbacks.
+                 */
+                inline size_t pending () const
+                {
+                    return events_.size();
+                }
+
+            }; // end of class 'Loop'
+
+            /**
+             * @brief Default constructor.
+             */
+            inline Loop::Loop ()
+                : now_(0), sequence_(0)
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Destructor, pending callbacks are discarded.
+             */
+            inline Loop::~Loop ()
+            {
+                /* empty */
+            }
+
+            /**
+             * @brief Schedule a 'main' thread callback.
+             *
+             * @param a_function Function to call.
+             * @param a_delay    Amount of time ( in ms ) to delay call, 0 none.
+             */
+            inline void Loop::Post (std::function<void()> a_function, const size_t a_delay)
+            {
+                events_[std::make_pair(now_ + a_delay, ++sequence_)] = { "", a_function };
+            }
+
+            /**
+             * @brief Schedule a 'looper' thread callback.
+             *
+             * @param a_id       Callback ID.
+             * @param a_function Function to call.
+             * @param a_delay    Amount of time ( in ms ) to delay call, 0 none.
+             */
+            inline void Loop::Post (const std::string& a_id, std::function<void(const std::string&)> a_function, const size_t a_delay)
+            {
+                events_[std::make_pair(now_ + a_delay, ++sequence_)] = { a_id, [a_id, a_function] () { a_function(a_id); } };
+            }
+
+            /**
+             * @brief Cancel pending 'looper' thread callbacks.
+             *
+             * @param a_id Callback ID.
+             */
+            inline void Loop::Cancel (const std::string& a_id)
+            {
+                for ( auto it = events_.begin() ; events_.end() != it ; ) {
+                    if ( a_id == it->second.id_ ) {
+                        it = events_.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            /**
+             * @brief Run callbacks until none is pending.
+             *
+             * @return Number of callbacks run.
+             */
+            inline size_t Loop::Run ()
+            {
+                size_t count = 0;
+                while ( 0 != events_.size() ) {
+                    const auto  it    = events_.begin();
+                    const Event event = it->second;
+                    now_ = it->first.first;
+                    events_.erase(it);
+                    event.function_();
+                    count++;
+                }
+                return count;
+            }
+
+            /**
+             * @brief Build the callbacks a dispatcher needs to run on this loop, logging is discarded.
+             *
+             * @param a_on_completed Function to call when a request completes.
+             *
+             * @return See \link ::casper::job::deferrable::Deferred<A>::Callbacks \link.
+             */
+            template <class A>
+            typename ::casper::job::deferrable::Deferred<A>::Callbacks Loop::Callbacks (std::function<void(const ::casper::job::deferrable::Deferred<A>*)> a_on_completed)
+            {
+                using Deferred = ::casper::job::deferrable::Deferred<A>;
+                return {
+                    /* on_progress_                */ [] (const Deferred*) { },
+                    /* on_changed_                 */ [] (const Deferred*) { },
+                    /* on_completed_               */ a_on_completed,
+                    /* on_main_thread_             */ [this] (std::function<void()> a_function) {
+                        Post(a_function, 0);
+                    },
+                    /* on_main_thread_deferred_    */ [this] (std::function<void()> a_function, const size_t a_delay) {
+                        Post(a_function, a_delay);
+                    },
+                    /* on_looper_thread_           */ [this] (const std::string& a_id, std::function<void(const std::string&)> a_function) {
+                        Post(a_id, a_function, 0);
+                    },
+                    /* on_looper_thread_deferred_  */ [this] (const std::string& a_id, std::function<void(const std::string&)> a_function, const size_t a_delay) {
+                        Post(a_id, a_function, a_delay);
+                    },
+                    /* try_cancel_on_looper_thread_ */ [this] (const std::string& a_id) {
+                        Cancel(a_id);
+                    },
+                    /* on_log_deferred_step_       */ [] (const Deferred*, const std::string&) { },
+                    /* on_log_deferred_debug_      */ [] (const Deferred*, const std::string&) { },
+                    /* on_log_deferred_error_      */ [] (const Deferred*, const std::string&) { },
+                    /* on_log_deferred_verbose_    */ [] (const Deferred*, const std::string&) { },
+                    /* on_log_deferred_            */ [] (const Deferred*, const size_t, const char* const, const std::string&) { },
+                    /* on_log_tracking_            */ [] (const ::casper::job::deferrable::Tracking&, const size_t, const char* const, const std::string&) { }
+                };
+            }
+
+        } // end of namespace 'test'
+
+    } // end of namespace 'job'
+
+} // end of namespace 'casper'
+
+#endif // CASPER_JOB_TEST_LOOP_H_
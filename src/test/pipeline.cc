@@ -0,0 +1,233 @@
+/**
+ * @file pipeline.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/pipeline.h"
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+#include <vector>
+#include <cmath> // std::abs
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+
+/**
+ * @brief Job steps, one per stage.
+ */
+enum class Step : uint8_t {
+    Fetch = 10,
+    Transform,
+    Done = 100
+};
+
+typedef ::casper::job::deferrable::Pipeline<Step> Pipeline;
+
+/**
+ * @brief Runs a pipeline the way a deferrable tube does: completed stages unblock their dependents, a failed stage settles it.
+ */
+class Driver final
+{
+
+public: // Data
+
+    ::casper::job::test::Loop     loop_;
+    Dispatcher                    dispatcher_;
+    std::map<std::string, double> latencies_; //!< Stage name -> Simulated latency, in ms; negative for a failure.
+    std::map<std::string, size_t> launched_;  //!< Stage name -> Launch time.
+    std::map<std::string, Pipeline::Outputs> inputs_; //!< Stage name -> Outputs available when it was launched.
+    uint16_t                      code_;      //!< Job response code, 0 while running.
+    size_t                        finished_;  //!< Job completion time.
+    Pipeline*                     pipeline_;
+
+public: // Constructor(s) / Destructor
+
+    Driver ()
+        : code_(0), finished_(0), pipeline_(nullptr)
+    {
+        dispatcher_.Bind(loop_.Callbacks<Arguments>([this] (const Deferred* a_deferred) {
+            const size_t stage     = pipeline_->Find(a_deferred->id_);
+            const bool   succeeded = ( CC_STATUS_CODE_OK == a_deferred->response().code() );
+            (void)pipeline_->Complete(stage, a_deferred->response(), succeeded);
+            if ( true == pipeline_->settled() ) {
+                return;
+            }
+            if ( false == succeeded ) {
+                pipeline_->Settle();
+                Finish(a_deferred->response().code());
+            } else if ( true == pipeline_->finished() ) {
+                pipeline_->Settle();
+                Json::Value payload;
+                Finish(pipeline_->conclusion()(pipeline_->outputs(), payload));
+            } else {
+                Launch();
+            }
+        }));
+    }
+
+    virtual ~Driver ()
+    {
+        delete pipeline_;
+    }
+
+public: // Method(s) / Function(s)
+
+    /**
+     * @return A stage that performs a request with it's configured latency.
+     *
+     * @param a_name  Stage name.
+     * @param a_after Names of the stages it depends on.
+     */
+    Pipeline::Stage Stage (const std::string& a_name, const std::vector<std::string>& a_after)
+    {
+        return { a_name, Step::Fetch, a_after, [this, a_name] (const std::string& a_id, const Pipeline::Outputs& a_outputs) {
+            launched_[a_name] = loop_.now();
+            inputs_[a_name]   = a_outputs;
+            Json::Value profile = Json::Value(Json::ValueType::objectValue);
+            profile["latency"]  = std::abs(latencies_[a_name]);
+            if ( latencies_[a_name] < 0.0 ) {
+                profile["error-rate"] = 1.0;
+            }
+            dispatcher_.Setup(Dispatcher::Load(profile));
+            dispatcher_.Perform({ 1, "", "", "ch-1", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), a_id);
+        }};
+    }
+
+    /**
+     * @brief Run stages to completion.
+     *
+     * @param a_stages Stages.
+     */
+    void Run (const std::vector<Pipeline::Stage>& a_stages)
+    {
+        pipeline_ = new Pipeline("ch-1", a_stages, [] (const Pipeline::Outputs& a_outputs, Json::Value& /* o_payload */) -> uint16_t {
+            return ( 4 == a_outputs.size() ? CC_STATUS_CODE_OK : CC_STATUS_CODE_INTERNAL_SERVER_ERROR );
+        });
+        Launch();
+        loop_.Run();
+    }
+
+private: // Method(s) / Function(s)
+
+    /**
+     * @brief Launch all stages whose dependencies succeeded.
+     */
+    void Launch ()
+    {
+        std::vector<size_t> ready;
+        pipeline_->Ready(ready);
+        for ( const auto stage : ready ) {
+            pipeline_->stage(stage).launch_(pipeline_->id(stage), pipeline_->outputs());
+        }
+    }
+
+    /**
+     * @brief Keep track of job outcome.
+     *
+     * @param a_code Job response code.
+     */
+    void Finish (const uint16_t a_code)
+    {
+        code_     = a_code;
+        finished_ = loop_.now();
+    }
+
+}; // end of class 'Driver'
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("independent stages run concurrently", [&check] () {
+        Driver driver;
+        driver.latencies_ = { { "a", 10.0 }, { "b", 20.0 }, { "c", 40.0 }, { "d", 10.0 } };
+        driver.Run({ driver.Stage("d", { "b", "c" }), driver.Stage("b", { "a" }), driver.Stage("c", { "a" }), driver.Stage("a", {}) });
+        CASPER_JOB_TEST_ASSERT(check, 0  == driver.launched_["a"]);
+        CASPER_JOB_TEST_ASSERT(check, 10 == driver.launched_["b"]);
+        CASPER_JOB_TEST_ASSERT(check, 10 == driver.launched_["c"]);
+        // ... once it's slowest dependency is done ...
+        CASPER_JOB_TEST_ASSERT(check, 50 == driver.launched_["d"]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == driver.code_);
+        CASPER_JOB_TEST_ASSERT(check, 60 == driver.finished_);
+    });
+
+    check.Case("outputs are shared with dependents", [&check] () {
+        Driver driver;
+        driver.latencies_ = { { "a", 10.0 }, { "b", 20.0 }, { "c", 40.0 }, { "d", 10.0 } };
+        driver.Run({ driver.Stage("a", {}), driver.Stage("b", { "a" }), driver.Stage("c", { "a" }), driver.Stage("d", { "b", "c" }) });
+        CASPER_JOB_TEST_ASSERT(check, 0 == driver.inputs_["a"].size());
+        CASPER_JOB_TEST_ASSERT(check, 3 == driver.inputs_["d"].size());
+        // ... never copied ...
+        CASPER_JOB_TEST_ASSERT(check, driver.inputs_["b"]["a"].get() == driver.inputs_["c"]["a"].get());
+        CASPER_JOB_TEST_ASSERT(check, driver.inputs_["b"]["a"].get() == driver.pipeline_->outputs().find("a")->second.get());
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK == driver.inputs_["d"]["c"]->code());
+    });
+
+    check.Case("a failed stage stops the pipeline", [&check] () {
+        Driver driver;
+        driver.latencies_ = { { "a", 10.0 }, { "b", -20.0 }, { "c", 40.0 }, { "d", 10.0 } };
+        driver.Run({ driver.Stage("a", {}), driver.Stage("b", { "a" }), driver.Stage("c", { "a" }), driver.Stage("d", { "b", "c" }) });
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_SERVICE_UNAVAILABLE == driver.code_);
+        CASPER_JOB_TEST_ASSERT(check, 30 == driver.finished_);
+        // ... late stage is accounted, but it unblocks nothing ...
+        CASPER_JOB_TEST_ASSERT(check, driver.launched_.end() == driver.launched_.find("d"));
+        CASPER_JOB_TEST_ASSERT(check, 0 == driver.pipeline_->running());
+        CASPER_JOB_TEST_ASSERT(check, false == driver.pipeline_->finished());
+    });
+
+    check.Case("hedged stages answer for their primary", [&check] () {
+        Driver driver;
+        Pipeline pipeline("ch-1", { driver.Stage("a", {}), driver.Stage("b", { "a" }) }, [] (const Pipeline::Outputs&, Json::Value&) -> uint16_t {
+            return CC_STATUS_CODE_OK;
+        });
+        CASPER_JOB_TEST_ASSERT(check, "ch-1@b" == pipeline.id(1));
+        CASPER_JOB_TEST_ASSERT(check, 1 == pipeline.Find(::casper::job::deferrable::Hedger::Hedge("ch-1@b")));
+        CASPER_JOB_TEST_ASSERT(check, pipeline.size() == pipeline.Find("ch-2@b"));
+    });
+
+    check.Case("invalid graphs", [&check] () {
+        Driver driver;
+        const Pipeline::Conclusion conclusion = [] (const Pipeline::Outputs&, Json::Value&) -> uint16_t {
+            return CC_STATUS_CODE_OK;
+        };
+        const std::vector<std::vector<Pipeline::Stage>> invalid = {
+            /* empty      */ {},
+            /* duplicated */ { driver.Stage("a", {}), driver.Stage("a", {}) },
+            /* unknown    */ { driver.Stage("a", { "z" }) },
+            /* cycle      */ { driver.Stage("a", {}), driver.Stage("b", { "a", "c" }), driver.Stage("c", { "b" }) },
+            /* no launch  */ { { "a", Step::Transform, {}, nullptr } }
+        };
+        for ( const auto& stages : invalid ) {
+            bool thrown = false;
+            try {
+                Pipeline pipeline("ch-1", stages, conclusion);
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}
@@ -0,0 +1,362 @@
+/**
+ * @file spill.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/spill.h"
+
+#include "cc/easy/json.h"
+
+#include "check.h"
+
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>   // mkdtemp
+#include <dirent.h>   // opendir, readdir, closedir
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const std::string& a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+/**
+ * @return Names of the files in a directory.
+ *
+ * @param a_directory Directory path.
+ */
+static std::vector<std::string> List (const std::string& a_directory)
+{
+    std::vector<std::string> names;
+    DIR* dir = opendir(a_directory.c_str());
+    if ( nullptr == dir ) {
+        throw ::cc::Exception("Unable to open directory '%s'!", a_directory.c_str());
+    }
+    for ( struct dirent* entry = readdir(dir) ; nullptr != entry ; entry = readdir(dir) ) {
+        const std::string name = entry->d_name;
+        if ( "." != name && ".." != name ) {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    return names;
+}
+
+/**
+ * @return File contents.
+ *
+ * @param a_path File path.
+ */
+static std::string Read (const std::string& a_path)
+{
+    std::ifstream     file(a_path, std::ios::binary);
+    std::stringstream contents; contents << file.rdbuf();
+    return contents.str();
+}
+
+/**
+ * @brief Temporary directory, removed with it's files when disposed.
+ */
+class Directory final
+{
+
+private: // Data
+
+    std::string path_;
+
+public: // Constructor(s) / Destructor
+
+    Directory ()
+    {
+        char pattern[] = "/tmp/casper-job-spill-XXXXXX";
+        if ( nullptr == mkdtemp(pattern) ) {
+            throw ::cc::Exception("%s", "Unable to create temporary directory!");
+        }
+        path_ = std::string(pattern) + "/";
+    }
+
+    ~Directory ()
+    {
+        for ( const auto& name : List(path_) ) {
+            unlink((path_ + name).c_str());
+        }
+        rmdir(path_.c_str());
+    }
+
+public: // Inline Method(s) / Function(s)
+
+    inline const std::string& path () const
+    {
+        return path_;
+    }
+
+}; // end of class 'Directory'
+
+/**
+ * @return Spill configuration for a directory.
+ *
+ * @param a_directory Directory.
+ * @param a_threshold Threshold, in bytes.
+ */
+static ::casper::job::Spill::Config Config (const Directory& a_directory, const size_t a_threshold)
+{
+    return ::casper::job::Spill::Load(Parse("{\"threshold\": " + std::to_string(a_threshold) + "}"), a_directory.path());
+}
+
+/**
+ * @return True if mapping a file throws.
+ *
+ * @param a_file See \link ::casper::job::Spill::File \link.
+ */
+static bool Rejected (const ::casper::job::Spill::File& a_file)
+{
+    try {
+        const ::casper::job::Spill::Mapping mapping(a_file);
+    } catch (const ::cc::Exception& /* a_cc_exception */) {
+        return true;
+    }
+    return false;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("crc32 matches zlib", [&check] () {
+        CASPER_JOB_TEST_ASSERT(check, 0xCBF43926U == ::casper::job::Spill::CRC32(0, "123456789", 9));
+        CASPER_JOB_TEST_ASSERT(check, 0 == ::casper::job::Spill::CRC32(0, "", 0));
+        // ... incremental ...
+        const uint32_t partial = ::casper::job::Spill::CRC32(0, "12345", 5);
+        CASPER_JOB_TEST_ASSERT(check, 0xCBF43926U == ::casper::job::Spill::CRC32(partial, "6789", 4));
+    });
+
+    check.Case("small outputs are kept", [&check] () {
+        const Directory directory;
+        ::casper::job::Spill spill(Config(directory, 1024));
+        ::casper::job::Spill::File file = { "untouched", 0, 0, "" };
+        CASPER_JOB_TEST_ASSERT(check, false == spill.Write("small", std::string(1024, 'a'), "application/octet-stream", file));
+        CASPER_JOB_TEST_ASSERT(check, false == spill.Write("small", [] (std::ostream& a_stream) { a_stream << std::string(1000, 'b'); }, "text/plain", file));
+        CASPER_JOB_TEST_ASSERT(check, false == spill.Write("small", Parse("{\"a\": 1}"), file));
+        CASPER_JOB_TEST_ASSERT(check, "untouched" == file.path_);
+        CASPER_JOB_TEST_ASSERT(check, 3 == spill.stats().kept_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == spill.stats().spilled_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == List(directory.path()).size());
+        // ... unless forced ...
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("forced", [] (std::ostream& a_stream) { a_stream << "tiny"; }, "text/plain", file, /* a_force */ true));
+        CASPER_JOB_TEST_ASSERT(check, "tiny" == Read(file.path_));
+    });
+
+    check.Case("large outputs are spilled and mapped", [&check] () {
+        const Directory directory;
+        ::casper::job::Spill spill(Config(directory, 1024));
+        std::string data;
+        for ( size_t idx = 0 ; data.length() < 300 * 1024 ; ++idx ) {
+            data += "line " + std::to_string(idx) + "\n";
+        }
+        ::casper::job::Spill::File file;
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("data", data, "text/plain", file));
+        CASPER_JOB_TEST_ASSERT(check, 0 == file.path_.compare(0, directory.path().length(), directory.path()));
+        CASPER_JOB_TEST_ASSERT(check, data.length() == file.size_);
+        CASPER_JOB_TEST_ASSERT(check, ::casper::job::Spill::CRC32(0, data.c_str(), data.length()) == file.crc32_);
+        CASPER_JOB_TEST_ASSERT(check, "text/plain" == file.content_type_);
+        CASPER_JOB_TEST_ASSERT(check, data == Read(file.path_));
+        {
+            const ::casper::job::Spill::Mapping mapping(file);
+            CASPER_JOB_TEST_ASSERT(check, data.length() == mapping.size());
+            CASPER_JOB_TEST_ASSERT(check, 0 == data.compare(0, data.length(), mapping.data(), mapping.size()));
+        }
+        // ... streamed in pieces, crossing threshold and put area many times ...
+        ::casper::job::Spill::File streamed;
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("streamed", [] (std::ostream& a_stream) {
+            for ( size_t idx = 0 ; idx < 300 * 1024 / 6 ; ++idx ) {
+                a_stream << "line " << std::to_string(idx) << "\n";
+            }
+        }, "text/plain", streamed));
+        CASPER_JOB_TEST_ASSERT(check, streamed.size_ > 300 * 1024);
+        CASPER_JOB_TEST_ASSERT(check, streamed.size_ == Read(streamed.path_).length());
+        CASPER_JOB_TEST_ASSERT(check, false == Rejected(streamed));
+        CASPER_JOB_TEST_ASSERT(check, 2 == spill.stats().spilled_);
+        CASPER_JOB_TEST_ASSERT(check, file.size_ + streamed.size_ == spill.stats().bytes_);
+    });
+
+    check.Case("json values are streamed", [&check] () {
+        const Directory directory;
+        ::casper::job::Spill spill(Config(directory, 64));
+        Json::Value value = Json::Value(Json::ValueType::objectValue);
+        for ( Json::Int idx = 0 ; idx < 1000 ; ++idx ) {
+            value["items"].append(idx);
+        }
+        value["name"] = "spilled";
+        ::casper::job::Spill::File file;
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("value", value, file));
+        CASPER_JOB_TEST_ASSERT(check, "application/json" == file.content_type_);
+        CASPER_JOB_TEST_ASSERT(check, ".json" == file.path_.substr(file.path_.length() - 5));
+        CASPER_JOB_TEST_ASSERT(check, value == Parse(Read(file.path_)));
+    });
+
+    check.Case("json values are measured before they are written", [&check] () {
+        const Directory directory;
+        ::casper::job::Spill spill(Config(directory, 5000));
+        ::casper::job::Spill::File file = { "untouched", 0, 0, "" };
+        // ... serialized as a quoted string, exactly threshold bytes ...
+        CASPER_JOB_TEST_ASSERT(check, false == spill.Write("edge", Json::Value(std::string(4998, 'k')), file));
+        CASPER_JOB_TEST_ASSERT(check, "untouched" == file.path_);
+        CASPER_JOB_TEST_ASSERT(check, 1 == spill.stats().kept_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == List(directory.path()).size());
+        // ... one byte more ...
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("edge", Json::Value(std::string(4999, 's')), file));
+        CASPER_JOB_TEST_ASSERT(check, 5001 == file.size_);
+        CASPER_JOB_TEST_ASSERT(check, "\"" + std::string(4999, 's') + "\"" == Read(file.path_));
+        // ... measuring stops at threshold, value is then written in full ...
+        const Json::Value large = Json::Value(std::string(1024 * 1024, 'l'));
+        ::casper::job::Spill::File spilled;
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("large", large, spilled));
+        CASPER_JOB_TEST_ASSERT(check, 1024 * 1024 + 2 == spilled.size_);
+        CASPER_JOB_TEST_ASSERT(check, large == Parse(Read(spilled.path_)));
+        CASPER_JOB_TEST_ASSERT(check, 1 == spill.stats().kept_);
+        CASPER_JOB_TEST_ASSERT(check, 2 == spill.stats().spilled_);
+    });
+
+    check.Case("references round-trip", [&check] () {
+        const ::casper::job::Spill::File file = { "/tmp/x/y-1-2-3.bin", 123456789012, 0xDEADBEEF, "application/octet-stream" };
+        Json::Value reference;
+        ::casper::job::Spill::Reference(file, reference);
+        CASPER_JOB_TEST_ASSERT(check, true == ::casper::job::Spill::Referenced(reference));
+        // ... as published, through text ...
+        Json::FastWriter jfw;
+        ::casper::job::Spill::File resolved;
+        ::casper::job::Spill::Resolve(Parse(jfw.write(reference)), resolved);
+        CASPER_JOB_TEST_ASSERT(check, file.path_         == resolved.path_);
+        CASPER_JOB_TEST_ASSERT(check, file.size_         == resolved.size_);
+        CASPER_JOB_TEST_ASSERT(check, file.crc32_        == resolved.crc32_);
+        CASPER_JOB_TEST_ASSERT(check, file.content_type_ == resolved.content_type_);
+        // ... not references ...
+        CASPER_JOB_TEST_ASSERT(check, false == ::casper::job::Spill::Referenced(Parse("{\"__spilled__\": {}, \"other\": 1}")));
+        CASPER_JOB_TEST_ASSERT(check, false == ::casper::job::Spill::Referenced(Parse("[1]")));
+        const char* const invalid[] = {
+            "{\"a\": 1}",
+            "{\"__spilled__\": {\"size\": 1, \"crc32\": 1}}",
+            "{\"__spilled__\": {\"path\": \"/x\", \"size\": -1, \"crc32\": 1}}",
+            "{\"__spilled__\": {\"path\": \"/x\", \"size\": 1, \"crc32\": 4294967296}}"
+        };
+        for ( const auto json : invalid ) {
+            bool thrown = false;
+            try {
+                ::casper::job::Spill::Resolve(Parse(json), resolved);
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    check.Case("mapping verifies size and checksum", [&check] () {
+        const Directory directory;
+        ::casper::job::Spill spill(Config(directory, 16));
+        ::casper::job::Spill::File file;
+        CASPER_JOB_TEST_ASSERT(check, true == spill.Write("verify", std::string(4096, 'v'), "application/octet-stream", file));
+        CASPER_JOB_TEST_ASSERT(check, ".bin" == file.path_.substr(file.path_.length() - 4));
+        CASPER_JOB_TEST_ASSERT(check, false == Rejected(file));
+        ::casper::job::Spill::File wrong = file;
+        wrong.size_++;
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(wrong));
+        wrong = file;
+        wrong.crc32_ ^= 1;
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(wrong));
+        {
+            // ... unverified, whatever it's checksum ...
+            const ::casper::job::Spill::Mapping mapping(wrong, /* a_verify */ false);
+            CASPER_JOB_TEST_ASSERT(check, 4096 == mapping.size());
+        }
+        wrong = file;
+        wrong.path_ += ".missing";
+        CASPER_JOB_TEST_ASSERT(check, true == Rejected(wrong));
+    });
+
+    check.Case("file names are unique", [&check] () {
+        const Directory directory;
+        std::vector<std::string> paths;
+        for ( size_t round = 0 ; round < 3 ; ++round ) {
+            // ... a new instance, e.g. tube re-created after a reload, must not reuse names ...
+            ::casper::job::Spill spill(Config(directory, 0));
+            for ( size_t idx = 0 ; idx < 3 ; ++idx ) {
+                ::casper::job::Spill::File file;
+                CASPER_JOB_TEST_ASSERT(check, true == spill.Write("same", std::string("x"), "text/plain", file));
+                paths.push_back(file.path_);
+            }
+        }
+        CASPER_JOB_TEST_ASSERT(check, 9 == List(directory.path()).size());
+        for ( size_t idx = 0 ; idx < paths.size() ; ++idx ) {
+            for ( size_t other = idx + 1 ; other < paths.size() ; ++other ) {
+                CASPER_JOB_TEST_ASSERT(check, paths[idx] != paths[other]);
+            }
+        }
+    });
+
+    check.Case("failed outputs leave no file", [&check] () {
+        const Directory directory;
+        ::casper::job::Spill spill(Config(directory, 16));
+        ::casper::job::Spill::File file;
+        bool thrown = false;
+        try {
+            (void)spill.Write("failed", [] (std::ostream& a_stream) {
+                a_stream << std::string(128 * 1024, 'f');
+                throw ::cc::Exception("%s", "producer failed");
+            }, "text/plain", file);
+        } catch (const ::cc::Exception& /* a_cc_exception */) {
+            thrown = true;
+        }
+        CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        CASPER_JOB_TEST_ASSERT(check, 0 == List(directory.path()).size());
+    });
+
+    check.Case("configuration", [&check] () {
+        const ::casper::job::Spill::Config disabled = ::casper::job::Spill::Load(Json::Value::null, "/tmp");
+        CASPER_JOB_TEST_ASSERT(check, false == disabled.enabled_);
+        ::casper::job::Spill spill(disabled);
+        ::casper::job::Spill::File file;
+        CASPER_JOB_TEST_ASSERT(check, false == spill.Write("off", std::string(10 * 1024 * 1024, 'o'), "text/plain", file));
+        CASPER_JOB_TEST_ASSERT(check, 0 == spill.stats().kept_);
+        const ::casper::job::Spill::Config config = ::casper::job::Spill::Load(Parse("{\"directory\": \"/var/tmp\"}"), "/tmp");
+        CASPER_JOB_TEST_ASSERT(check, true == config.enabled_);
+        CASPER_JOB_TEST_ASSERT(check, "/var/tmp/" == config.directory_);
+        CASPER_JOB_TEST_ASSERT(check, 1024 * 1024 == config.threshold_);
+        const char* const invalid[] = { "[]", "{\"threshold\": -1}", "{\"directory\": 1}", "{}" };
+        for ( const auto json : invalid ) {
+            bool thrown = false;
+            try {
+                (void)::casper::job::Spill::Load(Parse(json), "");
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}
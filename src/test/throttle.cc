@@ -0,0 +1,141 @@
+/**
+ * @file throttle.cc
+ *
+ * Copyright (c) 2011-2021 Cloudware S.A. All rights reserved.
+ *
+ * This file is part of casper-job.
+ *
+ * casper-job is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * casper-job  is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with casper-job. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "casper/job/deferrable/fake/dispatcher.h"
+
+#include "check.h"
+#include "loop.h"
+
+#include <map>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+typedef ::casper::job::deferrable::Arguments<Json::Value>      Arguments;
+typedef ::casper::job::deferrable::Deferred<Arguments>         Deferred;
+typedef ::casper::job::deferrable::fake::Dispatcher<Arguments> Dispatcher;
+typedef ::casper::job::deferrable::Throttle                    Throttle;
+
+/**
+ * @brief Parse a JSON string.
+ *
+ * @param a_json JSON string.
+ *
+ * @return JSON value.
+ */
+static Json::Value Parse (const char* const a_json)
+{
+    Json::Value value;
+    const ::cc::easy::JSON<::cc::Exception> json; json.Parse(a_json, value);
+    return value;
+}
+
+int main (int /* argc */, char** argv)
+{
+    ::casper::job::test::Check check;
+
+    check.Case("burst then wait for a token", [&check] () {
+        Throttle throttle;
+        throttle.Setup(Throttle::Load(Parse("{\"rate\": 1.0, \"burst\": 3.0}")));
+        for ( size_t idx = 0 ; idx < 3 ; ++idx ) {
+            CASPER_JOB_TEST_ASSERT(check, 0 == throttle.Take(""));
+        }
+        const size_t delay = throttle.Take("");
+        CASPER_JOB_TEST_ASSERT(check, delay > 900 && delay <= 1000);
+        CASPER_JOB_TEST_ASSERT(check, 3 == throttle.stats().passed_);
+    });
+
+    check.Case("tokens are refilled over time", [&check] () {
+        Throttle throttle;
+        throttle.Setup(Throttle::Load(Parse("{\"rate\": 100.0, \"burst\": 1.0}")));
+        CASPER_JOB_TEST_ASSERT(check, 0 == throttle.Take(""));
+        CASPER_JOB_TEST_ASSERT(check, 0 != throttle.Take(""));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CASPER_JOB_TEST_ASSERT(check, 0 == throttle.Take(""));
+    });
+
+    check.Case("each tenant has it's own bucket", [&check] () {
+        Throttle throttle;
+        throttle.Setup(Throttle::Load(Parse("{\"tenant\": \"tenant\", \"tenant-rate\": 1.0}")));
+        CASPER_JOB_TEST_ASSERT(check, 0 == throttle.Take("a"));
+        CASPER_JOB_TEST_ASSERT(check, 0 != throttle.Take("a"));
+        CASPER_JOB_TEST_ASSERT(check, 0 == throttle.Take("b"));
+        // ... unknown tenant is not limited, there's no dispatcher limit ...
+        for ( size_t idx = 0 ; idx < 10 ; ++idx ) {
+            CASPER_JOB_TEST_ASSERT(check, 0 == throttle.Take(""));
+        }
+        CASPER_JOB_TEST_ASSERT(check, 2 == throttle.stats().tenants_);
+    });
+
+    check.Case("dispatcher rejects requests that would wait too long", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::map<std::string, uint16_t> codes;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&codes] (const Deferred* a_deferred) {
+            codes[a_deferred->id_] = a_deferred->response().code();
+        }));
+        dispatcher.Ration(Throttle::Load(Parse("{\"rate\": 1.0, \"burst\": 2.0, \"max-wait\": 100}")));
+        for ( uint64_t id = 1 ; id <= 3 ; ++id ) {
+            dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Json::Value(Json::ValueType::objectValue)), "rq-" + std::to_string(id));
+        }
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK                == codes["rq-1"]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_OK                == codes["rq-2"]);
+        CASPER_JOB_TEST_ASSERT(check, CC_STATUS_CODE_TOO_MANY_REQUESTS == codes["rq-3"]);
+        CASPER_JOB_TEST_ASSERT(check, 1 == dispatcher.metrics().throttle_.expired_);
+    });
+
+    check.Case("dispatcher paces requests of the same tenant in order", [&check] () {
+        ::casper::job::test::Loop loop;
+        std::vector<std::string> order;
+        Dispatcher dispatcher;
+        dispatcher.Bind(loop.Callbacks<Arguments>([&order] (const Deferred* a_deferred) {
+            order.push_back(a_deferred->id_);
+        }));
+        dispatcher.Ration(Throttle::Load(Parse("{\"tenant\": \"tenant\", \"tenant-rate\": 200.0, \"tenant-burst\": 1.0}")));
+        dispatcher.Setup(Dispatcher::Load(Parse("{\"latency\": 0.0}")));
+        for ( uint64_t id = 1 ; id <= 3 ; ++id ) {
+            dispatcher.Perform({ id, "", "", "", "", "" }, Arguments(Parse("{\"tenant\": \"a\"}")), "rq-" + std::to_string(id));
+        }
+        // ... other tenant is not held back ...
+        dispatcher.Perform({ 4, "", "", "", "", "" }, Arguments(Parse("{\"tenant\": \"b\"}")), "rq-4");
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().paced_);
+        loop.Run();
+        CASPER_JOB_TEST_ASSERT(check, ( std::vector<std::string>{ "rq-1", "rq-4", "rq-2", "rq-3" } ) == order);
+        CASPER_JOB_TEST_ASSERT(check, 2 == dispatcher.metrics().throttle_.delayed_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().throttle_.expired_);
+        CASPER_JOB_TEST_ASSERT(check, 0 == dispatcher.metrics().paced_);
+    });
+
+    check.Case("invalid configuration", [&check] () {
+        for ( const char* const config : { "{}", "{\"rate\": -1.0}", "{\"rate\": 1.0, \"burst\": 0.5}", "{\"tenant-rate\": 1.0}" } ) {
+            bool thrown = false;
+            try {
+                (void)Throttle::Load(Parse(config));
+            } catch (const ::cc::Exception& /* a_cc_exception */) {
+                thrown = true;
+            }
+            CASPER_JOB_TEST_ASSERT(check, true == thrown);
+        }
+    });
+
+    return check.Summary(argv[0]);
+}